@@ -1,6 +1,7 @@
 #pragma once
 #include "stdint.h"
 #include "core/thread.h"
+#include "core/coroutine.h"
 
 typedef enum
 {
@@ -14,17 +15,42 @@ typedef struct
     const char*                      name;
     const uint16_t                   stack_size;
     const RHSInternalApplicationFlag flags;
+    const char* const*               provides;  // NULL terminated record names or NULL
+    const char* const*               consumes;  // NULL terminated record names or NULL
 } RHSInternalApplication;
 
 extern const short                  RHS_SERVICES_COUNT;
 extern const RHSInternalApplication RHS_SERVICES[];
 
+typedef struct
+{
+    const RHSCoroutineCallback app;
+    const char*                name;
+    const uint16_t             events;
+} RHSInternalCoService;
+
+extern const short                RHS_CO_SERVICES_COUNT;
+extern const RHSInternalCoService RHS_CO_SERVICES[];
+
 typedef void (*RHSInternalOnStartHook)(void);
 
 extern const short                  RHS_START_UP_COUNT;
 extern const RHSInternalOnStartHook RHS_START_UP[];
+extern const char* const            RHS_START_UP_NAMES[];
 
 typedef void (*RHSInternalOnTestHook)(void);
 
 extern const short                 RHS_TESTS_COUNT;
 extern const RHSInternalOnTestHook RHS_TESTS[];
+
+typedef uint32_t (*RHSInternalBenchmarkCallback)(uint32_t iterations);
+
+typedef struct
+{
+    const RHSInternalBenchmarkCallback run;
+    const char*                        name;
+    const uint32_t                     iterations;
+} RHSInternalBenchmark;
+
+extern const short                RHS_BENCHMARKS_COUNT;
+extern const RHSInternalBenchmark RHS_BENCHMARKS[];
@@ -6,6 +6,8 @@
 
 #define RECORD_CAN_OPEN "can_open"
 
+RHS_RECORD_DECLARE(record_can_open);
+
 typedef struct CanOpenApp CanOpenApp;
 
 void co_start_node(CanOpenApp* app, CO_Data* d, uint8_t id, RHSHalCANId can_id, uint32_t baud);
@@ -35,4 +37,37 @@ OD_GET_FIELD_H(uint32_t, od_get_field_uns32);
 OD_GET_FIELD_H(int32_t, od_get_field_s32);
 OD_GET_FIELD_H(float, od_get_field_float);
 
+/** Mark remote node as set up through SDO, mark is kept over soft reset
+ *
+ * After warm boot the remote node still has its PDO mapping, so check
+ * co_is_node_configured before configuring it again.
+ *
+ * @param      app         CANopen app
+ * @param      d           local OD the node is configured from
+ * @param[in]  id          remote node id
+ * @param[in]  configured  true once PDO mapping is done, false to force it again
+ */
+void co_set_node_configured(CanOpenApp* app, CO_Data* d, uint8_t id, bool configured);
+
+/** Check if remote node was set up before, also before soft reset
+ *
+ * @param      app  CANopen app
+ * @param      d    local OD the node is configured from
+ * @param[in]  id   remote node id
+ *
+ * @return     true if configured
+ */
+bool co_is_node_configured(CanOpenApp* app, CO_Data* d, uint8_t id);
+
+/** Program CAN acceptance filters from COB-IDs of all ODs on channel
+ *
+ * Called by co_start_node. Call it again after changing local SDO client,
+ * RPDO, SYNC or heartbeat consumer entries. Accepts all frames if the ids
+ * don't fit the filter banks.
+ *
+ * @param      app     CANopen app
+ * @param[in]  can_id  CAN channel
+ */
+void co_update_filters(CanOpenApp* app, RHSHalCANId can_id);
+
 uint8_t co_set_field(CanOpenApp* app, CO_Data* d, uint16_t ind, uint8_t sub, const void* data, uint32_t sz);
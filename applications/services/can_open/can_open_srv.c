@@ -5,6 +5,11 @@
 
 extern void can_open_cli(char* args, void* context);
 
+RHS_RECORD_DEFINE(record_can_open, RECORD_CAN_OPEN);
+
+// Reception in the CAN ISR to dispatch, the software share of the RX latency
+RHS_METRIC_HISTOGRAM_DEFINE(can_open_rx_latency, "can_open_rx_latency_us");
+
 static CanOpenApp* can_open_app_alloc(void)
 {
     CanOpenApp* app = malloc(sizeof(CanOpenApp));
@@ -13,12 +18,14 @@ static CanOpenApp* can_open_app_alloc(void)
     app->sdo_event  = rhs_event_flag_alloc();
     app->sdo_mutex  = rhs_mutex_alloc(RHSMutexTypeNormal);
     app->rx_queue   = rhs_message_queue_alloc(32, sizeof(CanOpenAppMessage));
-    app->tx_queue   = rhs_message_queue_alloc(32, sizeof(CanOpenAppMessage));
+    rhs_message_queue_set_name(app->rx_queue, "can_open_rx");
+    app->retained   = rhs_retained_get(RECORD_CAN_OPEN, sizeof(CanOpenRetained), &app->restored);
     TimerInit();
+    rhs_metric_register(&can_open_rx_latency);
 
-    Cli* cli = rhs_record_open(RECORD_CLI);
+    Cli* cli = rhs_record_id_open(&record_cli);
     cli_add_command(cli, "can_open", can_open_cli, app);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 
     extern CanOpenApp* can_open_app; /* co_stack and rtimer use callbacks without context. It makes me use this trash */
     can_open_app = app;
@@ -30,7 +37,6 @@ static void can_open_app_free(CanOpenApp* app)
 {
     rhs_event_flag_free(app->srv_event);
     rhs_message_queue_free(app->rx_queue);
-    rhs_message_queue_free(app->tx_queue);
     rhs_event_flag_free(app->sdo_event);
     rhs_mutex_free(app->sdo_mutex);
     free(app);
@@ -38,17 +44,16 @@ static void can_open_app_free(CanOpenApp* app)
 
 int32_t can_open_service(void* context)
 {
-    CanOpenApp*        app  = can_open_app_alloc();
-    uint32_t           flag = 0;
-    CanOpenAppMessage  msg;
-    RHSHalCANFrameType frame = {0};
+    CanOpenApp*       app  = can_open_app_alloc();
+    uint32_t          flag = 0;
+    CanOpenAppMessage msg;
 
-    rhs_record_create(RECORD_CAN_OPEN, app);
+    rhs_record_id_create(&record_can_open, app);
 
     while (1)
     {
         if (flag = rhs_event_flag_wait(app->srv_event,
-                                       CanOpenAppEventTypeRX | CanOpenAppEventTypeTX | CanOpenAppEventTypePDO,
+                                       CanOpenAppEventTypeRX | CanOpenAppEventTypePDO,
                                        RHSFlagWaitAny,
                                        RHSWaitForever))
         {
@@ -59,8 +64,19 @@ int32_t can_open_service(void* context)
                 {
                     rhs_kernel_lock();
                     rhs_assert(msg.od);
+                    rhs_metric_record(&can_open_rx_latency,
+                                      (uint32_t) ((rhs_hal_cortex_get_cycles64() - msg.timestamp) /
+                                                  (rhs_hal_cortex_get_cycles_frequency() / 1000000U)));
+                    RHS_TRACE_SPAN_BEGIN("canDispatch");
+                    RHS_PROFILE_BEGIN(canDispatch);
                     canDispatch(msg.od, &msg.data);
+                    RHS_PROFILE_END(canDispatch);
+                    RHS_TRACE_SPAN_END("canDispatch");
                     rhs_kernel_unlock();
+                    can_open_retain_state(app, msg.od);
+#ifdef RHS_VIRTUAL_TIME
+                    can_open_timer_sync();
+#endif
                 }
                 break;
             case CanOpenAppEventTypePDO:
@@ -68,21 +84,6 @@ int32_t can_open_service(void* context)
                 {
                     sendPDOevent(app->handler[i].od);
                 }
-            case CanOpenAppEventTypeTX:
-                while (rhs_message_queue_get(app->tx_queue, &msg, 0) == RHSStatusOk)
-                {
-                    uint8_t try_tx = 3;
-                    frame.id       = msg.data.cob_id;
-                    frame.type     = FrameTypeStdID;
-                    frame.len      = msg.data.len;
-                    frame.rtr      = msg.data.rtr;
-                    memcpy(frame.payload, msg.data.data, msg.data.len);
-                    while (!rhs_hal_can_tx(msg.can_id, &frame) && try_tx)
-                    {
-                        rhs_delay_ms(1);
-                        try_tx--;
-                    }
-                }
                 break;
             default:
                 break;
@@ -15,7 +15,6 @@
 typedef enum
 {
     CanOpenAppEventTypeRX  = (1 << 0),
-    CanOpenAppEventTypeTX  = (1 << 1),
     CanOpenAppEventTypePDO = (1 << 2),
 } CanOpenAppEventType;
 
@@ -24,8 +23,23 @@ typedef struct
     CO_Data*    od;
     RHSHalCANId can_id;
     Message     data;
+    uint64_t    timestamp;  // Frame reception, rhs_hal_cortex_get_cycles64
 } CanOpenAppMessage;
 
+// Node state kept over soft reset, see core/retained.h
+typedef struct
+{
+    uint8_t  node_id;
+    uint8_t  can_id;
+    uint8_t  state;          // e_nodeState before reset
+    uint32_t configured[4];  // Bit per remote node id set up through SDO
+} CanOpenRetainedNode;
+
+typedef struct
+{
+    CanOpenRetainedNode node[MAX_OD];
+} CanOpenRetained;
+
 struct CanOpenApp
 {
     RHSEventFlag* srv_event;
@@ -38,13 +52,23 @@ struct CanOpenApp
     } handler[MAX_OD];
 
     RHSMessageQueue* rx_queue;
-    RHSMessageQueue* tx_queue;
 
     RHSMutex*     sdo_mutex;
     RHSEventFlag* sdo_event;
     SDOCallback   sdo_callback;
+
+    CanOpenRetained* retained;
+    bool             restored;  // Retained state is from before reset
 };
 
+/** Keep node state over soft reset after it was changed by dispatch */
+void can_open_retain_state(CanOpenApp* app, CO_Data* d);
+
+#ifdef RHS_VIRTUAL_TIME
+/** Apply CANopen alarm deferred while dispatch held the kernel lock */
+void can_open_timer_sync(void);
+#endif
+
 typedef struct FilterId
 {
     uint16_t         id;
@@ -1,6 +1,8 @@
 #include "can_open.h"
 #include "can_open_srv.h"
-#include "rtimer.h"
+#ifndef RHS_VIRTUAL_TIME
+#    include "rtimer.h"
+#endif
 
 static void InitNodes(CO_Data* d, UNS32 id)
 {
@@ -10,75 +12,76 @@ static void InitNodes(CO_Data* d, UNS32 id)
     setState(d, Initialisation);
 }
 
-static void can_rx_irq_cb(RHSHalCANId can_id, void* context)
+#define CAN_OPEN_RX_BATCH 4
+
+static bool can_rx_frame(CanOpenApp* app, RHSHalCANId can_id, const RHSHalCANFrameType* frame)
 {
-    rhs_assert(context);
+    extern FilterId* filter_list;
+    Message          rxm = {0};
 
-    extern FilterId*   filter_list;
-    CanOpenApp*        app = context;
-    Message            rxm = {0};
-    RHSHalCANFrameType frame;
-
-    if (rhs_hal_can_rx(can_id, &frame) == false)
-    {
-        return;
-    }
+    RHS_TRACE_MARK("can_rx", frame->id);
 
     for (FilterId* current = filter_list; current != NULL; current = current->next)
     {
-        if (frame.id == current->id)
+        if (frame->id == current->id)
         {
             RHS_LOG_D(TAG,
                       "CAN%d: ID : %8x : LEN %d : %02x%02x%02x%02x%02x%02x%02x%02x",
                       can_id,
-                      frame.id,
-                      frame.len,
-                      frame.payload[0],
-                      frame.payload[1],
-                      frame.payload[2],
-                      frame.payload[3],
-                      frame.payload[4],
-                      frame.payload[5],
-                      frame.payload[6],
-                      frame.payload[7]);
+                      frame->id,
+                      frame->len,
+                      frame->payload[0],
+                      frame->payload[1],
+                      frame->payload[2],
+                      frame->payload[3],
+                      frame->payload[4],
+                      frame->payload[5],
+                      frame->payload[6],
+                      frame->payload[7]);
             break;
         }
     }
 
-    rxm.cob_id = frame.id;
-    rxm.rtr    = frame.rtr;
-    rxm.len    = frame.len;
-    memcpy(rxm.data, frame.payload, frame.len);
+    rxm.cob_id = frame->id;
+    rxm.rtr    = frame->rtr;
+    rxm.len    = frame->len;
+    memcpy(rxm.data, frame->payload, frame->len);
 
     for (uint8_t i = 0; i < app->counter_od; i++)
     {
         if (can_id == app->handler[i].can_id)
         {
-            CanOpenAppMessage msg = {.od = app->handler[i].od, .can_id = can_id, .data = rxm};
+            CanOpenAppMessage msg = {
+                .od = app->handler[i].od, .can_id = can_id, .data = rxm, .timestamp = frame->timestamp};
             rhs_message_queue_put(app->rx_queue, &msg, 0);
-            rhs_event_flag_set(app->srv_event, CanOpenAppEventTypeRX);
-            return;
+            return true;
         }
     }
+    return false;
 }
 
-static void can_sce_irq_cb(RHSHalCANId can_id, RHSHalCANSCEEvent event, void* context)
+static void can_rx_irq_cb(RHSHalCANId can_id, void* context)
 {
     rhs_assert(context);
-    CanOpenApp* app = context;
-    if (event & RHSHalCANSCEEventTXPassive)  // It means that line is empty
+
+    CanOpenApp*        app    = context;
+    bool               posted = false;
+    RHSHalCANFrameType frames[CAN_OPEN_RX_BATCH];
+    size_t             count;
+
+    // One callback may follow several frames drained from both hardware FIFOs
+    while ((count = rhs_hal_can_rx_batch(can_id, frames, CAN_OPEN_RX_BATCH)) > 0)
     {
-        for (uint8_t i = 0; i < app->counter_od; i++)
+        for (size_t i = 0; i < count; i++)
         {
-            if (can_id == app->handler[i].can_id)
-            {
-                setState(app->handler[i].od, Stopped);
-                rhs_hal_can_deinit(app->handler[i].can_id);
-                RHS_LOG_D(TAG, "CAN %d is stopped", app->handler[i].can_id);
-                return;
-            }
+            posted |= can_rx_frame(app, can_id, &frames[i]);
         }
     }
+
+    if (posted)
+    {
+        rhs_event_flag_set(app->srv_event, CanOpenAppEventTypeRX);
+    }
 }
 
 UNS8 GetSDOClientFromNodeId(CO_Data* d, UNS8 nodeId);
@@ -188,30 +191,335 @@ int canSend(CAN_PORT port, Message const* m)
     {
         if (port == app->handler[i].od->canHandle)
         {
-            CanOpenAppMessage msg = {.od = app->handler[i].od, .can_id = app->handler[i].can_id, .data = *m};
-            rhs_message_queue_put(app->tx_queue, &msg, 0);
-            rhs_event_flag_set(app->srv_event, CanOpenAppEventTypeTX);
-            return 0;
+            // The HAL TX queue sends in COB-ID order, NMT, SYNC, EMCY and TIME overtake PDO and SDO backlog
+            // There is no separate urgent lane, a burst fails only once RHS_HAL_CAN_TX_QUEUE_SIZE frames wait
+            RHSHalCANFrameType frame = {.id = m->cob_id, .type = FrameTypeStdID, .len = MIN(m->len, 8U), .rtr = m->rtr};
+            memcpy(frame.payload, m->data, frame.len);
+            return rhs_hal_can_tx_submit(app->handler[i].can_id, &frame) ? 0 : 1;
         }
     }
     rhs_crash("CAN_PORT doesn't reg for OD");
 }
 
+#define CAN_OPEN_FILTER_BANKS 28  // All banks of a bxCAN pair
+#define CAN_OPEN_FILTER_IDS (CAN_OPEN_FILTER_BANKS * 2)
+
+typedef struct
+{
+    uint16_t ids[CAN_OPEN_FILTER_IDS];
+    uint16_t masks[CAN_OPEN_FILTER_IDS];  // 0x7FF for a single id
+    size_t   count;
+    bool     complete;  // False if an id can't be filtered, accept all frames then
+} CanOpenFilterIds;
+
+// Add ranges before single ids, an id inside a range takes no bank then
+static void co_filter_add_range(CanOpenFilterIds* set, uint32_t cob_id, uint16_t mask)
+{
+    if (cob_id & 0x80000000UL)
+    {
+        return;  // Object is not valid
+    }
+    if ((cob_id & 0x20000000UL) || set->count == CAN_OPEN_FILTER_IDS)
+    {
+        set->complete = false;
+        return;
+    }
+
+    const uint16_t id = (uint16_t) (cob_id & 0x7FFU);
+    for (size_t i = 0; i < set->count; i++)
+    {
+        if (((id ^ set->ids[i]) & set->masks[i]) == 0U && (mask & set->masks[i]) == set->masks[i])
+        {
+            return;
+        }
+    }
+    set->ids[set->count]   = id;
+    set->masks[set->count] = mask;
+    set->count++;
+}
+
+static void co_filter_add(CanOpenFilterIds* set, uint32_t cob_id)
+{
+    co_filter_add_range(set, cob_id, 0x7FFU);
+}
+
+static bool co_filter_read(CO_Data* d, uint16_t index, uint8_t sub, uint32_t* value)
+{
+    uint32_t size = sizeof(uint32_t);
+    uint8_t  type = 0;
+
+    *value = 0;
+    return getODentry(d, index, sub, value, &size, &type, 0) == OD_SUCCESSFUL;
+}
+
+// COB-IDs the OD consumes, NMT, SYNC and TIME go to the urgent set
+static void co_filter_collect(CO_Data* d, CanOpenFilterIds* urgent, CanOpenFilterIds* normal)
+{
+    uint32_t value;
+
+    co_filter_add(urgent, 0x000);
+    if (co_filter_read(d, 0x1005, 0, &value))
+    {
+        co_filter_add(urgent, value & 0x3FFFFFFFUL);
+    }
+    if (co_filter_read(d, 0x1012, 0, &value) && (value & 0x80000000UL))
+    {
+        co_filter_add(urgent, value & 0x3FFFFFFFUL);
+    }
+
+    // A master handles EMCY, boot-up and error control of every node, so does a slave with EMCY consumers
+    const bool master = *d->iam_a_slave == 0U;
+    if (master || (co_filter_read(d, 0x1028, 0, &value) && (uint8_t) value > 0U))
+    {
+        co_filter_add_range(normal, 0x080U, 0x780U);
+    }
+    if (master)
+    {
+        co_filter_add_range(normal, 0x700U, 0x780U);
+    }
+#ifdef CO_ENABLE_LSS
+    co_filter_add_range(normal, 0x7E4U, 0x7FEU);  // LSS responses and requests
+#endif
+
+    // Node guarding requests and heartbeats of monitored nodes
+    co_filter_add(normal, 0x700U + getNodeId(d));
+    if (co_filter_read(d, 0x1016, 0, &value))
+    {
+        const uint8_t consumers = (uint8_t) value;
+        for (uint8_t sub = 1; sub <= consumers; sub++)
+        {
+            if (co_filter_read(d, 0x1016, sub, &value) && (value & 0xFFFFU) && ((value >> 16) & 0x7FU))
+            {
+                co_filter_add(normal, 0x700U + ((value >> 16) & 0x7FU));
+            }
+        }
+    }
+
+    // SDO server requests, SDO client responses and RPDOs, each group is contiguous in the OD
+    for (uint16_t i = 0; i < 0x80U && co_filter_read(d, 0x1200U + i, 1, &value); i++)
+    {
+        co_filter_add(normal, value);
+    }
+    for (uint16_t i = 0; i < 0x80U && co_filter_read(d, 0x1280U + i, 2, &value); i++)
+    {
+        co_filter_add(normal, value);
+    }
+    for (uint16_t i = 0; i < 0x200U && co_filter_read(d, 0x1400U + i, 1, &value); i++)
+    {
+        co_filter_add(normal, value);
+    }
+}
+
+// Id and mask image, IDE is compared so no 29-bit frame passes for an 11-bit id
+static void co_filter_image(const CanOpenFilterIds* set, size_t i, uint16_t* id, uint16_t* mask)
+{
+    *id   = rhs_hal_can_filter_id16(set->ids[i], FrameTypeStdID, false);
+    *mask = rhs_hal_can_filter_id16(set->masks[i], FrameTypeStdID, false) |
+            rhs_hal_can_filter_id16(0, FrameTypeExtID, false);
+}
+
+// Two ids or ranges per 16-bit mask bank, RTR is not compared so node guarding requests pass
+static size_t co_filter_banks(const CanOpenFilterIds* set, RHSHalCANFilterFifo fifo, RHSHalCANFilter* banks)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < set->count; i += 2)
+    {
+        uint16_t first;
+        uint16_t first_mask;
+        uint16_t second;
+        uint16_t second_mask;
+        co_filter_image(set, i, &first, &first_mask);
+        co_filter_image(set, MIN(i + 1, set->count - 1), &second, &second_mask);
+        banks[n++] = rhs_hal_can_filter_mask16(first, first_mask, second, second_mask, fifo);
+    }
+    return n;
+}
+
+void co_update_filters(CanOpenApp* app, RHSHalCANId can_id)
+{
+    rhs_assert(app);
+
+    CanOpenFilterIds urgent = {.complete = true};
+    CanOpenFilterIds normal = {.complete = true};
+    RHSHalCANFilter  banks[CAN_OPEN_FILTER_BANKS];
+
+    for (uint8_t i = 0; i < app->counter_od; i++)
+    {
+        if (app->handler[i].can_id == can_id)
+        {
+            co_filter_collect(app->handler[i].od, &urgent, &normal);
+        }
+    }
+
+    size_t count = (urgent.count + 1) / 2 + (normal.count + 1) / 2;
+    if (!urgent.complete || !normal.complete || count > CAN_OPEN_FILTER_BANKS)
+    {
+        count = 0;
+    }
+    else
+    {
+        count = co_filter_banks(&urgent, RHSHalCANFilterFifo1, banks);
+        count += co_filter_banks(&normal, RHSHalCANFilterFifo0, &banks[count]);
+    }
+
+    if (count == 0 || !rhs_hal_can_set_filters(can_id, banks, count))
+    {
+        RHS_LOG_W(TAG, "CAN%d accepts all frames, COB-IDs don't fit filter banks", can_id);
+        rhs_hal_can_set_filters(can_id, NULL, 0);
+        return;
+    }
+    RHS_LOG_I(TAG,
+              "CAN%d filters %u COB-IDs and ranges in %u banks",
+              can_id,
+              (unsigned) (urgent.count + normal.count),
+              (unsigned) count);
+}
+
 void co_start_node(CanOpenApp* app, CO_Data* d, uint8_t node_id, RHSHalCANId id, uint32_t baud)
 {
     rhs_assert(app->counter_od < MAX_OD);
 
     rhs_hal_can_init(id, baud);
     rhs_hal_can_async_rx_start(id, can_rx_irq_cb, app);
-    rhs_hal_can_async_sce(id, can_sce_irq_cb, app);
+
+    CanOpenRetainedNode* retained = &app->retained->node[app->counter_od];
+    bool                 restored = app->restored && retained->node_id == node_id && retained->can_id == (uint8_t) id;
 
     app->handler[app->counter_od].can_id        = id;
     app->handler[app->counter_od].od            = d;
     app->handler[app->counter_od].od->canHandle = rhs_hal_can_get_handle(id);
     app->counter_od++;
     InitNodes(app->handler[app->counter_od - 1].od, node_id);
+
+    if (restored && retained->state == Operational)
+    {
+        // Boot-up is sent and the node waits in pre-operational, the NMT master decides when it runs again
+        RHS_LOG_I(TAG, "Node 0x%02X was operational before reset, pre-operational until NMT start", node_id);
+    }
+    else if (!restored)
+    {
+        memset(retained, 0, sizeof(CanOpenRetainedNode));
+        retained->node_id = node_id;
+        retained->can_id  = (uint8_t) id;
+    }
+    retained->state = (uint8_t) getState(d);
+    rhs_retained_commit(app->retained);
+
+    co_update_filters(app, id);
+}
+
+static CanOpenRetainedNode* can_open_retained_node(CanOpenApp* app, CO_Data* d)
+{
+    for (uint8_t i = 0; i < app->counter_od; i++)
+    {
+        if (app->handler[i].od == d)
+        {
+            return &app->retained->node[i];
+        }
+    }
+    rhs_crash("OD is not started");
 }
 
+void can_open_retain_state(CanOpenApp* app, CO_Data* d)
+{
+    CanOpenRetainedNode* retained = can_open_retained_node(app, d);
+    if (retained->state != (uint8_t) getState(d))
+    {
+        retained->state = (uint8_t) getState(d);
+        rhs_retained_commit(app->retained);
+    }
+}
+
+void co_set_node_configured(CanOpenApp* app, CO_Data* d, uint8_t id, bool configured)
+{
+    rhs_assert(app && id < 128U);
+    CanOpenRetainedNode* retained = can_open_retained_node(app, d);
+    if (configured)
+    {
+        retained->configured[id / 32U] |= 1UL << (id % 32U);
+    }
+    else
+    {
+        retained->configured[id / 32U] &= ~(1UL << (id % 32U));
+    }
+    rhs_retained_commit(app->retained);
+}
+
+bool co_is_node_configured(CanOpenApp* app, CO_Data* d, uint8_t id)
+{
+    rhs_assert(app && id < 128U);
+    return (can_open_retained_node(app, d)->configured[id / 32U] & (1UL << (id % 32U))) != 0U;
+}
+
+#ifdef RHS_VIRTUAL_TIME
+/* Hardware rtimer runs in wall clock, drive CANopen alarms from kernel tick so they follow simulated time */
+static RHSTimer* timer       = NULL;
+static uint32_t  timer_start = 0;
+static uint32_t  timer_ticks = 0;
+static bool      timer_rearm = false;
+
+static void timer_notify(void* context)
+{
+    rhs_kernel_lock();
+    TimeDispatch();
+    rhs_kernel_unlock();
+    can_open_timer_sync();
+}
+
+void can_open_timer_sync(void)
+{
+    // Timer commands can't block while dispatch holds the kernel lock, so setTimer defers them here
+    if (timer_rearm)
+    {
+        timer_rearm = false;
+        rhs_timer_start(timer, timer_ticks);
+    }
+}
+
+void TimerInit(void)
+{
+    timer = rhs_timer_alloc(timer_notify, RHSTimerTypeOnce, NULL);
+}
+
+void TimerCleanup(void)
+{
+    rhs_timer_free(timer);
+    timer = NULL;
+}
+
+void StartTimerLoop(TimerCallback_t init_callback)
+{
+    setTimer(500);
+    SetAlarm(NULL, 0, init_callback, MS_TO_TIMEVAL(1500), 0);
+}
+
+void StopTimerLoop(TimerCallback_t exitfunction)
+{
+    timer_rearm = false;
+    rhs_timer_stop(timer);
+    exitfunction(NULL, 0);
+}
+
+void setTimer(TIMEVAL value)
+{
+    uint64_t ticks = ((uint64_t) value * rhs_kernel_get_tick_frequency() + 999999U) / 1000000U;
+
+    timer_start = rhs_get_tick();
+    timer_ticks = ticks ? (uint32_t) ticks : 1;
+    timer_rearm = true;
+
+    if (rhs_kernel_is_running())
+    {
+        can_open_timer_sync();
+    }
+}
+
+TIMEVAL getElapsedTime(void)
+{
+    return (TIMEVAL) ((uint64_t) (rhs_get_tick() - timer_start) * 1000000U / rhs_kernel_get_tick_frequency());
+}
+#else
 static rtimer timer;
 
 void timer_notify(void)
@@ -250,3 +558,4 @@ TIMEVAL getElapsedTime(void)
 {
     return rtimer_get_elapsed_time(&timer);
 }
+#endif
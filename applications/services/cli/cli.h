@@ -1,7 +1,11 @@
 #pragma once
 
+#include "core/record.h"
+
 #define RECORD_CLI "cli"
 
+RHS_RECORD_DECLARE(record_cli);
+
 typedef enum
 {
     CliSymbolAsciiSOH       = 0x01,
@@ -11,6 +11,8 @@
 
 #define MAX_LINE_LENGTH 64
 
+RHS_RECORD_DEFINE(record_cli, RECORD_CLI);
+
 DICT_DEF2(CliCommandDict, const char*, M_CSTR_DUP_OPLIST, CliCommand, M_POD_OPLIST);
 
 struct Cli
@@ -289,10 +291,365 @@ void cli_info(char* args, void* context)
     PRINT_ALL_VERSIONS();
 }
 
+#ifdef RHS_PROFILE
+void cli_command_profile(char* args, void* context)
+{
+    if (args != NULL && strcmp(args, "reset") == 0)
+    {
+        rhs_profile_reset();
+        return;
+    }
+
+    const uint32_t freq = rhs_profile_get_frequency() / 1000000U;
+    const bool     hist = args != NULL && strcmp(args, "-h") == 0;
+
+    printf("Cycles frequency: %luMHz\r\n", freq);
+    printf("%-24s %-10s %-10s %-10s %-10s %-12s\r\n", "Scope", "Count", "Min", "Avg", "Max", "Total(us)");
+
+    for (const RHSProfileScope* scope = rhs_profile_get_first(); scope != NULL; scope = scope->next)
+    {
+        uint32_t avg = scope->count ? (uint32_t) (scope->total / scope->count) : 0;
+        printf("%-24s %-10lu %-10lu %-10lu %-10lu %-12lu\r\n",
+               scope->name,
+               scope->count,
+               scope->count ? scope->min : 0,
+               avg,
+               scope->max,
+               (uint32_t) (scope->total / (freq ? freq : 1)));
+
+        if (!hist)
+            continue;
+
+        for (size_t i = 0; i < RHS_PROFILE_HISTOGRAM_SIZE; i++)
+        {
+            if (scope->histogram[i] != 0)
+            {
+                printf("    >= %-10lu %lu\r\n", 1UL << i, scope->histogram[i]);
+            }
+        }
+    }
+}
+#endif
+
+static const char* const cli_boot_types[] = {
+    [RHSBootEventTypeInit]       = "init",
+    [RHSBootEventTypeHalInit]    = "hal",
+    [RHSBootEventTypePeripheral] = "periph",
+    [RHSBootEventTypeService]    = "service",
+    [RHSBootEventTypeRecord]     = "record",
+    [RHSBootEventTypeStartUp]    = "start_up",
+    [RHSBootEventTypeDone]       = "done",
+};
+
+static const RHSBootEvent* cli_boot_find(RHSBootEventType type, const char* name)
+{
+    size_t              count;
+    const RHSBootEvent* events = rhs_boot_get_events(&count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (events[i].type == type && strcmp(events[i].name, name) == 0)
+        {
+            return &events[i];
+        }
+    }
+    return NULL;
+}
+
+// Time all provided records exist, service start if it provides none
+static bool cli_boot_service_ready(size_t index, uint32_t origin, uint32_t* ready)
+{
+    const RHSBootEvent* start = cli_boot_find(RHSBootEventTypeService, RHS_SERVICES[index].name);
+    if (start == NULL)
+    {
+        return false;
+    }
+
+    *ready = start->end - origin;
+    for (const char* const* record = RHS_SERVICES[index].provides; record && *record; record++)
+    {
+        const RHSBootEvent* created = cli_boot_find(RHSBootEventTypeRecord, *record);
+        if (created == NULL)
+        {
+            return false;
+        }
+        if (created->end - origin > *ready)
+        {
+            *ready = created->end - origin;
+        }
+    }
+    return true;
+}
+
+// Provider of the consumed record created last, the one the service waited for longest
+static int32_t cli_boot_service_blocker(size_t index, uint32_t origin)
+{
+    int32_t  blocker = -1;
+    uint32_t latest  = 0;
+    for (const char* const* record = RHS_SERVICES[index].consumes; record && *record; record++)
+    {
+        const RHSBootEvent* created  = cli_boot_find(RHSBootEventTypeRecord, *record);
+        int32_t             provider = rhs_service_find_provider(*record);
+        if (created && provider >= 0 && (size_t) provider != index && created->end - origin >= latest)
+        {
+            latest  = created->end - origin;
+            blocker = provider;
+        }
+    }
+    return blocker;
+}
+
+void cli_command_boot(char* args, void* context)
+{
+    size_t              count;
+    const RHSBootEvent* events = rhs_boot_get_events(&count);
+    if (count == 0)
+    {
+        printf("No boot events\r\n");
+        return;
+    }
+
+    // Cycle counter is reset in rhs_hal_init
+    const RHSBootEvent* hal    = cli_boot_find(RHSBootEventTypeHalInit, "rhs_hal_init");
+    const uint32_t      origin = hal ? hal->start : events[0].start;
+    uint32_t            freq   = rhs_boot_get_frequency() / 1000000U;
+    freq                       = freq ? freq : 1;
+
+    if (rhs_retained_is_warm())
+    {
+        printf("Warm boot %lu, retained state restored\r\n", rhs_retained_get_warm_boots());
+    }
+    else
+    {
+        printf("Cold boot\r\n");
+    }
+
+    printf("%-10s %-24s %-12s %-12s\r\n", "Type", "Name", "Start(us)", "Duration(us)");
+    for (size_t i = 0; i < count; i++)
+    {
+        printf("%-10s %-24s %-12lu %-12lu\r\n",
+               cli_boot_types[events[i].type],
+               events[i].name,
+               (events[i].start - origin) / freq,
+               (events[i].end - events[i].start) / freq);
+    }
+    if (!rhs_boot_is_done())
+    {
+        printf("Boot is not finished\r\n");
+    }
+
+    static const char* const modes[]  = {"early", "async", "lazy"};
+    static const char* const states[] = {"idle", "running", "ready"};
+    printf("%-10s %-8s %-8s %-12s\r\n", "Periph", "Mode", "State", "Duration(us)");
+    for (size_t i = 0; i < RHSHalPeripheralCount; i++)
+    {
+        const RHSHalInitInfo* info = rhs_hal_get_init_info((RHSHalPeripheral) i);
+        if (info->init)
+        {
+            printf("%-10s %-8s %-8s %-12lu\r\n",
+                   info->name,
+                   modes[info->mode],
+                   states[info->state],
+                   info->duration / freq);
+        }
+    }
+
+    // Critical path ends at the requested service or at the one ready last
+    int32_t  target = -1;
+    uint32_t ready  = 0;
+    for (size_t i = 0; i < (size_t) RHS_SERVICES_COUNT; i++)
+    {
+        uint32_t service_ready;
+        if (!cli_boot_service_ready(i, origin, &service_ready))
+        {
+            continue;
+        }
+        if (args != NULL && strcmp(args, RHS_SERVICES[i].name) == 0)
+        {
+            target = (int32_t) i;
+            break;
+        }
+        if (args == NULL && service_ready >= ready)
+        {
+            ready  = service_ready;
+            target = (int32_t) i;
+        }
+    }
+    if (target < 0)
+    {
+        printf("No critical path%s%s\r\n", args ? " to " : "", args ? args : "");
+        return;
+    }
+
+    // Walk back through blockers, bounded in case of a dependency cycle
+    int32_t* path   = malloc(RHS_SERVICES_COUNT * sizeof(int32_t));
+    size_t   length = 0;
+    int32_t  node   = target;
+    while (node >= 0 && length < (size_t) RHS_SERVICES_COUNT)
+    {
+        path[length++] = node;
+        node           = cli_boot_service_blocker((size_t) node, origin);
+    }
+
+    printf("Critical path:\r\n");
+    if (hal)
+    {
+        printf("  %-24s done at %lu us\r\n", hal->name, (hal->end - origin) / freq);
+    }
+    while (length--)
+    {
+        const RHSBootEvent* start = cli_boot_find(RHSBootEventTypeService, RHS_SERVICES[path[length]].name);
+        cli_boot_service_ready((size_t) path[length], origin, &ready);
+        printf("  %-24s started at %lu us, ready at %lu us\r\n",
+               RHS_SERVICES[path[length]].name,
+               (start->end - origin) / freq,
+               ready / freq);
+    }
+    free(path);
+}
+
+static void cli_metrics_writer(const char* data, size_t size, void* context)
+{
+    fwrite(data, 1, size, stdout);
+}
+
+static void cli_metrics_row(const RHSMetric* metric, void* context)
+{
+    const char* filter = context;
+    if (filter && strcmp(filter, metric->name) != 0)
+    {
+        return;
+    }
+
+    if (metric->type == RHSMetricTypeCounter)
+    {
+        printf("%-32s %-10s %lu\r\n", metric->name, "counter", rhs_metric_get_value(metric));
+    }
+    else if (metric->type == RHSMetricTypeGauge)
+    {
+        printf("%-32s %-10s %ld\r\n", metric->name, "gauge", (int32_t) rhs_metric_get_value(metric));
+    }
+    else
+    {
+        printf("%-32s %-10s n=%lu p50=%lu p90=%lu p99=%lu max=%lu\r\n",
+               metric->name,
+               "histogram",
+               rhs_metric_get_value(metric),
+               rhs_metric_get_percentile(metric, 50),
+               rhs_metric_get_percentile(metric, 90),
+               rhs_metric_get_percentile(metric, 99),
+               metric->histogram->max);
+
+        // Bucket details for one histogram only
+        for (size_t i = 0; filter && i < RHS_METRIC_HISTOGRAM_BUCKETS; i++)
+        {
+            if (metric->histogram->buckets[i])
+            {
+                printf("  >= %-10lu %lu\r\n", rhs_metric_bucket_value(i), metric->histogram->buckets[i]);
+            }
+        }
+    }
+}
+
+void cli_command_metrics(char* args, void* context)
+{
+    if (args != NULL && strcmp(args, "prom") == 0)
+    {
+        rhs_metrics_dump(cli_metrics_writer, NULL);
+        fflush(stdout);
+        return;
+    }
+
+    printf("%-32s %-10s %s\r\n", "Name", "Type", "Value");
+    rhs_metrics_foreach(cli_metrics_row, args);
+}
+
+#ifdef RHS_QUEUE_STATS
+static void cli_queues_row(const RHSQueueStats* stats, void* context)
+{
+    char address[12];
+    if (stats->name == NULL)
+    {
+        snprintf(address, sizeof(address), "%p", stats->queue);
+    }
+
+    printf("%-16s %-6s %-8lu %-8lu %-8lu %lu\r\n",
+           stats->name ? stats->name : address,
+           stats->type == RHSQueueStatsTypeMessageQueue ? "queue" : "stream",
+           stats->capacity,
+           rhs_atomic_load(&stats->peak),
+           rhs_atomic_load(&stats->drops),
+           rhs_atomic_load(&stats->total));
+
+    RHSMessageQueuePriorityStats priority;
+    if (stats->type == RHSQueueStatsTypeMessageQueue &&
+        rhs_message_queue_get_priority_stats((RHSMessageQueue*) stats->queue, &priority))
+    {
+        printf("  urgent %lu overtaken %lu max_run %lu forced %lu\r\n",
+               priority.urgent,
+               priority.overtaken,
+               priority.max_run,
+               priority.forced);
+    }
+}
+
+void cli_command_queues(char* args, void* context)
+{
+    if (args != NULL && strcmp(args, "reset") == 0)
+    {
+        rhs_queue_stats_reset();
+        return;
+    }
+
+    printf("%-16s %-6s %-8s %-8s %-8s %s\r\n", "Name", "Type", "Size", "Peak", "Drops", "Total");
+    rhs_queue_stats_foreach(cli_queues_row, NULL);
+}
+#endif
+
+#ifdef RHS_TRACE
+static void cli_trace_writer(const char* data, size_t size, void* context)
+{
+    fwrite(data, 1, size, stdout);
+}
+
+void cli_command_trace(char* args, void* context)
+{
+    if (args == NULL)
+    {
+        printf("trace is %s\r\n", rhs_trace_is_running() ? "running" : "stopped");
+        printf("usage: trace start|stop|clear|dump|rtt <channel>\r\n");
+    }
+    else if (strcmp(args, "start") == 0)
+    {
+        rhs_trace_start();
+    }
+    else if (strcmp(args, "stop") == 0)
+    {
+        rhs_trace_stop();
+    }
+    else if (strcmp(args, "clear") == 0)
+    {
+        rhs_trace_clear();
+    }
+    else if (strcmp(args, "dump") == 0)
+    {
+        rhs_trace_dump(cli_trace_writer, NULL);
+        fflush(stdout);
+    }
+    else if (strstr(args, "rtt ") == args && atoi(args + 4) > 0)
+    {
+        rhs_trace_dump_rtt(atoi(args + 4));
+    }
+    else
+    {
+        printf("Invalid argument\r\n");
+    }
+}
+#endif
+
 int32_t cli_service(void* context)
 {
     Cli* app = cli_alloc();
-    rhs_record_create(RECORD_CLI, app);
+    rhs_record_id_create(&record_cli, app);
 
     cli_add_command(app, "uptime", cli_command_uptime, NULL);
     cli_add_command(app, "free", cli_command_free, NULL);
@@ -304,6 +661,17 @@ int32_t cli_service(void* context)
     cli_add_command(app, "crash", cli_command_crash, NULL);
     cli_add_command(app, "hardfault", cli_command_hardfault, NULL);
     cli_add_command(app, "info", cli_info, NULL);
+    cli_add_command(app, "boot", cli_command_boot, NULL);
+    cli_add_command(app, "metrics", cli_command_metrics, NULL);
+#ifdef RHS_QUEUE_STATS
+    cli_add_command(app, "queues", cli_command_queues, NULL);
+#endif
+#ifdef RHS_TRACE
+    cli_add_command(app, "trace", cli_command_trace, NULL);
+#endif
+#ifdef RHS_PROFILE
+    cli_add_command(app, "profile", cli_command_profile, NULL);
+#endif
 
     for (;;)
     {
@@ -0,0 +1,593 @@
+#include "iso_tp.h"
+
+#define TAG "IsoTp"
+
+#define ISO_TP_RX_BATCH       8                                // Frames read from the RX ring at once
+#define ISO_TP_TX_QUEUE_SHARE (RHS_HAL_CAN_TX_QUEUE_SIZE / 2U)  // TX queue level that holds consecutive frames back
+#define ISO_TP_SF_MAX         7U                               // Longest single frame message
+#define ISO_TP_FF12_MAX       4095U                            // Longest message with the 12 bit first frame length
+
+#define ISO_TP_PCI_SF 0x00U
+#define ISO_TP_PCI_FF 0x10U
+#define ISO_TP_PCI_CF 0x20U
+#define ISO_TP_PCI_FC 0x30U
+
+#define ISO_TP_FLAG_RX   (1UL << 0)  // RX ring holds frames
+#define ISO_TP_FLAG_TX   (1UL << 1)  // TX queue took a frame out, or a send was started
+#define ISO_TP_FLAGS_ALL (ISO_TP_FLAG_RX | ISO_TP_FLAG_TX)
+
+typedef enum
+{
+    IsoTpFlowCts      = 0,
+    IsoTpFlowWait     = 1,
+    IsoTpFlowOverflow = 2,
+    IsoTpFlowNone     = 0xFF,  // No flow control to send
+} IsoTpFlow;
+
+typedef enum
+{
+    IsoTpTxIdle = 0,
+    IsoTpTxStart,    // Single or first frame not submitted yet
+    IsoTpTxWaitFc,   // First frame or block sent
+    IsoTpTxSending,  // Consecutive frames
+} IsoTpTxState;
+
+struct IsoTpSession
+{
+    IsoTp*                iso_tp;
+    IsoTpSession*         next;
+    IsoTpSessionConfig    config;
+    IsoTpSessionStatistic statistic;
+
+    IsoTpTxState   tx_state;
+    const uint8_t* tx_data;
+    size_t         tx_size;
+    size_t         tx_offset;
+    uint8_t        tx_sn;
+    uint8_t        tx_block;     // Consecutive frames left in the block, 0 for no limit
+    uint32_t       tx_st_ticks;  // Gap between consecutive frames the peer asked for
+    uint32_t       tx_tick;      // Next consecutive frame not before, or flow control deadline
+
+    bool      rx_active;
+    uint8_t*  rx_buffer;
+    size_t    rx_size;
+    size_t    rx_offset;
+    uint8_t   rx_sn;
+    uint8_t   rx_block;  // Consecutive frames left until the next flow control
+    uint32_t  rx_tick;   // Consecutive frame deadline
+    IsoTpFlow rx_flow;   // Flow control waiting for room in the TX queue
+};
+
+struct IsoTp
+{
+    RHSHalCANId        channel;
+    RHSMutex*          mutex;  // Recursive, callbacks may send
+    RHSThread*         thread;
+    RHSThreadId        thread_id;
+    IsoTpSession*      sessions;
+    RHSHalCANFrameType frames[ISO_TP_RX_BATCH];
+};
+
+static bool iso_tp_expired(uint32_t now, uint32_t tick)
+{
+    return (int32_t) (now - tick) >= 0;
+}
+
+static uint32_t iso_tp_st_min_ticks(uint8_t st_min)
+{
+    uint32_t ms;
+
+    if (st_min == 0)
+    {
+        return 0;
+    }
+    if (st_min <= 0x7FU)
+    {
+        ms = st_min;
+    }
+    else if (st_min >= 0xF1U && st_min <= 0xF9U)
+    {
+        ms = 1;  // 100 - 900 us
+    }
+    else
+    {
+        ms = 0x7FU;  // Reserved values mean the longest gap
+    }
+    // The next tick may come right after the previous frame, one tick more keeps the gap
+    return rhs_ms_to_ticks(ms) + 1U;
+}
+
+static bool iso_tp_submit(IsoTpSession* session, const uint8_t* data, size_t size)
+{
+    RHSHalCANFrameType frame = {
+        .id   = session->config.tx_id,
+        .type = session->config.type,
+        .rtr  = false,
+        .len  = (uint8_t) (session->config.pad ? 8U : size),
+    };
+    memset(frame.payload, session->config.padding, sizeof(frame.payload));
+    memcpy(frame.payload, data, size);
+
+    return rhs_hal_can_tx_submit(session->iso_tp->channel, &frame);
+}
+
+static void iso_tp_tx_done(IsoTpSession* session, IsoTpResult result)
+{
+    session->tx_state = IsoTpTxIdle;
+    if (result == IsoTpResultOk)
+    {
+        session->statistic.tx_messages++;
+        session->statistic.tx_bytes += session->tx_size;
+    }
+    else
+    {
+        session->statistic.tx_errors++;
+        RHS_LOG_W(TAG, "%lX: send failed, %d", (unsigned long) session->config.tx_id, result);
+    }
+
+    if (session->config.tx_callback)
+    {
+        session->config.tx_callback(session, result, session->config.context);
+    }
+}
+
+static void iso_tp_rx_done(IsoTpSession* session, IsoTpResult result)
+{
+    session->rx_active = false;
+    if (result == IsoTpResultOk)
+    {
+        session->statistic.rx_messages++;
+        session->statistic.rx_bytes += session->rx_size;
+    }
+    else
+    {
+        session->statistic.rx_errors++;
+        RHS_LOG_W(TAG, "%lX: receive failed, %d", (unsigned long) session->config.rx_id, result);
+    }
+
+    session->config.rx_callback(session,
+                                result,
+                                result == IsoTpResultOk ? session->rx_buffer : NULL,
+                                session->rx_size,
+                                session->config.context);
+}
+
+static void iso_tp_rx_first(IsoTpSession* session, const uint8_t* data, size_t len, uint32_t now)
+{
+    size_t size = ((size_t) (data[0] & 0x0FU) << 8) | data[1];
+    size_t pci  = 2;
+
+    if (len < 8U)
+    {
+        return;
+    }
+    if (size == 0)
+    {
+        size = ((size_t) data[2] << 24) | ((size_t) data[3] << 16) | ((size_t) data[4] << 8) | data[5];
+        pci  = 6;
+    }
+    if (size <= (pci == 2 ? ISO_TP_SF_MAX : ISO_TP_FF12_MAX))
+    {
+        return;  // Fits a shorter form, invalid
+    }
+
+    if (session->rx_active)
+    {
+        iso_tp_rx_done(session, IsoTpResultUnexpected);
+    }
+    if (size > session->config.rx_size)
+    {
+        session->rx_size = size;
+        session->rx_flow = IsoTpFlowOverflow;
+        iso_tp_rx_done(session, IsoTpResultOverflow);
+        return;
+    }
+
+    session->rx_active = true;
+    session->rx_size   = size;
+    session->rx_offset = 8U - pci;
+    session->rx_sn     = 1;
+    session->rx_block  = session->config.block_size;
+    session->rx_tick   = now + rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+    session->rx_flow   = IsoTpFlowCts;
+    memcpy(session->rx_buffer, &data[pci], session->rx_offset);
+}
+
+static void iso_tp_rx_consecutive(IsoTpSession* session, const uint8_t* data, size_t len, uint32_t now)
+{
+    if (!session->rx_active)
+    {
+        return;
+    }
+    if ((data[0] & 0x0FU) != session->rx_sn)
+    {
+        iso_tp_rx_done(session, IsoTpResultWrongSn);
+        return;
+    }
+
+    const size_t chunk = MIN(session->rx_size - session->rx_offset, ISO_TP_SF_MAX);
+    if (len - 1U < chunk)
+    {
+        return;  // Cut short
+    }
+    memcpy(&session->rx_buffer[session->rx_offset], &data[1], chunk);
+    session->rx_offset += chunk;
+    session->rx_sn      = (session->rx_sn + 1U) & 0x0FU;
+    session->rx_tick    = now + rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+
+    if (session->rx_offset == session->rx_size)
+    {
+        iso_tp_rx_done(session, IsoTpResultOk);
+    }
+    else if (session->rx_block > 0 && --session->rx_block == 0)
+    {
+        session->rx_block = session->config.block_size;
+        session->rx_flow  = IsoTpFlowCts;
+    }
+}
+
+static void iso_tp_rx_flow_control(IsoTpSession* session, const uint8_t* data, size_t len, uint32_t now)
+{
+    if (session->tx_state != IsoTpTxWaitFc || len < 3U)
+    {
+        return;
+    }
+
+    switch (data[0] & 0x0FU)
+    {
+    case IsoTpFlowCts:
+        session->tx_state    = IsoTpTxSending;
+        session->tx_block    = data[1];
+        session->tx_st_ticks = iso_tp_st_min_ticks(data[2]);
+        session->tx_tick     = now;
+        break;
+    case IsoTpFlowWait:
+        session->statistic.fc_waits++;
+        session->tx_tick = now + rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+        break;
+    case IsoTpFlowOverflow:
+        iso_tp_tx_done(session, IsoTpResultOverflow);
+        break;
+    default:
+        iso_tp_tx_done(session, IsoTpResultInvalidFs);
+        break;
+    }
+}
+
+static void iso_tp_rx(IsoTpSession* session, const RHSHalCANFrameType* frame, uint32_t now)
+{
+    const uint8_t* data = frame->payload;
+    const size_t   len  = MIN(frame->len, 8U);
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    switch (data[0] & 0xF0U)
+    {
+    case ISO_TP_PCI_SF:
+    {
+        const size_t size = data[0] & 0x0FU;
+        if (size == 0 || size > len - 1U)
+        {
+            return;  // CAN FD single frame or cut short
+        }
+        if (session->rx_active)
+        {
+            iso_tp_rx_done(session, IsoTpResultUnexpected);
+        }
+        memcpy(session->rx_buffer, &data[1], size);
+        session->rx_size = size;
+        iso_tp_rx_done(session, IsoTpResultOk);
+        break;
+    }
+    case ISO_TP_PCI_FF:
+        iso_tp_rx_first(session, data, len, now);
+        break;
+    case ISO_TP_PCI_CF:
+        iso_tp_rx_consecutive(session, data, len, now);
+        break;
+    case ISO_TP_PCI_FC:
+        iso_tp_rx_flow_control(session, data, len, now);
+        break;
+    default:
+        break;
+    }
+}
+
+static void iso_tp_tx_first(IsoTpSession* session, uint32_t now)
+{
+    const size_t size = session->tx_size;
+    uint8_t      data[8];
+
+    if (size <= ISO_TP_SF_MAX)
+    {
+        data[0] = (uint8_t) (ISO_TP_PCI_SF | size);
+        memcpy(&data[1], session->tx_data, size);
+        if (iso_tp_submit(session, data, 1U + size))
+        {
+            iso_tp_tx_done(session, IsoTpResultOk);
+        }
+        return;
+    }
+
+    size_t pci = 2;
+    if (size <= ISO_TP_FF12_MAX)
+    {
+        data[0] = (uint8_t) (ISO_TP_PCI_FF | (size >> 8));
+        data[1] = (uint8_t) size;
+    }
+    else
+    {
+        data[0] = ISO_TP_PCI_FF;
+        data[1] = 0;
+        data[2] = (uint8_t) (size >> 24);
+        data[3] = (uint8_t) (size >> 16);
+        data[4] = (uint8_t) (size >> 8);
+        data[5] = (uint8_t) size;
+        pci     = 6;
+    }
+    memcpy(&data[pci], session->tx_data, 8U - pci);
+    if (iso_tp_submit(session, data, 8))
+    {
+        session->tx_offset = 8U - pci;
+        session->tx_sn     = 1;
+        session->tx_state  = IsoTpTxWaitFc;
+        session->tx_tick   = now + rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+    }
+}
+
+// Submits consecutive frames until the block ends, STmin holds them or the TX queue is half full
+static void iso_tp_tx_consecutive(IsoTpSession* session, uint32_t now)
+{
+    uint8_t data[8];
+
+    while (session->tx_state == IsoTpTxSending &&
+           rhs_hal_can_tx_pending(session->iso_tp->channel) < ISO_TP_TX_QUEUE_SHARE)
+    {
+        if (session->tx_st_ticks > 0 && !iso_tp_expired(now, session->tx_tick))
+        {
+            return;
+        }
+
+        const size_t chunk = MIN(session->tx_size - session->tx_offset, ISO_TP_SF_MAX);
+        data[0]            = (uint8_t) (ISO_TP_PCI_CF | session->tx_sn);
+        memcpy(&data[1], &session->tx_data[session->tx_offset], chunk);
+        if (!iso_tp_submit(session, data, 1U + chunk))
+        {
+            return;
+        }
+        session->tx_offset += chunk;
+        session->tx_sn      = (session->tx_sn + 1U) & 0x0FU;
+
+        if (session->tx_offset == session->tx_size)
+        {
+            iso_tp_tx_done(session, IsoTpResultOk);
+        }
+        else if (session->tx_block > 0 && --session->tx_block == 0)
+        {
+            session->tx_state = IsoTpTxWaitFc;
+            session->tx_tick  = now + rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+        }
+        else
+        {
+            session->tx_tick = now + session->tx_st_ticks;
+        }
+    }
+}
+
+static void iso_tp_service(IsoTpSession* session, uint32_t now)
+{
+    if (session->rx_flow != IsoTpFlowNone)
+    {
+        const uint8_t data[3] = {
+            (uint8_t) (ISO_TP_PCI_FC | session->rx_flow), session->config.block_size, session->config.st_min};
+        if (iso_tp_submit(session, data, sizeof(data)))
+        {
+            session->rx_flow = IsoTpFlowNone;
+        }
+    }
+
+    if (session->rx_active && iso_tp_expired(now, session->rx_tick))
+    {
+        iso_tp_rx_done(session, IsoTpResultTimeoutCr);
+    }
+    if (session->tx_state == IsoTpTxWaitFc && iso_tp_expired(now, session->tx_tick))
+    {
+        iso_tp_tx_done(session, IsoTpResultTimeoutBs);
+    }
+
+    if (session->tx_state == IsoTpTxStart)
+    {
+        iso_tp_tx_first(session, now);
+    }
+    iso_tp_tx_consecutive(session, now);
+}
+
+// Ticks until the nearest deadline of the session, at most wait
+static uint32_t iso_tp_wait(const IsoTpSession* session, uint32_t now, uint32_t wait)
+{
+    uint32_t tick[2];
+    size_t   count = 0;
+
+    if (session->rx_active)
+    {
+        tick[count++] = session->rx_tick;
+    }
+    if (session->tx_state == IsoTpTxWaitFc || (session->tx_state == IsoTpTxSending && session->tx_st_ticks > 0))
+    {
+        tick[count++] = session->tx_tick;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        wait = MIN(wait, iso_tp_expired(now, tick[i]) ? 0U : tick[i] - now);
+    }
+    return wait;
+}
+
+static IsoTpSession* iso_tp_find(IsoTp* iso_tp, const RHSHalCANFrameType* frame)
+{
+    for (IsoTpSession* session = iso_tp->sessions; session != NULL; session = session->next)
+    {
+        if (session->config.rx_id == frame->id && session->config.type == frame->type && !frame->rtr)
+        {
+            return session;
+        }
+    }
+    return NULL;
+}
+
+static int32_t iso_tp_worker(void* context)
+{
+    IsoTp*   iso_tp = context;
+    uint32_t wait   = RHSWaitForever;
+
+    while (true)
+    {
+        rhs_thread_flags_wait(ISO_TP_FLAGS_ALL, RHSFlagWaitAny, wait);  // Timeout only moves deadlines
+
+        rhs_mutex_acquire(iso_tp->mutex, RHSWaitForever);
+        const uint32_t now = rhs_get_tick();
+
+        size_t count;
+        while ((count = rhs_hal_can_rx_batch(iso_tp->channel, iso_tp->frames, ISO_TP_RX_BATCH)) > 0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                IsoTpSession* session = iso_tp_find(iso_tp, &iso_tp->frames[i]);
+                if (session)
+                {
+                    iso_tp_rx(session, &iso_tp->frames[i], now);
+                }
+            }
+        }
+
+        wait = RHSWaitForever;
+        for (IsoTpSession* session = iso_tp->sessions; session != NULL; session = session->next)
+        {
+            iso_tp_service(session, now);
+            wait = iso_tp_wait(session, rhs_get_tick(), wait);
+        }
+        rhs_mutex_release(iso_tp->mutex);
+    }
+    return 0;
+}
+
+static void iso_tp_rx_callback(RHSHalCANId id, void* context)
+{
+    IsoTp* iso_tp = context;
+    (void) id;
+    rhs_thread_flags_set(iso_tp->thread_id, ISO_TP_FLAG_RX);
+}
+
+static void iso_tp_tx_callback(void* context)
+{
+    IsoTp* iso_tp = context;
+    rhs_thread_flags_set(iso_tp->thread_id, ISO_TP_FLAG_TX);
+}
+
+IsoTp* iso_tp_alloc(RHSHalCANId channel)
+{
+    rhs_assert(channel < RHSHalCANIdMax);
+
+    IsoTp* iso_tp = malloc(sizeof(IsoTp));
+    memset(iso_tp, 0, sizeof(IsoTp));
+    iso_tp->channel = channel;
+    iso_tp->mutex   = rhs_mutex_alloc(RHSMutexTypeRecursive);
+
+    // Session callbacks run on this stack
+    iso_tp->thread = rhs_thread_alloc_ex("IsoTpWorker", 2 * 1024, RHSThreadPriorityHigh, iso_tp_worker, iso_tp);
+    rhs_thread_start(iso_tp->thread);
+    iso_tp->thread_id = rhs_thread_get_id(iso_tp->thread);
+
+    rhs_hal_can_tx_cmplt_cb(channel, iso_tp_tx_callback, iso_tp);
+    rhs_hal_can_async_rx_start(channel, iso_tp_rx_callback, iso_tp);
+    return iso_tp;
+}
+
+IsoTpSession* iso_tp_session_open(IsoTp* iso_tp, const IsoTpSessionConfig* config)
+{
+    rhs_assert(iso_tp);
+    rhs_assert(config);
+    rhs_assert(config->type == FrameTypeStdID || config->type == FrameTypeExtID);
+    rhs_assert(config->rx_size >= ISO_TP_SF_MAX);
+    rhs_assert(config->rx_callback);
+
+    IsoTpSession* session = malloc(sizeof(IsoTpSession));
+    memset(session, 0, sizeof(IsoTpSession));
+    session->iso_tp    = iso_tp;
+    session->config    = *config;
+    session->rx_buffer = malloc(config->rx_size);
+    session->rx_flow   = IsoTpFlowNone;
+
+    rhs_mutex_acquire(iso_tp->mutex, RHSWaitForever);
+    for (IsoTpSession* other = iso_tp->sessions; other != NULL; other = other->next)
+    {
+        rhs_assert(other->config.rx_id != config->rx_id || other->config.type != config->type);
+    }
+    session->next    = iso_tp->sessions;
+    iso_tp->sessions = session;
+    rhs_mutex_release(iso_tp->mutex);
+
+    return session;
+}
+
+void iso_tp_session_close(IsoTpSession* session)
+{
+    rhs_assert(session);
+    IsoTp* iso_tp = session->iso_tp;
+
+    rhs_mutex_acquire(iso_tp->mutex, RHSWaitForever);
+    for (IsoTpSession** link = &iso_tp->sessions; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == session)
+        {
+            *link = session->next;
+            break;
+        }
+    }
+    rhs_mutex_release(iso_tp->mutex);
+
+    free(session->rx_buffer);
+    free(session);
+}
+
+bool iso_tp_send(IsoTpSession* session, const uint8_t* data, size_t size)
+{
+    rhs_assert(session);
+    rhs_assert(data);
+    rhs_assert(size > 0);
+    IsoTp* iso_tp = session->iso_tp;
+    bool   ready;
+
+    rhs_mutex_acquire(iso_tp->mutex, RHSWaitForever);
+    ready = session->tx_state == IsoTpTxIdle;
+    if (ready)
+    {
+        session->tx_data   = data;
+        session->tx_size   = size;
+        session->tx_offset = 0;
+        session->tx_state  = IsoTpTxStart;
+    }
+    rhs_mutex_release(iso_tp->mutex);
+
+    if (ready)
+    {
+        rhs_thread_flags_set(iso_tp->thread_id, ISO_TP_FLAG_TX);
+    }
+    return ready;
+}
+
+IsoTpSessionStatistic iso_tp_session_get_statistic(IsoTpSession* session)
+{
+    rhs_assert(session);
+    IsoTpSessionStatistic statistic;
+
+    rhs_mutex_acquire(session->iso_tp->mutex, RHSWaitForever);
+    statistic = session->statistic;
+    rhs_mutex_release(session->iso_tp->mutex);
+
+    return statistic;
+}
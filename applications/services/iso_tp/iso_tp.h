@@ -0,0 +1,140 @@
+/**
+ * @file iso_tp.h
+ * ISO-TP transport (ISO 15765-2) over rhs_hal_can
+ *
+ * Moves messages longer than a CAN frame with single, first, consecutive and
+ * flow control frames, normal addressing on classic CAN. An instance owns
+ * async receive and the TX complete callback of its channel and runs a worker
+ * thread that the two ISRs wake, so nothing is polled: received frames are
+ * handled as soon as the RX ring signals them and consecutive frames are
+ * submitted as soon as the TX queue has room for them.
+ *
+ * Sessions are keyed by their ID pair and run concurrently, each one sends
+ * and receives at the same time. Messages of up to 4095 bytes use the 12 bit
+ * length, longer ones the 32 bit length of ISO 15765-2:2016.
+ */
+#pragma once
+
+#include "rhs.h"
+#include "rhs_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ISO_TP_TIMEOUT_MS 1000  // N_Bs and N_Cr, longest wait for a flow control or a consecutive frame
+
+typedef struct IsoTp        IsoTp;
+typedef struct IsoTpSession IsoTpSession;
+
+typedef enum
+{
+    IsoTpResultOk,
+    IsoTpResultTimeoutBs,   // No flow control from the peer within ISO_TP_TIMEOUT_MS
+    IsoTpResultTimeoutCr,   // No consecutive frame from the peer within ISO_TP_TIMEOUT_MS
+    IsoTpResultWrongSn,     // Consecutive frame out of sequence
+    IsoTpResultOverflow,    // Message longer than the receiver buffer, reported on both sides
+    IsoTpResultInvalidFs,   // Flow control with an unknown flow status
+    IsoTpResultUnexpected,  // Reception broken off by a new single or first frame
+} IsoTpResult;
+
+/** Message received callback, called in the worker thread
+ *
+ * @param      session  session
+ * @param[in]  result   IsoTpResultOk or why the reception failed
+ * @param[in]  data     message, valid until the callback returns, NULL on failure
+ * @param[in]  size     message size
+ * @param      context  session context
+ */
+typedef void (*IsoTpRxCallback)(IsoTpSession*  session,
+                                IsoTpResult    result,
+                                const uint8_t* data,
+                                size_t         size,
+                                void*          context);
+
+/** Message sent callback, called in the worker thread
+ *
+ * @param      session  session
+ * @param[in]  result   IsoTpResultOk or why the transfer failed
+ * @param      context  session context
+ */
+typedef void (*IsoTpTxCallback)(IsoTpSession* session, IsoTpResult result, void* context);
+
+typedef struct
+{
+    uint32_t        tx_id;        // Id of the frames sent
+    uint32_t        rx_id;        // Id of the frames received, one session per rx_id
+    FrameType       type;         // FrameTypeStdID or FrameTypeExtID, both ids
+    uint8_t         block_size;   // Consecutive frames the peer sends per flow control, 0 for no limit
+    uint8_t         st_min;       // Gap the peer keeps between consecutive frames, ISO 15765-2 encoding
+    bool            pad;          // Send every frame with 8 bytes
+    uint8_t         padding;      // Byte that fills padded frames
+    size_t          rx_size;      // Longest message received, longer ones are refused with overflow
+    IsoTpRxCallback rx_callback;  // Required
+    IsoTpTxCallback tx_callback;  // May be NULL
+    void*           context;
+} IsoTpSessionConfig;
+
+typedef struct
+{
+    uint32_t tx_messages;
+    uint32_t tx_bytes;
+    uint32_t tx_errors;
+    uint32_t rx_messages;
+    uint32_t rx_bytes;
+    uint32_t rx_errors;
+    uint32_t fc_waits;  // Flow control frames with the wait status from the peer
+} IsoTpSessionStatistic;
+
+/** Start ISO-TP on a channel
+ *
+ * The channel must be initialized with rhs_hal_can_init. ISO-TP takes over
+ * its RX and TX complete callbacks, frames that match no session are
+ * dropped.
+ *
+ * @param[in]  channel  CAN channel
+ *
+ * @return     instance, lives as long as the channel
+ */
+IsoTp* iso_tp_alloc(RHSHalCANId channel);
+
+/** Open session
+ *
+ * @param      iso_tp  instance
+ * @param[in]  config  session config, copied
+ *
+ * @return     session
+ */
+IsoTpSession* iso_tp_session_open(IsoTp* iso_tp, const IsoTpSessionConfig* config);
+
+/** Close session, a transfer in progress is dropped without callback
+ *
+ * @warning    Not from the session callbacks
+ *
+ * @param      session  session
+ */
+void iso_tp_session_close(IsoTpSession* session);
+
+/** Start sending a message, returns without waiting for the transfer
+ *
+ * Callable from the session callbacks, to answer a request for example.
+ *
+ * @param      session  session
+ * @param[in]  data     message, not copied, keep it until tx_callback
+ * @param[in]  size     message size, 1 - UINT32_MAX
+ *
+ * @return     false if the session sends already
+ */
+bool iso_tp_send(IsoTpSession* session, const uint8_t* data, size_t size);
+
+/** Get session counters
+ *
+ * @param      session  session
+ *
+ * @return     statistic
+ */
+IsoTpSessionStatistic iso_tp_session_get_statistic(IsoTpSession* session);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,16 +3,38 @@
 
 #define TAG "loader"
 
+#define LOADER_QUEUE_SIZE     1
+#define LOADER_START_UP_STACK 2048  // Start up hooks ran on the loader stack before
+
 static Loader* loader_alloc(void)
 {
-    Loader* loader = malloc(sizeof(Loader));
-    loader->queue  = rhs_message_queue_alloc(1, sizeof(LoaderMessage));
+    uint32_t events = LOADER_QUEUE_SIZE;
+    for (size_t i = 0; i < RHS_CO_SERVICES_COUNT; i++)
+    {
+        events += RHS_CO_SERVICES[i].events;
+    }
+
+    Loader* loader   = malloc(sizeof(Loader));
+    loader->queue    = rhs_message_queue_alloc(LOADER_QUEUE_SIZE, sizeof(LoaderMessage));
+    rhs_message_queue_set_name(loader->queue, "loader");
+    loader->executor = rhs_coroutine_executor_alloc(events);
+    rhs_coroutine_executor_add_message_queue(loader->executor, loader->queue);
     return loader;
 }
 
-int32_t loader_service(void* context)
+static void loader_stable_callback(void* context)
 {
-    Loader* loader = loader_alloc();
+    (void) context;
+    rhs_retained_set_stable();
+}
+
+// Tests and hooks may block or wait on coroutine services, so they run next to the executor, not on it
+static int32_t loader_start_up(void* context)
+{
+    Loader* loader = (Loader*) context;
+
+    // Hooks open service records, start them after every service
+    rhs_wait_services();
 
     for (size_t i = 0; i < RHS_TESTS_COUNT; i++)
     {
@@ -22,16 +44,60 @@ int32_t loader_service(void* context)
     RHS_LOG_I(TAG, "Executing system start hooks");
     for (size_t i = 0; i < RHS_START_UP_COUNT; i++)
     {
+        const uint32_t start = rhs_boot_begin();
         RHS_START_UP[i]();
+        rhs_boot_mark(RHSBootEventTypeStartUp, RHS_START_UP_NAMES[i], start);
     }
+    rhs_boot_mark(RHSBootEventTypeDone, "boot", rhs_boot_begin());
+
+    const LoaderMessage message = {.type = LoaderMessageTypeStartUpDone};
+    rhs_message_queue_put(loader->queue, &message, RHSWaitForever);
+    return 0;
+}
+
+static void loader_start_up_done(Loader* loader)
+{
+    rhs_thread_join(loader->start_up);
+    rhs_thread_free(loader->start_up);
+    loader->start_up = NULL;
 
-    LoaderMessage message;
+    // Retained state that survives this long is not what crashes the system
+    loader->stable = rhs_timer_alloc(loader_stable_callback, RHSTimerTypeOnce, NULL);
+    rhs_timer_start(loader->stable, rhs_ms_to_ticks(RHS_RETAINED_STABLE_MS));
+}
+
+static RHSCoroutineStatus loader_co(RHSCoroutine* co, void* context)
+{
+    Loader* loader = (Loader*) context;
+
+    RHS_CO_BEGIN(co);
     for (;;)
     {
-        if (rhs_message_queue_get(loader->queue, &message, RHSWaitForever) == RHSStatusOk)
+        RHS_CO_MESSAGE_QUEUE_GET(co, loader->queue, &loader->message, RHSWaitForever, loader->status);
+        if (loader->status == RHSStatusOk && loader->message.type == LoaderMessageTypeStartUpDone)
         {
+            loader_start_up_done(loader);
         }
     }
+    RHS_CO_END(co);
+}
+
+int32_t loader_service(void* context)
+{
+    Loader* loader = loader_alloc();
+
+    // Coroutine services run up to their first await here, so their records exist before start up hooks
+    for (size_t i = 0; i < RHS_CO_SERVICES_COUNT; i++)
+    {
+        rhs_coroutine_spawn(loader->executor, RHS_CO_SERVICES[i].name, RHS_CO_SERVICES[i].app, NULL);
+    }
+    rhs_coroutine_spawn(loader->executor, TAG, loader_co, loader);
+
+    loader->start_up = rhs_thread_alloc("loader_start_up", LOADER_START_UP_STACK, loader_start_up, loader);
+    rhs_thread_start(loader->start_up);
+
+    RHS_LOG_I(TAG, "Running %lu coroutine services", rhs_coroutine_executor_get_count(loader->executor) - 1);
+    rhs_coroutine_executor_run(loader->executor);
 
     return 0;
 }
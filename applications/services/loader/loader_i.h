@@ -1,6 +1,11 @@
 #include "loader.h"
 #include "rhs.h"
 
+typedef enum
+{
+    LoaderMessageTypeStartUpDone,  // Start up thread ran tests and hooks, join it
+} LoaderMessageType;
+
 typedef struct
 {
     uint8_t type;
@@ -8,5 +13,10 @@ typedef struct
 
 struct Loader
 {
-    RHSMessageQueue* queue;
+    RHSMessageQueue*      queue;
+    RHSCoroutineExecutor* executor;  // Runs coroutine services on loader thread
+    LoaderMessage         message;
+    RHSStatus             status;
+    RHSTimer*             stable;    // Resets warm boot limit of retained RAM
+    RHSThread*            start_up;  // Runs tests and start up hooks next to the executor
 };
@@ -0,0 +1,343 @@
+#include "can_gateway.h"
+
+#define TAG "CanGateway"
+
+#define CAN_GATEWAY_DATAGRAM_MAX 1472U  // UDP payload that fits one Ethernet frame
+#define CAN_GATEWAY_HEADER_SIZE  5U     // Version, op code, sequence number, frame count
+#define CAN_GATEWAY_FRAME_MAX    13U    // Id, length and 8 data bytes
+#define CAN_GATEWAY_BATCH_MAX    ((CAN_GATEWAY_DATAGRAM_MAX - CAN_GATEWAY_HEADER_SIZE) / CAN_GATEWAY_FRAME_MAX)
+#define CAN_GATEWAY_READ_BATCH   16     // Capture records read at once
+#define CAN_GATEWAY_RATE_MS      1000   // Frames per second window
+
+#define CAN_GATEWAY_VERSION 2
+#define CAN_GATEWAY_OP_DATA 0
+
+// Frame id flags and length flag as cannelloni sends them, SocketCAN layout
+#define CAN_GATEWAY_FLAG_EFF 0x80000000UL
+#define CAN_GATEWAY_FLAG_RTR 0x40000000UL
+#define CAN_GATEWAY_FLAG_ERR 0x20000000UL
+#define CAN_GATEWAY_LEN_FD   0x80U
+
+#define CAN_GATEWAY_METRICS 4  // Frames and drops per direction
+
+struct CanGateway
+{
+    CanGatewayConfig       config;
+    size_t                 batch;         // Frames per datagram
+    struct mg_addr         remote;        // Peer, valid if remote_known
+    bool                   remote_fixed;  // Configured, not learned from the last sender
+    bool                   remote_known;
+    uint8_t                tx_seq;
+    uint8_t                rx_seq;  // Last sequence number of the peer
+    bool                   rx_seq_valid;
+    uint8_t                datagram[CAN_GATEWAY_DATAGRAM_MAX];
+    size_t                 datagram_size;
+    size_t                 datagram_frames;
+    uint32_t               datagram_tick;   // Kernel tick of the first frame
+    uint64_t               datagram_stamp;  // Capture timestamp of the first frame
+    RHSHalCANCaptureRecord records[CAN_GATEWAY_READ_BATCH];
+    uint32_t               rate_tick;    // Current rate window start
+    uint32_t               rate_to_udp;  // to_udp_frames at window start
+    uint32_t               rate_to_can;  // to_can_frames at window start
+    CanGatewayStatistic    statistic;
+    RHSMetric              metrics[CAN_GATEWAY_METRICS];
+    RHSMetric              latency;
+    RHSMetricHistogram     latency_histogram;
+};
+
+// clang-format off
+static const char* const can_gateway_metric_names[RHSHalCANIdMax][CAN_GATEWAY_METRICS] = {
+    [RHSHalCANId1] = {"can1_gateway_to_udp_frames", "can1_gateway_to_udp_drops", "can1_gateway_to_can_frames",
+                      "can1_gateway_to_can_drops"},
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = {"can2_gateway_to_udp_frames", "can2_gateway_to_udp_drops", "can2_gateway_to_can_frames",
+                      "can2_gateway_to_can_drops"},
+#endif
+};
+
+static const char* const can_gateway_latency_names[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = "can1_gateway_latency_us",
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = "can2_gateway_latency_us",
+#endif
+};
+// clang-format on
+
+static void can_gateway_register_metrics(CanGateway* gateway)
+{
+    const RHSHalCANId id = gateway->config.channel;
+
+    uint32_t* counters[CAN_GATEWAY_METRICS] = {
+        &gateway->statistic.to_udp_frames,
+        &gateway->statistic.to_udp_drops,
+        &gateway->statistic.to_can_frames,
+        &gateway->statistic.to_can_drops,
+    };
+    for (size_t i = 0; i < CAN_GATEWAY_METRICS; i++)
+    {
+        rhs_metric_init(&gateway->metrics[i],
+                        can_gateway_metric_names[id][i],
+                        RHSMetricTypeCounter,
+                        rhs_metric_read_word,
+                        counters[i]);
+        rhs_metric_register(&gateway->metrics[i]);
+    }
+
+    gateway->latency = (RHSMetric){
+        .name      = can_gateway_latency_names[id],
+        .type      = RHSMetricTypeHistogram,
+        .histogram = &gateway->latency_histogram,
+    };
+    rhs_metric_register(&gateway->latency);
+}
+
+static void can_gateway_flush(struct mg_connection* c, CanGateway* gateway)
+{
+    const size_t frames = gateway->datagram_frames;
+    if (frames == 0)
+    {
+        return;
+    }
+
+    uint8_t* header = gateway->datagram;
+    header[0]       = CAN_GATEWAY_VERSION;
+    header[1]       = CAN_GATEWAY_OP_DATA;
+    header[2]       = gateway->tx_seq;
+    header[3]       = (uint8_t) (frames >> 8);
+    header[4]       = (uint8_t) frames;
+
+    bool sent = false;
+    if (gateway->remote_known)
+    {
+        c->rem = gateway->remote;
+        sent   = mg_send(c, gateway->datagram, gateway->datagram_size);
+    }
+
+    if (sent)
+    {
+        const uint32_t cycles_per_us = MAX(rhs_hal_cortex_get_cycles_frequency() / 1000000U, 1U);
+        const uint64_t cycles        = rhs_hal_cortex_get_cycles64() - gateway->datagram_stamp;
+        rhs_metric_record(&gateway->latency, (uint32_t) (cycles / cycles_per_us));
+        gateway->statistic.to_udp_frames += frames;
+        gateway->statistic.to_udp_datagrams++;
+        gateway->tx_seq++;
+    }
+    else
+    {
+        gateway->statistic.to_udp_drops += frames;
+    }
+    gateway->datagram_size   = CAN_GATEWAY_HEADER_SIZE;
+    gateway->datagram_frames = 0;
+}
+
+static void can_gateway_append(CanGateway* gateway, const RHSHalCANFrameType* frame)
+{
+    const bool     ext   = frame->type == FrameTypeExtID;
+    const uint32_t len   = MIN(frame->len, 8U);
+    const uint32_t data  = frame->rtr ? 0U : len;
+    const uint32_t flags = (ext ? CAN_GATEWAY_FLAG_EFF : 0U) | (frame->rtr ? CAN_GATEWAY_FLAG_RTR : 0U);
+    const uint32_t id    = (frame->id & (ext ? 0x1FFFFFFFU : 0x7FFU)) | flags;
+    uint8_t*       p     = &gateway->datagram[gateway->datagram_size];
+
+    if (gateway->datagram_frames == 0)
+    {
+        gateway->datagram_tick  = rhs_get_tick();
+        gateway->datagram_stamp = frame->timestamp;
+    }
+    p[0] = (uint8_t) (id >> 24);
+    p[1] = (uint8_t) (id >> 16);
+    p[2] = (uint8_t) (id >> 8);
+    p[3] = (uint8_t) id;
+    p[4] = (uint8_t) len;
+    memcpy(&p[5], frame->payload, data);
+    gateway->datagram_size += 5U + data;
+    gateway->datagram_frames++;
+}
+
+static void can_gateway_rate(CanGateway* gateway, uint32_t now)
+{
+    const uint32_t elapsed = now - gateway->rate_tick;
+    if (elapsed < rhs_ms_to_ticks(CAN_GATEWAY_RATE_MS))
+    {
+        return;
+    }
+
+    const uint32_t       frequency = rhs_kernel_get_tick_frequency();
+    CanGatewayStatistic* statistic = &gateway->statistic;
+    statistic->to_udp_frames_per_s =
+        (uint32_t) ((uint64_t) (statistic->to_udp_frames - gateway->rate_to_udp) * frequency / elapsed);
+    statistic->to_can_frames_per_s =
+        (uint32_t) ((uint64_t) (statistic->to_can_frames - gateway->rate_to_can) * frequency / elapsed);
+    gateway->rate_tick   = now;
+    gateway->rate_to_udp = statistic->to_udp_frames;
+    gateway->rate_to_can = statistic->to_can_frames;
+}
+
+// Drain the capture ring into datagrams, runs on every net poll
+static void can_gateway_poll(struct mg_connection* c, CanGateway* gateway)
+{
+    const RHSHalCANId channel = gateway->config.channel;
+    size_t            count;
+
+    do
+    {
+        count = rhs_hal_can_capture_read(channel, gateway->records, CAN_GATEWAY_READ_BATCH);
+        for (size_t i = 0; i < count; i++)
+        {
+            can_gateway_append(gateway, &gateway->records[i].frame);
+            if (gateway->datagram_frames >= gateway->batch)
+            {
+                can_gateway_flush(c, gateway);
+            }
+        }
+    } while (count == CAN_GATEWAY_READ_BATCH);
+
+    const uint32_t now = rhs_get_tick();
+    if (gateway->datagram_frames > 0 && now - gateway->datagram_tick >= rhs_ms_to_ticks(gateway->config.flush_ms))
+    {
+        can_gateway_flush(c, gateway);
+    }
+    gateway->statistic.capture_drops = rhs_hal_can_capture_get_statistic(channel).drops;
+    can_gateway_rate(gateway, now);
+}
+
+// Parse cannelloni data datagram, returns false if it is malformed. Frames before the fault are sent.
+static bool can_gateway_parse(CanGateway* gateway, const uint8_t* p, size_t size)
+{
+    const uint8_t* end = p + size;
+
+    if (size < CAN_GATEWAY_HEADER_SIZE || p[0] != CAN_GATEWAY_VERSION || p[1] != CAN_GATEWAY_OP_DATA)
+    {
+        return false;
+    }
+
+    const uint8_t seq   = p[2];
+    const size_t  count = ((size_t) p[3] << 8) | p[4];
+    const uint8_t gap   = (uint8_t) (seq - gateway->rx_seq - 1U);
+    if (gateway->rx_seq_valid && gap < 0x80U)
+    {
+        gateway->statistic.lost += gap;  // A step back is a duplicate or a peer restart, nothing lost
+    }
+    gateway->rx_seq       = seq;
+    gateway->rx_seq_valid = true;
+    gateway->statistic.to_can_datagrams++;
+    p += CAN_GATEWAY_HEADER_SIZE;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (end - p < 5)
+        {
+            return false;
+        }
+        const uint32_t id  = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+        const uint8_t  len = p[4];
+        p += 5;
+        if ((len & CAN_GATEWAY_LEN_FD) || len > 8U)
+        {
+            return false;
+        }
+
+        // Remote frames carry no data bytes
+        const bool   rtr  = (id & CAN_GATEWAY_FLAG_RTR) != 0U;
+        const size_t data = rtr ? 0U : len;
+        if ((size_t) (end - p) < data)
+        {
+            return false;
+        }
+
+        RHSHalCANFrameType frame = {
+            .type = (id & CAN_GATEWAY_FLAG_EFF) ? FrameTypeExtID : FrameTypeStdID,
+            .id   = id & ((id & CAN_GATEWAY_FLAG_EFF) ? 0x1FFFFFFFU : 0x7FFU),
+            .len  = len,
+            .rtr  = rtr,
+        };
+        memcpy(frame.payload, p, data);
+        p += data;
+
+        if ((id & CAN_GATEWAY_FLAG_ERR) || ((frame.id ^ gateway->config.to_can_id) & gateway->config.to_can_mask))
+        {
+            gateway->statistic.to_can_filtered++;
+        }
+        else if (rhs_hal_can_tx_submit(gateway->config.channel, &frame))
+        {
+            gateway->statistic.to_can_frames++;
+        }
+        else
+        {
+            gateway->statistic.to_can_drops++;
+        }
+    }
+    return true;
+}
+
+static void can_gateway_handler(struct mg_connection* c, int ev, void* ev_data)
+{
+    CanGateway* gateway = (CanGateway*) c->fn_data;
+
+    if (ev == MG_EV_POLL)
+    {
+        can_gateway_poll(c, gateway);
+    }
+    else if (ev == MG_EV_READ)
+    {
+        // A datagram at a time, the built-in stack raises one read per datagram
+        if (!gateway->remote_fixed)
+        {
+            gateway->remote       = c->rem;
+            gateway->remote_known = true;
+        }
+        if (!can_gateway_parse(gateway, c->recv.buf, c->recv.len))
+        {
+            gateway->statistic.malformed++;
+        }
+        mg_iobuf_del(&c->recv, 0, c->recv.len);
+    }
+    (void) ev_data;
+}
+
+CanGateway* can_gateway_start(Net* net, const char* url, const CanGatewayConfig* config)
+{
+    rhs_assert(net);
+    rhs_assert(url);
+    rhs_assert(config);
+    rhs_assert(config->channel < RHSHalCANIdMax);
+
+    CanGateway* gateway = malloc(sizeof(CanGateway));
+    memset(gateway, 0, sizeof(CanGateway));
+    gateway->config        = *config;
+    gateway->config.remote = NULL;  // Parsed into remote, the url need not outlive the call
+    gateway->batch         = config->batch ? MIN(config->batch, CAN_GATEWAY_BATCH_MAX) : CAN_GATEWAY_BATCH_MAX;
+    gateway->datagram_size = CAN_GATEWAY_HEADER_SIZE;
+    gateway->rate_tick     = rhs_get_tick();
+    if (config->remote)
+    {
+        rhs_assert(mg_aton(mg_url_host(config->remote), &gateway->remote));
+        gateway->remote.port  = mg_htons(mg_url_port(config->remote));
+        gateway->remote_fixed = true;
+        gateway->remote_known = true;
+    }
+
+    const RHSHalCANCaptureConfig capture = {
+        .id     = config->to_udp_id,
+        .mask   = config->to_udp_mask,
+        .tx     = false,
+        .frames = config->frames,
+    };
+    rhs_hal_can_capture_start(config->channel, &capture);
+    can_gateway_register_metrics(gateway);
+
+    net_start_listener(net, url, can_gateway_handler, gateway);
+    RHS_LOG_I(TAG, "CAN%d gateway on %s", config->channel, url);
+
+    return gateway;
+}
+
+CanGatewayStatistic can_gateway_get_statistic(CanGateway* gateway)
+{
+    rhs_assert(gateway);
+
+    CanGatewayStatistic statistic = gateway->statistic;
+    statistic.latency_max_us      = rhs_atomic_load(&gateway->latency_histogram.max);
+    statistic.latency_p99_us      = rhs_metric_get_percentile(&gateway->latency, 99);
+    return statistic;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file can_gateway.h
+ * CAN over UDP gateway, cannelloni protocol version 2
+ *
+ * Bridges a CAN channel to a remote host. Frames from the bus are taken from
+ * the rhs_hal_can capture ring, so the gateway owns capture of its channel
+ * and needs async receive started on it, by CANopen for example. They are
+ * packed into datagrams of up to `batch` frames. A datagram leaves when it
+ * is full or when its first frame is `flush_ms` old. Frames from UDP go
+ * through rhs_hal_can_tx_submit and leave in arbitration order with the
+ * node's own traffic. CAN FD frames from UDP are not supported and count as
+ * malformed.
+ *
+ * The gateway runs in the net worker: datagrams are parsed on reception and
+ * the capture ring is drained on every net poll.
+ */
+#pragma once
+
+#include "net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CanGateway CanGateway;
+
+typedef struct
+{
+    RHSHalCANId channel;
+    const char* remote;       // Peer url, for example "udp://192.168.1.10:20000", NULL to answer the last sender
+    uint32_t    flush_ms;     // Longest wait of a partial datagram, 0 sends on every net poll
+    size_t      batch;        // Frames per datagram, 0 for as many as fit
+    size_t      frames;       // Capture ring size, power of two
+    uint32_t    to_udp_id;    // Frame goes to UDP if its id equals to_udp_id in the mask bits
+    uint32_t    to_udp_mask;  // 0 sends every frame
+    uint32_t    to_can_id;    // Frame goes to CAN if its id equals to_can_id in the mask bits
+    uint32_t    to_can_mask;  // 0 sends every frame
+} CanGatewayConfig;
+
+typedef struct
+{
+    uint32_t to_udp_frames;
+    uint32_t to_udp_datagrams;
+    uint32_t to_udp_frames_per_s;  // Last complete second
+    uint32_t to_udp_drops;         // Frames drained while no peer was known or the send failed
+    uint32_t capture_drops;        // Frames the capture ring could not take
+    uint32_t to_can_frames;
+    uint32_t to_can_datagrams;
+    uint32_t to_can_frames_per_s;  // Last complete second
+    uint32_t to_can_filtered;      // Frames dropped by the to_can filter
+    uint32_t to_can_drops;         // Frames refused by a full TX queue
+    uint32_t malformed;            // Datagrams that are not cannelloni data or are cut short
+    uint32_t lost;                 // Datagrams missing in the peer's sequence numbers
+    uint32_t latency_max_us;       // CAN reception of the first frame of a datagram to its send
+    uint32_t latency_p99_us;
+} CanGatewayStatistic;
+
+/** Start gateway on a UDP url
+ *
+ * @param      net     Net instance
+ * @param[in]  url     local url, for example "udp://0.0.0.0:20000"
+ * @param[in]  config  gateway config, copied, remote url included
+ *
+ * @return     gateway
+ */
+CanGateway* can_gateway_start(Net* net, const char* url, const CanGatewayConfig* config);
+
+/** Get gateway counters
+ *
+ * @param      gateway  gateway
+ *
+ * @return     statistic
+ */
+CanGatewayStatistic can_gateway_get_statistic(CanGateway* gateway);
+
+#ifdef __cplusplus
+}
+#endif
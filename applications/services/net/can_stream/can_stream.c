@@ -0,0 +1,273 @@
+#include "can_stream.h"
+
+#define TAG "CanStream"
+
+#define CAN_STREAM_BATCH      32    // Records formatted and sent at once
+#define CAN_STREAM_BATCHES    4     // Batches per net poll, the worker yields between them
+#define CAN_STREAM_PERIOD_MS  20    // Longest wait of a partial batch
+#define CAN_STREAM_RECORD_MAX 64    // Longest formatted record
+#define CAN_STREAM_SEND_MAX   8192  // Client send buffer level that skips a batch
+
+// Binary record id flags, as SocketCAN
+#define CAN_STREAM_FLAG_EXT (1UL << 31)
+#define CAN_STREAM_FLAG_RTR (1UL << 30)
+#define CAN_STREAM_FLAG_TX  (1UL << 29)
+
+typedef enum
+{
+    CanStreamClientIdle = 0,  // socketcand handshake not done
+    CanStreamClientStreaming,
+} CanStreamClientState;
+
+typedef struct
+{
+    CanStreamConfig        config;
+    uint32_t               clients;    // Streaming clients
+    uint32_t               last_tick;  // Last batch
+    uint32_t               skipped;    // Records slow clients missed
+    RHSHalCANCaptureRecord records[CAN_STREAM_BATCH];
+    char                   buffer[CAN_STREAM_BATCH * CAN_STREAM_RECORD_MAX];
+} CanStream;
+
+static const char can_stream_hex_digits[] = "0123456789ABCDEF";
+
+static char* can_stream_hex(char* out, uint32_t value, uint32_t digits)
+{
+    for (uint32_t i = digits; i > 0; i--)
+    {
+        out[i - 1] = can_stream_hex_digits[value & 0xFU];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+static char* can_stream_le(char* out, uint64_t value, uint32_t bytes)
+{
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        out[i] = (char) (value >> (8U * i));
+    }
+    return out + bytes;
+}
+
+// Returns formatted size, at most CAN_STREAM_RECORD_MAX
+static size_t can_stream_format(CanStreamFormat format, const RHSHalCANCaptureRecord* record, uint64_t us, char* out)
+{
+    const RHSHalCANFrameType* frame = &record->frame;
+    const bool                ext   = frame->type == FrameTypeExtID;
+    const uint32_t            id    = frame->id & (ext ? 0x1FFFFFFFU : 0x7FFU);
+    const uint32_t            len   = MIN(frame->len, 8U);
+    const uint32_t            data  = frame->rtr ? 0U : len;
+    char*                     p     = out;
+
+    switch (format)
+    {
+    case CanStreamFormatSocketcand:
+        p += snprintf(p,
+                      CAN_STREAM_RECORD_MAX,
+                      ext ? "< frame %08lX %lu.%06lu " : "< frame %03lX %lu.%06lu ",
+                      (unsigned long) id,
+                      (unsigned long) (us / 1000000U),
+                      (unsigned long) (us % 1000000U));
+        for (uint32_t i = 0; i < data; i++)
+        {
+            p = can_stream_hex(p, frame->payload[i], 2);
+        }
+        memcpy(p, " >", 2);
+        p += 2;
+        break;
+    case CanStreamFormatSlcan:
+        *p++ = ext ? (frame->rtr ? 'R' : 'T') : (frame->rtr ? 'r' : 't');
+        p    = can_stream_hex(p, id, ext ? 8U : 3U);
+        p    = can_stream_hex(p, len, 1);
+        for (uint32_t i = 0; i < data; i++)
+        {
+            p = can_stream_hex(p, frame->payload[i], 2);
+        }
+        p    = can_stream_hex(p, (uint32_t) ((us / 1000U) % 60000U), 4);  // SLCAN time wraps every minute
+        *p++ = '\r';
+        break;
+    case CanStreamFormatBinary:
+    default:
+        p = can_stream_le(p, us, 8);
+        p = can_stream_le(p,
+                          id | (ext ? CAN_STREAM_FLAG_EXT : 0U) | (frame->rtr ? CAN_STREAM_FLAG_RTR : 0U) |
+                              (record->tx ? CAN_STREAM_FLAG_TX : 0U),
+                          4);
+        *p++ = (char) len;
+        memcpy(p, frame->payload, data);
+        p += data;
+        break;
+    }
+    return (size_t) (p - out);
+}
+
+// Drain the capture ring to streaming clients in batches, runs on every net poll
+static void can_stream_send(struct mg_connection* listener, CanStream* stream)
+{
+    const RHSHalCANId               channel   = stream->config.channel;
+    const uint32_t                  now       = rhs_get_tick();
+    const RHSHalCANCaptureStatistic statistic = rhs_hal_can_capture_get_statistic(channel);
+
+    if (statistic.pending == 0 ||
+        (statistic.pending < CAN_STREAM_BATCH && now - stream->last_tick < rhs_ms_to_ticks(CAN_STREAM_PERIOD_MS)))
+    {
+        return;
+    }
+    stream->last_tick = now;
+
+    const uint32_t cycles_per_us = MAX(rhs_hal_cortex_get_cycles_frequency() / 1000000U, 1U);
+    for (uint32_t batch = 0; batch < CAN_STREAM_BATCHES; batch++)
+    {
+        const size_t count = rhs_hal_can_capture_read(channel, stream->records, CAN_STREAM_BATCH);
+        size_t       size  = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint64_t us = stream->records[i].frame.timestamp / cycles_per_us;
+            size += can_stream_format(stream->config.format, &stream->records[i], us, &stream->buffer[size]);
+        }
+
+        for (struct mg_connection* c = listener->mgr->conns; c != NULL && size > 0; c = c->next)
+        {
+            if (c->fn_data != stream || !c->is_accepted || c->data[0] != CanStreamClientStreaming)
+            {
+                continue;
+            }
+            if (c->send.len > CAN_STREAM_SEND_MAX)
+            {
+                stream->skipped += count;
+                continue;
+            }
+            mg_send(c, stream->buffer, size);
+        }
+
+        if (count < CAN_STREAM_BATCH)
+        {
+            break;
+        }
+        rhs_delay_ms(0);  // Yield, CANopen dispatch may share the worker priority
+    }
+}
+
+static void can_stream_client_start(struct mg_connection* c, CanStream* stream)
+{
+    c->data[0] = CanStreamClientStreaming;
+    if (stream->clients++ > 0)
+    {
+        return;
+    }
+
+    const RHSHalCANCaptureConfig capture = {
+        .id     = stream->config.id,
+        .mask   = stream->config.mask,
+        .tx     = stream->config.tx,
+        .frames = stream->config.frames,
+    };
+    rhs_hal_can_capture_start(stream->config.channel, &capture);
+    stream->last_tick = rhs_get_tick();
+    stream->skipped   = 0;
+    RHS_LOG_I(TAG, "CAN%d capture started", stream->config.channel);
+}
+
+static void can_stream_client_stop(struct mg_connection* c, CanStream* stream)
+{
+    c->data[0] = CanStreamClientIdle;
+    if (--stream->clients > 0)
+    {
+        return;
+    }
+
+    const RHSHalCANCaptureStatistic statistic = rhs_hal_can_capture_get_statistic(stream->config.channel);
+    rhs_hal_can_capture_stop(stream->config.channel);
+    RHS_LOG_I(TAG,
+              "CAN%d capture stopped, %lu captured, %lu dropped, %lu skipped",
+              stream->config.channel,
+              (unsigned long) statistic.captured,
+              (unsigned long) statistic.drops,
+              (unsigned long) stream->skipped);
+}
+
+// socketcand commands are `< command args >`, only the ones that open raw mode are served
+static void can_stream_read(struct mg_connection* c, CanStream* stream)
+{
+    if (stream->config.format != CanStreamFormatSocketcand)
+    {
+        mg_iobuf_del(&c->recv, 0, c->recv.len);  // Stream only
+        return;
+    }
+
+    char* end;
+    while ((end = memchr(c->recv.buf, '>', c->recv.len)) != NULL)
+    {
+        const size_t  size    = (size_t) (end - (char*) c->recv.buf) + 1U;
+        const char*   start   = memchr(c->recv.buf, '<', size);
+        struct mg_str command = start ? mg_str_n(start, (size_t) (end - start) + 1U) : mg_str("");
+
+        if (mg_match(command, mg_str("< open # >"), NULL))
+        {
+            mg_printf(c, "< ok >");
+        }
+        else if (mg_match(command, mg_str("< rawmode >"), NULL))
+        {
+            mg_printf(c, "< ok >");
+            if (c->data[0] != CanStreamClientStreaming)
+            {
+                can_stream_client_start(c, stream);
+            }
+        }
+        else if (mg_match(command, mg_str("< echo >"), NULL))
+        {
+            mg_printf(c, "< echo >");
+        }
+        else
+        {
+            mg_printf(c, "< error unsupported command >");
+        }
+        mg_iobuf_del(&c->recv, 0, size);
+    }
+}
+
+static void can_stream_handler(struct mg_connection* c, int ev, void* ev_data)
+{
+    CanStream* stream = (CanStream*) c->fn_data;
+
+    if (ev == MG_EV_POLL && c->is_listening && stream->clients > 0)
+    {
+        can_stream_send(c, stream);
+    }
+    else if (ev == MG_EV_ACCEPT)
+    {
+        if (stream->config.format == CanStreamFormatSocketcand)
+        {
+            mg_printf(c, "< hi >");
+        }
+        else
+        {
+            can_stream_client_start(c, stream);
+        }
+    }
+    else if (ev == MG_EV_READ)
+    {
+        can_stream_read(c, stream);
+    }
+    else if (ev == MG_EV_CLOSE && c->is_accepted && c->data[0] == CanStreamClientStreaming)
+    {
+        can_stream_client_stop(c, stream);
+    }
+    (void) ev_data;
+}
+
+void can_stream_start(Net* net, const char* url, const CanStreamConfig* config)
+{
+    rhs_assert(net);
+    rhs_assert(url);
+    rhs_assert(config);
+    rhs_assert(config->channel < RHSHalCANIdMax);
+    rhs_assert(config->frames > 0 && (config->frames & (config->frames - 1U)) == 0);
+
+    CanStream* stream = malloc(sizeof(CanStream));
+    memset(stream, 0, sizeof(CanStream));
+    stream->config = *config;
+
+    net_start_listener(net, url, can_stream_handler, stream);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file can_stream.h
+ * CAN capture streaming over TCP
+ *
+ * A listener on a Net instance that streams the rhs_hal_can capture ring to
+ * every connected client. Capture runs only while a client streams. The net
+ * worker drains the ring in batches on its poll, so the CAN ISRs only copy
+ * frames and a busy bus costs the CANopen dispatch thread nothing but the
+ * copy. A client that reads slower than the bus misses batches instead of
+ * holding frames back for the others.
+ */
+#pragma once
+
+#include "net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    CanStreamFormatSocketcand,  // socketcand raw mode, `< frame 123 23.424242 11223344 >`
+    CanStreamFormatSlcan,       // SLCAN with ms timestamp, `t12321122EA5F\r`
+    CanStreamFormatBinary,      // 13 byte header plus data, see README
+} CanStreamFormat;
+
+typedef struct
+{
+    RHSHalCANId     channel;
+    CanStreamFormat format;
+    uint32_t        id;      // Frame is streamed if its id equals id in the mask bits
+    uint32_t        mask;    // 0 streams every frame
+    bool            tx;      // Stream own frames too
+    size_t          frames;  // Capture ring size, power of two
+} CanStreamConfig;
+
+/** Start streaming listener
+ *
+ * socketcand clients open the stream with `< open can0 >` and
+ * `< rawmode >`, SLCAN and binary clients get frames from connect on.
+ *
+ * @param      net     Net instance
+ * @param[in]  url     listening url, for example "tcp://0.0.0.0:29536"
+ * @param[in]  config  stream config, copied
+ */
+void can_stream_start(Net* net, const char* url, const CanStreamConfig* config);
+
+#ifdef __cplusplus
+}
+#endif
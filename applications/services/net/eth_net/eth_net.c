@@ -12,6 +12,21 @@ typedef struct
 
 static_assert(offsetof(EthNet, net) == 0, "EthNet must be compatible with Net for safe casting");
 
+#define ETH_NET_IRQ_PRIORITY 10  // Below configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, the ISR releases rx_wake
+
+static RHSSemaphore* volatile eth_net_rx_wake;  // One MAC, NULL while eth_net is stopped
+
+void mg_tcpip_driver_stm32f_irq(void);  // Mongoose ETH_IRQHandler, renamed in CMakeLists.txt
+
+/* Mongoose queues received frames in its handler, wake the worker after it */
+void ETH_IRQHandler(void)
+{
+    mg_tcpip_driver_stm32f_irq();
+    RHSSemaphore* rx_wake = eth_net_rx_wake;
+    if (rx_wake != NULL)
+        rhs_semaphore_release(rx_wake);
+}
+
 static void eth_net_init_tcpip(Net* net, const EthPhyConfig* phy_config)
 {
     struct mg_tcpip_if*                 ifp    = malloc(sizeof(struct mg_tcpip_if));
@@ -69,9 +84,11 @@ static EthNet* eth_net_alloc(const NetConfig* config, const EthPhyConfig* phy_co
     rhs_assert(app != NULL);
 
     memset(app, 0, sizeof(*app));
-    app->net.queue  = rhs_message_queue_alloc(3, sizeof(NetApiEventMessage));
-    app->net.mgr    = malloc(sizeof(struct mg_mgr));
-    app->net.config = malloc(sizeof(NetConfig));
+    app->net.queue  = rhs_message_queue_alloc_priority(3, 2, sizeof(NetApiEventMessage));
+    rhs_message_queue_set_name(app->net.queue, "eth_net");
+    app->net.rx_wake = rhs_semaphore_alloc(1, 0);
+    app->net.mgr     = malloc(sizeof(struct mg_mgr));
+    app->net.config  = malloc(sizeof(NetConfig));
     rhs_assert(app->net.mgr != NULL && app->net.config != NULL);
 
     if (config == NULL)
@@ -87,13 +104,30 @@ static EthNet* eth_net_alloc(const NetConfig* config, const EthPhyConfig* phy_co
         memcpy(app->net.config, config, sizeof(NetConfig));
     }
 
-    // Initialise Mongoose network stack
+    // Initialise Mongoose network stack, wait for async HAL init not to reset MAC concurrently
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralEth);
     rhs_hal_eth_init();
+    NVIC_SetPriority(ETH_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), ETH_NET_IRQ_PRIORITY, 0));
+    eth_net_rx_wake = app->net.rx_wake;
 
     mg_mgr_init(app->net.mgr);  // and attach it to the interface
 
+    // Config changed at run time survives soft reset
+    bool restored;
+    char name[RHS_RETAINED_NAME_SIZE];
+    snprintf(name, sizeof(name), "eth_net_%d", phy_config ? phy_config->phy_addr : MG_TCPIP_PHY_ADDR);
+    app->net.retained = rhs_retained_get(name, sizeof(NetConfig), &restored);
+    if (restored)
+    {
+        memcpy(app->net.config, app->net.retained, sizeof(NetConfig));
+        RHS_LOG_I(TAG, "Config restored from retained RAM");
+    }
+
     eth_net_init_tcpip(&app->net, phy_config);
 
+    memcpy(app->net.retained, app->net.config, sizeof(NetConfig));
+    rhs_retained_commit(app->net.retained);
+
     return app;
 }
 
@@ -101,6 +135,7 @@ static void eth_net_free(EthNet* app)
 {
     rhs_thread_free(app->net.thread);
     rhs_message_queue_free(app->net.queue);
+    rhs_semaphore_free(app->net.rx_wake);
     mg_mgr_free(app->net.mgr);
     free(app->net.mgr->ifp->driver_data);
     free(app->net.mgr->ifp);
@@ -129,6 +164,7 @@ void eth_net_stop(Net* net)
     EthNet* app = (EthNet*) net;
     net_stop(net);
     rhs_thread_join(app->net.thread);
-    eth_net_free(app);
     rhs_hal_eth_deinit();
+    eth_net_rx_wake = NULL;
+    eth_net_free(app);
 }
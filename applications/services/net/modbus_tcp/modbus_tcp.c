@@ -4,6 +4,8 @@
 
 static void handle_modbus_pdu(struct mg_connection* c, uint8_t* buf, size_t len, void* context)
 {
+    RHS_PROFILE_SCOPE(handle_modbus_pdu);
+
     if (context == NULL)
     {
         MG_ERROR(("There isn't modbus context"));
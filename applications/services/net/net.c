@@ -4,6 +4,9 @@
 
 #define TAG "Net"
 
+// Mongoose timers and polled drivers are serviced at least this often
+#define NET_POLL_PERIOD_MS 5
+
 static void net_cli_command(char* args, void* context)
 {
     Net* net = (Net*) context;
@@ -85,79 +88,98 @@ static void net_mdns_stop(Net* net)
     cli_remove_command(net->cli, name);
 }
 
-void net_start_http(Net* net, const char* uri, mg_event_handler_t fn, void* context)
+// Post request to net worker, wait for completion unless called from the worker itself
+static void net_api_call(Net* net, NetApiEventMessage* msg)
 {
-    rhs_assert(net);
-    NetApiEventMessage msg = {.lock = api_lock_alloc_locked(),
-                              .type = NetApiEventTypeSetHttp,
-                              .data = {.interface = {.uri = (char*) uri, .fn = fn, .context = context}}};
-    rhs_message_queue_put(net->queue, &msg, RHSWaitForever);
-    api_lock_wait_unlock_and_free(msg.lock);
-}
+    RHSRpc rpc;
 
-void net_start_listener(Net* net, const char* uri, mg_event_handler_t fn, void* context)
-{
-    rhs_assert(net);
-    RHSThread* thread = rhs_thread_get_current();
-    RHSApiLock lock   = NULL;
-
-    if (thread != net->thread)
+    if (rhs_thread_get_current() != net->thread)
     {
-        lock = api_lock_alloc_locked();
+        rhs_rpc_init(&rpc);
+        msg->rpc = &rpc;
     }
 
-    NetApiEventMessage msg = {.lock = lock,
-                              .type = NetApiEventTypeSetTcp,
-                              .data = {.interface = {.uri = (char*) uri, .fn = fn, .context = context}}};
-
-    rhs_message_queue_put(net->queue, &msg, RHSWaitForever);
+    // Stop and reconfigure overtake listener setup
+    RHSMessagePriority priority = (msg->type == NetApiEventTypeSetHttp || msg->type == NetApiEventTypeSetTcp)
+                                      ? RHSMessagePriorityNormal
+                                      : RHSMessagePriorityUrgent;
+    rhs_message_queue_put_priority(net->queue, msg, priority, RHSWaitForever);
 
-    if (thread != net->thread)
+    if (msg->rpc)
     {
-        api_lock_wait_unlock_and_free(msg.lock);
+        rhs_rpc_wait(&rpc);
     }
 }
 
-void net_stop_listener(Net* net, const char* uri)
+void net_start_http(Net* net, const char* uri, mg_event_handler_t fn, void* context)
 {
     rhs_assert(net);
-    RHSThread* thread = rhs_thread_get_current();
-    RHSApiLock lock   = NULL;
+    NetApiEventMessage msg = {.type = NetApiEventTypeSetHttp,
+                              .data = {.interface = {.uri = (char*) uri, .fn = fn, .context = context}}};
+    net_api_call(net, &msg);
+}
 
-    if (thread != net->thread)
+static void net_metrics_chunk(const char* data, size_t size, void* context)
+{
+    mg_http_write_chunk((struct mg_connection*) context, data, size);
+}
+
+static void net_metrics_handler(struct mg_connection* c, int ev, void* ev_data)
+{
+    if (ev != MG_EV_HTTP_MSG)
     {
-        lock = api_lock_alloc_locked();
+        return;
     }
 
-    NetApiEventMessage msg = {.lock = lock, .type = NetApiEventTypeRstTcp, .data = {.interface = {.uri = (char*) uri}}};
-
-    rhs_message_queue_put(net->queue, &msg, RHSWaitForever);
-
-    if (thread != net->thread)
+    struct mg_http_message* hm = (struct mg_http_message*) ev_data;
+    if (mg_match(hm->uri, mg_str("/metrics"), NULL))
     {
-        api_lock_wait_unlock_and_free(msg.lock);
+        mg_printf(c,
+                  "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                  "Transfer-Encoding: chunked\r\n\r\n");
+        rhs_metrics_dump(net_metrics_chunk, c);
+        mg_http_write_chunk(c, "", 0);
+    }
+    else if (mg_match(hm->uri, mg_str("/metrics.bin"), NULL))
+    {
+        mg_printf(c,
+                  "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                  "Transfer-Encoding: chunked\r\n\r\n");
+        rhs_metrics_dump_binary(net_metrics_chunk, c);
+        mg_http_write_chunk(c, "", 0);
+    }
+    else
+    {
+        mg_http_reply(c, 404, "", "Not found\n");
     }
 }
 
-void net_set_config(Net* net, const NetConfig* config)
+void net_start_metrics(Net* net, const char* url)
+{
+    net_start_http(net, url, net_metrics_handler, NULL);
+}
+
+void net_start_listener(Net* net, const char* uri, mg_event_handler_t fn, void* context)
 {
     rhs_assert(net);
-    RHSThread* thread = rhs_thread_get_current();
-    RHSApiLock lock   = NULL;
+    NetApiEventMessage msg = {.type = NetApiEventTypeSetTcp,
+                              .data = {.interface = {.uri = (char*) uri, .fn = fn, .context = context}}};
+    net_api_call(net, &msg);
+}
 
-    if (thread != net->thread)
-    {
-        lock = api_lock_alloc_locked();
-    }
+void net_stop_listener(Net* net, const char* uri)
+{
+    rhs_assert(net);
+    NetApiEventMessage msg = {.type = NetApiEventTypeRstTcp, .data = {.interface = {.uri = (char*) uri}}};
+    net_api_call(net, &msg);
+}
 
-    NetApiEventMessage msg = {.lock = lock, .type = NetApiEventTypeRestart};
+void net_set_config(Net* net, const NetConfig* config)
+{
+    rhs_assert(net);
+    NetApiEventMessage msg = {.type = NetApiEventTypeRestart};
     memcpy(&msg.data.config, config, sizeof(NetConfig));
-    rhs_message_queue_put(net->queue, &msg, RHSWaitForever);
-
-    if (thread != net->thread)
-    {
-        api_lock_wait_unlock_and_free(msg.lock);
-    }
+    net_api_call(net, &msg);
 }
 
 void net_get_config(Net* net, NetConfig* config)
@@ -177,25 +199,40 @@ void net_stop(Net* net)
 {
     rhs_assert(net);
     NetApiEventMessage msg = {.type = NetApiEventTypeStop};
-    rhs_message_queue_put(net->queue, &msg, RHSWaitForever);
+    rhs_message_queue_put_priority(net->queue, &msg, RHSMessagePriorityUrgent, RHSWaitForever);
 }
 
 int32_t net_worker(void* context)
 {
     Net* net = (Net*) context;
-    net->cli = rhs_record_open(RECORD_CLI);
+    net->cli = rhs_record_id_open(&record_cli);
 
     net_mdns_start(net);
 
     NetApiEventMessage msg;
     RHS_LOG_I(TAG, "Starting event loop");
 
+    RHSWaitSet* wait_set = rhs_wait_set_alloc(rhs_message_queue_get_capacity(net->queue) + 1);
+    rhs_wait_set_add_message_queue(wait_set, net->queue);
+    if (net->rx_wake)
+        rhs_wait_set_add_semaphore(wait_set, net->rx_wake);
+
+    const uint32_t poll_period = rhs_ms_to_ticks(NET_POLL_PERIOD_MS);
+
     for (;;)
     {
         mg_mgr_poll(net->mgr, 0);  // Infinite event loop
 
-        if (rhs_message_queue_get(net->queue, &msg, 0) == RHSStatusOk)
+        // Sleep until API call, driver RX or next poll instead of spinning
+        void* ready = rhs_wait_set_wait(wait_set, poll_period);
+        if (ready != NULL && ready == net->rx_wake)
+        {
+            rhs_semaphore_acquire(net->rx_wake, 0);
+        }
+        else if (ready == net->queue && rhs_message_queue_get(net->queue, &msg, 0) == RHSStatusOk)
         {
+            RHSStatus status = RHSStatusOk;
+
             if (msg.type == NetApiEventTypeSetHttp)
             {
                 mg_http_listen(net->mgr, msg.data.interface.uri, msg.data.interface.fn, msg.data.interface.context);
@@ -248,11 +285,13 @@ int32_t net_worker(void* context)
                     if (net_listeners_remove(&net->listeners, msg.data.interface.uri) != true)
                     {
                         RHS_LOG_E(TAG, "Listener not found in stored list: %s", msg.data.interface.uri);
+                        status = RHSStatusErrorResource;
                     }
                 }
                 else
                 {
                     RHS_LOG_E(TAG, "invalid listening URL: %s", msg.data.interface.uri);
+                    status = RHSStatusErrorParameter;
                 }
             }
             else if (msg.type == NetApiEventTypeRestart)
@@ -266,6 +305,12 @@ int32_t net_worker(void* context)
                 if (string_to_ip(msg.data.config.gateway, &pa, &pb, &pc, &pd) == 0)
                     net->mgr->ifp->gw = MG_IPV4(pa, pb, pc, pd);
 
+                if (net->retained)
+                {
+                    net_get_config(net, net->retained);
+                    rhs_retained_commit(net->retained);
+                }
+
                 // Close all existing connections
                 for (c = net->mgr->conns; c != NULL; c = c->next)
                     c->is_closing = 1;
@@ -293,15 +338,25 @@ int32_t net_worker(void* context)
                 break;
             }
 
-            if (msg.lock)
-                api_lock_unlock(msg.lock);
+            if (msg.rpc)
+                rhs_rpc_complete(msg.rpc, status);
         }
     }
 
+    // Wait set members must be empty on removal
+    while (rhs_message_queue_get(net->queue, &msg, 0) == RHSStatusOk)
+    {
+        if (msg.rpc)
+            rhs_rpc_complete(msg.rpc, RHSStatusErrorResource);
+    }
+    if (net->rx_wake)
+        rhs_semaphore_acquire(net->rx_wake, 0);
+    rhs_wait_set_free(wait_set);
+
     for (NetListener* listener = net->listeners; listener != NULL; listener = listener->next)
     {
         net_listeners_remove(&net->listeners, listener->uri);
     }
     net_mdns_stop(net);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 }
@@ -27,6 +27,16 @@ typedef struct Net Net;
 
 void net_start_http(Net* net, const char* uri, mg_event_handler_t fn, void* context);
 
+/** Serve metrics registry over HTTP
+ *
+ * GET /metrics returns Prometheus text, GET /metrics.bin the binary dump of
+ * core/metrics.h.
+ *
+ * @param      net  Net instance
+ * @param[in]  url  listening url, for example "http://0.0.0.0:9100"
+ */
+void net_start_metrics(Net* net, const char* url);
+
 void net_start_listener(Net* net, const char* uri, mg_event_handler_t fn, void* context);
 
 void net_stop_listener(Net* net, const char* uri);
@@ -29,7 +29,7 @@ typedef enum
 
 typedef struct
 {
-    RHSApiLock      lock;
+    RHSRpc*         rpc;
     NetApiEventType type;
     NetApiEventData data;
 } NetApiEventMessage;
@@ -38,9 +38,11 @@ struct Net
 {
     struct mg_mgr*   mgr;  // Initialise Mongoose event manager
     NetConfig*       config;
+    NetConfig*       retained;   // Config restored on warm boot, NULL if driver does not retain it
     NetListener*     listeners;  // Linked list of registered listeners
     RHSThread*       thread;
     RHSMessageQueue* queue;
+    RHSSemaphore*    rx_wake;  // Released by drivers that signal RX, NULL if driver is only polled
     Cli*             cli;
 };
 
@@ -419,6 +419,7 @@ static bool cdc_net_recv_cb(const uint8_t* buf, uint16_t len, void* context)
 {
     rhs_assert(context);
     mg_tcpip_qwrite((void*) buf, len, ((Net*) context)->mgr->ifp);
+    rhs_semaphore_release(((Net*) context)->rx_wake);
     // RHS_LOG_I(TAG, "RECV %hu", len);
     // mg_hexdump(buf, len);
     tud_network_recv_renew();
@@ -512,6 +513,7 @@ static void usb_cdc_net_free(CdcNet* app)
 {
     rhs_thread_free(app->net.thread);
     rhs_message_queue_free(app->net.queue);
+    rhs_semaphore_free(app->net.rx_wake);
     mg_mgr_free(app->net.mgr);
     free(app->net.mgr->ifp->driver);
     free(app->net.mgr->ifp);
@@ -526,7 +528,9 @@ static CdcNet* usb_cdc_net_alloc(const NetConfig* config)
     rhs_assert(app != NULL);
 
     memset(app, 0, sizeof(*app));
-    app->net.queue = rhs_message_queue_alloc(3, sizeof(NetApiEventMessage));
+    app->net.queue   = rhs_message_queue_alloc_priority(3, 2, sizeof(NetApiEventMessage));
+    rhs_message_queue_set_name(app->net.queue, "usb_cdc_net");
+    app->net.rx_wake = rhs_semaphore_alloc(1, 0);
 
     app->net.mgr    = malloc(sizeof(struct mg_mgr));
     app->net.config = malloc(sizeof(NetConfig));
@@ -308,6 +308,7 @@ UsbEthBridge* usb_eth_bridge_start(const UsbEthBridgePhyConfig* phy_config)
     b->finish = false;
 
     /* --- Ethernet hardware + driver init ---------------------------------- */
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralEth);
     rhs_hal_eth_init();
 
     b->eth_drv_data.mdc_cr   = phy_config ? phy_config->mdc_cr : MG_DRIVER_MDC_CR;
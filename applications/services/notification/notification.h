@@ -1,8 +1,12 @@
 #pragma once
 #include "stdint.h"
+#include "stdbool.h"
+#include "core/record.h"
 
 #define RECORD_NOTIFY "notify"
 
+RHS_RECORD_DECLARE(record_notify);
+
 typedef struct NotificationApp NotificationApp;
 
 typedef struct
@@ -40,4 +44,10 @@ typedef struct
 
 typedef const NotificationMessage* NotificationSequence[];
 
-void notification_message(NotificationApp* app, const NotificationSequence* sequence);
+/** Queue sequence, waits at most NOTIFICATION_PUT_TIMEOUT_MS for room
+ *
+ * @return     false if the queue stayed full, the sequence is dropped and counted
+ */
+bool notification_message(NotificationApp* app, const NotificationSequence* sequence);
+
+uint32_t notification_get_drops(NotificationApp* app);
@@ -4,11 +4,15 @@
 #include "rhs.h"
 #include "rhs_hal.h"
 
+RHS_RECORD_DEFINE(record_notify, RECORD_NOTIFY);
+
 // App alloc
 static NotificationApp* notification_app_alloc(void)
 {
     NotificationApp* app = malloc(sizeof(NotificationApp));
-    app->queue           = rhs_message_queue_alloc(8, sizeof(NotificationAppMessage));
+    app->queue           = rhs_message_queue_alloc(NOTIFICATION_QUEUE_SIZE, sizeof(NotificationAppMessage));
+    rhs_message_queue_set_name(app->queue, "notification");
+    app->drops = 0;
     return app;
 }
 
@@ -34,54 +38,50 @@ static void notification_sound_off(void)
     }
 }
 
-// message processing
-static void notification_process_notification_message(NotificationApp* app, NotificationAppMessage* message)
+// Runs on loader thread, see co_service() in CMakeLists.txt
+RHSCoroutineStatus notification_srv(RHSCoroutine* co, void* context)
 {
-    uint32_t                   notification_message_index = 0;
-    const NotificationMessage* notification_message;
-    notification_message = (*message->sequence)[notification_message_index];
-    while (notification_message != NULL)
-    {
-        switch (notification_message->type)
-        {
-        case NotificationMessageTypeSoundOn:
-            notification_sound_on(notification_message->data.sound.frequency, notification_message->data.sound.volume);
-            break;
-        case NotificationMessageTypeSoundOff:
-            notification_sound_off();
-            break;
-        case NotificationMessageTypeDelay:
-            rhs_delay_ms(notification_message->data.delay.length);
-            break;
-        case NotificationMessageTypeDoNotReset:
-            break;
-        }
-        notification_message_index++;
-        notification_message = (*message->sequence)[notification_message_index];
-    };
-}
+    NotificationApp* app = (NotificationApp*) context;
 
-int32_t notification_srv(void* context)
-{
-    NotificationApp* app = notification_app_alloc();
+    RHS_CO_BEGIN(co);
+
+    app = notification_app_alloc();
+    rhs_coroutine_set_context(co, app);
+    rhs_coroutine_executor_add_message_queue(rhs_coroutine_get_executor(co), app->queue);
 
     notification_message(app, &sequence_success);
     notification_sound_off();
-    rhs_record_create(RECORD_NOTIFY, app);
-
-    NotificationAppMessage message;
+    rhs_record_id_create(&record_notify, app);
 
     while (1)
     {
-        rhs_assert(rhs_message_queue_get(app->queue, &message, RHSWaitForever) == RHSStatusOk);
+        RHS_CO_MESSAGE_QUEUE_GET(co, app->queue, &app->message, RHSWaitForever, app->status);
+        rhs_assert(app->status == RHSStatusOk);
+
+        if (app->message.type != NotificationLayerMessage)
+        {
+            continue;
+        }
 
-        switch (message.type)
+        // Message processing, awaits can not be placed inside switch
+        for (app->index = 0; (app->step = (*app->message.sequence)[app->index]) != NULL; app->index++)
         {
-        case NotificationLayerMessage:
-            notification_process_notification_message(app, &message);
-            break;
+            if (app->step->type == NotificationMessageTypeSoundOn)
+            {
+                notification_sound_on(app->step->data.sound.frequency, app->step->data.sound.volume);
+            }
+            else if (app->step->type == NotificationMessageTypeSoundOff)
+            {
+                notification_sound_off();
+            }
+            else if (app->step->type == NotificationMessageTypeDelay)
+            {
+                RHS_CO_SLEEP(co, rhs_ms_to_ticks(app->step->data.delay.length));
+            }
         }
         // TODO block Feature
     }
     notification_app_free(app);
+
+    RHS_CO_END(co);
 }
@@ -12,7 +12,15 @@ typedef struct
     NotificationAppMessageType  type;
 } NotificationAppMessage;
 
+#define NOTIFICATION_QUEUE_SIZE     8
+#define NOTIFICATION_PUT_TIMEOUT_MS 100  // Longest wait of notification_message for a full queue
+
 struct NotificationApp
 {
-    RHSMessageQueue* queue;
+    RHSMessageQueue*           queue;
+    NotificationAppMessage     message;
+    RHSStatus                  status;
+    uint32_t                   index;  // Position in message sequence
+    const NotificationMessage* step;
+    volatile uint32_t          drops;  // Sequences refused by a full queue
 };
@@ -3,10 +3,21 @@
 #include "notification_app.h"
 #include "rhs.h"
 
-void notification_message(NotificationApp* app, const NotificationSequence* sequence)
+bool notification_message(NotificationApp* app, const NotificationSequence* sequence)
 {
     rhs_assert(sequence);
 
+    // Bounded, the queue is drained by a coroutine that may not run yet or be held up by another one
     NotificationAppMessage m = {.type = NotificationLayerMessage, .sequence = sequence};
-    rhs_assert(rhs_message_queue_put(app->queue, &m, RHSWaitForever) == RHSStatusOk);
+    if (rhs_message_queue_put(app->queue, &m, rhs_ms_to_ticks(NOTIFICATION_PUT_TIMEOUT_MS)) != RHSStatusOk)
+    {
+        rhs_atomic_add(&app->drops, 1);
+        return false;
+    }
+    return true;
+}
+
+uint32_t notification_get_drops(NotificationApp* app)
+{
+    return rhs_atomic_load(&app->drops);
 }
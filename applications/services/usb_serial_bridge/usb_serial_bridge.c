@@ -15,42 +15,49 @@ typedef enum
     WorkerEvtStop   = (1 << 0),
     WorkerEvtRxDone = (1 << 1),
 
-    WorkerEvtTxStop        = (1 << 2),
-    WorkerEvtCdcRx         = (1 << 3),
-    WorkerEvtCdcTxComplete = (1 << 4),
+    WorkerEvtCdcRx         = (1 << 2),
+    WorkerEvtCdcTxComplete = (1 << 3),
 
-    WorkerEvtCfgChange = (1 << 5),
+    WorkerEvtCfgChange = (1 << 4),
 
-    WorkerEvtLineCfgSet  = (1 << 6),
-    WorkerEvtCtrlLineSet = (1 << 7),
+    WorkerEvtLineCfgSet  = (1 << 5),
+    WorkerEvtCtrlLineSet = (1 << 6),
 
 } WorkerEvtFlags;
 
-#define WORKER_ALL_RX_EVENTS                                                                             \
-    (WorkerEvtStop | WorkerEvtRxDone | WorkerEvtCfgChange | WorkerEvtLineCfgSet | WorkerEvtCtrlLineSet | \
-     WorkerEvtCdcTxComplete)
-#define WORKER_ALL_TX_EVENTS (WorkerEvtTxStop | WorkerEvtCdcRx)
+#define WORKER_ALL_EVENTS \
+    (WorkerEvtStop | WorkerEvtCfgChange | WorkerEvtLineCfgSet | WorkerEvtCtrlLineSet | WorkerEvtCdcTxComplete)
+#define WORKER_ALL_TX_EVENTS (WorkerEvtStop | WorkerEvtCdcRx)
 
 struct UsbSerialBridge
 {
     UsbSerialConfig cfg;
     UsbSerialConfig cfg_new;
 
-    RHSThread* thread;
-    RHSThread* tx_thread;
+    RHSThread*    thread;
+    RHSEventFlag* events;
+    RHSThread*    tx_thread;  // USB -> serial, blocking serial TX must not stall serial -> USB
+    RHSEventFlag* tx_events;
 
     RHSStreamBuffer* rx_stream;
     RHSHalSerial*    serial_handle;
 
-    RHSMutex* usb_mutex;
-
+    RHSMutex*     usb_mutex;  // CDC calls from both threads
     RHSSemaphore* tx_sem;
 
-    UsbSerialState st;
+    UsbSerialState    st;
+    RHSSeqlock        st_lock;  // Worker is the only writer of st
+    volatile uint32_t tx_cnt;   // Written by the TX thread, st.tx_cnt is filled in on read
+
+    RHSMetric metric_rx;
+    RHSMetric metric_tx;
+    char      metric_names[2][24];
 
-    RHSApiLock cfg_lock;
+    RHSMutex* cfg_mutex;  // Serializes usb_serial_set_config callers, held until the worker applied cfg_new
+    RHSRpc*   cfg_rpc;
 
     uint8_t rx_buf[USB_CDC_PKT_LEN];
+    uint8_t tx_buf[USB_CDC_PKT_LEN];
 };
 
 static void vcp_on_cdc_tx_complete(void* context);
@@ -75,8 +82,8 @@ static void serial_rx_cb(RHSHalSerial* handle, RHSHalSerialRxEvent event, void*
     if (event & (RHSHalSerialRxEventData))
     {
         uint8_t data = rhs_hal_serial_async_rx(handle);
+        // Wakes up worker through its wait set
         rhs_stream_buffer_send(usb_serial->rx_stream, &data, 1, 0);
-        rhs_thread_flags_set(rhs_thread_get_id(usb_serial->thread), WorkerEvtRxDone);
     }
 }
 
@@ -111,24 +118,24 @@ static int32_t usb_serial_tx_thread(void* context)
 {
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
 
-    uint8_t data[USB_CDC_PKT_LEN];
     while (1)
     {
-        uint32_t events = rhs_thread_flags_wait(WORKER_ALL_TX_EVENTS, RHSFlagWaitAny, RHSWaitForever);
+        uint32_t events =
+            rhs_event_flag_wait(usb_serial->tx_events, WORKER_ALL_TX_EVENTS, RHSFlagWaitAny, RHSWaitForever);
         rhs_assert(!(events & RHSFlagError));
-        if (events & WorkerEvtTxStop)
+        if (events & WorkerEvtStop)
             break;
         if (events & WorkerEvtCdcRx)
         {
             rhs_assert(rhs_mutex_acquire(usb_serial->usb_mutex, RHSWaitForever) == RHSStatusOk);
-            size_t len = rhs_hal_cdc_receive(usb_serial->cfg.vcp_ch, data, USB_CDC_PKT_LEN);
+            int32_t len = rhs_hal_cdc_receive(usb_serial->cfg.vcp_ch, usb_serial->tx_buf, USB_CDC_PKT_LEN);
             rhs_assert(rhs_mutex_release(usb_serial->usb_mutex) == RHSStatusOk);
 
             if (len > 0)
             {
-                usb_serial->st.tx_cnt += len;
+                rhs_atomic_add(&usb_serial->tx_cnt, (uint32_t) len);
 
-                rhs_hal_serial_tx(usb_serial->serial_handle, data, len);
+                rhs_hal_serial_tx(usb_serial->serial_handle, usb_serial->tx_buf, len);
 
                 if (usb_serial->cfg.software_de_re != 0)
                 {
@@ -139,6 +146,33 @@ static int32_t usb_serial_tx_thread(void* context)
     return 0;
 }
 
+static void usb_serial_tx_thread_stop(UsbSerialBridge* usb_serial)
+{
+    rhs_event_flag_set(usb_serial->tx_events, WorkerEvtStop);
+    rhs_thread_join(usb_serial->tx_thread);
+}
+
+static void usb_serial_tx_thread_start(UsbSerialBridge* usb_serial)
+{
+    // Data may have arrived while the thread was stopped
+    rhs_event_flag_clear(usb_serial->tx_events, WorkerEvtStop);
+    rhs_event_flag_set(usb_serial->tx_events, WorkerEvtCdcRx);
+    rhs_thread_start(usb_serial->tx_thread);
+}
+
+static uint32_t usb_serial_wait_events(UsbSerialBridge* usb_serial, RHSWaitSet* wait_set)
+{
+    void* ready = rhs_wait_set_wait(wait_set, RHSWaitForever);
+
+    if (ready == usb_serial->rx_stream)
+    {
+        return WorkerEvtRxDone;
+    }
+
+    uint32_t events = rhs_event_flag_wait(usb_serial->events, WORKER_ALL_EVENTS, RHSFlagWaitAny, 0);
+    return (events & RHSFlagError) ? 0 : events;
+}
+
 static int32_t usb_serial_worker(void* context)
 {
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
@@ -146,25 +180,31 @@ static int32_t usb_serial_worker(void* context)
     memcpy(&usb_serial->cfg, &usb_serial->cfg_new, sizeof(UsbSerialConfig));
 
     usb_serial->rx_stream = rhs_stream_buffer_alloc(USB_UART_RX_BUF_SIZE, 1);
+    rhs_stream_buffer_set_name(usb_serial->rx_stream, "usb_serial_rx");
 
     usb_serial->tx_sem    = rhs_semaphore_alloc(1, 1);
     usb_serial->usb_mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
-
     usb_serial->tx_thread = rhs_thread_alloc("UsbSerialTxWorker", 1024, usb_serial_tx_thread, usb_serial);
 
+    // Control events and serial RX data in one thread, USB RX in tx_thread
+    RHSWaitSet* wait_set = rhs_wait_set_alloc(2);
+    rhs_wait_set_add_event_flag(wait_set, usb_serial->events);
+    rhs_wait_set_add_stream_buffer(wait_set, usb_serial->rx_stream);
+
     usb_serial_vcp_init(usb_serial, usb_serial->cfg.vcp_ch);
 
     usb_serial->serial_handle = rhs_hal_serial_init(usb_serial->cfg.serial_ch, usb_serial->cfg.baudrate);
     rhs_hal_serial_async_rx_start(usb_serial->serial_handle, serial_rx_cb, usb_serial);
 
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->tx_thread), WorkerEvtCdcRx);
+    rhs_seqlock_write_begin(&usb_serial->st_lock);
+    usb_serial->st.baudrate_cur = usb_serial->cfg.baudrate;
+    rhs_seqlock_write_end(&usb_serial->st_lock);
 
-    rhs_thread_start(usb_serial->tx_thread);
+    usb_serial_tx_thread_start(usb_serial);
 
     while (1)
     {
-        uint32_t events = rhs_thread_flags_wait(WORKER_ALL_RX_EVENTS, RHSFlagWaitAny, RHSWaitForever);
-        rhs_assert(!(events & RHSFlagError));
+        uint32_t events = usb_serial_wait_events(usb_serial, wait_set);
         if (events & WorkerEvtStop)
             break;
         if (events & (WorkerEvtRxDone | WorkerEvtCdcTxComplete))
@@ -174,7 +214,9 @@ static int32_t usb_serial_worker(void* context)
             {
                 if (rhs_semaphore_acquire(usb_serial->tx_sem, 100) == RHSStatusOk)
                 {
+                    rhs_seqlock_write_begin(&usb_serial->st_lock);
                     usb_serial->st.rx_cnt += len;
+                    rhs_seqlock_write_end(&usb_serial->st_lock);
                     rhs_assert(rhs_mutex_acquire(usb_serial->usb_mutex, RHSWaitForever) == RHSStatusOk);
                     rhs_hal_cdc_send(usb_serial->cfg.vcp_ch, usb_serial->rx_buf, len);
                     rhs_assert(rhs_mutex_release(usb_serial->usb_mutex) == RHSStatusOk);
@@ -190,28 +232,25 @@ static int32_t usb_serial_worker(void* context)
         {
             if (usb_serial->cfg.vcp_ch != usb_serial->cfg_new.vcp_ch)
             {
-                rhs_thread_flags_set(rhs_thread_get_id(usb_serial->tx_thread), WorkerEvtTxStop);
-                rhs_thread_join(usb_serial->tx_thread);
+                usb_serial_tx_thread_stop(usb_serial);
 
                 usb_serial_vcp_deinit(usb_serial, usb_serial->cfg.vcp_ch);
                 usb_serial_vcp_init(usb_serial, usb_serial->cfg_new.vcp_ch);
 
                 usb_serial->cfg.vcp_ch = usb_serial->cfg_new.vcp_ch;
-                rhs_thread_start(usb_serial->tx_thread);
+                usb_serial_tx_thread_start(usb_serial);
                 events |= WorkerEvtCtrlLineSet;
                 events |= WorkerEvtLineCfgSet;
             }
             if (usb_serial->cfg.serial_ch != usb_serial->cfg_new.serial_ch)
             {
-                rhs_thread_flags_set(rhs_thread_get_id(usb_serial->tx_thread), WorkerEvtTxStop);
-                rhs_thread_join(usb_serial->tx_thread);
+                usb_serial_tx_thread_stop(usb_serial);
 
                 usb_uart_serial_deinit(usb_serial);
                 usb_uart_serial_init(usb_serial, usb_serial->cfg_new.serial_ch);
 
                 usb_serial->cfg.serial_ch = usb_serial->cfg_new.serial_ch;
-
-                rhs_thread_start(usb_serial->tx_thread);
+                usb_serial_tx_thread_start(usb_serial);
             }
             if (usb_serial->cfg.baudrate != usb_serial->cfg_new.baudrate)
             {
@@ -230,7 +269,12 @@ static int32_t usb_serial_worker(void* context)
                 rhs_crash("Software de-re change not implemented");
                 usb_serial->cfg.software_de_re = usb_serial->cfg_new.software_de_re;
             }
-            api_lock_unlock(usb_serial->cfg_lock);
+            if (usb_serial->cfg_rpc)
+            {
+                RHSRpc* rpc         = usb_serial->cfg_rpc;
+                usb_serial->cfg_rpc = NULL;
+                rhs_rpc_complete(rpc, RHSStatusOk);
+            }
         }
         if (events & WorkerEvtLineCfgSet)
         {
@@ -245,13 +289,13 @@ static int32_t usb_serial_worker(void* context)
         }
     }
 
+    usb_serial_tx_thread_stop(usb_serial);
+    rhs_thread_free(usb_serial->tx_thread);
+
     usb_serial_vcp_deinit(usb_serial, usb_serial->cfg.vcp_ch);
     usb_uart_serial_deinit(usb_serial);
 
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->tx_thread), WorkerEvtTxStop);
-    rhs_thread_join(usb_serial->tx_thread);
-    rhs_thread_free(usb_serial->tx_thread);
-
+    rhs_wait_set_free(wait_set);
     rhs_stream_buffer_free(usb_serial->rx_stream);
     rhs_mutex_free(usb_serial->usb_mutex);
     rhs_semaphore_free(usb_serial->tx_sem);
@@ -268,13 +312,13 @@ static void vcp_on_cdc_tx_complete(void* context)
 {
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
     rhs_semaphore_release(usb_serial->tx_sem);
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->thread), WorkerEvtCdcTxComplete);
+    rhs_event_flag_set(usb_serial->events, WorkerEvtCdcTxComplete);
 }
 
 static void vcp_on_cdc_rx(void* context)
 {
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->tx_thread), WorkerEvtCdcRx);
+    rhs_event_flag_set(usb_serial->tx_events, WorkerEvtCdcRx);
 }
 
 static void vcp_state_callback(void* context, uint8_t state)
@@ -287,14 +331,14 @@ static void vcp_on_cdc_control_line(void* context, uint8_t state)
 {
     // UNUSED(state);
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->thread), WorkerEvtCtrlLineSet);
+    rhs_event_flag_set(usb_serial->events, WorkerEvtCtrlLineSet);
 }
 
 static void vcp_on_line_config(void* context, struct usb_cdc_line_coding* config)
 {
     // UNUSED(config);
     UsbSerialBridge* usb_serial = (UsbSerialBridge*) context;
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->thread), WorkerEvtLineCfgSet);
+    rhs_event_flag_set(usb_serial->events, WorkerEvtLineCfgSet);
 }
 
 static void usb_bridge_cb(char* args, void* context)
@@ -369,8 +413,26 @@ UsbSerialBridge* usb_serial_enable(UsbSerialConfig* cfg)
     UsbSerialBridge* usb_serial = calloc(1, sizeof(UsbSerialBridge));
     memcpy(&(usb_serial->cfg_new), cfg, sizeof(UsbSerialConfig));
 
+    usb_serial->events    = rhs_event_flag_alloc();
+    usb_serial->tx_events = rhs_event_flag_alloc();
+    usb_serial->cfg_mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
     usb_serial->thread = rhs_thread_alloc("UsbSerialWorker", 1024, usb_serial_worker, usb_serial);
 
+    snprintf(usb_serial->metric_names[0], sizeof(usb_serial->metric_names[0]), "usb_serial%u_rx_bytes", cfg->vcp_ch);
+    snprintf(usb_serial->metric_names[1], sizeof(usb_serial->metric_names[1]), "usb_serial%u_tx_bytes", cfg->vcp_ch);
+    rhs_metric_init(&usb_serial->metric_rx,
+                    usb_serial->metric_names[0],
+                    RHSMetricTypeCounter,
+                    rhs_metric_read_word,
+                    &usb_serial->st.rx_cnt);
+    rhs_metric_init(&usb_serial->metric_tx,
+                    usb_serial->metric_names[1],
+                    RHSMetricTypeCounter,
+                    rhs_metric_read_word,
+                    (void*) &usb_serial->tx_cnt);
+    rhs_metric_register(&usb_serial->metric_rx);
+    rhs_metric_register(&usb_serial->metric_tx);
+
     rhs_thread_start(usb_serial->thread);
 
     return usb_serial;
@@ -379,17 +441,49 @@ UsbSerialBridge* usb_serial_enable(UsbSerialConfig* cfg)
 void usb_serial_disable(UsbSerialBridge* usb_serial)
 {
     rhs_assert(usb_serial);
-    rhs_thread_flags_set(rhs_thread_get_id(usb_serial->thread), WorkerEvtStop);
+    rhs_metric_unregister(&usb_serial->metric_rx);
+    rhs_metric_unregister(&usb_serial->metric_tx);
+
+    rhs_event_flag_set(usb_serial->events, WorkerEvtStop);
     rhs_thread_join(usb_serial->thread);
     rhs_thread_free(usb_serial->thread);
+    rhs_event_flag_free(usb_serial->events);
+    rhs_event_flag_free(usb_serial->tx_events);
+    rhs_mutex_free(usb_serial->cfg_mutex);
     free(usb_serial);
 }
 
+void usb_serial_set_config(UsbSerialBridge* usb_serial, UsbSerialConfig* cfg)
+{
+    rhs_assert(usb_serial);
+    rhs_assert(cfg);
+
+    RHSRpc rpc;
+    rhs_rpc_init(&rpc);
+
+    // cfg_new and cfg_rpc are one slot, the next caller waits until the worker is done with it
+    rhs_assert(rhs_mutex_acquire(usb_serial->cfg_mutex, RHSWaitForever) == RHSStatusOk);
+    memcpy(&(usb_serial->cfg_new), cfg, sizeof(UsbSerialConfig));
+    usb_serial->cfg_rpc = &rpc;
+    rhs_event_flag_set(usb_serial->events, WorkerEvtCfgChange);
+    rhs_rpc_wait(&rpc);
+    rhs_mutex_release(usb_serial->cfg_mutex);
+}
+
+void usb_serial_get_state(UsbSerialBridge* usb_serial, UsbSerialState* st)
+{
+    rhs_assert(usb_serial);
+    rhs_assert(st);
+
+    rhs_seqlock_read(&usb_serial->st_lock, st, &usb_serial->st, sizeof(UsbSerialState));
+    st->tx_cnt = rhs_atomic_load(&usb_serial->tx_cnt);
+}
+
 void cli_vcp_start_up(void)
 {
-    Cli* cli = rhs_record_open(RECORD_CLI);
+    Cli* cli = rhs_record_id_open(&record_cli);
     cli_add_command(cli, "usb_bridge", usb_bridge_cb, NULL);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 
     // TODO cli_vcp
     // This is a stub
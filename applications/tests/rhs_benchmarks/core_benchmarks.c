@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rhs.h"
+#include "rhs_hal.h"
+
+#define TAG "core_bench"
+
+#define BENCH_STACK_SIZE 512
+#define BENCH_STREAM_CHUNK 64
+#define BENCH_RECORD "bench"
+
+#define BENCH_FLAG_PING (1U << 0)
+#define BENCH_FLAG_PONG (1U << 1)
+#define BENCH_FLAG_EXIT (1U << 2)
+
+uint32_t bench_queue_put_get(uint32_t iterations)
+{
+    RHSMessageQueue* queue = rhs_message_queue_alloc(1, sizeof(uint32_t));
+    uint32_t         value = 0;
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_message_queue_put(queue, &i, 0);
+        rhs_message_queue_get(queue, &value, 0);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_message_queue_free(queue);
+    return cycles;
+}
+
+uint32_t bench_queue_priority_put_get(uint32_t iterations)
+{
+    RHSMessageQueue* queue = rhs_message_queue_alloc_priority(1, 1, sizeof(uint32_t));
+    uint32_t         value = 0;
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_message_queue_put_priority(queue, &i, RHSMessagePriorityUrgent, 0);
+        rhs_message_queue_get(queue, &value, 0);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_message_queue_free(queue);
+    return cycles;
+}
+
+static int32_t bench_event_flag_worker(void* context)
+{
+    RHSEventFlag* event = context;
+
+    for (;;)
+    {
+        uint32_t flags = rhs_event_flag_wait(event, BENCH_FLAG_PING | BENCH_FLAG_EXIT, RHSFlagWaitAny, RHSWaitForever);
+        if (flags & BENCH_FLAG_EXIT)
+            break;
+        rhs_event_flag_set(event, BENCH_FLAG_PONG);
+    }
+
+    return 0;
+}
+
+uint32_t bench_event_flag_round_trip(uint32_t iterations)
+{
+    RHSEventFlag* event  = rhs_event_flag_alloc();
+    RHSThread*    worker = rhs_thread_alloc_ex("bench_ef",
+                                            BENCH_STACK_SIZE,
+                                            RHSThreadPriorityHigh,
+                                            bench_event_flag_worker,
+                                            event);
+    rhs_thread_start(worker);
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_event_flag_set(event, BENCH_FLAG_PING);
+        rhs_event_flag_wait(event, BENCH_FLAG_PONG, RHSFlagWaitAny, RHSWaitForever);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_event_flag_set(event, BENCH_FLAG_EXIT);
+    rhs_thread_join(worker);
+    rhs_thread_free(worker);
+    rhs_event_flag_free(event);
+    return cycles;
+}
+
+uint32_t bench_mutex_uncontended(uint32_t iterations)
+{
+    RHSMutex* mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_mutex_acquire(mutex, RHSWaitForever);
+        rhs_mutex_release(mutex);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_mutex_free(mutex);
+    return cycles;
+}
+
+typedef struct
+{
+    RHSMutex*     mutex;
+    volatile bool exit;
+} BenchMutexContext;
+
+static int32_t bench_mutex_worker(void* context)
+{
+    BenchMutexContext* ctx = context;
+
+    while (!ctx->exit)
+    {
+        rhs_mutex_acquire(ctx->mutex, RHSWaitForever);
+        rhs_delay_ms(0);
+        rhs_mutex_release(ctx->mutex);
+    }
+
+    return 0;
+}
+
+uint32_t bench_mutex_contended(uint32_t iterations)
+{
+    BenchMutexContext ctx    = {.mutex = rhs_mutex_alloc(RHSMutexTypeNormal), .exit = false};
+    RHSThread*        worker = rhs_thread_alloc("bench_mtx", BENCH_STACK_SIZE, bench_mutex_worker, &ctx);
+    rhs_thread_start(worker);
+
+    // Both threads hold the mutex across a yield, so every acquire competes with the worker
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_mutex_acquire(ctx.mutex, RHSWaitForever);
+        rhs_delay_ms(0);
+        rhs_mutex_release(ctx.mutex);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    ctx.exit = true;
+    rhs_thread_join(worker);
+    rhs_thread_free(worker);
+    rhs_mutex_free(ctx.mutex);
+    return cycles;
+}
+
+uint32_t bench_stream_buffer(uint32_t iterations)
+{
+    RHSStreamBuffer* stream = rhs_stream_buffer_alloc(BENCH_STREAM_CHUNK * 2, 1);
+    uint8_t          tx[BENCH_STREAM_CHUNK];
+    uint8_t          rx[BENCH_STREAM_CHUNK];
+    memset(tx, 0xA5, sizeof(tx));
+
+    // iterations is amount of bytes pushed through the buffer
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t sent = 0; sent < iterations; sent += BENCH_STREAM_CHUNK)
+    {
+        rhs_stream_buffer_send(stream, tx, sizeof(tx), 0);
+        rhs_stream_buffer_receive(stream, rx, sizeof(rx), 0);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_stream_buffer_free(stream);
+    return cycles;
+}
+
+uint32_t bench_malloc_free(uint32_t iterations)
+{
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        void* volatile ptr = malloc(32);
+        free(ptr);
+    }
+    return rhs_hal_cortex_get_cycles() - start;
+}
+
+uint32_t bench_record_open(uint32_t iterations)
+{
+    static uint32_t data;
+    rhs_record_create(BENCH_RECORD, &data);
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_record_open(BENCH_RECORD);
+        rhs_record_close(BENCH_RECORD);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_record_destroy(BENCH_RECORD);
+    return cycles;
+}
+
+static RHS_RECORD_DEFINE(bench_record_id, "bench_id");
+
+uint32_t bench_record_id_open(uint32_t iterations)
+{
+    static uint32_t data;
+    rhs_record_id_create(&bench_record_id, &data);
+
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_record_id_open(&bench_record_id);
+        rhs_record_id_close(&bench_record_id);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_record_id_destroy(&bench_record_id);
+    return cycles;
+}
+
+typedef struct
+{
+    RHSSemaphore* running;
+    uint32_t      cycles;  // Body entry
+} BenchThread;
+
+static int32_t bench_thread_body(void* context)
+{
+    BenchThread* bench = context;
+    bench->cycles      = rhs_hal_cortex_get_cycles();
+    rhs_semaphore_release(bench->running);
+    return 0;
+}
+
+uint32_t bench_thread_start(uint32_t iterations)
+{
+    BenchThread bench  = {.running = rhs_semaphore_alloc(1, 0)};
+    RHSThread*  thread = rhs_thread_alloc("bench_thr", BENCH_STACK_SIZE, bench_thread_body, &bench);
+    uint32_t    cycles = 0;
+
+    // From rhs_thread_start to the first instruction of the body, join polls ticks and is left out
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        uint32_t start = rhs_hal_cortex_get_cycles();
+        rhs_thread_start(thread);
+        rhs_semaphore_acquire(bench.running, RHSWaitForever);
+        cycles += bench.cycles - start;
+        rhs_thread_join(thread);
+    }
+
+    rhs_thread_free(thread);
+    rhs_semaphore_free(bench.running);
+    return cycles;
+}
+
+static void bench_timer_callback(void* context)
+{
+    (void) context;
+}
+
+uint32_t bench_timer_restart(uint32_t iterations)
+{
+    RHSTimer* timer = rhs_timer_alloc(bench_timer_callback, RHSTimerTypeOnce, NULL);
+
+    // Each call is a round trip through timer command queue
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_timer_restart(timer, 1000 + (i & 0xFFU));
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_timer_stop(timer);
+    rhs_timer_free(timer);
+    return cycles;
+}
+
+uint32_t bench_timer_wheel_start_stop(uint32_t iterations)
+{
+    RHSTimerWheel*      wheel   = rhs_timer_wheel_alloc(1);
+    RHSTimerWheelEntry* entries = malloc(iterations * sizeof(RHSTimerWheelEntry));
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_timer_wheel_entry_init(&entries[i], bench_timer_callback, NULL);
+    }
+
+    // Arm all entries over every wheel level, then cancel them
+    uint32_t start = rhs_hal_cortex_get_cycles();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_timer_wheel_start(wheel, &entries[i], 1000 + i * 97U);
+    }
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        rhs_timer_wheel_stop(wheel, &entries[i]);
+    }
+    uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    free(entries);
+    rhs_timer_wheel_free(wheel);
+    return cycles;
+}
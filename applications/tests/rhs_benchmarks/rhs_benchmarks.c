@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include "rhs.h"
+#include "rhs_hal.h"
+#include "cli.h"
+#include "rhs_version.h"
+
+#define TAG "bench"
+
+static void rhs_benchmarks_run(const char* filter)
+{
+    bool first = true;
+
+    printf("{\"git_sha\":\"%s\",\"frequency\":%lu,\"benchmarks\":[",
+           PROJECT_GIT_SHA1,
+           rhs_hal_cortex_get_cycles_frequency());
+
+    for (size_t i = 0; i < RHS_BENCHMARKS_COUNT; i++)
+    {
+        const RHSInternalBenchmark* bench = &RHS_BENCHMARKS[i];
+        if (filter != NULL && strcmp(filter, bench->name) != 0)
+            continue;
+
+        RHS_LOG_D(TAG, "Running %s", bench->name);
+        uint32_t cycles = bench->run(bench->iterations);
+
+        printf("%s\r\n{\"name\":\"%s\",\"iterations\":%lu,\"cycles\":%lu,\"cycles_per_op\":%lu}",
+               first ? "" : ",",
+               bench->name,
+               bench->iterations,
+               cycles,
+               cycles / bench->iterations);
+        first = false;
+    }
+
+    printf("\r\n]}\r\n");
+}
+
+static void rhs_benchmarks_command(char* args, void* context)
+{
+    if (args != NULL && strcmp(args, "-l") == 0)
+    {
+        for (size_t i = 0; i < RHS_BENCHMARKS_COUNT; i++)
+        {
+            printf("%s\r\n", RHS_BENCHMARKS[i].name);
+        }
+        return;
+    }
+
+    rhs_benchmarks_run(args);
+}
+
+void rhs_benchmarks_start_up(void)
+{
+    Cli* cli = rhs_record_id_open(&record_cli);
+    cli_add_command(cli, "bench", rhs_benchmarks_command, NULL);
+    rhs_record_id_close(&record_cli);
+}
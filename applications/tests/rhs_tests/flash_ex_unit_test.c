@@ -107,7 +107,7 @@ void run_flash_ex_test(char* args, void* context)
 
 void flash_ex_test(void)
 {
-    Cli* cli = rhs_record_open(RECORD_CLI);
+    Cli* cli = rhs_record_id_open(&record_cli);
     cli_add_command(cli, "flash_ex_test", run_flash_ex_test, NULL);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 }
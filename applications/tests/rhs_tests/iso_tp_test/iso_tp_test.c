@@ -0,0 +1,412 @@
+#include <string.h>
+#include "rhs.h"
+#include "rhs_hal.h"
+#include "iso_tp.h"
+#include "runit.h"
+#include "cli.h"
+
+#define TAG "iso_tp_test"
+
+#define ISO_TP_TEST_CHANNEL (RHSHalCANIdMax - 1)  // can_virtual_round_trip benchmark inits and deinits the first
+#define ISO_TP_TEST_BAUD    1000000U
+#define ISO_TP_TEST_TX_ID   0x7E8U  // Frames of the session
+#define ISO_TP_TEST_RX_ID   0x7E0U  // Frames of the peer
+#define ISO_TP_TEST_SHORT   5U      // Single frame
+#define ISO_TP_TEST_BLOCKS  40U     // First frame and 5 consecutive frames, blocks of 2, 2 and 1
+#define ISO_TP_TEST_LONG    4100U   // Above 4095, 32 bit first frame length
+#define ISO_TP_TEST_ST_MIN  5U      // ms
+#define ISO_TP_TEST_WAIT_MS 100U    // Longest wait for a frame of the session
+#define ISO_TP_TEST_HOLD_MS 10U     // Session holds its next block at least this long
+#define ISO_TP_TEST_QUEUE   16U
+
+typedef struct
+{
+    RHSHalCANFrameType frame;
+    uint32_t           tick;  // Kernel tick the peer got it
+} IsoTpTestFrame;
+
+typedef struct
+{
+    RHSHalCANVirtualNode* node;
+    RHSMessageQueue*      frames;  // Frames of the session, as seen by the peer
+    RHSSemaphore*         rx_done;
+    RHSSemaphore*         tx_done;
+    IsoTpResult           rx_result;
+    IsoTpResult           tx_result;
+    size_t                rx_size;
+    uint32_t              rx_tick;
+} IsoTpTest;
+
+// Lives as long as the channel, the channel stays initialized after the first run
+static IsoTp* iso_tp_test_instance = NULL;
+
+static uint8_t iso_tp_test_message[ISO_TP_TEST_LONG];
+static uint8_t iso_tp_test_received[ISO_TP_TEST_LONG];
+
+static void iso_tp_test_peer_rx(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame, void* context)
+{
+    IsoTpTest*     test = context;
+    IsoTpTestFrame item = {.frame = *frame, .tick = rhs_get_tick()};
+    (void) node;
+
+    // A full queue drops the frame, the test then fails on the missing one
+    if (frame->id == ISO_TP_TEST_TX_ID)
+    {
+        rhs_message_queue_put(test->frames, &item, 0);
+    }
+}
+
+static void iso_tp_test_rx_callback(IsoTpSession*  session,
+                                    IsoTpResult    result,
+                                    const uint8_t* data,
+                                    size_t         size,
+                                    void*          context)
+{
+    IsoTpTest* test = context;
+    (void) session;
+
+    test->rx_result = result;
+    test->rx_size   = size;
+    test->rx_tick   = rhs_get_tick();
+    if (data)
+    {
+        memcpy(iso_tp_test_received, data, MIN(size, sizeof(iso_tp_test_received)));
+    }
+    rhs_semaphore_release(test->rx_done);
+}
+
+static void iso_tp_test_tx_callback(IsoTpSession* session, IsoTpResult result, void* context)
+{
+    IsoTpTest* test = context;
+    (void) session;
+
+    test->tx_result = result;
+    rhs_semaphore_release(test->tx_done);
+}
+
+static IsoTpSession* iso_tp_test_open(IsoTpTest* test, uint8_t block_size)
+{
+    const IsoTpSessionConfig config = {
+        .tx_id       = ISO_TP_TEST_TX_ID,
+        .rx_id       = ISO_TP_TEST_RX_ID,
+        .type        = FrameTypeStdID,
+        .block_size  = block_size,
+        .st_min      = 0,
+        .rx_size     = ISO_TP_TEST_LONG,
+        .rx_callback = iso_tp_test_rx_callback,
+        .tx_callback = iso_tp_test_tx_callback,
+        .context     = test,
+    };
+
+    rhs_message_queue_reset(test->frames);
+    memset(iso_tp_test_received, 0, sizeof(iso_tp_test_received));
+    return iso_tp_session_open(iso_tp_test_instance, &config);
+}
+
+static bool iso_tp_test_peer_get(IsoTpTest* test, IsoTpTestFrame* item, uint32_t timeout_ms)
+{
+    return rhs_message_queue_get(test->frames, item, rhs_ms_to_ticks(timeout_ms)) == RHSStatusOk;
+}
+
+static void iso_tp_test_peer_put(IsoTpTest* test, const uint8_t* data, size_t len)
+{
+    RHSHalCANFrameType frame = {.id = ISO_TP_TEST_RX_ID, .type = FrameTypeStdID, .len = (uint8_t) len};
+    memcpy(frame.payload, data, len);
+    runit_assert(rhs_hal_can_virtual_node_tx(test->node, &frame));
+}
+
+static void iso_tp_test_peer_fc(IsoTpTest* test, uint8_t block_size, uint8_t st_min)
+{
+    const uint8_t data[3] = {0x30, block_size, st_min};
+    iso_tp_test_peer_put(test, data, sizeof(data));
+}
+
+// Peer sends a first frame of size, 32 bit length above 4095, returns the bytes it carries
+static size_t iso_tp_test_peer_first(IsoTpTest* test, size_t size)
+{
+    uint8_t data[8] = {0};
+    size_t  pci     = 2;
+
+    if (size <= 4095U)
+    {
+        data[0] = (uint8_t) (0x10U | (size >> 8));
+        data[1] = (uint8_t) size;
+    }
+    else
+    {
+        data[0] = 0x10;
+        data[2] = (uint8_t) (size >> 24);
+        data[3] = (uint8_t) (size >> 16);
+        data[4] = (uint8_t) (size >> 8);
+        data[5] = (uint8_t) size;
+        pci     = 6;
+    }
+    memcpy(&data[pci], iso_tp_test_message, 8U - pci);
+    iso_tp_test_peer_put(test, data, sizeof(data));
+    return 8U - pci;
+}
+
+static void iso_tp_test_peer_consecutive(IsoTpTest* test, uint8_t sn, size_t offset, size_t size)
+{
+    uint8_t      data[8];
+    const size_t chunk = MIN(size - offset, 7U);
+
+    data[0] = (uint8_t) (0x20U | (sn & 0x0FU));
+    memcpy(&data[1], &iso_tp_test_message[offset], chunk);
+    iso_tp_test_peer_put(test, data, 1U + chunk);
+}
+
+// Peer receives a message of the session with its flow control, returns false on the first wrong frame
+static bool iso_tp_test_peer_receive(IsoTpTest* test, size_t size, uint8_t block_size, uint8_t st_min)
+{
+    IsoTpTestFrame item;
+    const uint8_t* data = item.frame.payload;
+    size_t         pci  = 2;
+
+    runit_assert(iso_tp_test_peer_get(test, &item, ISO_TP_TEST_WAIT_MS));
+    if (size <= 7U)
+    {
+        runit_assert(item.frame.len == 1U + size);
+        runit_assert(data[0] == size);
+        runit_assert(memcmp(&data[1], iso_tp_test_message, size) == 0);
+        return data[0] == size;
+    }
+
+    if (size <= 4095U)
+    {
+        runit_assert(data[0] == (0x10U | (size >> 8)));
+        runit_assert(data[1] == (uint8_t) size);
+    }
+    else
+    {
+        runit_assert(data[0] == 0x10U && data[1] == 0U);
+        runit_assert(data[2] == (uint8_t) (size >> 24) && data[3] == (uint8_t) (size >> 16));
+        runit_assert(data[4] == (uint8_t) (size >> 8) && data[5] == (uint8_t) size);
+        pci = 6;
+    }
+    size_t offset = 8U - pci;
+    runit_assert(item.frame.len == 8U);
+    runit_assert(memcmp(&data[pci], iso_tp_test_message, offset) == 0);
+
+    uint8_t sn = 1;
+    while (offset < size)
+    {
+        iso_tp_test_peer_fc(test, block_size, st_min);
+
+        uint32_t last = 0;
+        for (uint32_t i = 0; (block_size == 0 || i < block_size) && offset < size; i++)
+        {
+            const size_t chunk = MIN(size - offset, 7U);
+            if (!iso_tp_test_peer_get(test, &item, ISO_TP_TEST_WAIT_MS + ISO_TP_TEST_ST_MIN))
+            {
+                runit_assert(false);
+                return false;
+            }
+            if (data[0] != (0x20U | sn) || item.frame.len != 1U + chunk)
+            {
+                runit_assert(false);
+                return false;
+            }
+            runit_assert(memcmp(&data[1], &iso_tp_test_message[offset], chunk) == 0);
+
+            // Gap from the previous frame of the block
+            if (i > 0 && st_min > 0)
+            {
+                runit_assert(item.tick - last >= rhs_ms_to_ticks(st_min));
+            }
+            last    = item.tick;
+            offset += chunk;
+            sn      = (sn + 1U) & 0x0FU;
+        }
+
+        // Next block waits for the flow control
+        if (offset < size)
+        {
+            runit_assert(iso_tp_test_peer_get(test, &item, ISO_TP_TEST_HOLD_MS) == false);
+        }
+    }
+    return true;
+}
+
+// Peer sends a message to the session and follows its flow control, returns the flow control count
+static uint32_t iso_tp_test_peer_send(IsoTpTest* test, size_t size)
+{
+    IsoTpTestFrame item;
+    const uint8_t* data = item.frame.payload;
+    uint32_t       fcs  = 0;
+    uint32_t       left = 0;  // Frames of the block, 0 waits for flow control
+
+    if (size <= 7U)
+    {
+        uint8_t sf[8] = {(uint8_t) size};
+        memcpy(&sf[1], iso_tp_test_message, size);
+        iso_tp_test_peer_put(test, sf, 1U + size);
+        return 0;
+    }
+
+    size_t  offset = iso_tp_test_peer_first(test, size);
+    uint8_t sn     = 1;
+    while (offset < size)
+    {
+        if (left == 0)
+        {
+            if (!iso_tp_test_peer_get(test, &item, ISO_TP_TEST_WAIT_MS) || data[0] != 0x30U)
+            {
+                runit_assert(false);
+                return fcs;
+            }
+            fcs++;
+            left = data[1] ? data[1] : UINT32_MAX;
+        }
+
+        iso_tp_test_peer_consecutive(test, sn, offset, size);
+        offset += MIN(size - offset, 7U);
+        sn      = (sn + 1U) & 0x0FU;
+        left--;
+    }
+    return fcs;
+}
+
+static void single_frame_test(IsoTpTest* test)
+{
+    IsoTpSession* session = iso_tp_test_open(test, 0);
+
+    runit_assert(iso_tp_send(session, iso_tp_test_message, ISO_TP_TEST_SHORT));
+    runit_assert(iso_tp_test_peer_receive(test, ISO_TP_TEST_SHORT, 0, 0));
+    runit_assert(rhs_semaphore_acquire(test->tx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->tx_result == IsoTpResultOk);
+
+    runit_assert(iso_tp_test_peer_send(test, ISO_TP_TEST_SHORT) == 0U);
+    runit_assert(rhs_semaphore_acquire(test->rx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->rx_result == IsoTpResultOk);
+    runit_assert(test->rx_size == ISO_TP_TEST_SHORT);
+    runit_assert(memcmp(iso_tp_test_received, iso_tp_test_message, ISO_TP_TEST_SHORT) == 0);
+
+    IsoTpSessionStatistic statistic = iso_tp_session_get_statistic(session);
+    runit_assert(statistic.tx_messages == 1U);
+    runit_assert(statistic.rx_messages == 1U);
+    runit_assert(statistic.tx_errors == 0U && statistic.rx_errors == 0U);
+
+    iso_tp_session_close(session);
+}
+
+// Session sends with the block size and STmin of the peer, and asks the peer for blocks of 2
+static void block_test(IsoTpTest* test)
+{
+    IsoTpSession* session = iso_tp_test_open(test, 2);
+
+    runit_assert(iso_tp_send(session, iso_tp_test_message, ISO_TP_TEST_BLOCKS));
+    runit_assert(iso_tp_test_peer_receive(test, ISO_TP_TEST_BLOCKS, 2, ISO_TP_TEST_ST_MIN));
+    runit_assert(rhs_semaphore_acquire(test->tx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->tx_result == IsoTpResultOk);
+
+    runit_assert(iso_tp_test_peer_send(test, ISO_TP_TEST_BLOCKS) == 3U);
+    runit_assert(rhs_semaphore_acquire(test->rx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->rx_result == IsoTpResultOk);
+    runit_assert(test->rx_size == ISO_TP_TEST_BLOCKS);
+    runit_assert(memcmp(iso_tp_test_received, iso_tp_test_message, ISO_TP_TEST_BLOCKS) == 0);
+
+    iso_tp_session_close(session);
+}
+
+static void long_test(IsoTpTest* test)
+{
+    IsoTpSession* session = iso_tp_test_open(test, 8);
+
+    runit_assert(iso_tp_send(session, iso_tp_test_message, ISO_TP_TEST_LONG));
+    runit_assert(iso_tp_test_peer_receive(test, ISO_TP_TEST_LONG, 8, 0));
+    runit_assert(rhs_semaphore_acquire(test->tx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->tx_result == IsoTpResultOk);
+
+    // 4098 bytes after the first frame, 586 consecutive frames in blocks of 8
+    runit_assert(iso_tp_test_peer_send(test, ISO_TP_TEST_LONG) == 74U);
+    runit_assert(rhs_semaphore_acquire(test->rx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->rx_result == IsoTpResultOk);
+    runit_assert(test->rx_size == ISO_TP_TEST_LONG);
+    runit_assert(memcmp(iso_tp_test_received, iso_tp_test_message, ISO_TP_TEST_LONG) == 0);
+
+    iso_tp_session_close(session);
+}
+
+static void wrong_sn_test(IsoTpTest* test)
+{
+    IsoTpSession*  session = iso_tp_test_open(test, 0);
+    IsoTpTestFrame item;
+
+    const size_t offset = iso_tp_test_peer_first(test, ISO_TP_TEST_BLOCKS);
+    runit_assert(iso_tp_test_peer_get(test, &item, ISO_TP_TEST_WAIT_MS));
+    runit_assert(item.frame.payload[0] == 0x30U);
+
+    iso_tp_test_peer_consecutive(test, 2, offset, ISO_TP_TEST_BLOCKS);
+    runit_assert(rhs_semaphore_acquire(test->rx_done, rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->rx_result == IsoTpResultWrongSn);
+    runit_assert(iso_tp_session_get_statistic(session).rx_errors == 1U);
+
+    iso_tp_session_close(session);
+}
+
+static void timeout_cr_test(IsoTpTest* test)
+{
+    IsoTpSession*  session = iso_tp_test_open(test, 0);
+    IsoTpTestFrame item;
+
+    size_t offset = iso_tp_test_peer_first(test, ISO_TP_TEST_BLOCKS);
+    runit_assert(iso_tp_test_peer_get(test, &item, ISO_TP_TEST_WAIT_MS));
+    runit_assert(item.frame.payload[0] == 0x30U);
+
+    // Peer stops after one consecutive frame
+    iso_tp_test_peer_consecutive(test, 1, offset, ISO_TP_TEST_BLOCKS);
+    const uint32_t start = rhs_get_tick();
+
+    const uint32_t timeout = rhs_ms_to_ticks(ISO_TP_TIMEOUT_MS);
+    runit_assert(rhs_semaphore_acquire(test->rx_done, timeout + rhs_ms_to_ticks(ISO_TP_TEST_WAIT_MS)) == RHSStatusOk);
+    runit_assert(test->rx_result == IsoTpResultTimeoutCr);
+    runit_assert(test->rx_tick - start >= timeout);
+    runit_assert(iso_tp_session_get_statistic(session).rx_errors == 1U);
+
+    iso_tp_session_close(session);
+}
+
+void iso_tp_test(char* args, void* context)
+{
+    runit_counter_assert_passes   = 0;
+    runit_counter_assert_failures = 0;
+
+    if (iso_tp_test_instance == NULL)
+    {
+        rhs_hal_can_init(ISO_TP_TEST_CHANNEL, ISO_TP_TEST_BAUD);
+        iso_tp_test_instance = iso_tp_alloc(ISO_TP_TEST_CHANNEL);
+    }
+    for (size_t i = 0; i < sizeof(iso_tp_test_message); i++)
+    {
+        iso_tp_test_message[i] = (uint8_t) (i * 7U + 1U);
+    }
+
+    IsoTpTest test = {
+        .node    = rhs_hal_can_virtual_node_alloc(ISO_TP_TEST_CHANNEL),
+        .frames  = rhs_message_queue_alloc(ISO_TP_TEST_QUEUE, sizeof(IsoTpTestFrame)),
+        .rx_done = rhs_semaphore_alloc(1, 0),
+        .tx_done = rhs_semaphore_alloc(1, 0),
+    };
+    rhs_hal_can_virtual_node_set_rx_callback(test.node, iso_tp_test_peer_rx, &test);
+
+    single_frame_test(&test);
+    block_test(&test);
+    long_test(&test);
+    wrong_sn_test(&test);
+    timeout_cr_test(&test);
+
+    rhs_hal_can_virtual_node_free(test.node);
+    rhs_message_queue_free(test.frames);
+    rhs_semaphore_free(test.rx_done);
+    rhs_semaphore_free(test.tx_done);
+
+    runit_report();
+}
+
+void rhs_iso_tp_test(void)
+{
+    Cli* cli = rhs_record_id_open(&record_cli);
+    cli_add_command(cli, "iso_tp_test", iso_tp_test, NULL);
+    rhs_record_id_close(&record_cli);
+}
@@ -59,7 +59,7 @@ void memmgr_test(char* args, void* context)
 
 void rhs_memmgr_test(void)
 {
-    Cli* cli = rhs_record_open(RECORD_CLI);
+    Cli* cli = rhs_record_id_open(&record_cli);
     cli_add_command(cli, "mem_test", memmgr_test, NULL);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 }
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "rhs.h"
+#include "cli.h"
+#include "runit.h"
+
+#define TAG "queue_test"
+
+#define QUEUE_TEST_NORMAL 4
+#define QUEUE_TEST_URGENT (RHS_MESSAGE_QUEUE_URGENT_BURST + 2U)
+
+static uint32_t queue_test_get(RHSMessageQueue* queue)
+{
+    uint32_t value = UINT32_MAX;
+    runit_assert(rhs_message_queue_get(queue, &value, 0) == RHSStatusOk);
+    return value;
+}
+
+static void lanes_test(void)
+{
+    RHSMessageQueue* queue = rhs_message_queue_alloc_priority(QUEUE_TEST_NORMAL, 2, sizeof(uint32_t));
+    uint32_t         value;
+
+    runit_assert(rhs_message_queue_get_capacity(queue) == QUEUE_TEST_NORMAL + 2U);
+    runit_assert(rhs_message_queue_get_message_size(queue) == sizeof(uint32_t));
+
+    // Urgent first, put_front in front of the urgent lane, normal in order
+    value = 1;
+    runit_assert(rhs_message_queue_put(queue, &value, 0) == RHSStatusOk);
+    value = 2;
+    runit_assert(rhs_message_queue_put(queue, &value, 0) == RHSStatusOk);
+    value = 10;
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    value = 11;
+    runit_assert(rhs_message_queue_put_front(queue, &value, 0) == RHSStatusOk);
+    runit_assert(rhs_message_queue_get_count(queue) == 4U);
+
+    // Each lane is bounded on its own
+    value = 12;
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusErrorResource);
+    runit_assert(rhs_message_queue_get_count(queue) == 4U);
+
+    runit_assert(queue_test_get(queue) == 11U);
+    runit_assert(queue_test_get(queue) == 10U);
+    runit_assert(queue_test_get(queue) == 1U);
+    runit_assert(queue_test_get(queue) == 2U);
+    runit_assert(rhs_message_queue_get(queue, &value, 0) == RHSStatusErrorResource);
+
+    rhs_message_queue_free(queue);
+}
+
+static void reset_test(void)
+{
+    RHSMessageQueue* queue = rhs_message_queue_alloc_priority(QUEUE_TEST_NORMAL, 2, sizeof(uint32_t));
+    uint32_t         value = 1;
+
+    runit_assert(rhs_message_queue_put(queue, &value, 0) == RHSStatusOk);
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+
+    // Tokens and messages go together, get after reset returns instead of spinning
+    runit_assert(rhs_message_queue_reset(queue) == RHSStatusOk);
+    runit_assert(rhs_message_queue_get_count(queue) == 0U);
+    runit_assert(rhs_message_queue_get_space(queue) == QUEUE_TEST_NORMAL + 2U);
+    runit_assert(rhs_message_queue_get(queue, &value, 0) == RHSStatusErrorResource);
+
+    // Both lanes have their full room again
+    for (uint32_t i = 0; i < QUEUE_TEST_NORMAL; i++)
+    {
+        runit_assert(rhs_message_queue_put(queue, &i, 0) == RHSStatusOk);
+    }
+    value = 20;
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    runit_assert(rhs_message_queue_get_space(queue) == 0U);
+
+    runit_assert(queue_test_get(queue) == 20U);
+    runit_assert(queue_test_get(queue) == 20U);
+    for (uint32_t i = 0; i < QUEUE_TEST_NORMAL; i++)
+    {
+        runit_assert(queue_test_get(queue) == i);
+    }
+
+    rhs_message_queue_free(queue);
+}
+
+static void burst_test(void)
+{
+    RHSMessageQueue* queue = rhs_message_queue_alloc_priority(QUEUE_TEST_NORMAL, QUEUE_TEST_URGENT, sizeof(uint32_t));
+
+    RHSMessageQueuePriorityStats stats;
+    uint32_t                     value = 0;
+
+    // A FIFO queue has no lanes
+    RHSMessageQueue* fifo = rhs_message_queue_alloc(1, sizeof(uint32_t));
+    runit_assert(rhs_message_queue_get_priority_stats(fifo, &stats) == false);
+    rhs_message_queue_free(fifo);
+
+    runit_assert(rhs_message_queue_put(queue, &value, 0) == RHSStatusOk);
+    for (value = 1; value <= RHS_MESSAGE_QUEUE_URGENT_BURST + 1U; value++)
+    {
+        runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    }
+
+    // Burst of urgent messages overtakes, then the waiting normal one is forced through
+    for (value = 1; value <= RHS_MESSAGE_QUEUE_URGENT_BURST; value++)
+    {
+        runit_assert(queue_test_get(queue) == value);
+    }
+    runit_assert(queue_test_get(queue) == 0U);
+    runit_assert(queue_test_get(queue) == RHS_MESSAGE_QUEUE_URGENT_BURST + 1U);
+
+    runit_assert(rhs_message_queue_get_priority_stats(queue, &stats) == true);
+    runit_assert(stats.urgent == RHS_MESSAGE_QUEUE_URGENT_BURST + 1U);
+    runit_assert(stats.overtaken == RHS_MESSAGE_QUEUE_URGENT_BURST);
+    runit_assert(stats.max_run == RHS_MESSAGE_QUEUE_URGENT_BURST);
+    runit_assert(stats.forced == 1U);
+
+    // Urgent message with an empty normal lane overtakes nothing
+    value = 1;
+    runit_assert(rhs_message_queue_put_priority(queue, &value, RHSMessagePriorityUrgent, 0) == RHSStatusOk);
+    runit_assert(queue_test_get(queue) == 1U);
+    runit_assert(rhs_message_queue_get_priority_stats(queue, &stats) == true);
+    runit_assert(stats.urgent == RHS_MESSAGE_QUEUE_URGENT_BURST + 2U);
+    runit_assert(stats.overtaken == RHS_MESSAGE_QUEUE_URGENT_BURST);
+
+    rhs_message_queue_free(queue);
+}
+
+void message_queue_test(char* args, void* context)
+{
+    runit_counter_assert_passes   = 0;
+    runit_counter_assert_failures = 0;
+
+    lanes_test();
+    reset_test();
+    burst_test();
+
+    runit_report();
+}
+
+void rhs_message_queue_test(void)
+{
+    Cli* cli = rhs_record_id_open(&record_cli);
+    cli_add_command(cli, "queue_test", message_queue_test, NULL);
+    rhs_record_id_close(&record_cli);
+}
@@ -3,6 +3,9 @@
 #include "cli.h"
 
 #define TEST_RECORD_NAME "test_record"
+#define TEST_RECORD_ID_NAME "test_record_id"
+
+static RHS_RECORD_DEFINE(test_record_id, TEST_RECORD_ID_NAME);
 
 void records_test(char* args, void* context)
 {
@@ -32,12 +35,31 @@ void records_test(char* args, void* context)
     // Test that record does not exist
     runit_assert(rhs_record_exists(TEST_RECORD_NAME) == false);
 
+    // Same life cycle through static id
+    runit_assert(rhs_record_id_exists(&test_record_id) == false);
+    rhs_record_id_create(&test_record_id, (void*) &test_data);
+    runit_assert(rhs_record_id_exists(&test_record_id) == true);
+
+    // Visible by name too
+    runit_assert(rhs_record_exists(TEST_RECORD_ID_NAME) == true);
+    runit_eq(rhs_record_open(TEST_RECORD_ID_NAME), &test_data);
+    runit_eq(rhs_record_id_open(&test_record_id), &test_data);
+
+    // Destroy is refused while held
+    runit_assert(rhs_record_id_destroy(&test_record_id) == false);
+    rhs_record_close(TEST_RECORD_ID_NAME);
+    rhs_record_id_close(&test_record_id);
+    runit_assert(rhs_record_id_destroy(&test_record_id) == true);
+
+    runit_assert(rhs_record_id_exists(&test_record_id) == false);
+    runit_assert(rhs_record_exists(TEST_RECORD_ID_NAME) == false);
+
     runit_report();
 }
 
 void rhs_records_test(void)
 {
-    Cli* cli = rhs_record_open(RECORD_CLI);
+    Cli* cli = rhs_record_id_open(&record_cli);
     cli_add_command(cli, "records_test", records_test, NULL);
-    rhs_record_close(RECORD_CLI);
+    rhs_record_id_close(&record_cli);
 }
\ No newline at end of file
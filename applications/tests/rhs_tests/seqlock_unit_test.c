@@ -0,0 +1,159 @@
+// Take the ARMv6-M PRIMASK path of core/atomic.h on every core, this file only
+#define RHS_ATOMIC_EXCLUSIVE 0
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "rhs.h"
+#include "cli.h"
+#include "runit.h"
+
+#define TAG "seqlock_test"
+
+#define SEQLOCK_TEST_STACK 512
+#define SEQLOCK_TEST_HOLD_TICKS 5  // Writer sleeps inside its update
+#define SEQLOCK_TEST_WRITES 50
+#define SEQLOCK_TEST_WORDS 32  // Long copy, so the writer lands inside it
+
+typedef struct
+{
+    RHSSeqlock        lock;
+    volatile uint32_t words[SEQLOCK_TEST_WORDS];
+    volatile bool     done;
+} SeqlockTest;
+
+static void atomic_test(void)
+{
+    volatile uint32_t value = 0;
+
+    runit_assert(rhs_atomic_add(&value, 5) == 5U);
+    runit_assert(rhs_atomic_add(&value, UINT32_MAX) == 4U);
+    runit_assert(rhs_atomic_exchange(&value, 7) == 4U);
+    runit_assert(rhs_atomic_load(&value) == 7U);
+
+    runit_assert(rhs_atomic_cas(&value, 7, 9) == true);
+    runit_assert(rhs_atomic_cas(&value, 7, 11) == false);
+    runit_assert(rhs_atomic_load(&value) == 9U);
+
+    runit_assert(rhs_atomic_max(&value, 3) == 9U);
+    runit_assert(rhs_atomic_max(&value, 12) == 12U);
+    runit_assert(rhs_atomic_load(&value) == 12U);
+
+    // Interrupt mask of the caller is restored, not cleared
+    __disable_irq();
+    rhs_atomic_add(&value, 1);
+    rhs_atomic_cas(&value, 13, 14);
+    bool masked = __get_PRIMASK() != 0U;
+    __enable_irq();
+    runit_assert(masked);
+    rhs_atomic_add(&value, 1);
+    rhs_atomic_cas(&value, 15, 16);
+    runit_assert(__get_PRIMASK() == 0U);
+    runit_assert(rhs_atomic_load(&value) == 16U);
+}
+
+static int32_t seqlock_test_slow_writer(void* context)
+{
+    SeqlockTest* test = context;
+
+    rhs_seqlock_write_begin(&test->lock);
+    test->words[0] = 1;
+    rhs_delay_tick(SEQLOCK_TEST_HOLD_TICKS);
+    test->words[1] = 1;
+    rhs_seqlock_write_end(&test->lock);
+    return 0;
+}
+
+static void seqlock_wait_test(void)
+{
+    SeqlockTest test = {.lock = RHS_SEQLOCK_INIT};
+    uint32_t    snapshot[SEQLOCK_TEST_WORDS];
+
+    RHSThread* writer = rhs_thread_alloc("seqlock_writer", SEQLOCK_TEST_STACK, seqlock_test_slow_writer, &test);
+    rhs_thread_start(writer);
+    while ((rhs_atomic_load(&test.lock.sequence) & 1U) == 0U)
+    {
+        rhs_delay_tick(1);
+    }
+
+    // Writer sleeps in its update, the thread reader waits for it instead of copying half of it
+    rhs_seqlock_read(&test.lock, snapshot, test.words, sizeof(snapshot));
+    runit_assert(snapshot[0] == 1U);
+    runit_assert(snapshot[1] == 1U);
+    runit_assert(rhs_atomic_load(&test.lock.sequence) == 2U);
+
+    rhs_thread_join(writer);
+    rhs_thread_free(writer);
+}
+
+static int32_t seqlock_test_fast_writer(void* context)
+{
+    SeqlockTest* test = context;
+
+    for (uint32_t i = 1; i <= SEQLOCK_TEST_WRITES; i++)
+    {
+        rhs_seqlock_write_begin(&test->lock);
+        for (size_t j = 0; j < SEQLOCK_TEST_WORDS; j++)
+        {
+            test->words[j] = i;
+        }
+        rhs_seqlock_write_end(&test->lock);
+        rhs_delay_tick(1);
+    }
+    test->done = true;
+    return 0;
+}
+
+static void seqlock_retry_test(void)
+{
+    SeqlockTest test = {.lock = RHS_SEQLOCK_INIT};
+    uint32_t    snapshot[SEQLOCK_TEST_WORDS];
+    uint32_t    reads = 0;
+    uint32_t    torn  = 0;
+
+    // Writer outranks the reader and wakes every tick, some wake ups land inside a copy and force a retry
+    RHSThread* writer = rhs_thread_alloc_ex(
+        "seqlock_writer", SEQLOCK_TEST_STACK, RHSThreadPriorityHighest, seqlock_test_fast_writer, &test);
+    rhs_thread_start(writer);
+
+    while (!test.done)
+    {
+        rhs_seqlock_read(&test.lock, snapshot, test.words, sizeof(snapshot));
+        for (size_t j = 1; j < SEQLOCK_TEST_WORDS; j++)
+        {
+            if (snapshot[j] != snapshot[0])
+            {
+                torn++;
+                break;
+            }
+        }
+        reads++;
+    }
+
+    runit_assert(torn == 0U);
+    runit_assert(reads > SEQLOCK_TEST_WRITES);
+    rhs_seqlock_read(&test.lock, snapshot, test.words, sizeof(snapshot));
+    runit_assert(snapshot[0] == SEQLOCK_TEST_WRITES);
+    runit_assert(rhs_atomic_load(&test.lock.sequence) == 2U * SEQLOCK_TEST_WRITES);
+
+    rhs_thread_join(writer);
+    rhs_thread_free(writer);
+}
+
+void seqlock_test(char* args, void* context)
+{
+    runit_counter_assert_passes   = 0;
+    runit_counter_assert_failures = 0;
+
+    atomic_test();
+    seqlock_wait_test();
+    seqlock_retry_test();
+
+    runit_report();
+}
+
+void rhs_seqlock_test(void)
+{
+    Cli* cli = rhs_record_id_open(&record_cli);
+    cli_add_command(cli, "seqlock_test", seqlock_test, NULL);
+    rhs_record_id_close(&record_cli);
+}
@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "rhs.h"
+#include "cli.h"
+#include "runit.h"
+
+#define TAG "wheel_test"
+
+#define WHEEL_TEST_ENTRIES 6
+#define WHEEL_TEST_FIRED 5  // Entries that expire, one is stopped
+#define WHEEL_TEST_LATE_TICKS 2  // Timer thread may run this much after the deadline
+
+typedef struct
+{
+    RHSTimerWheel*     wheel;
+    RHSTimerWheelEntry entries[WHEEL_TEST_ENTRIES];
+    RHSSemaphore*      done;
+    uint32_t           order[WHEEL_TEST_ENTRIES];  // Entry index in callback order
+    uint32_t           fired_tick[WHEEL_TEST_ENTRIES];
+    volatile uint32_t  fired;
+} WheelTest;
+
+typedef struct
+{
+    WheelTest* test;
+    uint32_t   index;
+} WheelTestEntry;
+
+static WheelTestEntry wheel_test_entries[WHEEL_TEST_ENTRIES];
+
+static void wheel_test_callback(void* context)
+{
+    WheelTestEntry* entry = context;
+    WheelTest*      test  = entry->test;
+
+    test->fired_tick[entry->index] = rhs_get_tick();
+    if (test->fired < WHEEL_TEST_ENTRIES)
+    {
+        test->order[test->fired] = entry->index;
+    }
+    if (++test->fired == WHEEL_TEST_FIRED)
+    {
+        rhs_semaphore_release(test->done);
+    }
+}
+
+// Level 0 is up to 63 wheel ticks, level 1 up to 4095, level 2 above, started latest first
+static void cascade_test(void)
+{
+    // clang-format off
+    const uint32_t ticks[WHEEL_TEST_ENTRIES] = {
+        4100,  // Level 2, cascades twice
+        70,    // Level 1
+        64,    // First tick of level 1
+        100,   // Stopped
+        200,   // Restarted to 5, level 1 to level 0
+        2,     // Level 0
+    };
+    const uint32_t expected[WHEEL_TEST_FIRED] = {5, 4, 2, 1, 0};
+    // clang-format on
+
+    WheelTest test = {0};
+    test.wheel     = rhs_timer_wheel_alloc(1);
+    test.done      = rhs_semaphore_alloc(1, 0);
+
+    for (uint32_t i = 0; i < WHEEL_TEST_ENTRIES; i++)
+    {
+        wheel_test_entries[i].test  = &test;
+        wheel_test_entries[i].index = i;
+        rhs_timer_wheel_entry_init(&test.entries[i], wheel_test_callback, &wheel_test_entries[i]);
+        runit_assert(rhs_timer_wheel_is_running(&test.entries[i]) == false);
+    }
+
+    const uint32_t start = rhs_get_tick();
+    for (uint32_t i = 0; i < WHEEL_TEST_ENTRIES; i++)
+    {
+        rhs_timer_wheel_start(test.wheel, &test.entries[i], ticks[i]);
+    }
+    runit_assert(rhs_timer_wheel_get_count(test.wheel) == WHEEL_TEST_ENTRIES);
+
+    rhs_timer_wheel_stop(test.wheel, &test.entries[3]);
+    rhs_timer_wheel_start(test.wheel, &test.entries[4], 5);
+    runit_assert(rhs_timer_wheel_is_running(&test.entries[3]) == false);
+    runit_assert(rhs_timer_wheel_is_running(&test.entries[4]) == true);
+    runit_assert(rhs_timer_wheel_get_count(test.wheel) == WHEEL_TEST_FIRED);
+
+    runit_assert(rhs_semaphore_acquire(test.done, ticks[0] + rhs_ms_to_ticks(1000)) == RHSStatusOk);
+    runit_assert(test.fired == WHEEL_TEST_FIRED);
+    runit_assert(rhs_timer_wheel_get_count(test.wheel) == 0U);
+
+    // Each one fires once, in expiry order, not early and not later than a timer thread delay
+    for (uint32_t i = 0; i < WHEEL_TEST_FIRED; i++)
+    {
+        const uint32_t index   = expected[i];
+        const uint32_t timeout = index == 4 ? 5U : ticks[index];
+        const uint32_t elapsed = test.fired_tick[index] - start;
+
+        runit_assert(test.order[i] == index);
+        runit_assert(elapsed >= timeout);
+        runit_assert(elapsed <= timeout + WHEEL_TEST_LATE_TICKS);
+        runit_assert(rhs_timer_wheel_is_running(&test.entries[index]) == false);
+    }
+    runit_assert(test.fired_tick[3] == 0U);
+
+    rhs_semaphore_free(test.done);
+    rhs_timer_wheel_free(test.wheel);
+}
+
+// A late timer thread collects several wheel ticks in one batch, callbacks keep expiry order
+static void batch_test(void)
+{
+    WheelTest test = {0};
+    test.wheel     = rhs_timer_wheel_alloc(1);
+    test.done      = rhs_semaphore_alloc(1, 0);
+
+    for (uint32_t i = 0; i < WHEEL_TEST_FIRED; i++)
+    {
+        wheel_test_entries[i].test  = &test;
+        wheel_test_entries[i].index = i;
+        rhs_timer_wheel_entry_init(&test.entries[i], wheel_test_callback, &wheel_test_entries[i]);
+    }
+
+    rhs_kernel_lock();
+    for (uint32_t i = 0; i < WHEEL_TEST_FIRED; i++)
+    {
+        rhs_timer_wheel_start(test.wheel, &test.entries[i], WHEEL_TEST_FIRED - i);
+    }
+    rhs_delay_us(1000U * 1000U * (WHEEL_TEST_FIRED + 1U) / rhs_kernel_get_tick_frequency());
+    rhs_kernel_unlock();
+
+    runit_assert(rhs_semaphore_acquire(test.done, rhs_ms_to_ticks(1000)) == RHSStatusOk);
+    for (uint32_t i = 0; i < WHEEL_TEST_FIRED; i++)
+    {
+        runit_assert(test.order[i] == WHEEL_TEST_FIRED - 1U - i);
+    }
+
+    rhs_semaphore_free(test.done);
+    rhs_timer_wheel_free(test.wheel);
+}
+
+void timer_wheel_test(char* args, void* context)
+{
+    runit_counter_assert_passes   = 0;
+    runit_counter_assert_failures = 0;
+
+    cascade_test();
+    batch_test();
+
+    runit_report();
+}
+
+void rhs_timer_wheel_test(void)
+{
+    Cli* cli = rhs_record_id_open(&record_cli);
+    cli_add_command(cli, "wheel_test", timer_wheel_test, NULL);
+    rhs_record_id_close(&record_cli);
+}
@@ -21,6 +21,15 @@ set(RHS_SERVICE_COUNT "const short RHS_SERVICES_COUNT = (sizeof(RHS_SERVICES) /
 # Initialize services section
 file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_SERVICE_BEGIN}\n${RHS_SERVICE_END}\n${RHS_SERVICE_COUNT}")
 
+################################## CO SERVICES ##################################
+# Coroutine services - stackless services sharing the loader thread
+set(RHS_CO_SERVICE_BEGIN "const RHSInternalCoService RHS_CO_SERVICES[] = {\n/* CO_SERVICE_BEGIN */\n")
+set(RHS_CO_SERVICE_END "/* CO_SERVICE_END */\n};\n")
+set(RHS_CO_SERVICE_COUNT "const short RHS_CO_SERVICES_COUNT = (sizeof(RHS_CO_SERVICES) / sizeof(RHS_CO_SERVICES[0]));\n\n")
+
+# Initialize coroutine services section
+file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_CO_SERVICE_BEGIN}\n${RHS_CO_SERVICE_END}\n${RHS_CO_SERVICE_COUNT}")
+
 ################################## START UPs ##################################
 # Initialization hooks - functions executed after all services are started
 set(RHS_STARTUP_EXTERN_SECTION "")
@@ -28,9 +37,12 @@ set(RHS_STARTUP_ARRAY_SECTION "")
 set(RHS_STARTUP_BEGIN "const RHSInternalOnStartHook RHS_START_UP[] = {\n/* START_UP_BEGIN */\n")
 set(RHS_STARTUP_END "/* START_UP_END */\n};\n")
 set(RHS_STARTUP_COUNT "const short RHS_START_UP_COUNT = (sizeof(RHS_START_UP) / sizeof(RHS_START_UP[0]));\n")
+set(RHS_STARTUP_NAMES_BEGIN "const char* const RHS_START_UP_NAMES[] = {\n/* START_UP_NAMES_BEGIN */\n")
+set(RHS_STARTUP_NAMES_END "/* START_UP_NAMES_END */\n};\n")
 
 # Initialize startup section
 file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_STARTUP_BEGIN}\n${RHS_STARTUP_END}\n${RHS_STARTUP_COUNT}")
+file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_STARTUP_NAMES_BEGIN}\n${RHS_STARTUP_NAMES_END}\n")
 
 ################################## TESTS ##################################
 # Test functions - executed in debug builds or when selftest is enabled
@@ -43,10 +55,21 @@ set(RHS_TEST_COUNT "const short RHS_TESTS_COUNT = (sizeof(RHS_TESTS) / sizeof(RH
 # Initialize tests section
 file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_TEST_BEGIN}\n${RHS_TEST_END}\n${RHS_TEST_COUNT}")
 
+################################## BENCHMARKS ##################################
+# Benchmark functions - executed on demand by the rhs_benchmarks runner
+set(RHS_BENCHMARK_BEGIN "const RHSInternalBenchmark RHS_BENCHMARKS[] = {\n/* BENCHMARK_BEGIN */\n")
+set(RHS_BENCHMARK_END "/* BENCHMARK_END */\n};\n")
+set(RHS_BENCHMARK_COUNT "const short RHS_BENCHMARKS_COUNT = (sizeof(RHS_BENCHMARKS) / sizeof(RHS_BENCHMARKS[0]));\n\n")
+
+# Initialize benchmarks section
+file(APPEND "${RHS_OUTPUT_FILE}" "${RHS_BENCHMARK_BEGIN}\n${RHS_BENCHMARK_END}\n${RHS_BENCHMARK_COUNT}")
+
 # Global lists to track registered services and startup hooks
 set(RHS_REGISTERED_SERVICES "" CACHE INTERNAL "List of registered services")
+set(RHS_REGISTERED_CO_SERVICES "" CACHE INTERNAL "List of registered coroutine services")
 set(RHS_REGISTERED_STARTUPS "" CACHE INTERNAL "List of registered startup hooks")
 set(RHS_REGISTERED_TESTS "" CACHE INTERNAL "List of registered tests")
+set(RHS_REGISTERED_BENCHMARKS "" CACHE INTERNAL "List of registered benchmarks")
 
 # Internal helper function to update file content efficiently
 function(_rhs_update_file_content marker_begin marker_end new_content)
@@ -55,8 +78,54 @@ function(_rhs_update_file_content marker_begin marker_end new_content)
     file(WRITE "${RHS_OUTPUT_FILE}" "${FILE_CONTENT}")
 endfunction()
 
+# Internal helper: C initializer of NULL terminated string array, NULL for empty list
+function(_rhs_c_string_list out_var)
+    if(ARGN)
+        set(items "")
+        foreach(item IN LISTS ARGN)
+            string(APPEND items "\"${item}\", ")
+        endforeach()
+        set(${out_var} "(const char* const[]){${items}NULL}" PARENT_SCOPE)
+    else()
+        set(${out_var} "NULL" PARENT_SCOPE)
+    endif()
+endfunction()
+
+# Internal helper: rewrite service dependency graph (Graphviz) from registered services
+function(_rhs_write_service_graph)
+    set(graph "digraph rhs_services {\n    rankdir=LR;\n")
+    foreach(consumer_info IN LISTS RHS_REGISTERED_SERVICES)
+        string(REPLACE ":" ";" consumer_parts "${consumer_info}")
+        list(GET consumer_parts 0 consumer_name)
+        list(GET consumer_parts 4 consumes)
+        string(APPEND graph "    \"${consumer_name}\" [shape=box];\n")
+        string(REPLACE "," ";" consumes "${consumes}")
+        foreach(record IN LISTS consumes)
+            set(provider_name "")
+            foreach(provider_info IN LISTS RHS_REGISTERED_SERVICES)
+                string(REPLACE ":" ";" provider_parts "${provider_info}")
+                list(GET provider_parts 3 provides)
+                string(REPLACE "," ";" provides "${provides}")
+                if(record IN_LIST provides)
+                    list(GET provider_parts 0 provider_name)
+                endif()
+            endforeach()
+            if(provider_name)
+                string(APPEND graph "    \"${provider_name}\" -> \"${consumer_name}\" [label=\"${record}\"];\n")
+            else()
+                string(APPEND graph "    \"${record}\" [shape=ellipse, style=dashed];\n")
+                string(APPEND graph "    \"${record}\" -> \"${consumer_name}\";\n")
+            endif()
+        endforeach()
+    endforeach()
+    string(APPEND graph "}\n")
+    file(WRITE "${CMAKE_BINARY_DIR}/rhs_services.dot" "${graph}")
+endfunction()
+
 # Register a FreeRTOS service (persistent task)
-# Usage: service(handler_function "service_name" stack_size_bytes)
+# Usage: service(handler_function "service_name" stack_size_bytes [PROVIDES record...] [CONSUMES record...])
+# - PROVIDES lists records the service creates, CONSUMES lists records it opens
+# - rhs_start_services() starts providers before their consumers, the graph is written to rhs_services.dot
 function(service service_handler service_name stack_size)
     # Input validation
     if(NOT service_handler)
@@ -74,22 +143,30 @@ function(service service_handler service_name stack_size)
         message(FATAL_ERROR "service(): stack_size must be a positive integer, got: ${stack_size}")
     endif()
 
+    cmake_parse_arguments(SERVICE "" "" "PROVIDES;CONSUMES" ${ARGN})
+    _rhs_c_string_list(service_provides ${SERVICE_PROVIDES})
+    _rhs_c_string_list(service_consumes ${SERVICE_CONSUMES})
+
     # Add extern declaration
     set(service_extern "extern int32_t ${service_handler}(void* context);\n")
     file(READ "${RHS_OUTPUT_FILE}" FILE_CONTENT)
     string(REPLACE "${RHS_SERVICE_BEGIN}" "${service_extern}${RHS_SERVICE_BEGIN}" FILE_CONTENT "${FILE_CONTENT}")
 
     # Add service definition to array
-    set(service_definition "    {\n        .app = ${service_handler},\n        .name = \"${service_name}\",\n        .stack_size = ${stack_size},\n    },\n")
+    set(service_definition "    {\n        .app = ${service_handler},\n        .name = \"${service_name}\",\n        .stack_size = ${stack_size},\n        .provides = ${service_provides},\n        .consumes = ${service_consumes},\n    },\n")
     string(REPLACE "${RHS_SERVICE_END}" "${service_definition}${RHS_SERVICE_END}" FILE_CONTENT "${FILE_CONTENT}")
 
     file(WRITE "${RHS_OUTPUT_FILE}" "${FILE_CONTENT}")
 
     # Save service info to global list
-    set(service_info "${service_name}:${service_handler}:${stack_size}")
+    string(REPLACE ";" "," provides_info "${SERVICE_PROVIDES}")
+    string(REPLACE ";" "," consumes_info "${SERVICE_CONSUMES}")
+    set(service_info "${service_name}:${service_handler}:${stack_size}:${provides_info}:${consumes_info}")
     list(APPEND RHS_REGISTERED_SERVICES "${service_info}")
     set(RHS_REGISTERED_SERVICES "${RHS_REGISTERED_SERVICES}" CACHE INTERNAL "List of registered services")
 
+    _rhs_write_service_graph()
+
     # Only link to rhs if it exists in this project
     if(TARGET rhs)
         target_link_libraries(rhs PUBLIC ${PROJECT_NAME})
@@ -97,6 +174,43 @@ function(service service_handler service_name stack_size)
 
 endfunction()
 
+# Register a coroutine service (stackless, runs on loader thread)
+# Usage: co_service(coroutine_function "service_name" events)
+# - coroutine_function has signature RHSCoroutineStatus f(RHSCoroutine* co, void* context)
+# - events is the sum of message queue lengths plus one per event flag the service registers with the executor
+function(co_service service_handler service_name events)
+    # Input validation
+    if(NOT service_handler)
+        message(FATAL_ERROR "co_service(): service_handler is required")
+    endif()
+    if(NOT service_name)
+        message(FATAL_ERROR "co_service(): service_name is required")
+    endif()
+    if(NOT events MATCHES "^[0-9]+$")
+        message(FATAL_ERROR "co_service(): events must be a positive integer, got: ${events}")
+    endif()
+
+    # Add extern declaration
+    set(service_extern "extern RHSCoroutineStatus ${service_handler}(RHSCoroutine* co, void* context);\n")
+    file(READ "${RHS_OUTPUT_FILE}" FILE_CONTENT)
+    string(REPLACE "${RHS_CO_SERVICE_BEGIN}" "${service_extern}${RHS_CO_SERVICE_BEGIN}" FILE_CONTENT "${FILE_CONTENT}")
+
+    # Add service definition to array
+    set(service_definition "    {\n        .app = ${service_handler},\n        .name = \"${service_name}\",\n        .events = ${events},\n    },\n")
+    string(REPLACE "${RHS_CO_SERVICE_END}" "${service_definition}${RHS_CO_SERVICE_END}" FILE_CONTENT "${FILE_CONTENT}")
+
+    file(WRITE "${RHS_OUTPUT_FILE}" "${FILE_CONTENT}")
+
+    # Save service info to global list
+    list(APPEND RHS_REGISTERED_CO_SERVICES "${service_name}:${service_handler}:${events}")
+    set(RHS_REGISTERED_CO_SERVICES "${RHS_REGISTERED_CO_SERVICES}" CACHE INTERNAL "List of registered coroutine services")
+
+    # Only link to rhs if it exists in this project
+    if(TARGET rhs)
+        target_link_libraries(rhs PUBLIC ${PROJECT_NAME})
+    endif()
+endfunction()
+
 # Register a startup hook (initialization function)
 # Usage: start_up(initialization_function)
 function(start_up start_func)
@@ -114,6 +228,10 @@ function(start_up start_func)
     set(startup_definition "    ${start_func},\n")
     string(REPLACE "${RHS_STARTUP_END}" "${startup_definition}${RHS_STARTUP_END}" FILE_CONTENT "${FILE_CONTENT}")
 
+    # Add name for boot timeline
+    set(startup_name "    \"${start_func}\",\n")
+    string(REPLACE "${RHS_STARTUP_NAMES_END}" "${startup_name}${RHS_STARTUP_NAMES_END}" FILE_CONTENT "${FILE_CONTENT}")
+
     file(WRITE "${RHS_OUTPUT_FILE}" "${FILE_CONTENT}")
 
     # Save startup hook info to global list
@@ -181,6 +299,42 @@ function(test test_func)
     endif()
 endfunction()
 
+# Register a benchmark function
+# Usage: benchmark(benchmark_function "benchmark_name" iterations)
+# - benchmark_function has signature uint32_t f(uint32_t iterations) and returns elapsed cycles
+function(benchmark bench_func bench_name iterations)
+    # Input validation
+    if(NOT bench_func)
+        message(FATAL_ERROR "benchmark(): bench_func is required")
+    endif()
+    if(NOT bench_name)
+        message(FATAL_ERROR "benchmark(): bench_name is required")
+    endif()
+    if(NOT iterations MATCHES "^[0-9]+$")
+        message(FATAL_ERROR "benchmark(): iterations must be a positive integer, got: ${iterations}")
+    endif()
+
+    # Add extern declaration
+    set(bench_extern "extern uint32_t ${bench_func}(uint32_t iterations);\n")
+    file(READ "${RHS_OUTPUT_FILE}" FILE_CONTENT)
+    string(REPLACE "${RHS_BENCHMARK_BEGIN}" "${bench_extern}${RHS_BENCHMARK_BEGIN}" FILE_CONTENT "${FILE_CONTENT}")
+
+    # Add benchmark definition to array
+    set(bench_definition "    {\n        .run = ${bench_func},\n        .name = \"${bench_name}\",\n        .iterations = ${iterations},\n    },\n")
+    string(REPLACE "${RHS_BENCHMARK_END}" "${bench_definition}${RHS_BENCHMARK_END}" FILE_CONTENT "${FILE_CONTENT}")
+
+    file(WRITE "${RHS_OUTPUT_FILE}" "${FILE_CONTENT}")
+
+    # Save benchmark info to global list
+    list(APPEND RHS_REGISTERED_BENCHMARKS "${bench_name}:${bench_func}")
+    set(RHS_REGISTERED_BENCHMARKS "${RHS_REGISTERED_BENCHMARKS}" CACHE INTERNAL "List of registered benchmarks")
+
+    # Only link to rhs if it exists in this project
+    if(TARGET rhs)
+        target_link_libraries(rhs PUBLIC ${PROJECT_NAME})
+    endif()
+endfunction()
+
 # Report function to display all registered services and startup hooks
 function(rhs_report)
     message(STATUS "=== RHS Registration Report ===")
@@ -194,7 +348,15 @@ function(rhs_report)
             list(GET service_parts 0 service_name)
             list(GET service_parts 1 service_handler)
             list(GET service_parts 2 stack_size)
+            list(GET service_parts 3 provides)
+            list(GET service_parts 4 consumes)
             message(STATUS "  - ${service_name}: ${service_handler} (${stack_size} bytes)")
+            if(provides)
+                message(STATUS "      provides: ${provides}")
+            endif()
+            if(consumes)
+                message(STATUS "      consumes: ${consumes}")
+            endif()
         endforeach()
     else()
         message(STATUS "No FreeRTOS services registered.")
@@ -202,6 +364,23 @@ function(rhs_report)
 
     message(STATUS "")
 
+    # Report coroutine services
+    list(LENGTH RHS_REGISTERED_CO_SERVICES co_services_count)
+    if(co_services_count GREATER 0)
+        message(STATUS "Registered Coroutine Services (${co_services_count}):")
+        foreach(service_info IN LISTS RHS_REGISTERED_CO_SERVICES)
+            string(REPLACE ":" ";" service_parts "${service_info}")
+            list(GET service_parts 0 service_name)
+            list(GET service_parts 1 service_handler)
+            list(GET service_parts 2 events)
+            message(STATUS "  - ${service_name}: ${service_handler} (${events} events)")
+        endforeach()
+    else()
+        message(STATUS "No coroutine services registered.")
+    endif()
+
+    message(STATUS "")
+
     # Report startup hooks
     list(LENGTH RHS_REGISTERED_STARTUPS startups_count)
     if(startups_count GREATER 0)
@@ -226,5 +405,18 @@ function(rhs_report)
         message(STATUS "No test functions registered.")
     endif()
 
+    message(STATUS "")
+
+    # Report benchmarks
+    list(LENGTH RHS_REGISTERED_BENCHMARKS benchmarks_count)
+    if(benchmarks_count GREATER 0)
+        message(STATUS "Registered Benchmarks (${benchmarks_count}):")
+        foreach(bench_info IN LISTS RHS_REGISTERED_BENCHMARKS)
+            message(STATUS "  - ${bench_info}")
+        endforeach()
+    else()
+        message(STATUS "No benchmarks registered.")
+    endif()
+
     message(STATUS "=== End Report ===")
 endfunction()
@@ -1,6 +1,8 @@
 #pragma once
 #include <rhs.h>
 
+/* Allocates an event group per call, prefer RHSRpc (core/rpc.h) for new code */
+
 typedef RHSEventFlag* RHSApiLock;
 
 #define API_LOCK_EVENT (1U << 0)
@@ -0,0 +1,151 @@
+/**
+ * @file atomic.h
+ * RHS atomic counters
+ *
+ * Word sized read-modify-write that is safe between threads and ISRs of any
+ * priority without masking interrupts. Uses LDREX/STREX on ARMv7-M and
+ * ARMv8-M mainline, a few instructions with PRIMASK set on ARMv6-M (M0+).
+ *
+ * Plain aligned word loads and stores are already atomic, read counters
+ * with rhs_atomic_load to keep the compiler from caching them.
+ */
+#pragma once
+
+#include "base.h"
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Predefine as 0 to take the PRIMASK path on any core, the seqlock unit test does
+#ifndef RHS_ATOMIC_EXCLUSIVE
+#    if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+#        define RHS_ATOMIC_EXCLUSIVE 1
+#    else
+#        define RHS_ATOMIC_EXCLUSIVE 0
+#    endif
+#endif
+
+/** Load value
+ *
+ * @param[in]  value  pointer to value
+ *
+ * @return     value
+ */
+inline static uint32_t rhs_atomic_load(const volatile uint32_t* value)
+{
+    return *value;
+}
+
+/** Add to value
+ *
+ * @param      value  pointer to value
+ * @param[in]  delta  value to add, wraps around
+ *
+ * @return     new value
+ */
+inline static uint32_t rhs_atomic_add(volatile uint32_t* value, uint32_t delta)
+{
+#if RHS_ATOMIC_EXCLUSIVE
+    uint32_t result;
+    do
+    {
+        result = __LDREXW(value) + delta;
+    } while (__STREXW(result, value) != 0U);
+    return result;
+#else
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t result = *value + delta;
+    *value          = result;
+    __set_PRIMASK(primask);
+    return result;
+#endif
+}
+
+/** Replace value
+ *
+ * @param      value    pointer to value
+ * @param[in]  desired  new value
+ *
+ * @return     previous value, use with 0 to read and clear a counter
+ */
+inline static uint32_t rhs_atomic_exchange(volatile uint32_t* value, uint32_t desired)
+{
+#if RHS_ATOMIC_EXCLUSIVE
+    uint32_t previous;
+    do
+    {
+        previous = __LDREXW(value);
+    } while (__STREXW(desired, value) != 0U);
+    return previous;
+#else
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t previous = *value;
+    *value            = desired;
+    __set_PRIMASK(primask);
+    return previous;
+#endif
+}
+
+/** Compare and swap value, full barrier on success
+ *
+ * @param      value     pointer to value
+ * @param[in]  expected  value that must be stored
+ * @param[in]  desired   new value
+ *
+ * @return     true if value was expected and is replaced
+ */
+inline static bool rhs_atomic_cas(volatile uint32_t* value, uint32_t expected, uint32_t desired)
+{
+#if RHS_ATOMIC_EXCLUSIVE
+    do
+    {
+        if (__LDREXW(value) != expected)
+        {
+            __CLREX();
+            return false;
+        }
+    } while (__STREXW(desired, value) != 0U);
+    __DMB();
+    return true;
+#else
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool ret = (*value == expected);
+    if (ret)
+    {
+        *value = desired;
+    }
+    __set_PRIMASK(primask);
+    __DMB();
+    return ret;
+#endif
+}
+
+/** Raise value to candidate if it is lower, for high-water marks
+ *
+ * @param      value      pointer to value
+ * @param[in]  candidate  new value if greater
+ *
+ * @return     resulting value
+ */
+inline static uint32_t rhs_atomic_max(volatile uint32_t* value, uint32_t candidate)
+{
+    uint32_t current = *value;
+    while (current < candidate)
+    {
+        if (rhs_atomic_cas(value, current, candidate))
+        {
+            return candidate;
+        }
+        current = *value;
+    }
+    return current;
+}
+
+#ifdef __cplusplus
+}
+#endif
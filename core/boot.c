@@ -0,0 +1,55 @@
+#include "boot.h"
+#include "check.h"
+#include "common.h"
+#include "rhs_hal_cortex.h"
+
+static RHSBootEvent boot_events[RHS_BOOT_EVENTS];
+static size_t       boot_count = 0;
+static bool         boot_done  = false;
+
+uint32_t rhs_boot_begin(void)
+{
+    return rhs_hal_cortex_get_cycles();
+}
+
+void rhs_boot_mark(RHSBootEventType type, const char* name, uint32_t start)
+{
+    const uint32_t end = rhs_hal_cortex_get_cycles();
+
+    rhs_assert(name);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!boot_done && boot_count < RHS_BOOT_EVENTS)
+    {
+        RHSBootEvent* event = &boot_events[boot_count++];
+        event->name         = name;
+        event->type         = type;
+        event->start        = start;
+        event->end          = end;
+    }
+    if (type == RHSBootEventTypeDone)
+    {
+        boot_done = true;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+bool rhs_boot_is_done(void)
+{
+    return boot_done;
+}
+
+const RHSBootEvent* rhs_boot_get_events(size_t* count)
+{
+    rhs_assert(count);
+    *count = boot_count;
+    return boot_events;
+}
+
+uint32_t rhs_boot_get_frequency(void)
+{
+    return rhs_hal_cortex_get_cycles_frequency();
+}
@@ -0,0 +1,80 @@
+/**
+ * @file boot.h
+ * RHS boot timeline
+ *
+ * Cycle counter timestamps of rhs_init, rhs_hal_init, service thread starts,
+ * record creation and start up hooks, collected until the loader has run all
+ * start up hooks. The `boot` CLI command combines the timeline with service
+ * provides/consumes declarations to show the critical path.
+ *
+ * Timestamps are taken from the cycle counter that rhs_hal_init resets, call
+ * rhs_init after rhs_hal_init to get it timed as well.
+ */
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef RHS_BOOT_EVENTS
+#    define RHS_BOOT_EVENTS 32
+#endif
+
+typedef enum
+{
+    RHSBootEventTypeInit,        // rhs_init
+    RHSBootEventTypeHalInit,     // rhs_hal_init
+    RHSBootEventTypePeripheral,  // Peripheral init, early, async or lazy
+    RHSBootEventTypeService,     // Service thread started running
+    RHSBootEventTypeRecord,      // Record created
+    RHSBootEventTypeStartUp,     // Start up hook
+    RHSBootEventTypeDone,        // All start up hooks returned
+} RHSBootEventType;
+
+typedef struct
+{
+    const char*      name;
+    RHSBootEventType type;
+    uint32_t         start;  // Cycles
+    uint32_t         end;    // Cycles
+} RHSBootEvent;
+
+/** Get timestamp for rhs_boot_mark
+ *
+ * @return     cycle counter value
+ */
+uint32_t rhs_boot_begin(void);
+
+/** Add event ending now, ignored once boot is done or timeline is full, ISR safe
+ *
+ * @param[in]  type   event type
+ * @param[in]  name   event name, must stay valid
+ * @param[in]  start  value returned by rhs_boot_begin
+ */
+void rhs_boot_mark(RHSBootEventType type, const char* name, uint32_t start);
+
+/** Check if boot timeline is closed
+ *
+ * @return     true after RHSBootEventTypeDone was marked
+ */
+bool rhs_boot_is_done(void);
+
+/** Get recorded events
+ *
+ * @param[out] count  number of events
+ *
+ * @return     events in order of completion
+ */
+const RHSBootEvent* rhs_boot_get_events(size_t* count);
+
+/** Get cycle counter frequency to convert timestamps to time
+ *
+ * @return     counts per second
+ */
+uint32_t rhs_boot_get_frequency(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
 #include "log.h"
 #include "rhs_hal_power.h"
 #if defined(TIMESTAMPER_RTC)
+#    include "rhs_hal.h"
 #    include "rhs_hal_rtc.h"
 #endif
 
@@ -96,10 +97,14 @@ _Noreturn void __rhs_crash_implementation(const char* file, int line, char* m)
     {
         file = last_separator + 1;
     }
+    bool rtc_time = false;
 #if defined(TIMESTAMPER_RTC)
+    // Never initialize here, a lazy or still pending RTC gets tick time
+    if (rhs_hal_init_is_ready(RHSHalPeripheralRtc))
     {
         datetime_t datetime;
         rhs_hal_rtc_get_datetime(&datetime);
+        rtc_time = true;
         if (rhs_log_save)
         {
             rhs_log_save("%04u-%02u-%02u %02u:%02u:%02u: msg: %s. file: %s, line: %d;",
@@ -114,12 +119,11 @@ _Noreturn void __rhs_crash_implementation(const char* file, int line, char* m)
                          line);
         }
     }
-#else
-    if (rhs_log_save)
+#endif
+    if (!rtc_time && rhs_log_save)
     {
         rhs_log_save("%u: msg: %s. file: %s, line: %d;", rhs_get_tick(), m, file, line);
     }
-#endif
     rhs_save_stack_info();
     RHS_LOG_D("Assert", "Message: %s. Called from file: %s, line: %d\n", m, file, line);
 
@@ -0,0 +1,332 @@
+#include "coroutine.h"
+#include "wait_set.h"
+#include "kernel.h"
+#include "common.h"
+#include "memmgr.h"
+#include "check.h"
+
+typedef struct RHSCoroutineQueue RHSCoroutineQueue;
+
+// Queue set rule: one read per select, tokens count selects not yet consumed
+struct RHSCoroutineQueue
+{
+    RHSMessageQueue*   queue;
+    uint32_t           tokens;
+    RHSCoroutineQueue* next;
+};
+
+struct RHSCoroutineExecutor
+{
+    RHSWaitSet*        wait_set;
+    RHSCoroutine*      coroutines;
+    RHSCoroutineQueue* queues;
+    RHSThreadId        thread_id;
+};
+
+static RHSCoroutineQueue* rhs_coroutine_find_queue(RHSCoroutineExecutor* executor, RHSMessageQueue* queue)
+{
+    for (RHSCoroutineQueue* item = executor->queues; item != NULL; item = item->next)
+    {
+        if (item->queue == queue)
+        {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void rhs_coroutine_set_deadline(RHSCoroutine* co, uint32_t timeout)
+{
+    co->forever  = (timeout == RHSWaitForever);
+    co->poll     = (timeout == 0U);
+    co->deadline = rhs_get_tick() + timeout;
+}
+
+static bool rhs_coroutine_is_expired(RHSCoroutine* co, uint32_t now)
+{
+    return !co->forever && (int32_t) (co->deadline - now) <= 0;
+}
+
+static bool rhs_coroutine_step(RHSCoroutine* co)
+{
+    co->ready = false;
+    return co->callback(co, co->context) == RHSCoroutineStatusDone;
+}
+
+RHSCoroutineExecutor* rhs_coroutine_executor_alloc(uint32_t capacity)
+{
+    RHSCoroutineExecutor* executor = malloc(sizeof(RHSCoroutineExecutor));
+    executor->wait_set             = rhs_wait_set_alloc(capacity);
+    executor->coroutines           = NULL;
+    executor->queues               = NULL;
+    executor->thread_id            = NULL;
+    return executor;
+}
+
+void rhs_coroutine_executor_free(RHSCoroutineExecutor* executor)
+{
+    rhs_assert(executor);
+
+    while (executor->coroutines)
+    {
+        RHSCoroutine* co     = executor->coroutines;
+        executor->coroutines = co->next;
+        free(co);
+    }
+    while (executor->queues)
+    {
+        RHSCoroutineQueue* item = executor->queues;
+        executor->queues        = item->next;
+        free(item);
+    }
+
+    rhs_wait_set_free(executor->wait_set);
+    free(executor);
+}
+
+void rhs_coroutine_executor_add_message_queue(RHSCoroutineExecutor* executor, RHSMessageQueue* queue)
+{
+    rhs_assert(executor);
+    rhs_assert(rhs_coroutine_find_queue(executor, queue) == NULL);
+
+    RHSCoroutineQueue* item = malloc(sizeof(RHSCoroutineQueue));
+    item->queue             = queue;
+    item->tokens            = 0;
+    item->next              = executor->queues;
+    executor->queues        = item;
+
+    rhs_wait_set_add_message_queue(executor->wait_set, queue);
+}
+
+void rhs_coroutine_executor_add_event_flag(RHSCoroutineExecutor* executor, RHSEventFlag* event_flag)
+{
+    rhs_assert(executor);
+    rhs_wait_set_add_event_flag(executor->wait_set, event_flag);
+}
+
+void rhs_coroutine_spawn(RHSCoroutineExecutor* executor,
+                         const char*           name,
+                         RHSCoroutineCallback  callback,
+                         void*                 context)
+{
+    rhs_assert(executor);
+    rhs_assert(callback);
+    rhs_assert(executor->thread_id == NULL || executor->thread_id == rhs_thread_get_current_id());
+
+    RHSCoroutine* co = malloc(sizeof(RHSCoroutine));
+    memset(co, 0, sizeof(RHSCoroutine));
+    co->name     = name;
+    co->callback = callback;
+    co->context  = context;
+    co->executor = executor;
+
+    if (rhs_coroutine_step(co))
+    {
+        free(co);
+        return;
+    }
+
+    co->next             = executor->coroutines;
+    executor->coroutines = co;
+}
+
+void rhs_coroutine_executor_run(RHSCoroutineExecutor* executor)
+{
+    rhs_assert(executor);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    executor->thread_id = rhs_thread_get_current_id();
+
+    while (executor->coroutines)
+    {
+        // Resume ready coroutines, drop finished ones
+        uint32_t now = rhs_get_tick();
+        for (RHSCoroutine** link = &executor->coroutines; *link != NULL;)
+        {
+            RHSCoroutine* co = *link;
+            if (co->ready || rhs_coroutine_is_expired(co, now))
+            {
+                if (rhs_coroutine_step(co))
+                {
+                    *link = co->next;
+                    free(co);
+                    continue;
+                }
+            }
+            link = &co->next;
+        }
+
+        // Sleep until nearest deadline or member event
+        uint32_t timeout = RHSWaitForever;
+        now              = rhs_get_tick();
+        for (RHSCoroutine* co = executor->coroutines; co != NULL; co = co->next)
+        {
+            if (co->ready)
+            {
+                timeout = 0;
+                break;
+            }
+            if (!co->forever)
+            {
+                int32_t left = (int32_t) (co->deadline - now);
+                if (left <= 0)
+                {
+                    timeout = 0;
+                    break;
+                }
+                if ((uint32_t) left < timeout)
+                {
+                    timeout = (uint32_t) left;
+                }
+            }
+        }
+
+        void* member = rhs_wait_set_wait(executor->wait_set, timeout);
+        if (member == NULL)
+        {
+            continue;
+        }
+
+        RHSCoroutineQueue* item = rhs_coroutine_find_queue(executor, member);
+        if (item)
+        {
+            item->tokens++;
+        }
+
+        for (RHSCoroutine* co = executor->coroutines; co != NULL; co = co->next)
+        {
+            if (co->object == member)
+            {
+                co->ready = true;
+            }
+        }
+    }
+
+    executor->thread_id = NULL;
+}
+
+uint32_t rhs_coroutine_executor_get_count(RHSCoroutineExecutor* executor)
+{
+    rhs_assert(executor);
+
+    uint32_t count = 0;
+    for (RHSCoroutine* co = executor->coroutines; co != NULL; co = co->next)
+    {
+        count++;
+    }
+    return count;
+}
+
+RHSCoroutineExecutor* rhs_coroutine_get_executor(RHSCoroutine* co)
+{
+    rhs_assert(co);
+    return co->executor;
+}
+
+void rhs_coroutine_set_context(RHSCoroutine* co, void* context)
+{
+    rhs_assert(co);
+    co->context = context;
+}
+
+void rhs_coroutine_prepare_yield(RHSCoroutine* co)
+{
+    co->wait    = RHSCoroutineWaitYield;
+    co->object  = NULL;
+    co->forever = true;
+}
+
+void rhs_coroutine_prepare_sleep(RHSCoroutine* co, uint32_t ticks)
+{
+    co->wait   = RHSCoroutineWaitSleep;
+    co->object = NULL;
+    rhs_coroutine_set_deadline(co, ticks);
+}
+
+void rhs_coroutine_prepare_message_queue(RHSCoroutine* co, RHSMessageQueue* queue, void* message, uint32_t timeout)
+{
+    rhs_assert(rhs_coroutine_find_queue(co->executor, queue));
+
+    co->wait   = RHSCoroutineWaitMessageQueue;
+    co->object = queue;
+    co->data   = message;
+    rhs_coroutine_set_deadline(co, timeout);
+}
+
+void rhs_coroutine_prepare_event_flag(RHSCoroutine* co,
+                                      RHSEventFlag* event_flag,
+                                      uint32_t      flags,
+                                      uint32_t      options,
+                                      uint32_t      timeout)
+{
+    co->wait    = RHSCoroutineWaitEventFlag;
+    co->object  = event_flag;
+    co->flags   = flags;
+    co->options = options;
+    rhs_coroutine_set_deadline(co, timeout);
+}
+
+bool rhs_coroutine_poll(RHSCoroutine* co)
+{
+    const bool expired = rhs_coroutine_is_expired(co, rhs_get_tick());
+    bool       done    = false;
+
+    switch (co->wait)
+    {
+    case RHSCoroutineWaitNone:
+        done = true;
+        break;
+
+    case RHSCoroutineWaitYield:
+        // First poll parks, executor resumes on next round
+        co->wait  = RHSCoroutineWaitNone;
+        co->ready = true;
+        return false;
+
+    case RHSCoroutineWaitSleep:
+        done       = expired;
+        co->result = RHSStatusOk;
+        break;
+
+    case RHSCoroutineWaitMessageQueue:
+    {
+        RHSCoroutineQueue* item = rhs_coroutine_find_queue(co->executor, co->object);
+        if (item->tokens > 0 && rhs_message_queue_get(item->queue, co->data, 0) == RHSStatusOk)
+        {
+            item->tokens--;
+            co->result = RHSStatusOk;
+            done       = true;
+        }
+        else if (expired)
+        {
+            co->result = co->poll ? RHSStatusErrorResource : RHSStatusErrorTimeout;
+            done       = true;
+        }
+        break;
+    }
+
+    case RHSCoroutineWaitEventFlag:
+    {
+        uint32_t flags = rhs_event_flag_wait(co->object, co->flags, co->options, 0);
+        if ((flags & RHSFlagError) == 0U)
+        {
+            co->result = flags;
+            done       = true;
+        }
+        else if (expired)
+        {
+            co->result = co->poll ? (uint32_t) RHSFlagErrorResource : (uint32_t) RHSFlagErrorTimeout;
+            done       = true;
+        }
+        break;
+    }
+    }
+
+    if (done)
+    {
+        co->wait   = RHSCoroutineWaitNone;
+        co->object = NULL;
+    }
+
+    return done;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file coroutine.h
+ * RHS stackless coroutines
+ *
+ * Cooperative tasks that share one thread and one stack. A coroutine is a
+ * function that is re-entered at the point of its last await, so locals do
+ * not survive an await: keep state in the context. Awaits must not be placed
+ * inside a nested switch and at most one await fits on a source line.
+ *
+ * @code
+ * static RHSCoroutineStatus blink(RHSCoroutine* co, void* context)
+ * {
+ *     Blink* app = context;
+ *     RHS_CO_BEGIN(co);
+ *     for (;;)
+ *     {
+ *         RHS_CO_MESSAGE_QUEUE_GET(co, app->queue, &app->message, RHSWaitForever, app->status);
+ *         rhs_hal_gpio_write(...);
+ *         RHS_CO_SLEEP(co, rhs_ms_to_ticks(100));
+ *     }
+ *     RHS_CO_END(co);
+ * }
+ *
+ * RHSCoroutineExecutor* executor = rhs_coroutine_executor_alloc(8 + 1);
+ * rhs_coroutine_executor_add_message_queue(executor, app->queue);
+ * rhs_coroutine_spawn(executor, "blink", blink, app);
+ * rhs_coroutine_executor_run(executor);
+ * @endcode
+ */
+#pragma once
+
+#include "base.h"
+#include "message_queue.h"
+#include "event_flag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RHSCoroutine         RHSCoroutine;
+typedef struct RHSCoroutineExecutor RHSCoroutineExecutor;
+
+typedef enum
+{
+    RHSCoroutineStatusPending,  // Parked on an await
+    RHSCoroutineStatusDone,     // Finished, will be freed by executor
+} RHSCoroutineStatus;
+
+typedef RHSCoroutineStatus (*RHSCoroutineCallback)(RHSCoroutine* co, void* context);
+
+typedef enum
+{
+    RHSCoroutineWaitNone,
+    RHSCoroutineWaitYield,
+    RHSCoroutineWaitSleep,
+    RHSCoroutineWaitMessageQueue,
+    RHSCoroutineWaitEventFlag,
+} RHSCoroutineWait;
+
+/** Coroutine state, members are used by RHS_CO_* macros only */
+struct RHSCoroutine
+{
+    uint32_t              resume;  // Line of last await, 0 before first run
+    uint32_t              result;  // RHSStatus or flags of last await
+    RHSCoroutineWait      wait;
+    void*                 object;
+    void*                 data;
+    uint32_t              flags;
+    uint32_t              options;
+    uint32_t              deadline;
+    bool                  forever;  // No deadline
+    bool                  poll;     // Zero timeout
+    bool                  ready;
+    const char*           name;
+    RHSCoroutineCallback  callback;
+    void*                 context;
+    RHSCoroutineExecutor* executor;
+    RHSCoroutine*         next;
+};
+
+/** Start of coroutine body */
+#define RHS_CO_BEGIN(co)  \
+    switch ((co)->resume) \
+    {                     \
+    case 0:
+
+/** End of coroutine body, coroutine is finished once reached */
+#define RHS_CO_END(co)            \
+    }                             \
+    (co)->resume = 0;             \
+    return RHSCoroutineStatusDone
+
+#define RHS_CO_AWAIT_(co, prepare)            \
+    do                                        \
+    {                                         \
+        prepare;                              \
+        (co)->resume = __LINE__;              \
+        /* FALLTHROUGH */                     \
+    case __LINE__:                            \
+        if (!rhs_coroutine_poll(co))          \
+        {                                     \
+            return RHSCoroutineStatusPending; \
+        }                                     \
+    } while (0)
+
+/** Let other coroutines run */
+#define RHS_CO_YIELD(co) RHS_CO_AWAIT_(co, rhs_coroutine_prepare_yield(co))
+
+/** Sleep for ticks */
+#define RHS_CO_SLEEP(co, ticks) RHS_CO_AWAIT_(co, rhs_coroutine_prepare_sleep(co, ticks))
+
+/** Get message from queue registered with rhs_coroutine_executor_add_message_queue
+ *
+ * status receives RHSStatus like rhs_message_queue_get
+ */
+#define RHS_CO_MESSAGE_QUEUE_GET(co, queue, message, timeout, status)                        \
+    do                                                                                       \
+    {                                                                                        \
+        RHS_CO_AWAIT_(co, rhs_coroutine_prepare_message_queue(co, queue, message, timeout)); \
+        (status) = (RHSStatus) (co)->result;                                                 \
+    } while (0)
+
+/** Wait for event flag registered with rhs_coroutine_executor_add_event_flag
+ *
+ * result receives flags or error like rhs_event_flag_wait
+ */
+#define RHS_CO_EVENT_FLAG_WAIT(co, event_flag, flags, options, timeout, result)                       \
+    do                                                                                                \
+    {                                                                                                 \
+        RHS_CO_AWAIT_(co, rhs_coroutine_prepare_event_flag(co, event_flag, flags, options, timeout)); \
+        (result) = (co)->result;                                                                      \
+    } while (0)
+
+/** Allocate executor
+ *
+ * @param[in]  capacity  sum of registered message queue lengths plus one per
+ *                       registered event flag
+ *
+ * @return     pointer to RHSCoroutineExecutor instance
+ */
+RHSCoroutineExecutor* rhs_coroutine_executor_alloc(uint32_t capacity);
+
+/** Free executor and remaining coroutines
+ *
+ * @param      executor  pointer to RHSCoroutineExecutor instance
+ */
+void rhs_coroutine_executor_free(RHSCoroutineExecutor* executor);
+
+/** Register message queue for RHS_CO_MESSAGE_QUEUE_GET
+ *
+ * Queue must be empty and must be read only by coroutines of this executor.
+ *
+ * @param      executor  pointer to RHSCoroutineExecutor instance
+ * @param      queue     pointer to RHSMessageQueue instance
+ */
+void rhs_coroutine_executor_add_message_queue(RHSCoroutineExecutor* executor, RHSMessageQueue* queue);
+
+/** Register event flag for RHS_CO_EVENT_FLAG_WAIT
+ *
+ * @param      executor    pointer to RHSCoroutineExecutor instance
+ * @param      event_flag  pointer to RHSEventFlag instance
+ */
+void rhs_coroutine_executor_add_event_flag(RHSCoroutineExecutor* executor, RHSEventFlag* event_flag);
+
+/** Get executor running coroutine
+ *
+ * @param      co    pointer to RHSCoroutine instance
+ *
+ * @return     pointer to RHSCoroutineExecutor instance
+ */
+RHSCoroutineExecutor* rhs_coroutine_get_executor(RHSCoroutine* co);
+
+/** Replace context passed to coroutine on next resume
+ *
+ * @param      co       pointer to RHSCoroutine instance
+ * @param      context  new context
+ */
+void rhs_coroutine_set_context(RHSCoroutine* co, void* context);
+
+/** Spawn coroutine
+ *
+ * Coroutine runs immediately up to its first await, so it must be called
+ * from executor thread or before rhs_coroutine_executor_run.
+ *
+ * @param      executor  pointer to RHSCoroutineExecutor instance
+ * @param[in]  name      coroutine name
+ * @param[in]  callback  coroutine body
+ * @param      context   callback context
+ */
+void rhs_coroutine_spawn(RHSCoroutineExecutor* executor,
+                         const char*           name,
+                         RHSCoroutineCallback  callback,
+                         void*                 context);
+
+/** Run coroutines in current thread until all of them are done
+ *
+ * @param      executor  pointer to RHSCoroutineExecutor instance
+ */
+void rhs_coroutine_executor_run(RHSCoroutineExecutor* executor);
+
+/** Get number of live coroutines
+ *
+ * @param      executor  pointer to RHSCoroutineExecutor instance
+ *
+ * @return     coroutine count
+ */
+uint32_t rhs_coroutine_executor_get_count(RHSCoroutineExecutor* executor);
+
+// Used by RHS_CO_* macros
+void rhs_coroutine_prepare_yield(RHSCoroutine* co);
+void rhs_coroutine_prepare_sleep(RHSCoroutine* co, uint32_t ticks);
+void rhs_coroutine_prepare_message_queue(RHSCoroutine* co, RHSMessageQueue* queue, void* message, uint32_t timeout);
+void rhs_coroutine_prepare_event_flag(RHSCoroutine* co,
+                                      RHSEventFlag* event_flag,
+                                      uint32_t      flags,
+                                      uint32_t      options,
+                                      uint32_t      timeout);
+bool rhs_coroutine_poll(RHSCoroutine* co);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,16 +2,19 @@
 #include "common.h"
 #include "memmgr.h"
 #include "check.h"
+#include "wait_set_i.h"
 
 #include <FreeRTOS.h>
 #include <event_groups.h>
+#include <timers.h>
 
 #define RHS_EVENT_FLAG_MAX_BITS_EVENT_GROUPS 24U
 #define RHS_EVENT_FLAG_INVALID_BITS (~((1UL << RHS_EVENT_FLAG_MAX_BITS_EVENT_GROUPS) - 1U))
 
 struct RHSEventFlag
 {
-    StaticEventGroup_t container;
+    StaticEventGroup_t     container;
+    RHSSemaphore* volatile wait_set_proxy;
 };
 
 // IMPORTANT: container MUST be the FIRST struct member
@@ -24,10 +27,24 @@ RHSEventFlag* rhs_event_flag_alloc(void)
     RHSEventFlag* instance = malloc(sizeof(RHSEventFlag));
 
     rhs_assert(xEventGroupCreateStatic(&instance->container) == (EventGroupHandle_t) instance);
+    instance->wait_set_proxy = NULL;
 
     return instance;
 }
 
+static void rhs_event_flag_set_deferred(void* context, uint32_t flags)
+{
+    RHSEventFlag* instance = context;
+
+    (void) xEventGroupSetBits((EventGroupHandle_t) instance, (EventBits_t) flags);
+
+    RHSSemaphore* proxy = instance->wait_set_proxy;
+    if (proxy)
+    {
+        (void) rhs_semaphore_release(proxy);
+    }
+}
+
 void rhs_event_flag_free(RHSEventFlag* instance)
 {
     rhs_assert(!RHS_IS_IRQ_MODE());
@@ -44,10 +61,16 @@ uint32_t rhs_event_flag_set(RHSEventFlag* instance, uint32_t flags)
     uint32_t           rflags;
     BaseType_t         yield;
 
+    RHSSemaphore* proxy = instance->wait_set_proxy;
+
     if (RHS_IS_IRQ_MODE())
     {
         yield = pdFALSE;
-        if (xEventGroupSetBitsFromISR(hEventGroup, (EventBits_t) flags, &yield) == pdFAIL)
+        // Bits are set later by timer task, wait set must be woken up after that
+        BaseType_t pended =
+            proxy ? xTimerPendFunctionCallFromISR(rhs_event_flag_set_deferred, instance, flags, &yield)
+                  : xEventGroupSetBitsFromISR(hEventGroup, (EventBits_t) flags, &yield);
+        if (pended == pdFAIL)
         {
             rflags = (uint32_t) RHSFlagErrorResource;
         }
@@ -62,6 +85,11 @@ uint32_t rhs_event_flag_set(RHSEventFlag* instance, uint32_t flags)
         vTaskSuspendAll();
         rflags = xEventGroupSetBits(hEventGroup, (EventBits_t) flags);
         (void) xTaskResumeAll();
+
+        if (proxy)
+        {
+            (void) rhs_semaphore_release(proxy);
+        }
     }
 
     /* Return event flags after setting */
@@ -184,3 +212,10 @@ uint32_t rhs_event_flag_wait(RHSEventFlag* instance, uint32_t flags, uint32_t op
     /* Return event flags before clearing */
     return rflags;
 }
+
+void rhs_event_flag_set_wait_set_proxy(RHSEventFlag* instance, RHSSemaphore* proxy)
+{
+    rhs_assert(instance);
+    rhs_assert(proxy == NULL || instance->wait_set_proxy == NULL);
+    instance->wait_set_proxy = proxy;
+}
@@ -235,5 +235,14 @@ void rhs_delay_ms(uint32_t milliseconds)
 
 void rhs_delay_us(uint32_t microseconds)
 {
+#ifdef RHS_VIRTUAL_TIME
+    /* Busy wait would stall simulated clock, sleep for rounded up amount of ticks instead */
+    if (!RHS_IS_ISR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        uint64_t ticks = ((uint64_t) microseconds * configTICK_RATE_HZ + 999999U) / 1000000U;
+        rhs_delay_tick((uint32_t) ticks);
+        return;
+    }
+#endif
     rhs_hal_cortex_delay_us(microseconds);
 }
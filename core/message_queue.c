@@ -7,16 +7,34 @@
 #include "memmgr.h"
 #include "common.h"
 #include "check.h"
+#include "trace.h"
+#include "queue_stats_i.h"
+#include "atomic.h"
+
+#include <string.h>
 
 // Internal FreeRTOS member names
 #define uxMessagesWaiting uxDummy4[0]
 #define uxLength uxDummy4[1]
 #define uxItemSize uxDummy4[2]
 
+// Urgent and normal lanes of a priority queue, container counts messages in both
+typedef struct
+{
+    StaticQueue_t                urgent;
+    StaticQueue_t                normal;
+    volatile uint32_t            run;  // Urgent messages served in a row while normal ones waited, CAS updated
+    RHSMessageQueuePriorityStats stats;
+} RHSMessageQueueLanes;
+
 struct RHSMessageQueue
 {
-    StaticQueue_t container;
-    uint8_t       buffer[];
+    StaticQueue_t         container;
+    RHSMessageQueueLanes* lanes;  // NULL for FIFO queue
+#ifdef RHS_QUEUE_STATS
+    RHSQueueStats stats;
+#endif
+    uint8_t buffer[];
 };
 
 // IMPORTANT: container MUST be the FIRST struct member
@@ -37,6 +55,32 @@ RHSMessageQueue* rhs_message_queue_alloc(uint32_t msg_count, uint32_t msg_size)
     //
     // As a bonus it guarantees that RHSMessageQueue* can be casted into StaticQueue_t* or QueueHandle_t.
     rhs_assert(xQueueCreateStatic(msg_count, msg_size, instance->buffer, &instance->container) == (void*) instance);
+    instance->lanes = NULL;
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_register(&instance->stats, instance, RHSQueueStatsTypeMessageQueue, msg_count);
+#endif
+    return instance;
+}
+
+RHSMessageQueue* rhs_message_queue_alloc_priority(uint32_t msg_count, uint32_t urgent_count, uint32_t msg_size)
+{
+    rhs_assert((rhs_kernel_is_irq_or_masked() == 0U) && (msg_count > 0U) && (urgent_count > 0U) && (msg_size > 0U));
+
+    RHSMessageQueue* instance =
+        malloc(sizeof(RHSMessageQueue) + sizeof(RHSMessageQueueLanes) + (msg_count + urgent_count) * msg_size);
+    RHSMessageQueueLanes* lanes   = (RHSMessageQueueLanes*) instance->buffer;
+    uint8_t*              storage = instance->buffer + sizeof(RHSMessageQueueLanes);
+
+    // Zero sized items turn container into a counting semaphore that wait sets can select
+    rhs_assert(xQueueCreateStatic(msg_count + urgent_count, 0, NULL, &instance->container) == (void*) instance);
+    rhs_assert(xQueueCreateStatic(urgent_count, msg_size, storage, &lanes->urgent) != NULL);
+    rhs_assert(xQueueCreateStatic(msg_count, msg_size, storage + urgent_count * msg_size, &lanes->normal) != NULL);
+    lanes->run = 0;
+    memset(&lanes->stats, 0, sizeof(RHSMessageQueuePriorityStats));
+    instance->lanes = lanes;
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_register(&instance->stats, instance, RHSQueueStatsTypeMessageQueue, msg_count + urgent_count);
+#endif
     return instance;
 }
 
@@ -45,23 +89,31 @@ void rhs_message_queue_free(RHSMessageQueue* instance)
     rhs_assert(rhs_kernel_is_irq_or_masked() == 0U);
     rhs_assert(instance);
 
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_unregister(&instance->stats);
+#endif
+    if (instance->lanes)
+    {
+        vQueueDelete((QueueHandle_t) &instance->lanes->urgent);
+        vQueueDelete((QueueHandle_t) &instance->lanes->normal);
+    }
     vQueueDelete((QueueHandle_t) instance);
     free(instance);
 }
 
-RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr, uint32_t timeout)
+static RHSStatus rhs_message_queue_send(QueueHandle_t hQueue,
+                                        const void*   msg_ptr,
+                                        uint32_t      timeout,
+                                        BaseType_t    position)
 {
-    rhs_assert(instance);
-
-    QueueHandle_t hQueue = (QueueHandle_t) instance;
-    RHSStatus     stat;
-    BaseType_t    yield;
+    RHSStatus  stat;
+    BaseType_t yield;
 
     stat = RHSStatusOk;
 
     if (rhs_kernel_is_irq_or_masked() != 0U)
     {
-        if ((msg_ptr == NULL) || (timeout != 0U))
+        if (timeout != 0U)
         {
             stat = RHSStatusErrorParameter;
         }
@@ -69,7 +121,7 @@ RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr,
         {
             yield = pdFALSE;
 
-            if (xQueueSendToBackFromISR(hQueue, msg_ptr, &yield) != pdTRUE)
+            if (xQueueGenericSendFromISR(hQueue, msg_ptr, &yield, position) != pdTRUE)
             {
                 stat = RHSStatusErrorResource;
             }
@@ -81,43 +133,105 @@ RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr,
     }
     else
     {
-        if (msg_ptr == NULL)
+        if (xQueueGenericSend(hQueue, msg_ptr, (TickType_t) timeout, position) != pdPASS)
         {
-            stat = RHSStatusErrorParameter;
-        }
-        else
-        {
-            if (xQueueSendToBack(hQueue, msg_ptr, (TickType_t) timeout) != pdPASS)
+            if (timeout != 0U)
+            {
+                stat = RHSStatusErrorTimeout;
+            }
+            else
             {
-                if (timeout != 0U)
-                {
-                    stat = RHSStatusErrorTimeout;
-                }
-                else
-                {
-                    stat = RHSStatusErrorResource;
-                }
+                stat = RHSStatusErrorResource;
             }
         }
     }
 
+    return stat;
+}
+
+static RHSStatus rhs_message_queue_put_at(RHSMessageQueue*   instance,
+                                          const void*        msg_ptr,
+                                          RHSMessagePriority priority,
+                                          BaseType_t         position,
+                                          uint32_t           timeout)
+{
+    rhs_assert(instance);
+
+    RHSStatus stat;
+
+    if (msg_ptr == NULL)
+    {
+        stat = RHSStatusErrorParameter;
+    }
+    else if (instance->lanes == NULL)
+    {
+        stat = rhs_message_queue_send((QueueHandle_t) instance, msg_ptr, timeout, position);
+    }
+    else
+    {
+        StaticQueue_t* lane =
+            (priority == RHSMessagePriorityUrgent) ? &instance->lanes->urgent : &instance->lanes->normal;
+
+        stat = rhs_message_queue_send((QueueHandle_t) lane, msg_ptr, timeout, position);
+        if (stat == RHSStatusOk)
+        {
+            // Container length is the sum of both lanes, so it has room for every stored message
+            rhs_assert(rhs_message_queue_send((QueueHandle_t) instance, NULL, 0, queueSEND_TO_BACK) == RHSStatusOk);
+        }
+    }
+
+    RHS_TRACE_EVENT(RHSTraceEventQueuePut, instance, stat);
+
+#ifdef RHS_QUEUE_STATS
+    if (stat != RHSStatusErrorParameter)
+    {
+        rhs_queue_stats_put(
+            &instance->stats, stat == RHSStatusOk, stat != RHSStatusOk, instance->container.uxMessagesWaiting);
+    }
+#endif
+
     /* Return execution status */
     return stat;
 }
 
-RHSStatus rhs_message_queue_get(RHSMessageQueue* instance, void* msg_ptr, uint32_t timeout)
+RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr, uint32_t timeout)
+{
+    return rhs_message_queue_put_at(instance, msg_ptr, RHSMessagePriorityNormal, queueSEND_TO_BACK, timeout);
+}
+
+RHSStatus rhs_message_queue_put_priority(RHSMessageQueue*   instance,
+                                         const void*        msg_ptr,
+                                         RHSMessagePriority priority,
+                                         uint32_t           timeout)
+{
+    return rhs_message_queue_put_at(instance, msg_ptr, priority, queueSEND_TO_BACK, timeout);
+}
+
+RHSStatus rhs_message_queue_put_front(RHSMessageQueue* instance, const void* msg_ptr, uint32_t timeout)
+{
+    return rhs_message_queue_put_at(instance, msg_ptr, RHSMessagePriorityUrgent, queueSEND_TO_FRONT, timeout);
+}
+
+void rhs_message_queue_set_name(RHSMessageQueue* instance, const char* name)
 {
     rhs_assert(instance);
+#ifdef RHS_QUEUE_STATS
+    instance->stats.name = name;
+#else
+    (void) name;
+#endif
+}
 
-    QueueHandle_t hQueue = (QueueHandle_t) instance;
-    RHSStatus     stat;
-    BaseType_t    yield;
+static RHSStatus rhs_message_queue_receive(QueueHandle_t hQueue, void* msg_ptr, uint32_t timeout)
+{
+    RHSStatus  stat;
+    BaseType_t yield;
 
     stat = RHSStatusOk;
 
     if (rhs_kernel_is_irq_or_masked() != 0U)
     {
-        if ((msg_ptr == NULL) || (timeout != 0U))
+        if (timeout != 0U)
         {
             stat = RHSStatusErrorParameter;
         }
@@ -137,29 +251,123 @@ RHSStatus rhs_message_queue_get(RHSMessageQueue* instance, void* msg_ptr, uint32
     }
     else
     {
-        if (msg_ptr == NULL)
-        {
-            stat = RHSStatusErrorParameter;
-        }
-        else
+        if (xQueueReceive(hQueue, msg_ptr, (TickType_t) timeout) != pdPASS)
         {
-            if (xQueueReceive(hQueue, msg_ptr, (TickType_t) timeout) != pdPASS)
+            if (timeout != 0U)
             {
-                if (timeout != 0U)
-                {
-                    stat = RHSStatusErrorTimeout;
-                }
-                else
-                {
-                    stat = RHSStatusErrorResource;
-                }
+                stat = RHSStatusErrorTimeout;
             }
+            else
+            {
+                stat = RHSStatusErrorResource;
+            }
+        }
+    }
+
+    return stat;
+}
+
+// Take message of priority queue after its count was decremented
+static void rhs_message_queue_receive_lane(RHSMessageQueue* instance, void* msg_ptr)
+{
+    RHSMessageQueueLanes* lanes    = instance->lanes;
+    const bool            waiting  = lanes->urgent.uxMessagesWaiting != 0U;
+    const bool            overtake = waiting && (lanes->normal.uxMessagesWaiting != 0U);
+    bool                  urgent;
+    uint32_t              run;
+    uint32_t              next;
+
+    // Consumers may race for the lane choice, the run count moves by compare and swap only
+    do
+    {
+        run    = rhs_atomic_load(&lanes->run);
+        urgent = waiting;
+        next   = 0;
+        if (overtake)
+        {
+            // Bound latency of normal messages under sustained urgent load
+            urgent = run < RHS_MESSAGE_QUEUE_URGENT_BURST;
+            next   = urgent ? run + 1U : 0U;
+        }
+    } while (!rhs_atomic_cas(&lanes->run, run, next));
+
+    if (overtake && urgent)
+    {
+        rhs_atomic_add(&lanes->stats.overtaken, 1U);
+        rhs_atomic_max(&lanes->stats.max_run, next);
+    }
+    else if (overtake)
+    {
+        rhs_atomic_add(&lanes->stats.forced, 1U);
+    }
+
+    QueueHandle_t first  = (QueueHandle_t) (urgent ? &lanes->urgent : &lanes->normal);
+    QueueHandle_t second = (QueueHandle_t) (urgent ? &lanes->normal : &lanes->urgent);
+
+    // The count guarantees a stored message, another consumer may just have taken it from the chosen lane
+    for (;;)
+    {
+        if (rhs_message_queue_receive(first, msg_ptr, 0) == RHSStatusOk)
+        {
+            break;
+        }
+        if (rhs_message_queue_receive(second, msg_ptr, 0) == RHSStatusOk)
+        {
+            urgent = !urgent;
+            break;
+        }
+    }
+
+    if (urgent)
+    {
+        rhs_atomic_add(&lanes->stats.urgent, 1U);
+    }
+}
+
+RHSStatus rhs_message_queue_get(RHSMessageQueue* instance, void* msg_ptr, uint32_t timeout)
+{
+    rhs_assert(instance);
+
+    RHSStatus stat;
+
+    if (msg_ptr == NULL)
+    {
+        stat = RHSStatusErrorParameter;
+    }
+    else if (instance->lanes == NULL)
+    {
+        stat = rhs_message_queue_receive((QueueHandle_t) instance, msg_ptr, timeout);
+    }
+    else
+    {
+        stat = rhs_message_queue_receive((QueueHandle_t) instance, NULL, timeout);
+        if (stat == RHSStatusOk)
+        {
+            rhs_message_queue_receive_lane(instance, msg_ptr);
         }
     }
 
+    RHS_TRACE_EVENT(RHSTraceEventQueueGet, instance, stat);
+
     return stat;
 }
 
+bool rhs_message_queue_get_priority_stats(RHSMessageQueue* instance, RHSMessageQueuePriorityStats* stats)
+{
+    rhs_assert(instance && stats);
+
+    if (instance->lanes == NULL)
+    {
+        return false;
+    }
+
+    stats->urgent    = rhs_atomic_load(&instance->lanes->stats.urgent);
+    stats->overtaken = rhs_atomic_load(&instance->lanes->stats.overtaken);
+    stats->max_run   = rhs_atomic_load(&instance->lanes->stats.max_run);
+    stats->forced    = rhs_atomic_load(&instance->lanes->stats.forced);
+    return true;
+}
+
 uint32_t rhs_message_queue_get_capacity(RHSMessageQueue* instance)
 {
     rhs_assert(instance);
@@ -171,7 +379,7 @@ uint32_t rhs_message_queue_get_message_size(RHSMessageQueue* instance)
 {
     rhs_assert(instance);
 
-    return instance->container.uxItemSize;
+    return instance->lanes ? instance->lanes->normal.uxItemSize : instance->container.uxItemSize;
 }
 
 uint32_t rhs_message_queue_get_count(RHSMessageQueue* instance)
@@ -216,6 +424,27 @@ uint32_t rhs_message_queue_get_space(RHSMessageQueue* instance)
     return space;
 }
 
+// Drop messages of priority queue a message at a time, each with its container token
+static void rhs_message_queue_drain_lanes(RHSMessageQueue* instance)
+{
+    RHSMessageQueueLanes* lanes   = instance->lanes;
+    uint32_t              count   = instance->container.uxLength;
+    void*                 message = malloc(lanes->normal.uxItemSize);
+
+    // Resetting container and lanes apart lets a concurrent put post a token for a dropped message, get would spin
+    while ((count-- > 0U) && (rhs_message_queue_receive((QueueHandle_t) instance, NULL, 0) == RHSStatusOk))
+    {
+        while ((rhs_message_queue_receive((QueueHandle_t) &lanes->urgent, message, 0) != RHSStatusOk) &&
+               (rhs_message_queue_receive((QueueHandle_t) &lanes->normal, message, 0) != RHSStatusOk))
+        {
+            // The token guarantees a stored message, as in rhs_message_queue_receive_lane
+        }
+    }
+
+    free(message);
+    (void) rhs_atomic_exchange(&lanes->run, 0);
+}
+
 RHSStatus rhs_message_queue_reset(RHSMessageQueue* instance)
 {
     rhs_assert(instance);
@@ -230,7 +459,14 @@ RHSStatus rhs_message_queue_reset(RHSMessageQueue* instance)
     else
     {
         stat = RHSStatusOk;
-        (void) xQueueReset(hQueue);
+        if (instance->lanes)
+        {
+            rhs_message_queue_drain_lanes(instance);
+        }
+        else
+        {
+            (void) xQueueReset(hQueue);
+        }
     }
 
     /* Return execution status */
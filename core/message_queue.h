@@ -1,6 +1,12 @@
 /**
  * @file message_queue.h
  * RHSMessageQueue
+ *
+ * A queue is a FIFO by default. A priority queue, see
+ * rhs_message_queue_alloc_priority, has an urgent and a normal lane: control
+ * messages put as urgent overtake the normal backlog. After
+ * RHS_MESSAGE_QUEUE_URGENT_BURST urgent messages in a row while normal ones
+ * wait, one normal message is served, so neither lane starves.
  */
 #pragma once
 
@@ -10,8 +16,26 @@
 extern "C" {
 #endif
 
+#ifndef RHS_MESSAGE_QUEUE_URGENT_BURST
+#    define RHS_MESSAGE_QUEUE_URGENT_BURST 8U
+#endif
+
 typedef struct RHSMessageQueue RHSMessageQueue;
 
+typedef enum
+{
+    RHSMessagePriorityNormal,
+    RHSMessagePriorityUrgent,
+} RHSMessagePriority;
+
+typedef struct
+{
+    volatile uint32_t urgent;     // Urgent messages served
+    volatile uint32_t overtaken;  // Urgent messages served while normal ones waited
+    volatile uint32_t max_run;    // Longest run of those
+    volatile uint32_t forced;     // Normal messages served because the run reached the burst limit
+} RHSMessageQueuePriorityStats;
+
 /** Allocate rhs message queue
  *
  * @param[in]  msg_count  The message count
@@ -21,6 +45,19 @@ typedef struct RHSMessageQueue RHSMessageQueue;
  */
 RHSMessageQueue* rhs_message_queue_alloc(uint32_t msg_count, uint32_t msg_size);
 
+/** Allocate priority message queue with urgent and normal lanes
+ *
+ * Works with every rhs_message_queue function and with wait sets.
+ * rhs_message_queue_put puts into the normal lane.
+ *
+ * @param[in]  msg_count     The normal lane message count
+ * @param[in]  urgent_count  The urgent lane message count
+ * @param[in]  msg_size      The message size
+ *
+ * @return     pointer to RHSMessageQueue instance
+ */
+RHSMessageQueue* rhs_message_queue_alloc_priority(uint32_t msg_count, uint32_t urgent_count, uint32_t msg_size);
+
 /** Free queue
  *
  * @param      instance  pointer to RHSMessageQueue instance
@@ -37,6 +74,39 @@ void rhs_message_queue_free(RHSMessageQueue* instance);
  */
 RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr, uint32_t timeout);
 
+/** Put message into lane of priority queue
+ *
+ * @param      instance  pointer to RHSMessageQueue instance
+ * @param[in]  msg_ptr   The message pointer
+ * @param[in]  priority  The lane, FIFO queues ignore it
+ * @param[in]  timeout   The timeout, waits for space in the lane
+ *
+ * @return     The rhs status.
+ */
+RHSStatus rhs_message_queue_put_priority(RHSMessageQueue*   instance,
+                                         const void*        msg_ptr,
+                                         RHSMessagePriority priority,
+                                         uint32_t           timeout);
+
+/** Put message in front of all other messages
+ *
+ * Front of the urgent lane for priority queues, front of the queue otherwise.
+ *
+ * @param      instance  pointer to RHSMessageQueue instance
+ * @param[in]  msg_ptr   The message pointer
+ * @param[in]  timeout   The timeout
+ *
+ * @return     The rhs status.
+ */
+RHSStatus rhs_message_queue_put_front(RHSMessageQueue* instance, const void* msg_ptr, uint32_t timeout);
+
+/** Set name shown in queue statistics, see queue_stats.h
+ *
+ * @param      instance  pointer to RHSMessageQueue instance
+ * @param[in]  name      queue name, must stay valid
+ */
+void rhs_message_queue_set_name(RHSMessageQueue* instance, const char* name);
+
 /** Get message from queue
  *
  * @param      instance  pointer to RHSMessageQueue instance
@@ -47,6 +117,15 @@ RHSStatus rhs_message_queue_put(RHSMessageQueue* instance, const void* msg_ptr,
  */
 RHSStatus rhs_message_queue_get(RHSMessageQueue* instance, void* msg_ptr, uint32_t timeout);
 
+/** Get starvation counters of priority queue
+ *
+ * @param      instance  pointer to RHSMessageQueue instance
+ * @param[out] stats     The counters
+ *
+ * @return     false if queue is a FIFO queue
+ */
+bool rhs_message_queue_get_priority_stats(RHSMessageQueue* instance, RHSMessageQueuePriorityStats* stats);
+
 /** Get queue capacity
  *
  * @param      instance  pointer to RHSMessageQueue instance
@@ -80,6 +159,9 @@ uint32_t rhs_message_queue_get_count(RHSMessageQueue* instance);
 uint32_t rhs_message_queue_get_space(RHSMessageQueue* instance);
 
 /** Reset queue
+ *
+ * A priority queue is drained message by message, a put running at the same
+ * time may keep its message.
  *
  * @param      instance  pointer to RHSMessageQueue instance
  *
@@ -0,0 +1,429 @@
+#include "metrics.h"
+#include "check.h"
+#include "common.h"
+#include "defines.h"
+#include "kernel.h"
+#include "memmgr.h"
+#include "mutex.h"
+#include "thread.h"
+#include "thread_list.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define METRICS_LINE_SIZE 96
+
+// Values below are exact, above there are four buckets per power of two
+#define METRICS_LINEAR 8U
+
+static RHSMetric*  metrics_head  = NULL;
+static RHSMetric** metrics_tail  = &metrics_head;
+static RHSMutex*   metrics_mutex = NULL;
+
+static uint32_t rhs_metrics_heap_free(void* context)
+{
+    (void) context;
+    return memmgr_get_free_heap();
+}
+
+static uint32_t rhs_metrics_heap_min_free(void* context)
+{
+    (void) context;
+    return memmgr_get_minimum_free_heap();
+}
+
+static uint32_t rhs_metrics_uptime(void* context)
+{
+    (void) context;
+    return (uint32_t) ((uint64_t) rhs_get_tick() * 1000U / rhs_kernel_get_tick_frequency());
+}
+
+static RHSMetric metrics_heap_free;
+static RHSMetric metrics_heap_min_free;
+static RHSMetric metrics_uptime;
+
+void rhs_metrics_init(void)
+{
+    metrics_mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
+
+    rhs_metric_init(&metrics_heap_free, "rhs_heap_free_bytes", RHSMetricTypeGauge, rhs_metrics_heap_free, NULL);
+    rhs_metric_init(
+        &metrics_heap_min_free, "rhs_heap_min_free_bytes", RHSMetricTypeGauge, rhs_metrics_heap_min_free, NULL);
+    rhs_metric_init(&metrics_uptime, "rhs_uptime_ms", RHSMetricTypeCounter, rhs_metrics_uptime, NULL);
+    rhs_metric_register(&metrics_heap_free);
+    rhs_metric_register(&metrics_heap_min_free);
+    rhs_metric_register(&metrics_uptime);
+}
+
+void rhs_metric_init(RHSMetric*            metric,
+                     const char*           name,
+                     RHSMetricType         type,
+                     RHSMetricReadCallback read,
+                     void*                 context)
+{
+    rhs_assert(metric && name && read);
+    rhs_assert(type != RHSMetricTypeHistogram);
+
+    memset(metric, 0, sizeof(RHSMetric));
+    metric->name    = name;
+    metric->type    = type;
+    metric->read    = read;
+    metric->context = context;
+}
+
+uint32_t rhs_metric_read_word(void* context)
+{
+    return rhs_atomic_load(context);
+}
+
+void rhs_metric_register(RHSMetric* metric)
+{
+    rhs_assert(metric && metric->name);
+    rhs_assert(metric->type != RHSMetricTypeHistogram || metric->histogram);
+    rhs_assert(strlen(metric->name) <= UINT8_MAX);
+
+    RHS_CRITICAL_ENTER();
+    rhs_assert(!metric->registered);
+    metric->next       = NULL;
+    metric->registered = true;
+    *metrics_tail      = metric;
+    metrics_tail       = &metric->next;
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_metric_unregister(RHSMetric* metric)
+{
+    rhs_assert(metric && metric->registered);
+    rhs_assert(metrics_mutex);
+
+    // Export walks the list with the mutex held
+    rhs_assert(rhs_mutex_acquire(metrics_mutex, RHSWaitForever) == RHSStatusOk);
+
+    RHS_CRITICAL_ENTER();
+    RHSMetric** link = &metrics_head;
+    while (*link != metric)
+    {
+        rhs_assert(*link);
+        link = &(*link)->next;
+    }
+    *link = metric->next;
+    if (metrics_tail == &metric->next)
+    {
+        metrics_tail = link;
+    }
+    metric->registered = false;
+    RHS_CRITICAL_EXIT();
+
+    rhs_mutex_release(metrics_mutex);
+}
+
+static uint32_t rhs_metric_bucket(uint32_t value)
+{
+    if (value < METRICS_LINEAR)
+    {
+        return value;
+    }
+
+    uint32_t exponent = 31U - __CLZ(value);
+    uint32_t bucket   = METRICS_LINEAR + (exponent - 3U) * 4U + ((value >> (exponent - 2U)) & 3U);
+    return MIN(bucket, (uint32_t) RHS_METRIC_HISTOGRAM_BUCKETS - 1U);
+}
+
+uint32_t rhs_metric_bucket_value(uint32_t bucket)
+{
+    if (bucket < METRICS_LINEAR)
+    {
+        return bucket;
+    }
+
+    uint32_t exponent = 3U + (bucket - METRICS_LINEAR) / 4U;
+    return (4U + ((bucket - METRICS_LINEAR) & 3U)) << (exponent - 2U);
+}
+
+void rhs_metric_record(RHSMetric* metric, uint32_t value)
+{
+    rhs_assert(metric && metric->type == RHSMetricTypeHistogram);
+
+    RHSMetricHistogram* histogram = metric->histogram;
+    rhs_atomic_add(&histogram->buckets[rhs_metric_bucket(value)], 1U);
+    rhs_atomic_add(&histogram->sum, value);
+    rhs_atomic_max(&histogram->max, value);
+    rhs_atomic_add(&histogram->count, 1U);
+}
+
+uint32_t rhs_metric_get_value(const RHSMetric* metric)
+{
+    rhs_assert(metric);
+
+    if (metric->type == RHSMetricTypeHistogram)
+    {
+        return rhs_atomic_load(&metric->histogram->count);
+    }
+    return metric->read ? metric->read(metric->context) : rhs_atomic_load(&metric->value);
+}
+
+uint32_t rhs_metric_get_percentile(const RHSMetric* metric, uint32_t percentile)
+{
+    rhs_assert(metric && metric->type == RHSMetricTypeHistogram);
+    rhs_assert(percentile <= 100U);
+
+    const RHSMetricHistogram* histogram = metric->histogram;
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < RHS_METRIC_HISTOGRAM_BUCKETS; i++)
+    {
+        total += rhs_atomic_load(&histogram->buckets[i]);
+    }
+    if (total == 0U)
+    {
+        return 0;
+    }
+
+    // Rank of the sample at percentile, at least the first one
+    uint64_t rank = MAX((total * percentile + 99U) / 100U, 1U);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < RHS_METRIC_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += rhs_atomic_load(&histogram->buckets[i]);
+        if (seen >= rank)
+        {
+            return rhs_metric_bucket_value(i);
+        }
+    }
+    return rhs_metric_bucket_value(RHS_METRIC_HISTOGRAM_BUCKETS - 1U);
+}
+
+void rhs_metrics_foreach(RHSMetricsCallback callback, void* context)
+{
+    rhs_assert(callback);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    if (metrics_mutex)
+    {
+        rhs_assert(rhs_mutex_acquire(metrics_mutex, RHSWaitForever) == RHSStatusOk);
+    }
+
+    for (const RHSMetric* metric = metrics_head; metric != NULL; metric = metric->next)
+    {
+        callback(metric, context);
+    }
+
+    if (metrics_mutex)
+    {
+        rhs_mutex_release(metrics_mutex);
+    }
+}
+
+typedef struct
+{
+    RHSMetricsWriter writer;
+    void*            context;
+    uint16_t         count;
+} RHSMetricsDump;
+
+static void rhs_metrics_printf(RHSMetricsDump* dump, const char* format, ...)
+    _ATTRIBUTE((__format__(__printf__, 2, 3)));
+
+static void rhs_metrics_printf(RHSMetricsDump* dump, const char* format, ...)
+{
+    char    line[METRICS_LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        dump->writer(line, MIN((size_t) len, sizeof(line) - 1), dump->context);
+    }
+}
+
+static void rhs_metrics_dump_histogram(RHSMetricsDump* dump, const RHSMetric* metric)
+{
+    const RHSMetricHistogram* histogram = metric->histogram;
+
+    size_t last = 0;
+    for (size_t i = 0; i < RHS_METRIC_HISTOGRAM_BUCKETS; i++)
+    {
+        if (rhs_atomic_load(&histogram->buckets[i]))
+        {
+            last = i;
+        }
+    }
+
+    // Cumulative count of values up to and including le, last bucket only goes in +Inf
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i <= last && i < RHS_METRIC_HISTOGRAM_BUCKETS - 1U; i++)
+    {
+        cumulative += rhs_atomic_load(&histogram->buckets[i]);
+        rhs_metrics_printf(dump,
+                           "%s_bucket{le=\"%lu\"} %lu\n",
+                           metric->name,
+                           (unsigned long) rhs_metric_bucket_value(i + 1U) - 1UL,
+                           (unsigned long) cumulative);
+    }
+    if (last == RHS_METRIC_HISTOGRAM_BUCKETS - 1U)
+    {
+        cumulative += rhs_atomic_load(&histogram->buckets[last]);
+    }
+    rhs_metrics_printf(dump, "%s_bucket{le=\"+Inf\"} %lu\n", metric->name, (unsigned long) cumulative);
+    rhs_metrics_printf(dump, "%s_sum %lu\n", metric->name, (unsigned long) rhs_atomic_load(&histogram->sum));
+    rhs_metrics_printf(dump, "%s_count %lu\n", metric->name, (unsigned long) cumulative);
+}
+
+static void rhs_metrics_dump_text(const RHSMetric* metric, void* context)
+{
+    static const char* const types[] = {
+        [RHSMetricTypeCounter]   = "counter",
+        [RHSMetricTypeGauge]     = "gauge",
+        [RHSMetricTypeHistogram] = "histogram",
+    };
+
+    RHSMetricsDump* dump = context;
+
+    rhs_metrics_printf(dump, "# TYPE %s %s\n", metric->name, types[metric->type]);
+    if (metric->type == RHSMetricTypeHistogram)
+    {
+        rhs_metrics_dump_histogram(dump, metric);
+    }
+    else if (metric->type == RHSMetricTypeGauge)
+    {
+        rhs_metrics_printf(dump, "%s %ld\n", metric->name, (long) (int32_t) rhs_metric_get_value(metric));
+    }
+    else
+    {
+        rhs_metrics_printf(dump, "%s %lu\n", metric->name, (unsigned long) rhs_metric_get_value(metric));
+    }
+}
+
+static void rhs_metrics_dump_threads(RHSMetricsDump* dump)
+{
+    RHSThreadList* thread_list = rhs_thread_list_create();
+    rhs_thread_enumerate(thread_list);
+    uint16_t count = rhs_thread_list_size(thread_list);
+
+    rhs_metrics_printf(dump, "# TYPE rhs_thread_cpu_percent gauge\n");
+    for (uint16_t i = 0; i < count; i++)
+    {
+        RHSThreadListItem* item = rhs_thread_list_at(thread_list, i);
+        rhs_metrics_printf(
+            dump, "rhs_thread_cpu_percent{thread=\"%s\"} %lu\n", item->name, (unsigned long) item->cpu);
+    }
+    rhs_metrics_printf(dump, "# TYPE rhs_thread_stack_min_free gauge\n");
+    for (uint16_t i = 0; i < count; i++)
+    {
+        RHSThreadListItem* item = rhs_thread_list_at(thread_list, i);
+        rhs_metrics_printf(
+            dump, "rhs_thread_stack_min_free{thread=\"%s\"} %lu\n", item->name, (unsigned long) item->stack_min_free);
+    }
+
+    rhs_thread_list_destroy(thread_list);
+}
+
+void rhs_metrics_dump(RHSMetricsWriter writer, void* context)
+{
+    rhs_assert(writer);
+
+    RHSMetricsDump dump = {.writer = writer, .context = context};
+    rhs_metrics_foreach(rhs_metrics_dump_text, &dump);
+    rhs_metrics_dump_threads(&dump);
+}
+
+static uint8_t* rhs_metrics_put_u32(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t) value;
+    out[1] = (uint8_t) (value >> 8);
+    out[2] = (uint8_t) (value >> 16);
+    out[3] = (uint8_t) (value >> 24);
+    return out + 4;
+}
+
+static void rhs_metrics_dump_record(const RHSMetric* metric, void* context)
+{
+    RHSMetricsDump* dump = context;
+    uint8_t         buffer[16];
+    uint8_t*        out  = buffer;
+    const uint8_t   size = (uint8_t) strlen(metric->name);
+
+    *out++ = (uint8_t) metric->type;
+    *out++ = size;
+    dump->writer((const char*) buffer, out - buffer, dump->context);
+    dump->writer(metric->name, size, dump->context);
+
+    out = buffer;
+    if (metric->type != RHSMetricTypeHistogram)
+    {
+        out = rhs_metrics_put_u32(out, rhs_metric_get_value(metric));
+        dump->writer((const char*) buffer, out - buffer, dump->context);
+        return;
+    }
+
+    const RHSMetricHistogram* histogram = metric->histogram;
+
+    uint8_t used = 0;
+    for (size_t i = 0; i < RHS_METRIC_HISTOGRAM_BUCKETS; i++)
+    {
+        used += rhs_atomic_load(&histogram->buckets[i]) ? 1U : 0U;
+    }
+
+    out    = rhs_metrics_put_u32(out, rhs_atomic_load(&histogram->count));
+    out    = rhs_metrics_put_u32(out, rhs_atomic_load(&histogram->sum));
+    out    = rhs_metrics_put_u32(out, rhs_atomic_load(&histogram->max));
+    *out++ = used;
+    dump->writer((const char*) buffer, out - buffer, dump->context);
+
+    for (size_t i = 0; i < RHS_METRIC_HISTOGRAM_BUCKETS && used; i++)
+    {
+        uint32_t count = rhs_atomic_load(&histogram->buckets[i]);
+        if (count)
+        {
+            out    = buffer;
+            *out++ = (uint8_t) i;
+            out    = rhs_metrics_put_u32(out, count);
+            dump->writer((const char*) buffer, out - buffer, dump->context);
+            used--;
+        }
+    }
+}
+
+void rhs_metrics_dump_binary(RHSMetricsWriter writer, void* context)
+{
+    rhs_assert(writer);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    RHSMetricsDump dump = {.writer = writer, .context = context};
+
+    // Mutex keeps unregister out, a metric registered meanwhile is appended after the counted ones
+    if (metrics_mutex)
+    {
+        rhs_assert(rhs_mutex_acquire(metrics_mutex, RHSWaitForever) == RHSStatusOk);
+    }
+
+    for (const RHSMetric* metric = metrics_head; metric != NULL; metric = metric->next)
+    {
+        dump.count++;
+    }
+
+    uint8_t  header[11];
+    uint8_t* out = header;
+    memcpy(out, "RHSM", 4);
+    out += 4;
+    *out++ = RHS_METRICS_BINARY_VERSION;
+    *out++ = (uint8_t) dump.count;
+    *out++ = (uint8_t) (dump.count >> 8);
+    out    = rhs_metrics_put_u32(out, rhs_metrics_uptime(NULL));
+    writer((const char*) header, out - header, context);
+
+    // Header count is what the parser reads, never write more records
+    const RHSMetric* metric = metrics_head;
+    for (uint16_t i = 0; i < dump.count && metric != NULL; i++, metric = metric->next)
+    {
+        rhs_metrics_dump_record(metric, &dump);
+    }
+
+    if (metrics_mutex)
+    {
+        rhs_mutex_release(metrics_mutex);
+    }
+}
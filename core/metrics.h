@@ -0,0 +1,198 @@
+/**
+ * @file metrics.h
+ * RHS metrics registry
+ *
+ * Named counters, gauges and latency histograms in one registry, exported by
+ * the `metrics` CLI command, as Prometheus text over HTTP and as a compact
+ * binary dump. Updates are O(1), lock-free and ISR safe. A metric either
+ * holds its own value or is sampled from a read callback on export, so
+ * existing statistics can be registered without touching their hot path.
+ *
+ * Histograms use fixed log-linear buckets: exact below 8, then four buckets
+ * per power of two (at most 25% error), values above the last bucket are
+ * counted in it.
+ *
+ * Binary dump, little endian:
+ *
+ *     "RHSM" u8 version u16 count u32 uptime_ms
+ *     per metric: u8 type u8 name_len name[name_len] then
+ *       counter, gauge: u32 value
+ *       histogram:      u32 count u32 sum u32 max u8 n, n x (u8 bucket u32 count)
+ */
+#pragma once
+
+#include "base.h"
+#include "atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef RHS_METRIC_HISTOGRAM_BUCKETS
+#    define RHS_METRIC_HISTOGRAM_BUCKETS 64  // Values from 2^17 on share the last bucket
+#endif
+
+#define RHS_METRICS_BINARY_VERSION 1
+
+typedef enum
+{
+    RHSMetricTypeCounter,    // Monotonic, wraps at 2^32
+    RHSMetricTypeGauge,      // Signed instantaneous value
+    RHSMetricTypeHistogram,  // Distribution of recorded values
+} RHSMetricType;
+
+typedef uint32_t (*RHSMetricReadCallback)(void* context);
+
+typedef struct
+{
+    volatile uint32_t count;
+    volatile uint32_t sum;  // Wraps at 2^32
+    volatile uint32_t max;
+    volatile uint32_t buckets[RHS_METRIC_HISTOGRAM_BUCKETS];
+} RHSMetricHistogram;
+
+typedef struct RHSMetric RHSMetric;
+
+/** Metric, members are private, use RHS_METRIC_*_DEFINE or rhs_metric_init */
+struct RHSMetric
+{
+    const char*           name;
+    RHSMetricType         type;
+    volatile uint32_t     value;
+    RHSMetricHistogram*   histogram;
+    RHSMetricReadCallback read;  // Value is sampled on export, NULL if updated
+    void*                 context;
+    RHSMetric*            next;
+    bool                  registered;
+};
+
+/** Define metric, register it with rhs_metric_register */
+#define RHS_METRIC_COUNTER_DEFINE(id, metric_name) RHSMetric id = {.name = (metric_name), .type = RHSMetricTypeCounter}
+#define RHS_METRIC_GAUGE_DEFINE(id, metric_name) RHSMetric id = {.name = (metric_name), .type = RHSMetricTypeGauge}
+#define RHS_METRIC_HISTOGRAM_DEFINE(id, metric_name) \
+    static RHSMetricHistogram id##_histogram;        \
+    RHSMetric id = {.name = (metric_name), .type = RHSMetricTypeHistogram, .histogram = &id##_histogram}
+
+#define RHS_METRIC_DECLARE(id) extern RHSMetric id
+
+typedef void (*RHSMetricsWriter)(const char* data, size_t size, void* context);
+
+typedef void (*RHSMetricsCallback)(const RHSMetric* metric, void* context);
+
+/** Allocate registry lock, called by rhs_init */
+void rhs_metrics_init(void);
+
+/** Initialize metric sampled from callback on export
+ *
+ * @param[out] metric   metric to initialize
+ * @param[in]  name     metric name, must stay valid, [a-z0-9_] for Prometheus
+ * @param[in]  type     RHSMetricTypeCounter or RHSMetricTypeGauge
+ * @param[in]  read     value source, called in exporting thread
+ * @param      context  callback context
+ */
+void rhs_metric_init(RHSMetric*            metric,
+                     const char*           name,
+                     RHSMetricType         type,
+                     RHSMetricReadCallback read,
+                     void*                 context);
+
+/** Read callback for a uint32_t word, context is the word address */
+uint32_t rhs_metric_read_word(void* context);
+
+/** Add metric to registry, may be called before rhs_init
+ *
+ * @param      metric  metric, must stay valid until unregistered
+ */
+void rhs_metric_register(RHSMetric* metric);
+
+/** Remove metric from registry, waits for running export
+ *
+ * @param      metric  registered metric
+ */
+void rhs_metric_unregister(RHSMetric* metric);
+
+/** Add to counter, ISR safe
+ *
+ * @param      metric  counter
+ * @param[in]  delta   increment
+ */
+inline static void rhs_metric_add(RHSMetric* metric, uint32_t delta)
+{
+    rhs_atomic_add(&metric->value, delta);
+}
+
+/** Increment counter, ISR safe
+ *
+ * @param      metric  counter
+ */
+inline static void rhs_metric_inc(RHSMetric* metric)
+{
+    rhs_atomic_add(&metric->value, 1U);
+}
+
+/** Set gauge, ISR safe
+ *
+ * @param      metric  gauge
+ * @param[in]  value   new value
+ */
+inline static void rhs_metric_set(RHSMetric* metric, int32_t value)
+{
+    metric->value = (uint32_t) value;
+}
+
+/** Record value into histogram, ISR safe
+ *
+ * @param      metric  histogram
+ * @param[in]  value   value, usually a latency in us or cycles
+ */
+void rhs_metric_record(RHSMetric* metric, uint32_t value);
+
+/** Get current value of counter or gauge
+ *
+ * @param[in]  metric  metric
+ *
+ * @return     value, histogram sample count for histograms
+ */
+uint32_t rhs_metric_get_value(const RHSMetric* metric);
+
+/** Get histogram percentile
+ *
+ * @param[in]  metric      histogram
+ * @param[in]  percentile  0 - 100
+ *
+ * @return     lower bound of bucket holding percentile, 0 if empty
+ */
+uint32_t rhs_metric_get_percentile(const RHSMetric* metric, uint32_t percentile);
+
+/** Get lowest value counted in histogram bucket
+ *
+ * @param[in]  bucket  bucket index
+ *
+ * @return     bucket lower bound
+ */
+uint32_t rhs_metric_bucket_value(uint32_t bucket);
+
+/** Call callback for every registered metric, registry is locked meanwhile
+ *
+ * @param[in]  callback  called in this thread
+ * @param      context   callback context
+ */
+void rhs_metrics_foreach(RHSMetricsCallback callback, void* context);
+
+/** Dump all metrics and thread statistics in Prometheus text format
+ *
+ * @param[in]  writer   dump writer
+ * @param      context  writer context
+ */
+void rhs_metrics_dump(RHSMetricsWriter writer, void* context);
+
+/** Dump all metrics in binary format described above
+ *
+ * @param[in]  writer   dump writer
+ * @param      context  writer context
+ */
+void rhs_metrics_dump_binary(RHSMetricsWriter writer, void* context);
+
+#ifdef __cplusplus
+}
+#endif
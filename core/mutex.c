@@ -2,6 +2,7 @@
 #include "common.h"
 #include "memmgr.h"
 #include "check.h"
+#include "trace.h"
 
 // Internal FreeRTOS member names
 #define ucQueueType ucDummy9
@@ -95,6 +96,8 @@ RHSStatus rhs_mutex_acquire(RHSMutex* instance, uint32_t timeout)
         rhs_assert(0);
     }
 
+    RHS_TRACE_EVENT(RHSTraceEventMutexAcquire, instance, stat);
+
     return stat;
 }
 
@@ -130,6 +133,8 @@ RHSStatus rhs_mutex_release(RHSMutex* instance)
         rhs_assert(0);
     }
 
+    RHS_TRACE_EVENT(RHSTraceEventMutexRelease, instance, status);
+
     return status;
 }
 
@@ -0,0 +1,78 @@
+#include "profile.h"
+#include "check.h"
+#include "common.h"
+#include "rhs_hal_cortex.h"
+
+static RHSProfileScope* profile_scopes = NULL;
+
+static inline uint32_t rhs_profile_log2(uint32_t value)
+{
+    return value ? 31U - __builtin_clz(value) : 0U;
+}
+
+uint32_t rhs_profile_begin(void)
+{
+    return rhs_hal_cortex_get_cycles();
+}
+
+void rhs_profile_end(RHSProfileScope* scope, uint32_t start)
+{
+    const uint32_t cycles = rhs_hal_cortex_get_cycles() - start;
+
+    rhs_assert(scope);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!scope->registered)
+    {
+        scope->registered = true;
+        scope->next       = profile_scopes;
+        profile_scopes    = scope;
+    }
+
+    scope->count++;
+    scope->total += cycles;
+    if (cycles < scope->min)
+        scope->min = cycles;
+    if (cycles > scope->max)
+        scope->max = cycles;
+    scope->histogram[rhs_profile_log2(cycles)]++;
+
+    __set_PRIMASK(primask);
+}
+
+void rhs_profile_mark_end(RHSProfileMark* mark)
+{
+    rhs_profile_end(mark->scope, mark->start);
+}
+
+const RHSProfileScope* rhs_profile_get_first(void)
+{
+    return profile_scopes;
+}
+
+void rhs_profile_reset(void)
+{
+    for (RHSProfileScope* scope = profile_scopes; scope != NULL; scope = scope->next)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        scope->count = 0;
+        scope->total = 0;
+        scope->min   = UINT32_MAX;
+        scope->max   = 0;
+        for (size_t i = 0; i < RHS_PROFILE_HISTOGRAM_SIZE; i++)
+        {
+            scope->histogram[i] = 0;
+        }
+
+        __set_PRIMASK(primask);
+    }
+}
+
+uint32_t rhs_profile_get_frequency(void)
+{
+    return rhs_hal_cortex_get_cycles_frequency();
+}
@@ -0,0 +1,114 @@
+/**
+ * @file profile.h
+ * RHS cycle accurate profiling scopes
+ *
+ * Each scope is a static object placed at the point of use. Scopes register
+ * themselves on first pass and aggregate count, total, min, max and a log2
+ * histogram of duration in cycles (DWT->CYCCNT, TIM2 on Cortex-M0+).
+ *
+ * @code
+ * RHS_PROFILE_BEGIN(dispatch);
+ * canDispatch(od, &msg);
+ * RHS_PROFILE_END(dispatch);
+ *
+ * int flash_write(...)
+ * {
+ *     RHS_PROFILE_SCOPE(flash_write);
+ *     ...
+ * }
+ * @endcode
+ *
+ * Profiling is compiled in only when RHS_PROFILE is defined (cmake option
+ * RHS_PROFILE). Otherwise all RHS_PROFILE_* macros expand to nothing.
+ */
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RHS_PROFILE_HISTOGRAM_SIZE 32
+
+typedef struct RHSProfileScope RHSProfileScope;
+
+struct RHSProfileScope
+{
+    const char*      name;
+    RHSProfileScope* next;
+    bool             registered;
+    uint32_t         count;
+    uint64_t         total;
+    uint32_t         min;
+    uint32_t         max;
+    uint32_t         histogram[RHS_PROFILE_HISTOGRAM_SIZE]; /**< bucket n: [2^n, 2^(n+1)) cycles */
+};
+
+typedef struct
+{
+    RHSProfileScope* scope;
+    uint32_t         start;
+} RHSProfileMark;
+
+/** Get scope start timestamp
+ *
+ * @return     cycle counter value
+ */
+uint32_t rhs_profile_begin(void);
+
+/** Account scope pass, ISR safe
+ *
+ * @param      scope  profile scope
+ * @param[in]  start  value returned by rhs_profile_begin
+ */
+void rhs_profile_end(RHSProfileScope* scope, uint32_t start);
+
+/** Cleanup handler of RHS_PROFILE_SCOPE
+ *
+ * @param      mark  scope mark
+ */
+void rhs_profile_mark_end(RHSProfileMark* mark);
+
+/** Get first registered scope
+ *
+ * @return     scope or NULL, iterate with scope->next
+ */
+const RHSProfileScope* rhs_profile_get_first(void);
+
+/** Reset statistics of all registered scopes */
+void rhs_profile_reset(void);
+
+/** Get cycle counter frequency to convert scope values to time
+ *
+ * @return     counts per second
+ */
+uint32_t rhs_profile_get_frequency(void);
+
+#ifdef RHS_PROFILE
+#    define RHS_PROFILE_BEGIN(tag)                                                            \
+        static RHSProfileScope __rhs_profile_scope_##tag = {.name = #tag, .min = UINT32_MAX}; \
+        const uint32_t         __rhs_profile_start_##tag = rhs_profile_begin()
+#    define RHS_PROFILE_END(tag) rhs_profile_end(&__rhs_profile_scope_##tag, __rhs_profile_start_##tag)
+#    define RHS_PROFILE_SCOPE(tag)                                                                 \
+        static RHSProfileScope __rhs_profile_scope_##tag = {.name = #tag, .min = UINT32_MAX};      \
+        RHSProfileMark __rhs_profile_mark_##tag __attribute__((cleanup(rhs_profile_mark_end))) = { \
+            &__rhs_profile_scope_##tag, rhs_profile_begin()}
+#else
+#    define RHS_PROFILE_BEGIN(tag) \
+        do                         \
+        {                          \
+        } while (0)
+#    define RHS_PROFILE_END(tag) \
+        do                       \
+        {                        \
+        } while (0)
+#    define RHS_PROFILE_SCOPE(tag) \
+        do                         \
+        {                          \
+        } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+#include "queue_stats_i.h"
+#include "check.h"
+#include "common.h"
+#include "mutex.h"
+
+static RHSQueueStats* queue_stats_head  = NULL;
+static RHSMutex*      queue_stats_mutex = NULL;
+
+void rhs_queue_stats_init(void)
+{
+    queue_stats_mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
+}
+
+void rhs_queue_stats_register(RHSQueueStats*    stats,
+                              const void*       queue,
+                              RHSQueueStatsType type,
+                              uint32_t          capacity)
+{
+    rhs_assert(stats && queue);
+
+    stats->name     = NULL;
+    stats->queue    = queue;
+    stats->type     = type;
+    stats->capacity = capacity;
+    stats->peak     = 0;
+    stats->drops    = 0;
+    stats->total    = 0;
+
+    RHS_CRITICAL_ENTER();
+    stats->next      = queue_stats_head;
+    queue_stats_head = stats;
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_queue_stats_unregister(RHSQueueStats* stats)
+{
+    rhs_assert(stats);
+
+    // Queues freed before rhs_init can not race a listing
+    if (queue_stats_mutex)
+    {
+        rhs_assert(rhs_mutex_acquire(queue_stats_mutex, RHSWaitForever) == RHSStatusOk);
+    }
+
+    RHS_CRITICAL_ENTER();
+    RHSQueueStats** link = &queue_stats_head;
+    while (*link != stats)
+    {
+        rhs_assert(*link);
+        link = &(*link)->next;
+    }
+    *link = stats->next;
+    RHS_CRITICAL_EXIT();
+
+    if (queue_stats_mutex)
+    {
+        rhs_mutex_release(queue_stats_mutex);
+    }
+}
+
+void rhs_queue_stats_foreach(RHSQueueStatsCallback callback, void* context)
+{
+    rhs_assert(callback);
+    rhs_assert(queue_stats_mutex);
+
+    rhs_assert(rhs_mutex_acquire(queue_stats_mutex, RHSWaitForever) == RHSStatusOk);
+    for (const RHSQueueStats* stats = queue_stats_head; stats != NULL; stats = stats->next)
+    {
+        callback(stats, context);
+    }
+    rhs_mutex_release(queue_stats_mutex);
+}
+
+void rhs_queue_stats_reset(void)
+{
+    rhs_assert(queue_stats_mutex);
+
+    rhs_assert(rhs_mutex_acquire(queue_stats_mutex, RHSWaitForever) == RHSStatusOk);
+    for (RHSQueueStats* stats = queue_stats_head; stats != NULL; stats = stats->next)
+    {
+        rhs_atomic_exchange(&stats->peak, 0U);
+        rhs_atomic_exchange(&stats->drops, 0U);
+        rhs_atomic_exchange(&stats->total, 0U);
+    }
+    rhs_mutex_release(queue_stats_mutex);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file queue_stats.h
+ * RHS queue statistics
+ *
+ * With RHS_QUEUE_STATS defined (cmake option RHS_QUEUE_STATS) every
+ * RHSMessageQueue and RHSStreamBuffer counts items moved, failed puts and
+ * its peak fill level. Message queues count messages, stream buffers bytes.
+ * A put that moves nothing, or a stream buffer send that is cut short, is a
+ * drop. Name a queue with rhs_message_queue_set_name or
+ * rhs_stream_buffer_set_name to find it in the `queues` CLI listing.
+ *
+ * Without RHS_QUEUE_STATS nothing is counted and the registry is empty.
+ */
+#pragma once
+
+#include "base.h"
+#include "atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    RHSQueueStatsTypeMessageQueue,
+    RHSQueueStatsTypeStreamBuffer,
+} RHSQueueStatsType;
+
+typedef struct RHSQueueStats RHSQueueStats;
+
+struct RHSQueueStats
+{
+    const char*       name;  // NULL if not named
+    const void*       queue;
+    RHSQueueStatsType type;
+    uint32_t          capacity;  // Messages or bytes
+    volatile uint32_t peak;      // Highest fill level after a put
+    volatile uint32_t drops;     // Failed puts
+    volatile uint32_t total;     // Messages or bytes put
+    RHSQueueStats*    next;
+};
+
+typedef void (*RHSQueueStatsCallback)(const RHSQueueStats* stats, void* context);
+
+/** Allocate registry lock, called by rhs_init */
+void rhs_queue_stats_init(void);
+
+/** Call callback for every queue, registry is locked meanwhile
+ *
+ * @param[in]  callback  called in this thread
+ * @param      context   callback context
+ */
+void rhs_queue_stats_foreach(RHSQueueStatsCallback callback, void* context);
+
+/** Clear peak, drops and total of every queue */
+void rhs_queue_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file queue_stats_i.h
+ * RHS queue statistics hooks for RHSMessageQueue and RHSStreamBuffer
+ */
+#pragma once
+
+#include "queue_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Add queue to registry, may be called before rhs_init */
+void rhs_queue_stats_register(RHSQueueStats*    stats,
+                              const void*       queue,
+                              RHSQueueStatsType type,
+                              uint32_t          capacity);
+
+/** Remove queue from registry, waits for running listing */
+void rhs_queue_stats_unregister(RHSQueueStats* stats);
+
+/** Account put, ISR safe
+ *
+ * @param      stats    queue statistics
+ * @param[in]  moved    messages or bytes put
+ * @param[in]  dropped  true if the put failed or was cut short
+ * @param[in]  level    fill level after the put
+ */
+inline static void rhs_queue_stats_put(RHSQueueStats* stats, uint32_t moved, bool dropped, uint32_t level)
+{
+    if (moved != 0U)
+    {
+        rhs_atomic_add(&stats->total, moved);
+        rhs_atomic_max(&stats->peak, level);
+    }
+    if (dropped)
+    {
+        rhs_atomic_add(&stats->drops, 1U);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,7 +2,11 @@
 #include "check.h"
 #include "mutex.h"
 #include "event_flag.h"
+#include "boot.h"
+#include "atomic.h"
 
+#include <cmsis_compiler.h>
+#include <string.h>
 #include <m-dict.h>
 #include "m_cstr_dup.h"
 
@@ -21,6 +25,7 @@ typedef struct
 {
     RHSMutex*           mutex;
     RHSRecordDataDict_t records;
+    RHSRecordId*        ids;  // Ids created at least once, for named lookups
 } RHSRecord;
 
 static RHSRecord* rhs_record = NULL;
@@ -46,6 +51,7 @@ void rhs_record_init(void)
     rhs_record        = malloc(sizeof(RHSRecord));
     rhs_record->mutex = rhs_mutex_alloc(RHSMutexTypeNormal);
     RHSRecordDataDict_init(rhs_record->records);
+    rhs_record->ids = NULL;
 }
 
 static RHSRecordData* rhs_record_data_get_or_create(const char* name)
@@ -64,6 +70,18 @@ static RHSRecordData* rhs_record_data_get_or_create(const char* name)
     return record_data;
 }
 
+static RHSRecordId* rhs_record_find_id(const char* name)
+{
+    for (RHSRecordId* id = rhs_record->ids; id != NULL; id = id->next)
+    {
+        if (strcmp(id->name, name) == 0)
+        {
+            return id;
+        }
+    }
+    return NULL;
+}
+
 static void rhs_record_lock(void)
 {
     rhs_assert(rhs_mutex_acquire(rhs_record->mutex, RHSWaitForever) == RHSStatusOk);
@@ -82,7 +100,8 @@ bool rhs_record_exists(const char* name)
     bool ret = false;
 
     rhs_record_lock();
-    ret = (rhs_record_get(name) != NULL);
+    RHSRecordId* id = rhs_record_find_id(name);
+    ret             = (rhs_record_get(name) != NULL) || (id && rhs_record_id_exists(id));
     rhs_record_unlock();
 
     return ret;
@@ -94,6 +113,8 @@ void rhs_record_create(const char* name, void* data)
     rhs_assert(name);
     rhs_assert(data);
 
+    const uint32_t start = rhs_boot_begin();
+
     rhs_record_lock();
 
     // Get record data and fill it
@@ -103,6 +124,8 @@ void rhs_record_create(const char* name, void* data)
     rhs_event_flag_set(record_data->flags, RHS_RECORD_FLAG_READY);
 
     rhs_record_unlock();
+
+    rhs_boot_mark(RHSBootEventTypeRecord, name, start);
 }
 
 bool rhs_record_destroy(const char* name)
@@ -114,6 +137,13 @@ bool rhs_record_destroy(const char* name)
 
     rhs_record_lock();
 
+    RHSRecordId* id = rhs_record_find_id(name);
+    if (id && (rhs_record_get(name) == NULL || rhs_record_id_exists(id)))
+    {
+        rhs_record_unlock();
+        return rhs_record_id_destroy(id);
+    }
+
     RHSRecordData* record_data = rhs_record_get(name);
     rhs_assert(record_data);
     if (record_data->holders_count == 0)
@@ -134,6 +164,14 @@ void* rhs_record_open(const char* name)
 
     rhs_record_lock();
 
+    // Records created by id are opened lock-free unless someone already waits by name
+    RHSRecordId* id = rhs_record_find_id(name);
+    if (id && rhs_record_get(name) == NULL)
+    {
+        rhs_record_unlock();
+        return rhs_record_id_open(id);
+    }
+
     RHSRecordData* record_data = rhs_record_data_get_or_create(name);
     record_data->holders_count++;
 
@@ -156,8 +194,167 @@ void rhs_record_close(const char* name)
     rhs_record_lock();
 
     RHSRecordData* record_data = rhs_record_get(name);
-    rhs_assert(record_data);
+    if (record_data == NULL)
+    {
+        RHSRecordId* id = rhs_record_find_id(name);
+        rhs_assert(id);
+        rhs_record_unlock();
+        rhs_record_id_close(id);
+        return;
+    }
     record_data->holders_count--;
 
     rhs_record_unlock();
 }
+
+static bool rhs_record_id_cas(RHSRecordId* id, uint32_t expected, uint32_t desired)
+{
+    return rhs_atomic_cas(&id->holders, expected, desired);
+}
+
+static bool rhs_record_id_acquire(RHSRecordId* id)
+{
+    for (;;)
+    {
+        uint32_t holders = id->holders;
+        if (holders & RHS_RECORD_ID_CLOSED)
+        {
+            return false;
+        }
+        if (rhs_record_id_cas(id, holders, holders + 1U))
+        {
+            return true;
+        }
+    }
+}
+
+static RHSEventFlag* rhs_record_id_get_flags(RHSRecordId* id)
+{
+    if (id->flags == NULL)
+    {
+        id->flags = rhs_event_flag_alloc();
+    }
+    return id->flags;
+}
+
+void rhs_record_id_create(RHSRecordId* id, void* data)
+{
+    rhs_assert(rhs_record);
+    rhs_assert(id && id->name);
+    rhs_assert(data);
+
+    const uint32_t start = rhs_boot_begin();
+
+    rhs_record_lock();
+
+    rhs_assert(id->holders == RHS_RECORD_ID_CLOSED);
+    id->data = data;
+    if (!id->listed)
+    {
+        id->listed      = true;
+        id->next        = rhs_record->ids;
+        rhs_record->ids = id;
+    }
+
+    // Publish data before opening the record for lock-free holders
+    __DMB();
+    id->holders = 0;
+
+    // Threads that opened by name before creation
+    RHSRecordData* record_data = rhs_record_get(id->name);
+    if (record_data)
+    {
+        record_data->data = data;
+        rhs_event_flag_set(record_data->flags, RHS_RECORD_FLAG_READY);
+    }
+
+    if (id->flags)
+    {
+        rhs_event_flag_set(id->flags, RHS_RECORD_FLAG_READY);
+    }
+
+    rhs_record_unlock();
+
+    rhs_boot_mark(RHSBootEventTypeRecord, id->name, start);
+}
+
+bool rhs_record_id_destroy(RHSRecordId* id)
+{
+    rhs_assert(rhs_record);
+    rhs_assert(id);
+
+    bool ret = false;
+
+    rhs_record_lock();
+
+    RHSRecordData* record_data = rhs_record_get(id->name);
+    if ((record_data == NULL || record_data->holders_count == 0) && rhs_record_id_cas(id, 0, RHS_RECORD_ID_CLOSED))
+    {
+        if (record_data)
+        {
+            rhs_record_erase(id->name, record_data);
+        }
+        if (id->flags)
+        {
+            rhs_event_flag_clear(id->flags, RHS_RECORD_FLAG_READY);
+        }
+        id->data = NULL;
+        ret      = true;
+    }
+
+    rhs_record_unlock();
+
+    return ret;
+}
+
+void* rhs_record_id_open(RHSRecordId* id)
+{
+    rhs_assert(id);
+
+    while (!rhs_record_id_acquire(id))
+    {
+        // Creation sets the flag under the same lock, so it cannot be missed
+        rhs_assert(rhs_record);
+        rhs_record_lock();
+        RHSEventFlag* flags  = rhs_record_id_get_flags(id);
+        const bool    closed = (id->holders & RHS_RECORD_ID_CLOSED) != 0U;
+        rhs_record_unlock();
+
+        if (closed)
+        {
+            rhs_assert(rhs_event_flag_wait(flags,
+                                           RHS_RECORD_FLAG_READY,
+                                           RHSFlagWaitAny | RHSFlagNoClear,
+                                           RHSWaitForever) == RHS_RECORD_FLAG_READY);
+        }
+    }
+
+    return id->data;
+}
+
+void rhs_record_id_close(RHSRecordId* id)
+{
+    rhs_assert(id);
+
+    for (;;)
+    {
+        uint32_t holders = id->holders;
+        rhs_assert(holders != 0U && (holders & RHS_RECORD_ID_CLOSED) == 0U);
+        if (rhs_record_id_cas(id, holders, holders - 1U))
+        {
+            return;
+        }
+    }
+}
+
+bool rhs_record_id_exists(RHSRecordId* id)
+{
+    rhs_assert(id);
+    return (id->holders & RHS_RECORD_ID_CLOSED) == 0U;
+}
+
+const char* rhs_record_id_get_name(RHSRecordId* id)
+{
+    rhs_assert(id);
+    return id->name;
+}
@@ -1,17 +1,46 @@
 /**
  * @file record.h
  * RHS: record API
+ *
+ * Records are looked up either by name or by a static RHSRecordId. Ids are
+ * defined once with RHS_RECORD_DEFINE, need no heap and once the record is
+ * created open and close are a lock-free holder count update. Named lookups
+ * also find records created through an id, the name is used for that and for
+ * diagnostics only.
  */
 
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "defines.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct RHSRecordId RHSRecordId;
+
+/** Static record descriptor, members are private */
+struct RHSRecordId
+{
+    const char*       name;
+    void* volatile    data;
+    volatile uint32_t holders;  // Holder count or RHS_RECORD_ID_CLOSED
+    void* volatile    flags;    // RHSEventFlag, allocated on first blocking open
+    bool              listed;   // Linked into registry for named lookups
+    RHSRecordId*      next;
+};
+
+#define RHS_RECORD_ID_CLOSED (0x80000000UL)
+
+/** Define record id, must have static storage duration */
+#define RHS_RECORD_DEFINE(id, record_name) \
+    RHSRecordId id = {.name = (record_name), .holders = RHS_RECORD_ID_CLOSED}
+
+/** Declare record id defined elsewhere */
+#define RHS_RECORD_DECLARE(id) extern RHSRecordId id
+
 /** Initialize record storage For internal use only.
  */
 void rhs_record_init(void);
@@ -62,6 +91,56 @@ __attribute__((returns_nonnull)) void* rhs_record_open(const char* name);
  */
 void rhs_record_close(const char* name);
 
+/** Create record by id
+ *
+ * @param      id    record id
+ * @param      data  data pointer (not NULL)
+ * @note       Thread safe. Wakes threads blocked in rhs_record_id_open.
+ */
+void rhs_record_id_create(RHSRecordId* id, void* data);
+
+/** Destroy record by id
+ *
+ * @param      id    record id
+ *
+ * @return     true if successful, false if still have holders
+ * @note       Thread safe
+ */
+bool rhs_record_id_destroy(RHSRecordId* id);
+
+/** Open record by id
+ *
+ * Lock-free once the record is created, otherwise suspends caller thread till
+ * record is available.
+ *
+ * @param      id    record id
+ *
+ * @return     pointer to the record
+ */
+__attribute__((returns_nonnull)) void* rhs_record_id_open(RHSRecordId* id);
+
+/** Close record by id, lock-free and ISR safe
+ *
+ * @param      id    record id
+ */
+void rhs_record_id_close(RHSRecordId* id);
+
+/** Check if record is created, lock-free
+ *
+ * @param      id    record id
+ *
+ * @return     true if created
+ */
+bool rhs_record_id_exists(RHSRecordId* id);
+
+/** Get record name
+ *
+ * @param      id    record id
+ *
+ * @return     name given to RHS_RECORD_DEFINE
+ */
+const char* rhs_record_id_get_name(RHSRecordId* id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,261 @@
+#include "retained.h"
+#include "check.h"
+#include "common.h"
+#include "log.h"
+
+#include <string.h>
+
+#if defined(STM32F765xx)
+#    include "stm32f7xx.h"
+#elif defined(STM32F407xx) || defined(STM32F405xx)
+#    include "stm32f4xx.h"
+#elif defined(STM32F103xE)
+#    include "stm32f1xx.h"
+#elif defined(STM32G0B1xx)
+#    include "stm32g0xx.h"
+#endif
+
+#define TAG "Retained"
+
+#define RETAINED_MAGIC 0x52455441UL  // "RETA"
+#define RETAINED_ALIGN 8U
+
+// Layout changes of the descriptor make retained RAM of older firmware invalid
+#define RETAINED_LAYOUT ((uint32_t) sizeof(RHSRetainedDescriptor) ^ ((uint32_t) RHS_RETAINED_SIZE << 16))
+
+typedef struct
+{
+    char     name[RHS_RETAINED_NAME_SIZE];
+    uint16_t offset;
+    uint16_t size;
+    uint32_t crc;  // Of committed blob content
+} RHSRetainedEntry;
+
+typedef struct
+{
+    uint32_t         magic;
+    uint32_t         layout;
+    uint32_t         restarts;    // Warm boots since last rhs_retained_set_stable
+    uint32_t         warm_boots;  // Warm boots since last cold boot
+    uint32_t         count;
+    uint32_t         used;        // Bytes of data taken by blobs
+    RHSRetainedEntry entries[RHS_RETAINED_ENTRIES];
+    uint32_t         crc;         // Of all fields above, MUST be last
+} RHSRetainedDescriptor;
+
+static RHSRetainedDescriptor retained_descriptor RHS_RETAINED_SECTION;
+static uint8_t               retained_data[RHS_RETAINED_SIZE] RHS_RETAINED_SECTION __attribute__((aligned(RETAINED_ALIGN)));
+
+static bool retained_warm = false;
+
+// Nibble table CRC-32, small enough for M0+ and fast enough for critical sections
+static uint32_t rhs_retained_crc(const void* data, size_t size)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    const uint8_t* byte = data;
+    uint32_t       crc  = 0xFFFFFFFFUL;
+    while (size--)
+    {
+        crc ^= *byte++;
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+    }
+    return ~crc;
+}
+
+static uint32_t rhs_retained_descriptor_crc(void)
+{
+    return rhs_retained_crc(&retained_descriptor, offsetof(RHSRetainedDescriptor, crc));
+}
+
+// Watchdog reset does not write back dirty cache lines
+static void rhs_retained_clean(void* data, size_t size)
+{
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    if (SCB->CCR & SCB_CCR_DC_Msk)
+    {
+        SCB_CleanDCache_by_Addr((uint32_t*) data, (int32_t) size);
+    }
+#else
+    (void) data;
+    (void) size;
+#endif
+}
+
+// Must be called in critical section
+static void rhs_retained_seal(void)
+{
+    retained_descriptor.crc = rhs_retained_descriptor_crc();
+    rhs_retained_clean(&retained_descriptor, sizeof(retained_descriptor));
+}
+
+static void rhs_retained_reset(void)
+{
+    memset(&retained_descriptor, 0, sizeof(retained_descriptor));
+    memset(retained_data, 0, sizeof(retained_data));
+    retained_descriptor.magic  = RETAINED_MAGIC;
+    retained_descriptor.layout = RETAINED_LAYOUT;
+}
+
+static bool rhs_retained_is_valid(void)
+{
+    if (retained_descriptor.magic != RETAINED_MAGIC || retained_descriptor.layout != RETAINED_LAYOUT ||
+        retained_descriptor.crc != rhs_retained_descriptor_crc())
+    {
+        return false;
+    }
+    if (retained_descriptor.count > RHS_RETAINED_ENTRIES || retained_descriptor.used > RHS_RETAINED_SIZE)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < retained_descriptor.count; i++)
+    {
+        const RHSRetainedEntry* entry = &retained_descriptor.entries[i];
+        if ((uint32_t) entry->offset + entry->size > retained_descriptor.used)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void rhs_retained_init(void)
+{
+    retained_warm = rhs_retained_is_valid();
+
+    if (retained_warm && retained_descriptor.restarts >= RHS_RETAINED_MAX_RESTARTS)
+    {
+        RHS_LOG_W(TAG, "%lu warm boots in a row, dropping retained state", retained_descriptor.restarts);
+        retained_warm = false;
+    }
+
+    if (retained_warm)
+    {
+        retained_descriptor.restarts++;
+        retained_descriptor.warm_boots++;
+        RHS_LOG_I(TAG, "Warm boot %lu, %lu blobs", retained_descriptor.warm_boots, retained_descriptor.count);
+    }
+    else
+    {
+        rhs_retained_reset();
+    }
+
+    RHS_CRITICAL_ENTER();
+    rhs_retained_seal();
+    RHS_CRITICAL_EXIT();
+}
+
+static RHSRetainedEntry* rhs_retained_find(const char* name)
+{
+    for (size_t i = 0; i < retained_descriptor.count; i++)
+    {
+        if (strncmp(retained_descriptor.entries[i].name, name, RHS_RETAINED_NAME_SIZE) == 0)
+        {
+            return &retained_descriptor.entries[i];
+        }
+    }
+    return NULL;
+}
+
+void* rhs_retained_get(const char* name, size_t size, bool* restored)
+{
+    rhs_assert(name && strlen(name) < RHS_RETAINED_NAME_SIZE);
+    rhs_assert(size > 0U);
+
+    bool is_restored = false;
+
+    RHS_CRITICAL_ENTER();
+
+    RHSRetainedEntry* entry = rhs_retained_find(name);
+    if (entry && entry->size == size)
+    {
+        is_restored = (rhs_retained_crc(&retained_data[entry->offset], size) == entry->crc);
+    }
+    else
+    {
+        // New blob, or firmware changed its size: take fresh space until next cold boot
+        const uint32_t offset = (retained_descriptor.used + RETAINED_ALIGN - 1U) & ~(RETAINED_ALIGN - 1U);
+        rhs_assert(offset + size <= RHS_RETAINED_SIZE);
+        if (entry == NULL)
+        {
+            rhs_assert(retained_descriptor.count < RHS_RETAINED_ENTRIES);
+            entry = &retained_descriptor.entries[retained_descriptor.count++];
+            strncpy(entry->name, name, RHS_RETAINED_NAME_SIZE);
+        }
+        entry->offset            = (uint16_t) offset;
+        entry->size              = (uint16_t) size;
+        retained_descriptor.used = offset + size;
+    }
+
+    void* blob = &retained_data[entry->offset];
+    if (!is_restored)
+    {
+        memset(blob, 0, size);
+        entry->crc = rhs_retained_crc(blob, size);
+    }
+    rhs_retained_seal();
+
+    RHS_CRITICAL_EXIT();
+
+    if (restored)
+    {
+        *restored = is_restored;
+    }
+
+    return blob;
+}
+
+void rhs_retained_commit(void* blob)
+{
+    const uint8_t* data = blob;
+    rhs_assert(data >= retained_data && data < retained_data + RHS_RETAINED_SIZE);
+
+    RHS_CRITICAL_ENTER();
+
+    RHSRetainedEntry* entry = NULL;
+    for (size_t i = 0; i < retained_descriptor.count; i++)
+    {
+        if (&retained_data[retained_descriptor.entries[i].offset] == data)
+        {
+            entry = &retained_descriptor.entries[i];
+            break;
+        }
+    }
+    rhs_assert(entry);
+
+    entry->crc = rhs_retained_crc(data, entry->size);
+    rhs_retained_clean(blob, entry->size);
+    rhs_retained_seal();
+
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_retained_invalidate(void)
+{
+    RHS_CRITICAL_ENTER();
+    retained_descriptor.magic = 0;
+    rhs_retained_seal();
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_retained_set_stable(void)
+{
+    RHS_CRITICAL_ENTER();
+    retained_descriptor.restarts = 0;
+    rhs_retained_seal();
+    RHS_CRITICAL_EXIT();
+}
+
+bool rhs_retained_is_warm(void)
+{
+    return retained_warm;
+}
+
+uint32_t rhs_retained_get_warm_boots(void)
+{
+    return retained_descriptor.warm_boots;
+}
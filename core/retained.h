@@ -0,0 +1,95 @@
+/**
+ * @file retained.h
+ * RHS retained RAM
+ *
+ * State blobs that survive a soft reset (rhs_hal_power_reset, crash, watchdog)
+ * so services can restart without expensive re-configuration. Blobs live in
+ * a `.noinit` region that startup code does not clear. A CRC-guarded
+ * descriptor lists them by name, and every blob has its own CRC. After power
+ * loss, or when anything does not match, the boot is cold and all blobs start
+ * zeroed.
+ *
+ * Linker script must place `.noinit` in RAM as NOLOAD, outside of `.bss`:
+ *
+ *     .noinit (NOLOAD) : { *(.noinit*) } >RAM
+ *
+ * RHS_RETAINED_LINK_CHECK fails the link when it does not, see core/retained.ld.
+ *
+ * Warm boots in a row are limited by RHS_RETAINED_MAX_RESTARTS, so state that
+ * makes the system crash is dropped instead of restored forever.
+ */
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef RHS_RETAINED_SIZE
+#    define RHS_RETAINED_SIZE 1024  // Bytes for all blobs
+#endif
+
+#ifndef RHS_RETAINED_ENTRIES
+#    define RHS_RETAINED_ENTRIES 8
+#endif
+
+#ifndef RHS_RETAINED_MAX_RESTARTS
+#    define RHS_RETAINED_MAX_RESTARTS 3  // Warm boots without rhs_retained_set_stable
+#endif
+
+#ifndef RHS_RETAINED_STABLE_MS
+#    define RHS_RETAINED_STABLE_MS 10000  // Uptime after which loader calls rhs_retained_set_stable
+#endif
+
+#ifndef RHS_RETAINED_SECTION
+#    define RHS_RETAINED_SECTION __attribute__((section(".noinit")))
+#endif
+
+#define RHS_RETAINED_NAME_SIZE 16
+
+/** Validate retained RAM, called by rhs_init */
+void rhs_retained_init(void);
+
+/** Get retained blob, creating it on first call after cold boot
+ *
+ * Blob content is only restored if it was committed before reset and the
+ * size did not change.
+ *
+ * @param[in]  name      blob name, shorter than RHS_RETAINED_NAME_SIZE
+ * @param[in]  size      blob size
+ * @param[out] restored  true if blob holds state from before reset, may be NULL
+ *
+ * @return     pointer to blob in retained RAM, zeroed if not restored
+ */
+void* rhs_retained_get(const char* name, size_t size, bool* restored);
+
+/** Make current blob content the one restored on warm boot, ISR safe
+ *
+ * Blob changed after the last commit is dropped on reset.
+ *
+ * @param      blob  pointer returned by rhs_retained_get
+ */
+void rhs_retained_commit(void* blob);
+
+/** Drop all blobs, next boot is cold */
+void rhs_retained_invalidate(void);
+
+/** Reset warm boot limit, system is considered stable */
+void rhs_retained_set_stable(void);
+
+/** Check if retained state was restored
+ *
+ * @return     true on warm boot
+ */
+bool rhs_retained_is_warm(void);
+
+/** Get warm boots since last cold boot
+ *
+ * @return     warm boot count
+ */
+uint32_t rhs_retained_get_warm_boots(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+#include "rpc.h"
+#include "check.h"
+#include "common.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define RPC_NOTIFY_INDEX (2)  // Index 0 is used for stream buffers, 1 for thread flags
+
+void rhs_rpc_init(RHSRpc* rpc)
+{
+    rhs_assert(rpc);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    rpc->caller = (RHSThreadId) xTaskGetCurrentTaskHandle();
+    rpc->result = 0;
+
+#ifdef RHS_RPC_SEMAPHORE
+    rhs_assert(xSemaphoreCreateBinaryStatic(&rpc->done) != NULL);
+#else
+    // Drop completion left from a call that timed out or was never waited
+    (void) xTaskNotifyStateClearIndexed(NULL, RPC_NOTIFY_INDEX);
+    (void) ulTaskNotifyValueClearIndexed(NULL, RPC_NOTIFY_INDEX, UINT32_MAX);
+#endif
+}
+
+int32_t rhs_rpc_wait(RHSRpc* rpc)
+{
+    rhs_assert(rpc);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+    rhs_assert(rpc->caller == (RHSThreadId) xTaskGetCurrentTaskHandle());
+
+#ifdef RHS_RPC_SEMAPHORE
+    while (xSemaphoreTake((SemaphoreHandle_t) &rpc->done, portMAX_DELAY) != pdTRUE)
+    {
+    }
+    vSemaphoreDelete((SemaphoreHandle_t) &rpc->done);
+#else
+    while (ulTaskNotifyTakeIndexed(RPC_NOTIFY_INDEX, pdTRUE, portMAX_DELAY) == 0)
+    {
+    }
+#endif
+
+    return rpc->result;
+}
+
+void rhs_rpc_complete(RHSRpc* rpc, int32_t result)
+{
+    rhs_assert(rpc);
+
+#ifdef RHS_RPC_SEMAPHORE
+    // Give leaves the semaphore before the woken caller runs and deletes it
+    rpc->result = result;
+
+    if (RHS_IS_IRQ_MODE())
+    {
+        BaseType_t yield = pdFALSE;
+        (void) xSemaphoreGiveFromISR((SemaphoreHandle_t) &rpc->done, &yield);
+        portYIELD_FROM_ISR(yield);
+    }
+    else
+    {
+        (void) xSemaphoreGive((SemaphoreHandle_t) &rpc->done);
+    }
+#else
+    // Caller may leave the scope of rpc as soon as it is notified
+    TaskHandle_t caller = (TaskHandle_t) rpc->caller;
+    rpc->result         = result;
+
+    if (RHS_IS_IRQ_MODE())
+    {
+        BaseType_t yield = pdFALSE;
+        vTaskNotifyGiveIndexedFromISR(caller, RPC_NOTIFY_INDEX, &yield);
+        portYIELD_FROM_ISR(yield);
+    }
+    else
+    {
+        (void) xTaskNotifyGiveIndexed(caller, RPC_NOTIFY_INDEX);
+    }
+#endif
+}
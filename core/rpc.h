@@ -0,0 +1,81 @@
+/**
+ * @file rpc.h
+ * RHS synchronous cross-thread call
+ *
+ * Lightweight replacement for api_lock: the request lives on the caller stack
+ * and completion is signaled through the caller task notification, so a call
+ * costs no heap operations and no kernel object.
+ *
+ * @code
+ * // caller
+ * RHSRpc         rpc;
+ * ServiceMessage msg = {.rpc = &rpc, ...};
+ * rhs_rpc_init(&rpc);
+ * rhs_message_queue_put(service->queue, &msg, RHSWaitForever);
+ * int32_t result = rhs_rpc_wait(&rpc);
+ *
+ * // service thread
+ * rhs_rpc_complete(msg.rpc, result);
+ * @endcode
+ *
+ * Uses task notification index 2 (0 is used by stream buffers, 1 by thread
+ * flags) when configTASK_NOTIFICATION_ARRAY_ENTRIES is at least 3. With fewer
+ * entries RHSRpc carries a static binary semaphore instead, still no heap.
+ */
+#pragma once
+
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include "base.h"
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES < 3
+#    define RHS_RPC_SEMAPHORE  // No free notification index, completion goes through done
+#endif
+
+typedef struct
+{
+    RHSThreadId      caller;
+    volatile int32_t result;
+#ifdef RHS_RPC_SEMAPHORE
+    StaticSemaphore_t done;
+#endif
+} RHSRpc;
+
+/** Prepare call on behalf of current thread
+ *
+ * Must be called before the request becomes visible to the callee.
+ *
+ * @warning    Cannot be used from ISR
+ *
+ * @param[out] rpc   call context, usually on caller stack
+ */
+void rhs_rpc_init(RHSRpc* rpc);
+
+/** Wait for call completion
+ *
+ * @warning    Cannot be used from ISR
+ *
+ * @param      rpc   call context
+ *
+ * @return     value passed to rhs_rpc_complete
+ */
+int32_t rhs_rpc_wait(RHSRpc* rpc);
+
+/** Complete call and wake up caller
+ *
+ * ISR safe. rpc must not be accessed after this call, it may already be out
+ * of scope.
+ *
+ * @param      rpc     call context
+ * @param[in]  result  return value for caller
+ */
+void rhs_rpc_complete(RHSRpc* rpc, int32_t result);
+
+#ifdef __cplusplus
+}
+#endif
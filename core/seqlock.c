@@ -0,0 +1,48 @@
+#include "seqlock.h"
+#include "check.h"
+#include "kernel.h"
+
+// Retries before a thread reader yields the CPU to a preempted writer
+#define SEQLOCK_SPIN_COUNT 16U
+
+void rhs_seqlock_read(const RHSSeqlock* lock, void* dst, const volatile void* src, size_t size)
+{
+    rhs_assert(lock && dst && src);
+
+    uint8_t*                out  = dst;
+    const volatile uint8_t* in   = src;
+    uint32_t                spin = 0;
+    uint32_t                sequence;
+
+    for (;;)
+    {
+        sequence = lock->sequence;
+        if ((sequence & 1U) == 0U)
+        {
+            __DMB();
+            for (size_t i = 0; i < size; i++)
+            {
+                out[i] = in[i];
+            }
+            __DMB();
+            if (lock->sequence == sequence)
+            {
+                return;
+            }
+            // A writer that preempted the copy has finished, retry
+            continue;
+        }
+
+        // Writer is active and this reader interrupted it
+        if (rhs_kernel_is_irq_or_masked())
+        {
+            rhs_crash("Seqlock read preempted its writer");
+        }
+        if (++spin >= SEQLOCK_SPIN_COUNT)
+        {
+            // Writer is a lower priority thread, give it the CPU
+            rhs_delay_tick(1);
+            spin = 0;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file seqlock.h
+ * RHS sequence lock
+ *
+ * Consistent snapshots of a struct that one writer updates, usually an ISR,
+ * while any number of readers copy it. The writer never waits and interrupts
+ * are never masked. A reader retries its copy if the writer was active.
+ *
+ * There must be only one writer at a time. Fields with several writers in
+ * different contexts are atomic counters instead, see atomic.h.
+ *
+ * A thread reader may preempt the writer, it waits a tick for a lower priority
+ * writer to finish. An ISR reader, or a reader with interrupts masked, must
+ * not preempt the writer: the writer can not run until the reader returns.
+ * That is a misuse and crashes. Read data written by a thread from threads
+ * only, and data written by an ISR from threads or from ISRs that the writer
+ * can not be interrupted by.
+ */
+#pragma once
+
+#include "base.h"
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    volatile uint32_t sequence;  // Odd while writer is active
+} RHSSeqlock;
+
+#define RHS_SEQLOCK_INIT {0}
+
+/** Start update of protected data, ISR safe
+ *
+ * @param      lock  pointer to RHSSeqlock
+ */
+inline static void rhs_seqlock_write_begin(RHSSeqlock* lock)
+{
+    lock->sequence = lock->sequence + 1U;
+    __DMB();
+}
+
+/** Finish update of protected data, ISR safe
+ *
+ * @param      lock  pointer to RHSSeqlock
+ */
+inline static void rhs_seqlock_write_end(RHSSeqlock* lock)
+{
+    __DMB();
+    lock->sequence = lock->sequence + 1U;
+}
+
+/** Copy consistent snapshot of protected data
+ *
+ * Waits a tick in thread context while a lower priority writer is active.
+ * Crashes in an ISR or with interrupts masked if the writer was interrupted.
+ *
+ * @param      lock  pointer to RHSSeqlock
+ * @param[out] dst   snapshot
+ * @param[in]  src   protected data
+ * @param[in]  size  size of protected data
+ */
+void rhs_seqlock_read(const RHSSeqlock* lock, void* dst, const volatile void* src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,6 +2,8 @@
 #include "common.h"
 #include "memmgr.h"
 #include "check.h"
+#include "wait_set_i.h"
+#include "queue_stats_i.h"
 
 #include <FreeRTOS.h>
 #include "stream_buffer.h"
@@ -11,8 +13,12 @@
 
 struct RHSStreamBuffer
 {
-    StaticStreamBuffer_t container;
-    uint8_t              buffer[];
+    StaticStreamBuffer_t   container;
+    RHSSemaphore* volatile wait_set_proxy;
+#ifdef RHS_QUEUE_STATS
+    RHSQueueStats stats;
+#endif
+    uint8_t buffer[];
 };
 
 // IMPORTANT: container MUST be the FIRST struct member
@@ -32,6 +38,10 @@ RHSStreamBuffer* rhs_stream_buffer_alloc(uint16_t size, uint16_t trigger_level)
         xStreamBufferCreateStatic(buffer_size, trigger_level, stream_buffer->buffer, &stream_buffer->container);
 
     rhs_assert(hStreamBuffer == (StreamBufferHandle_t) stream_buffer);
+    stream_buffer->wait_set_proxy = NULL;
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_register(&stream_buffer->stats, stream_buffer, RHSQueueStatsTypeStreamBuffer, size);
+#endif
 
     return stream_buffer;
 }
@@ -39,6 +49,9 @@ RHSStreamBuffer* rhs_stream_buffer_alloc(uint16_t size, uint16_t trigger_level)
 void rhs_stream_buffer_free(RHSStreamBuffer* stream_buffer)
 {
     rhs_assert(stream_buffer);
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_unregister(&stream_buffer->stats);
+#endif
     vStreamBufferDelete((StreamBufferHandle_t) stream_buffer);
     free(stream_buffer);
 }
@@ -72,9 +85,32 @@ uint16_t rhs_stream_buffer_send(RHSStreamBuffer* stream_buffer, const void* data
         ret = xStreamBufferSend((StreamBufferHandle_t) stream_buffer, data, length, timeout);
     }
 
+#ifdef RHS_QUEUE_STATS
+    rhs_queue_stats_put(&stream_buffer->stats,
+                        ret,
+                        ret < length,
+                        xStreamBufferBytesAvailable((StreamBufferHandle_t) stream_buffer));
+#endif
+
+    RHSSemaphore* proxy = stream_buffer->wait_set_proxy;
+    if (ret && proxy)
+    {
+        (void) rhs_semaphore_release(proxy);
+    }
+
     return ret;
 }
 
+void rhs_stream_buffer_set_name(RHSStreamBuffer* stream_buffer, const char* name)
+{
+    rhs_assert(stream_buffer);
+#ifdef RHS_QUEUE_STATS
+    stream_buffer->stats.name = name;
+#else
+    (void) name;
+#endif
+}
+
 uint16_t rhs_stream_buffer_receive(RHSStreamBuffer* stream_buffer, void* data, uint16_t length, uint32_t timeout)
 {
     rhs_assert(stream_buffer);
@@ -140,3 +176,10 @@ RHSStatus rhs_stream_buffer_reset(RHSStreamBuffer* stream_buffer)
 
     return status;
 }
+
+void rhs_stream_buffer_set_wait_set_proxy(RHSStreamBuffer* stream_buffer, RHSSemaphore* proxy)
+{
+    rhs_assert(stream_buffer);
+    rhs_assert(proxy == NULL || stream_buffer->wait_set_proxy == NULL);
+    stream_buffer->wait_set_proxy = proxy;
+}
@@ -82,6 +82,14 @@ uint16_t rhs_stream_get_trigger_level(RHSStreamBuffer* stream_buffer);
  */
 uint16_t rhs_stream_buffer_send(RHSStreamBuffer* stream_buffer, const void* data, uint16_t length, uint32_t timeout);
 
+/**
+ * @brief Set name shown in queue statistics, see queue_stats.h
+ *
+ * @param stream_buffer The stream buffer instance.
+ * @param name Stream buffer name, must stay valid.
+ */
+void rhs_stream_buffer_set_name(RHSStreamBuffer* stream_buffer, const char* name);
+
 /**
  * @brief Receives bytes from a stream buffer.
  * Wakes up task waiting for space to become available if called from ISR.
@@ -110,6 +110,7 @@ static void rhs_thread_body(void* context)
 void rhs_thread_init(void)
 {
     rhs_thread_scrub_message_queue = rhs_message_queue_alloc(8, sizeof(RHSThread*));
+    rhs_message_queue_set_name(rhs_thread_scrub_message_queue, "thread_scrub");
 }
 
 void rhs_thread_set_name(RHSThread* thread, const char* name)
@@ -0,0 +1,324 @@
+#include "timer_wheel.h"
+#include "semaphore.h"
+#include "kernel.h"
+#include "common.h"
+#include "memmgr.h"
+#include "check.h"
+
+#include <FreeRTOS.h>
+#include <timers.h>
+
+#define TIMER_WHEEL_LEVELS 4U
+#define TIMER_WHEEL_BITS 6U
+#define TIMER_WHEEL_SLOTS (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1U)
+#define TIMER_WHEEL_MAX_DELTA ((1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1U)
+
+// Entry is not armed
+#define TIMER_WHEEL_IDLE (NULL)
+
+struct RHSTimerWheel
+{
+    StaticTimer_t        container;
+    uint32_t             resolution;
+    uint32_t             base_tick;     // Kernel tick of wheel tick `now`
+    uint32_t             now;           // Last processed wheel tick
+    uint32_t             count;
+    bool                 active;        // Driver timer is running
+    RHSTimerWheelEntry*  expired;       // Collected, callbacks not yet called, in expiry order
+    RHSTimerWheelEntry** expired_tail;  // Next pointer of the last collected entry
+    RHSTimerWheelEntry*  slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+// IMPORTANT: container MUST be the FIRST struct member
+static_assert(offsetof(RHSTimerWheel, container) == 0);
+
+// Head slot and entry both start with next pointer
+static_assert(offsetof(RHSTimerWheelEntry, next) == 0);
+
+// Entry list head is found through its prev pointer: the first entry points
+// back to the head slot, so unlink needs no search.
+static void rhs_timer_wheel_link(RHSTimerWheelEntry** head, RHSTimerWheelEntry* entry)
+{
+    entry->next = *head;
+    entry->prev = (RHSTimerWheelEntry*) head;
+    if (*head)
+    {
+        (*head)->prev = entry;
+    }
+    *head = entry;
+}
+
+// Appended at the tail: a late timer thread collects several wheel ticks at once and still calls them in order
+static void rhs_timer_wheel_append(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry)
+{
+    entry->next          = NULL;
+    entry->prev          = (RHSTimerWheelEntry*) wheel->expired_tail;
+    *wheel->expired_tail = entry;
+    wheel->expired_tail  = &entry->next;
+}
+
+static void rhs_timer_wheel_unlink(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry)
+{
+    if (wheel->expired_tail == &entry->next)
+    {
+        wheel->expired_tail = &entry->prev->next;
+    }
+    entry->prev->next = entry->next;
+    if (entry->next)
+    {
+        entry->next->prev = entry->prev;
+    }
+    entry->next = NULL;
+    entry->prev = TIMER_WHEEL_IDLE;
+    wheel->count--;
+}
+
+static void rhs_timer_wheel_insert(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry)
+{
+    uint32_t delta = entry->expire - wheel->now;
+    if (delta > TIMER_WHEEL_MAX_DELTA)
+    {
+        delta         = TIMER_WHEEL_MAX_DELTA;
+        entry->expire = wheel->now + delta;
+    }
+
+    uint32_t level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1U && delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1U))))
+    {
+        level++;
+    }
+
+    uint32_t slot = (entry->expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    rhs_timer_wheel_link(&wheel->slots[level][slot], entry);
+    wheel->count++;
+}
+
+// Must be called in critical section
+static void rhs_timer_wheel_advance(RHSTimerWheel* wheel)
+{
+    wheel->now++;
+
+    // Move entries of upper level slot that has come due one level down
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if ((wheel->now & ((1UL << (TIMER_WHEEL_BITS * level)) - 1U)) != 0U)
+        {
+            break;
+        }
+
+        uint32_t            slot  = (wheel->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        RHSTimerWheelEntry* entry = wheel->slots[level][slot];
+        wheel->slots[level][slot] = NULL;
+
+        while (entry)
+        {
+            RHSTimerWheelEntry* next = entry->next;
+            wheel->count--;
+            rhs_timer_wheel_insert(wheel, entry);
+            entry = next;
+        }
+    }
+
+    RHSTimerWheelEntry** head = &wheel->slots[0][wheel->now & TIMER_WHEEL_MASK];
+    while (*head)
+    {
+        RHSTimerWheelEntry* entry = *head;
+        rhs_timer_wheel_unlink(wheel, entry);
+        rhs_timer_wheel_append(wheel, entry);
+        wheel->count++;
+    }
+}
+
+static void rhs_timer_wheel_collect(RHSTimerWheel* wheel)
+{
+    RHS_CRITICAL_ENTER();
+
+    // Catch up with kernel tick, timer thread may have been delayed
+    uint32_t steps = (rhs_get_tick() - wheel->base_tick) / wheel->resolution;
+    wheel->base_tick += steps * wheel->resolution;
+    while (steps--)
+    {
+        rhs_timer_wheel_advance(wheel);
+    }
+
+    RHS_CRITICAL_EXIT();
+}
+
+static RHSTimerWheelEntry* rhs_timer_wheel_pop_expired(RHSTimerWheel* wheel)
+{
+    RHS_CRITICAL_ENTER();
+
+    RHSTimerWheelEntry* entry = wheel->expired;
+    if (entry)
+    {
+        rhs_timer_wheel_unlink(wheel, entry);
+    }
+
+    RHS_CRITICAL_EXIT();
+
+    return entry;
+}
+
+static void rhs_timer_wheel_idle(RHSTimerWheel* wheel)
+{
+    RHS_CRITICAL_ENTER();
+
+    if (wheel->count == 0U && wheel->active)
+    {
+        wheel->active = false;
+        rhs_assert(xTimerStop((TimerHandle_t) wheel, 0) == pdPASS);
+    }
+
+    RHS_CRITICAL_EXIT();
+}
+
+static void rhs_timer_wheel_driver(TimerHandle_t hTimer)
+{
+    RHSTimerWheel* wheel = pvTimerGetTimerID(hTimer);
+    rhs_assert(wheel);
+
+    rhs_timer_wheel_collect(wheel);
+
+    // Batched expiry, entries stopped meanwhile are already unlinked
+    RHSTimerWheelEntry* entry;
+    while ((entry = rhs_timer_wheel_pop_expired(wheel)) != NULL)
+    {
+        entry->callback(entry->context);
+    }
+
+    rhs_timer_wheel_idle(wheel);
+}
+
+RHSTimerWheel* rhs_timer_wheel_alloc(uint32_t resolution)
+{
+    rhs_assert(!rhs_kernel_is_irq_or_masked());
+    rhs_assert(resolution > 0U);
+
+    RHSTimerWheel* wheel = malloc(sizeof(RHSTimerWheel));
+    memset(wheel, 0, sizeof(RHSTimerWheel));
+    wheel->resolution   = resolution;
+    wheel->expired_tail = &wheel->expired;
+
+    TimerHandle_t hTimer =
+        xTimerCreateStatic(NULL, resolution, pdTRUE, wheel, rhs_timer_wheel_driver, &wheel->container);
+    rhs_assert(hTimer == (TimerHandle_t) wheel);
+
+    return wheel;
+}
+
+static void rhs_timer_wheel_epilogue(void* context, uint32_t arg)
+{
+    (void) arg;
+    rhs_semaphore_release(context);
+}
+
+void rhs_timer_wheel_free(RHSTimerWheel* wheel)
+{
+    rhs_assert(!rhs_kernel_is_irq_or_masked());
+    rhs_assert(wheel);
+    rhs_assert(wheel->count == 0U);
+
+    rhs_assert(xTimerDelete((TimerHandle_t) wheel, portMAX_DELAY) == pdPASS);
+
+    // Wait until timer thread has processed delete command
+    RHSSemaphore* done = rhs_semaphore_alloc(1, 0);
+    rhs_timer_pending_callback(rhs_timer_wheel_epilogue, done, 0);
+    rhs_assert(rhs_semaphore_acquire(done, RHSWaitForever) == RHSStatusOk);
+    rhs_semaphore_free(done);
+
+    free(wheel);
+}
+
+void rhs_timer_wheel_entry_init(RHSTimerWheelEntry* entry, RHSTimerCallback callback, void* context)
+{
+    rhs_assert(entry);
+    rhs_assert(callback);
+
+    entry->next     = NULL;
+    entry->prev     = TIMER_WHEEL_IDLE;
+    entry->expire   = 0;
+    entry->callback = callback;
+    entry->context  = context;
+}
+
+// False if the driver timer of an idle wheel could not be started, entry is left stopped then
+static bool rhs_timer_wheel_arm(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry, uint32_t ticks)
+{
+    rhs_assert(wheel);
+    rhs_assert(entry && entry->callback);
+
+    const uint32_t delay   = (ticks + wheel->resolution - 1U) / wheel->resolution;
+    bool           started = true;
+
+    RHS_CRITICAL_ENTER();
+
+    if (entry->prev != TIMER_WHEEL_IDLE)
+    {
+        rhs_timer_wheel_unlink(wheel, entry);
+    }
+
+    const uint32_t tick = rhs_get_tick();
+    if (!wheel->active)
+    {
+        // Wheel is empty, resynchronize with kernel tick
+        wheel->base_tick = tick;
+
+        if (RHS_IS_IRQ_MODE())
+        {
+            started = xTimerStartFromISR((TimerHandle_t) wheel, NULL) == pdPASS;
+        }
+        else
+        {
+            started = xTimerStart((TimerHandle_t) wheel, 0) == pdPASS;
+        }
+        wheel->active = started;
+    }
+
+    if (started)
+    {
+        // Relative to kernel tick, wheel may lag behind if timer thread is late
+        uint32_t current = wheel->now + (tick - wheel->base_tick) / wheel->resolution;
+        entry->expire    = current + (delay ? delay : 1U);
+        rhs_timer_wheel_insert(wheel, entry);
+    }
+
+    RHS_CRITICAL_EXIT();
+
+    return started;
+}
+
+void rhs_timer_wheel_start(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry, uint32_t ticks)
+{
+    rhs_assert(rhs_timer_wheel_arm(wheel, entry, ticks));
+}
+
+bool rhs_timer_wheel_try_start(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry, uint32_t ticks)
+{
+    return rhs_timer_wheel_arm(wheel, entry, ticks);
+}
+
+void rhs_timer_wheel_stop(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry)
+{
+    rhs_assert(wheel);
+    rhs_assert(entry);
+
+    RHS_CRITICAL_ENTER();
+    if (entry->prev != TIMER_WHEEL_IDLE)
+    {
+        rhs_timer_wheel_unlink(wheel, entry);
+    }
+    RHS_CRITICAL_EXIT();
+}
+
+bool rhs_timer_wheel_is_running(RHSTimerWheelEntry* entry)
+{
+    rhs_assert(entry);
+    return entry->prev != TIMER_WHEEL_IDLE;
+}
+
+uint32_t rhs_timer_wheel_get_count(RHSTimerWheel* wheel)
+{
+    rhs_assert(wheel);
+    return wheel->count;
+}
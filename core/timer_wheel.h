@@ -0,0 +1,105 @@
+/**
+ * @file timer_wheel.h
+ * RHS hierarchical timer wheel
+ *
+ * Thousands of protocol timeouts on a single FreeRTOS timer. Entries are
+ * embedded into user structures, start and stop are O(1), do not allocate and
+ * do not go through the timer command queue. Expired entries are collected
+ * and their callbacks run in one batch in timer thread context.
+ *
+ * Four levels of 64 slots cover 2^24 wheel ticks, longer timeouts are clamped.
+ */
+#pragma once
+
+#include "base.h"
+#include "timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RHSTimerWheel      RHSTimerWheel;
+typedef struct RHSTimerWheelEntry RHSTimerWheelEntry;
+
+/** Wheel entry, members are private */
+struct RHSTimerWheelEntry
+{
+    RHSTimerWheelEntry* next;
+    RHSTimerWheelEntry* prev;
+    uint32_t            expire;  // In wheel ticks
+    RHSTimerCallback    callback;
+    void*               context;
+};
+
+/** Allocate timer wheel
+ *
+ * @param[in]  resolution  wheel tick in kernel ticks
+ *
+ * @return     pointer to RHSTimerWheel instance
+ */
+RHSTimerWheel* rhs_timer_wheel_alloc(uint32_t resolution);
+
+/** Free timer wheel, all entries must be stopped
+ *
+ * @param      wheel  pointer to RHSTimerWheel instance
+ */
+void rhs_timer_wheel_free(RHSTimerWheel* wheel);
+
+/** Initialize entry
+ *
+ * @param[out] entry     entry, usually embedded into owner structure
+ * @param[in]  callback  called in timer thread context on expiry
+ * @param      context   callback context
+ */
+void rhs_timer_wheel_entry_init(RHSTimerWheelEntry* entry, RHSTimerCallback callback, void* context);
+
+/** Start or restart entry, ISR safe
+ *
+ * @param      wheel  pointer to RHSTimerWheel instance
+ * @param      entry  initialized entry
+ * @param[in]  ticks  timeout in kernel ticks, rounded up to wheel resolution
+ */
+void rhs_timer_wheel_start(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry, uint32_t ticks);
+
+/** Start or restart entry, ISR safe, without asserting on a full timer command queue
+ *
+ * An idle wheel starts its FreeRTOS timer through the timer command queue.
+ * When the queue is full this returns false and leaves the entry stopped, the
+ * caller tries again later.
+ *
+ * @param      wheel  pointer to RHSTimerWheel instance
+ * @param      entry  initialized entry
+ * @param[in]  ticks  timeout in kernel ticks, rounded up to wheel resolution
+ *
+ * @return     true if armed
+ */
+bool rhs_timer_wheel_try_start(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry, uint32_t ticks);
+
+/** Stop entry, ISR safe
+ *
+ * Callback of an entry stopped from another thread may already be running.
+ *
+ * @param      wheel  pointer to RHSTimerWheel instance
+ * @param      entry  initialized entry
+ */
+void rhs_timer_wheel_stop(RHSTimerWheel* wheel, RHSTimerWheelEntry* entry);
+
+/** Check if entry is armed
+ *
+ * @param      entry  initialized entry
+ *
+ * @return     true if armed
+ */
+bool rhs_timer_wheel_is_running(RHSTimerWheelEntry* entry);
+
+/** Get number of armed entries
+ *
+ * @param      wheel  pointer to RHSTimerWheel instance
+ *
+ * @return     entry count
+ */
+uint32_t rhs_timer_wheel_get_count(RHSTimerWheel* wheel);
+
+#ifdef __cplusplus
+}
+#endif
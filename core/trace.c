@@ -0,0 +1,244 @@
+#include "trace.h"
+#include "check.h"
+#include "defines.h"
+#include "common.h"
+#include "rhs_hal_cortex.h"
+#include "SEGGER_RTT.h"
+
+#include <stdio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#ifdef RHS_TRACE
+
+#    if (RHS_TRACE_BUFFER_SIZE & (RHS_TRACE_BUFFER_SIZE - 1)) != 0
+#        error "RHS_TRACE_BUFFER_SIZE must be power of two"
+#    endif
+
+#    define RHS_TRACE_LINE_SIZE 64
+
+#    ifndef RHS_TRACE_RTT_BUFFER_SIZE
+#        define RHS_TRACE_RTT_BUFFER_SIZE 512
+#    endif
+
+typedef struct
+{
+    RHSTraceEvent     events[RHS_TRACE_BUFFER_SIZE];
+    volatile uint32_t head; /**< Total amount of recorded events */
+    volatile bool     running;
+} RHSTrace;
+
+static RHSTrace rhs_trace = {0};
+
+static char rhs_trace_rtt_buffer[RHS_TRACE_RTT_BUFFER_SIZE];
+
+static const char* const rhs_trace_event_name[RHSTraceEventMax] = {
+    [RHSTraceEventThreadSwitchIn]  = "SI",
+    [RHSTraceEventThreadSwitchOut] = "SO",
+    [RHSTraceEventIsrEnter]        = "IE",
+    [RHSTraceEventIsrExit]         = "IX",
+    [RHSTraceEventQueuePut]        = "QP",
+    [RHSTraceEventQueueGet]        = "QG",
+    [RHSTraceEventMutexAcquire]    = "MA",
+    [RHSTraceEventMutexRelease]    = "MR",
+    [RHSTraceEventSpanBegin]       = "SB",
+    [RHSTraceEventSpanEnd]         = "SE",
+    [RHSTraceEventMark]            = "MK",
+};
+
+void rhs_trace_start(void)
+{
+    rhs_trace.running = true;
+}
+
+void rhs_trace_stop(void)
+{
+    rhs_trace.running = false;
+}
+
+void rhs_trace_clear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    rhs_trace.head = 0;
+    __set_PRIMASK(primask);
+}
+
+bool rhs_trace_is_running(void)
+{
+    return rhs_trace.running;
+}
+
+void rhs_trace_event(RHSTraceEventType type, uint32_t id, uint32_t arg)
+{
+    if (!rhs_trace.running)
+        return;
+
+    // Called from scheduler hooks with BASEPRI raised, so PRIMASK is the only safe lock here
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    RHSTraceEvent* event = &rhs_trace.events[rhs_trace.head & (RHS_TRACE_BUFFER_SIZE - 1)];
+    event->timestamp     = rhs_hal_cortex_get_cycles();
+    event->id            = id;
+    event->arg           = arg;
+    event->type          = (uint8_t) type;
+    rhs_trace.head++;
+
+    __set_PRIMASK(primask);
+}
+
+void rhs_trace_thread_switched_in(void* thread_id)
+{
+    rhs_trace_event(RHSTraceEventThreadSwitchIn, (uint32_t) thread_id, 0);
+}
+
+void rhs_trace_thread_switched_out(void* thread_id)
+{
+    rhs_trace_event(RHSTraceEventThreadSwitchOut, (uint32_t) thread_id, 0);
+}
+
+static void rhs_trace_dump_threads(RHSTraceWriter writer, void* context)
+{
+    char line[RHS_TRACE_LINE_SIZE];
+
+    vTaskSuspendAll();
+    uint32_t      count = uxTaskGetNumberOfTasks();
+    TaskStatus_t* task  = pvPortMalloc(count * sizeof(TaskStatus_t));
+    if (task)
+    {
+        count = uxTaskGetSystemState(task, count, NULL);
+    }
+    (void) xTaskResumeAll();
+
+    if (!task)
+        return;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int len = snprintf(line,
+                           sizeof(line),
+                           "T %08lx %s\n",
+                           (unsigned long) (uint32_t) task[i].xHandle,
+                           task[i].pcTaskName);
+        writer(line, MIN((size_t) len, sizeof(line) - 1), context);
+    }
+    vPortFree(task);
+}
+
+void rhs_trace_dump(RHSTraceWriter writer, void* context)
+{
+    rhs_assert(writer);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    bool was_running  = rhs_trace.running;
+    rhs_trace.running = false;
+
+    uint32_t head  = rhs_trace.head;
+    uint32_t count = MIN(head, (uint32_t) RHS_TRACE_BUFFER_SIZE);
+    char     line[RHS_TRACE_LINE_SIZE];
+    int      len;
+
+    len = snprintf(line,
+                   sizeof(line),
+                   "# rhs trace\nF %lu\nN %lu %lu\n",
+                   (unsigned long) rhs_hal_cortex_get_cycles_frequency(),
+                   (unsigned long) count,
+                   (unsigned long) (head - count));
+    writer(line, MIN((size_t) len, sizeof(line) - 1), context);
+
+    rhs_trace_dump_threads(writer, context);
+
+    for (uint32_t i = head - count; i != head; i++)
+    {
+        const RHSTraceEvent* event = &rhs_trace.events[i & (RHS_TRACE_BUFFER_SIZE - 1)];
+        if (event->type >= RHSTraceEventMax)
+            continue;
+
+        if (event->type == RHSTraceEventSpanBegin || event->type == RHSTraceEventSpanEnd ||
+            event->type == RHSTraceEventMark)
+        {
+            len = snprintf(line,
+                           sizeof(line),
+                           "E %08lx %s %s %lu\n",
+                           (unsigned long) event->timestamp,
+                           rhs_trace_event_name[event->type],
+                           (const char*) event->id,
+                           (unsigned long) event->arg);
+        }
+        else
+        {
+            len = snprintf(line,
+                           sizeof(line),
+                           "E %08lx %s %08lx %lu\n",
+                           (unsigned long) event->timestamp,
+                           rhs_trace_event_name[event->type],
+                           (unsigned long) event->id,
+                           (unsigned long) event->arg);
+        }
+        writer(line, MIN((size_t) len, sizeof(line) - 1), context);
+    }
+
+    writer("# end\n", 6, context);
+
+    rhs_trace.running = was_running;
+}
+
+static void rhs_trace_rtt_writer(const char* data, size_t size, void* context)
+{
+    SEGGER_RTT_Write((unsigned) (uint32_t) context, data, size);
+}
+
+void rhs_trace_dump_rtt(uint8_t channel)
+{
+    rhs_assert(channel != 0);
+    SEGGER_RTT_ConfigUpBuffer(channel,
+                              "trace",
+                              rhs_trace_rtt_buffer,
+                              sizeof(rhs_trace_rtt_buffer),
+                              SEGGER_RTT_MODE_BLOCK_IF_FIFO_FULL);
+    rhs_trace_dump(rhs_trace_rtt_writer, (void*) (uint32_t) channel);
+}
+
+#else
+
+void rhs_trace_start(void) {}
+
+void rhs_trace_stop(void) {}
+
+void rhs_trace_clear(void) {}
+
+bool rhs_trace_is_running(void)
+{
+    return false;
+}
+
+void rhs_trace_event(RHSTraceEventType type, uint32_t id, uint32_t arg)
+{
+    (void) type;
+    (void) id;
+    (void) arg;
+}
+
+void rhs_trace_dump(RHSTraceWriter writer, void* context)
+{
+    (void) writer;
+    (void) context;
+}
+
+void rhs_trace_dump_rtt(uint8_t channel)
+{
+    (void) channel;
+}
+
+void rhs_trace_thread_switched_in(void* thread_id)
+{
+    (void) thread_id;
+}
+
+void rhs_trace_thread_switched_out(void* thread_id)
+{
+    (void) thread_id;
+}
+
+#endif
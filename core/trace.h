@@ -0,0 +1,128 @@
+/**
+ * @file trace.h
+ * RHS system event tracer
+ *
+ * Records scheduler, interrupt, queue, mutex and user events into a RAM ring
+ * with cycle counter timestamps. The ring is dumped as text and converted to
+ * Chrome trace JSON with tools/trace2chrome.py.
+ *
+ * Tracer is compiled in only when RHS_TRACE is defined (cmake option
+ * RHS_TRACE). Otherwise all RHS_TRACE_* macros expand to nothing.
+ *
+ * To record context switches add the following line to the end of
+ * FreeRTOSConfig.h:
+ *
+ * @code
+ * #include "core/trace_freertos.h"
+ * @endcode
+ */
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef RHS_TRACE_BUFFER_SIZE
+#    define RHS_TRACE_BUFFER_SIZE 256
+#endif
+
+typedef enum
+{
+    RHSTraceEventThreadSwitchIn,
+    RHSTraceEventThreadSwitchOut,
+    RHSTraceEventIsrEnter,
+    RHSTraceEventIsrExit,
+    RHSTraceEventQueuePut,
+    RHSTraceEventQueueGet,
+    RHSTraceEventMutexAcquire,
+    RHSTraceEventMutexRelease,
+    RHSTraceEventSpanBegin,
+    RHSTraceEventSpanEnd,
+    RHSTraceEventMark,
+    RHSTraceEventMax,
+} RHSTraceEventType;
+
+typedef struct
+{
+    uint32_t timestamp; /**< Cycle counter value, see rhs_hal_cortex_get_cycles */
+    uint32_t id;        /**< Object: thread, irq index, queue, mutex or span name */
+    uint32_t arg;       /**< Event specific argument, usually RHSStatus */
+    uint8_t  type;      /**< RHSTraceEventType */
+} RHSTraceEvent;
+
+/** Dump writer
+ *
+ * @param      data     text chunk
+ * @param      size     chunk size
+ * @param      context  writer context
+ */
+typedef void (*RHSTraceWriter)(const char* data, size_t size, void* context);
+
+/** Start recording, ring content is preserved */
+void rhs_trace_start(void);
+
+/** Stop recording */
+void rhs_trace_stop(void);
+
+/** Drop all recorded events */
+void rhs_trace_clear(void);
+
+/** Check if tracer is recording
+ *
+ * @return     true if recording
+ */
+bool rhs_trace_is_running(void);
+
+/** Record event
+ *
+ * ISR safe, never blocks. Oldest events are overwritten when ring is full.
+ *
+ * @param[in]  type  RHSTraceEventType
+ * @param[in]  id    object identifier
+ * @param[in]  arg   event argument
+ */
+void rhs_trace_event(RHSTraceEventType type, uint32_t id, uint32_t arg);
+
+/** Dump recorded events as text
+ *
+ * Recording is paused while dumping. Format is line based and understood by
+ * tools/trace2chrome.py, so the same dump can go to CLI, RTT or TCP.
+ *
+ * @param[in]  writer   dump writer
+ * @param      context  writer context
+ */
+void rhs_trace_dump(RHSTraceWriter writer, void* context);
+
+/** Dump recorded events into dedicated RTT up buffer
+ *
+ * Blocks until the host reads the buffer, so a debugger must be attached.
+ *
+ * @param[in]  channel  RTT up buffer index, must not be 0 (used by log)
+ */
+void rhs_trace_dump_rtt(uint8_t channel);
+
+/** FreeRTOS hooks, see trace_freertos.h */
+void rhs_trace_thread_switched_in(void* thread_id);
+void rhs_trace_thread_switched_out(void* thread_id);
+
+#ifdef RHS_TRACE
+#    define RHS_TRACE_EVENT(type, id, arg) rhs_trace_event((type), (uint32_t) (id), (uint32_t) (arg))
+#else
+#    define RHS_TRACE_EVENT(type, id, arg) \
+        do                                 \
+        {                                  \
+        } while (0)
+#endif
+
+/** User span, name must be a string literal or other static string */
+#define RHS_TRACE_SPAN_BEGIN(name) RHS_TRACE_EVENT(RHSTraceEventSpanBegin, (const char*) (name), 0)
+#define RHS_TRACE_SPAN_END(name) RHS_TRACE_EVENT(RHSTraceEventSpanEnd, (const char*) (name), 0)
+
+/** Instant user event, name must be a string literal or other static string */
+#define RHS_TRACE_MARK(name, arg) RHS_TRACE_EVENT(RHSTraceEventMark, (const char*) (name), (arg))
+
+#ifdef __cplusplus
+}
+#endif
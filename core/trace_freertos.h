@@ -0,0 +1,19 @@
+/**
+ * @file trace_freertos.h
+ * FreeRTOS trace hooks for RHS tracer
+ *
+ * Include at the end of FreeRTOSConfig.h. Hooks are empty unless RHS_TRACE is
+ * defined for the FreeRTOS kernel build as well (cmake option RHS_TRACE
+ * propagates it to freertos_config).
+ */
+#pragma once
+
+#if defined(RHS_TRACE) && !defined(__ASSEMBLER__)
+
+void rhs_trace_thread_switched_in(void* thread_id);
+void rhs_trace_thread_switched_out(void* thread_id);
+
+#    define traceTASK_SWITCHED_IN() rhs_trace_thread_switched_in((void*) pxCurrentTCB)
+#    define traceTASK_SWITCHED_OUT() rhs_trace_thread_switched_out((void*) pxCurrentTCB)
+
+#endif
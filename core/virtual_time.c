@@ -0,0 +1,128 @@
+#include "virtual_time.h"
+#include "check.h"
+#include "common.h"
+#include "kernel.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#ifdef RHS_VIRTUAL_TIME
+
+typedef struct
+{
+    uint32_t last_tick;
+    uint64_t ticks;
+    uint64_t idle_ticks;
+    uint32_t jumps;
+} RHSVirtualTime;
+
+static RHSVirtualTime virtual_time = {0};
+
+// Extend 32 bit kernel tick to 64 bit, called often enough to never miss a wrap
+static void rhs_virtual_time_sync(TickType_t now)
+{
+    virtual_time.ticks += (uint32_t) (now - virtual_time.last_tick);
+    virtual_time.last_tick = now;
+}
+
+void vApplicationTickHook(void)
+{
+    rhs_virtual_time_sync(xTaskGetTickCountFromISR());
+}
+
+void vApplicationIdleHook(void)
+{
+    // Every other thread is blocked: make time pass. Longer gaps are skipped
+    // at once in rhs_virtual_time_suppress_ticks, the last tick of a gap goes
+    // through the regular tick path here so wake ups are processed on time.
+    if (xTaskCatchUpTicks(1) != pdFALSE)
+    {
+        taskYIELD();
+    }
+
+    RHS_CRITICAL_ENTER();
+    virtual_time.idle_ticks++;
+    rhs_virtual_time_sync(xTaskGetTickCount());
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_virtual_time_suppress_ticks(uint32_t expected_idle_ticks)
+{
+    // Called by idle thread with scheduler suspended. Stop one tick short of
+    // the wake up, vTaskStepTick must not process the unblocking tick itself.
+    if (expected_idle_ticks > 1)
+    {
+        vTaskStepTick(expected_idle_ticks - 1);
+
+        RHS_CRITICAL_ENTER();
+        virtual_time.idle_ticks += expected_idle_ticks - 1;
+        virtual_time.jumps++;
+        rhs_virtual_time_sync(xTaskGetTickCount());
+        RHS_CRITICAL_EXIT();
+    }
+}
+
+void rhs_virtual_time_advance(uint32_t ticks)
+{
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    if (ticks == 0)
+        return;
+
+    if (xTaskCatchUpTicks(ticks) != pdFALSE)
+    {
+        taskYIELD();
+    }
+
+    RHS_CRITICAL_ENTER();
+    virtual_time.jumps++;
+    rhs_virtual_time_sync(xTaskGetTickCount());
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_virtual_time_get_stats(RHSVirtualTimeStats* stats)
+{
+    rhs_assert(stats);
+
+    RHS_CRITICAL_ENTER();
+    rhs_virtual_time_sync(xTaskGetTickCount());
+    stats->ticks      = virtual_time.ticks;
+    stats->idle_ticks = virtual_time.idle_ticks;
+    stats->jumps      = virtual_time.jumps;
+    RHS_CRITICAL_EXIT();
+}
+
+uint64_t rhs_virtual_time_get_us(void)
+{
+    RHSVirtualTimeStats stats;
+    rhs_virtual_time_get_stats(&stats);
+    return stats.ticks * 1000000ULL / configTICK_RATE_HZ;
+}
+
+#else
+
+void rhs_virtual_time_suppress_ticks(uint32_t expected_idle_ticks)
+{
+    (void) expected_idle_ticks;
+}
+
+void rhs_virtual_time_advance(uint32_t ticks)
+{
+    (void) ticks;
+    rhs_crash("Virtual time is disabled");
+}
+
+void rhs_virtual_time_get_stats(RHSVirtualTimeStats* stats)
+{
+    rhs_assert(stats);
+    stats->ticks      = rhs_get_tick();
+    stats->idle_ticks = 0;
+    stats->jumps      = 0;
+}
+
+uint64_t rhs_virtual_time_get_us(void)
+{
+    return (uint64_t) rhs_get_tick() * 1000000ULL / configTICK_RATE_HZ;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file virtual_time.h
+ * RHS virtual time executor
+ *
+ * Intended for host (simulation) builds. When RHS_VIRTUAL_TIME is defined the
+ * kernel tick is no longer tied to wall clock: whenever all threads are
+ * blocked the idle thread jumps the tick count straight to the next wake up.
+ * rhs_get_tick, rhs_delay_*, timers and every queue/flag/mutex timeout are
+ * driven by the FreeRTOS tick, so they all follow the simulated clock and hours
+ * of traffic run in seconds with reproducible timing.
+ *
+ * Add the following line to the end of FreeRTOSConfig.h of the host build and
+ * disable the port tick interrupt for fully deterministic runs. The module
+ * owns vApplicationIdleHook and vApplicationTickHook in this configuration.
+ *
+ * @code
+ * #include "core/virtual_time_freertos.h"
+ * @endcode
+ */
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint64_t ticks;       /**< Simulated ticks since start, never wraps */
+    uint64_t idle_ticks;  /**< Ticks skipped while all threads were blocked */
+    uint32_t jumps;       /**< Number of tick jumps */
+} RHSVirtualTimeStats;
+
+/** Get simulated time in microseconds
+ *
+ * @return     microseconds since scheduler start
+ */
+uint64_t rhs_virtual_time_get_us(void);
+
+/** Get virtual time statistics
+ *
+ * @param[out] stats  statistics
+ */
+void rhs_virtual_time_get_stats(RHSVirtualTimeStats* stats);
+
+/** Advance simulated clock from a thread
+ *
+ * Behaves as if ticks elapsed at once: expired delays, timers and timeouts
+ * are processed before the call returns to the scheduler.
+ *
+ * @warning    Cannot be used from ISR
+ *
+ * @param[in]  ticks  ticks to advance
+ */
+void rhs_virtual_time_advance(uint32_t ticks);
+
+/** Tickless idle hook, see virtual_time_freertos.h
+ *
+ * @param[in]  expected_idle_ticks  ticks until next thread wake up
+ */
+void rhs_virtual_time_suppress_ticks(uint32_t expected_idle_ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+/**
+ * @file virtual_time_freertos.h
+ * FreeRTOS configuration for RHS virtual time executor
+ *
+ * Include at the end of FreeRTOSConfig.h. Overrides idle, tick and tickless
+ * idle hooks when RHS_VIRTUAL_TIME is defined, does nothing otherwise.
+ */
+#pragma once
+
+#if defined(RHS_VIRTUAL_TIME) && !defined(__ASSEMBLER__)
+
+#    include <stdint.h>
+
+void rhs_virtual_time_suppress_ticks(uint32_t expected_idle_ticks);
+
+#    undef configUSE_IDLE_HOOK
+#    define configUSE_IDLE_HOOK 1
+
+#    undef configUSE_TICK_HOOK
+#    define configUSE_TICK_HOOK 1
+
+#    undef configUSE_TICKLESS_IDLE
+#    define configUSE_TICKLESS_IDLE 2
+
+#    undef configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+#    define configEXPECTED_IDLE_TIME_BEFORE_SLEEP 2
+
+#    undef portSUPPRESS_TICKS_AND_SLEEP
+#    define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) rhs_virtual_time_suppress_ticks(xExpectedIdleTime)
+
+#endif
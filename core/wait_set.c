@@ -0,0 +1,284 @@
+#include "wait_set.h"
+#include "wait_set_i.h"
+#include "common.h"
+#include "memmgr.h"
+#include "check.h"
+
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+
+#if configUSE_QUEUE_SETS != 1
+#    define RHS_WAIT_SET_POLL_TICKS 1U  // Members are polled without queue sets
+#endif
+
+typedef enum
+{
+    RHSWaitSetMemberMessageQueue,
+    RHSWaitSetMemberSemaphore,
+    RHSWaitSetMemberStreamBuffer,
+    RHSWaitSetMemberEventFlag,
+} RHSWaitSetMemberType;
+
+typedef struct RHSWaitSetMember RHSWaitSetMember;
+
+struct RHSWaitSetMember
+{
+    void*                object;
+    RHSSemaphore*        proxy;  // NULL for native queue set members
+    RHSWaitSetMemberType type;
+    RHSWaitSetMember*    next;
+};
+
+struct RHSWaitSet
+{
+#ifndef RHS_WAIT_SET_POLL_TICKS
+    QueueSetHandle_t handle;
+#endif
+    RHSWaitSetMember* members;
+};
+
+static void rhs_wait_set_add(RHSWaitSet* instance, void* object, RHSWaitSetMemberType type)
+{
+    rhs_assert(instance);
+    rhs_assert(object);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    RHSWaitSetMember* member = malloc(sizeof(RHSWaitSetMember));
+    member->object           = object;
+    member->proxy            = NULL;
+    member->type             = type;
+
+    QueueSetMemberHandle_t handle;
+    if (type == RHSWaitSetMemberStreamBuffer || type == RHSWaitSetMemberEventFlag)
+    {
+        member->proxy = rhs_semaphore_alloc(1, 0);
+        handle        = (QueueSetMemberHandle_t) member->proxy;
+    }
+    else
+    {
+        handle = (QueueSetMemberHandle_t) object;
+    }
+
+#ifndef RHS_WAIT_SET_POLL_TICKS
+    // Fails if member is not empty or already belongs to a set
+    rhs_assert(xQueueAddToSet(handle, instance->handle) == pdPASS);
+#else
+    (void) handle;
+#endif
+
+    if (type == RHSWaitSetMemberStreamBuffer)
+    {
+        rhs_stream_buffer_set_wait_set_proxy(object, member->proxy);
+    }
+    else if (type == RHSWaitSetMemberEventFlag)
+    {
+        rhs_event_flag_set_wait_set_proxy(object, member->proxy);
+    }
+
+    member->next      = instance->members;
+    instance->members = member;
+}
+
+static void rhs_wait_set_member_release(RHSWaitSet* instance, RHSWaitSetMember* member)
+{
+    if (member->proxy)
+    {
+        if (member->type == RHSWaitSetMemberStreamBuffer)
+        {
+            rhs_stream_buffer_set_wait_set_proxy(member->object, NULL);
+        }
+        else
+        {
+            rhs_event_flag_set_wait_set_proxy(member->object, NULL);
+        }
+
+        // Queue set refuses to remove non empty members, drop pending wake up.
+        // Its stale handle left in the set is skipped by rhs_wait_set_wait.
+        (void) rhs_semaphore_acquire(member->proxy, 0);
+#ifndef RHS_WAIT_SET_POLL_TICKS
+        rhs_assert(xQueueRemoveFromSet((QueueSetMemberHandle_t) member->proxy, instance->handle) == pdPASS);
+#endif
+        rhs_semaphore_free(member->proxy);
+    }
+#ifndef RHS_WAIT_SET_POLL_TICKS
+    else
+    {
+        rhs_assert(xQueueRemoveFromSet((QueueSetMemberHandle_t) member->object, instance->handle) == pdPASS);
+    }
+#else
+    (void) instance;
+#endif
+
+    free(member);
+}
+
+RHSWaitSet* rhs_wait_set_alloc(uint32_t capacity)
+{
+    rhs_assert(!RHS_IS_IRQ_MODE());
+    rhs_assert(capacity > 0U);
+
+    RHSWaitSet* instance = malloc(sizeof(RHSWaitSet));
+    instance->members    = NULL;
+#ifndef RHS_WAIT_SET_POLL_TICKS
+    instance->handle = xQueueCreateSet((UBaseType_t) capacity);
+    rhs_assert(instance->handle);
+#endif
+
+    return instance;
+}
+
+void rhs_wait_set_free(RHSWaitSet* instance)
+{
+    rhs_assert(instance);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    while (instance->members)
+    {
+        RHSWaitSetMember* member = instance->members;
+        instance->members        = member->next;
+        rhs_wait_set_member_release(instance, member);
+    }
+
+#ifndef RHS_WAIT_SET_POLL_TICKS
+    vQueueDelete((QueueHandle_t) instance->handle);
+#endif
+    free(instance);
+}
+
+void rhs_wait_set_add_message_queue(RHSWaitSet* instance, RHSMessageQueue* queue)
+{
+    rhs_wait_set_add(instance, queue, RHSWaitSetMemberMessageQueue);
+}
+
+void rhs_wait_set_add_semaphore(RHSWaitSet* instance, RHSSemaphore* semaphore)
+{
+    rhs_wait_set_add(instance, semaphore, RHSWaitSetMemberSemaphore);
+}
+
+void rhs_wait_set_add_stream_buffer(RHSWaitSet* instance, RHSStreamBuffer* stream_buffer)
+{
+    rhs_wait_set_add(instance, stream_buffer, RHSWaitSetMemberStreamBuffer);
+}
+
+void rhs_wait_set_add_event_flag(RHSWaitSet* instance, RHSEventFlag* event_flag)
+{
+    rhs_wait_set_add(instance, event_flag, RHSWaitSetMemberEventFlag);
+}
+
+void rhs_wait_set_remove(RHSWaitSet* instance, void* member)
+{
+    rhs_assert(instance);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    for (RHSWaitSetMember** link = &instance->members; *link != NULL; link = &(*link)->next)
+    {
+        if ((*link)->object == member)
+        {
+            RHSWaitSetMember* found = *link;
+            *link                   = found->next;
+            rhs_wait_set_member_release(instance, found);
+            return;
+        }
+    }
+
+    rhs_crash("Not a wait set member");
+}
+
+#ifdef RHS_WAIT_SET_POLL_TICKS
+// Ready member without taking what the caller reads, proxies are consumed as on a queue set wake up
+static void* rhs_wait_set_poll(RHSWaitSet* instance)
+{
+    for (RHSWaitSetMember* member = instance->members; member != NULL; member = member->next)
+    {
+        if (member->proxy)
+        {
+            if (rhs_semaphore_acquire(member->proxy, 0) == RHSStatusOk)
+            {
+                return member->object;
+            }
+        }
+        else if (member->type == RHSWaitSetMemberMessageQueue)
+        {
+            if (rhs_message_queue_get_count(member->object) != 0U)
+            {
+                return member->object;
+            }
+        }
+        else if (rhs_semaphore_get_count(member->object) != 0U)
+        {
+            return member->object;
+        }
+    }
+    return NULL;
+}
+
+void* rhs_wait_set_wait(RHSWaitSet* instance, uint32_t timeout)
+{
+    rhs_assert(instance);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    const TickType_t start = xTaskGetTickCount();
+
+    for (;;)
+    {
+        void* ready = rhs_wait_set_poll(instance);
+        if (ready != NULL)
+        {
+            return ready;
+        }
+        if ((timeout != RHSWaitForever) && ((xTaskGetTickCount() - start) >= (TickType_t) timeout))
+        {
+            return NULL;
+        }
+        vTaskDelay(RHS_WAIT_SET_POLL_TICKS);
+    }
+}
+#else
+void* rhs_wait_set_wait(RHSWaitSet* instance, uint32_t timeout)
+{
+    rhs_assert(instance);
+    rhs_assert(!RHS_IS_IRQ_MODE());
+
+    const TickType_t start = xTaskGetTickCount();
+    TickType_t       left  = (TickType_t) timeout;
+
+    for (;;)
+    {
+        QueueSetMemberHandle_t ready = xQueueSelectFromSet(instance->handle, left);
+        if (ready == NULL)
+        {
+            return NULL;
+        }
+
+        for (RHSWaitSetMember* member = instance->members; member != NULL; member = member->next)
+        {
+            if (member->proxy)
+            {
+                if (ready == (QueueSetMemberHandle_t) member->proxy)
+                {
+                    // Proxy is internal, consume its wake up on behalf of caller
+                    (void) rhs_semaphore_acquire(member->proxy, 0);
+                    return member->object;
+                }
+            }
+            else if (ready == (QueueSetMemberHandle_t) member->object)
+            {
+                // Container is the first member of RHS object
+                return member->object;
+            }
+        }
+
+        // Stale handle of removed member
+        if (timeout != RHSWaitForever)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= (TickType_t) timeout)
+            {
+                return NULL;
+            }
+            left = (TickType_t) timeout - elapsed;
+        }
+    }
+}
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file wait_set.h
+ * RHSWaitSet
+ *
+ * Lets one thread block on any mix of message queues, semaphores, stream
+ * buffers and event flags and learn which one is ready. Built on FreeRTOS
+ * queue sets: queues and semaphores are set members themselves, stream
+ * buffers and event flags signal the set through an internal binary
+ * semaphore on every send/set. With configUSE_QUEUE_SETS off members are
+ * polled every tick instead, same API with up to a tick of wake up latency.
+ *
+ * @code
+ * RHSWaitSet* set = rhs_wait_set_alloc(QUEUE_LEN + 1);
+ * rhs_wait_set_add_message_queue(set, queue);
+ * rhs_wait_set_add_stream_buffer(set, stream);
+ *
+ * for (;;)
+ * {
+ *     void* ready = rhs_wait_set_wait(set, RHSWaitForever);
+ *     if (ready == queue)
+ *         rhs_message_queue_get(queue, &msg, 0);
+ *     else if (ready == stream)
+ *         while (rhs_stream_buffer_receive(stream, buf, sizeof(buf), 0)) ...
+ * }
+ * @endcode
+ */
+#pragma once
+
+#include "base.h"
+#include "message_queue.h"
+#include "semaphore.h"
+#include "stream_buf.h"
+#include "event_flag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RHSWaitSet RHSWaitSet;
+
+/** Allocate wait set
+ *
+ * @warning    Cannot be used from ISR
+ *
+ * @param[in]  capacity  sum of message queue lengths and semaphore max counts
+ *                       plus one per stream buffer and event flag
+ *
+ * @return     pointer to RHSWaitSet instance
+ */
+RHSWaitSet* rhs_wait_set_alloc(uint32_t capacity);
+
+/** Free wait set, members are removed but not freed
+ *
+ * All message queue and semaphore members must be empty.
+ *
+ * @param      instance  pointer to RHSWaitSet instance
+ */
+void rhs_wait_set_free(RHSWaitSet* instance);
+
+/** Add message queue
+ *
+ * Queue must be empty and must not belong to another set. When the queue is
+ * returned by rhs_wait_set_wait exactly one message must be read from it.
+ *
+ * @param      instance  pointer to RHSWaitSet instance
+ * @param      queue     pointer to RHSMessageQueue instance
+ */
+void rhs_wait_set_add_message_queue(RHSWaitSet* instance, RHSMessageQueue* queue);
+
+/** Add semaphore
+ *
+ * Semaphore must not be available and must not belong to another set. When
+ * the semaphore is returned by rhs_wait_set_wait it must be acquired once.
+ *
+ * @param      instance   pointer to RHSWaitSet instance
+ * @param      semaphore  pointer to RHSSemaphore instance
+ */
+void rhs_wait_set_add_semaphore(RHSWaitSet* instance, RHSSemaphore* semaphore);
+
+/** Add stream buffer
+ *
+ * Every rhs_stream_buffer_send wakes the set. When the stream buffer is
+ * returned by rhs_wait_set_wait it should be drained with zero timeout reads,
+ * it may be empty if data was already consumed on a previous wake up.
+ *
+ * @param      instance       pointer to RHSWaitSet instance
+ * @param      stream_buffer  pointer to RHSStreamBuffer instance
+ */
+void rhs_wait_set_add_stream_buffer(RHSWaitSet* instance, RHSStreamBuffer* stream_buffer);
+
+/** Add event flag
+ *
+ * Every rhs_event_flag_set wakes the set. When the event flag is returned by
+ * rhs_wait_set_wait read it with rhs_event_flag_wait and zero timeout, no
+ * flags may be set after a spurious wake up.
+ *
+ * @param      instance    pointer to RHSWaitSet instance
+ * @param      event_flag  pointer to RHSEventFlag instance
+ */
+void rhs_wait_set_add_event_flag(RHSWaitSet* instance, RHSEventFlag* event_flag);
+
+/** Remove member
+ *
+ * Message queue and semaphore members must be empty. Stream buffer and event
+ * flag members must be removed before they are freed.
+ *
+ * @param      instance  pointer to RHSWaitSet instance
+ * @param      member    pointer to member previously added to the set
+ */
+void rhs_wait_set_remove(RHSWaitSet* instance, void* member);
+
+/** Wait until one of members is ready
+ *
+ * @warning    Cannot be used from ISR
+ *
+ * @param      instance  pointer to RHSWaitSet instance
+ * @param[in]  timeout   timeout in ticks
+ *
+ * @return     ready member as passed to rhs_wait_set_add_*, NULL on timeout
+ */
+void* rhs_wait_set_wait(RHSWaitSet* instance, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+/**
+ * @file wait_set_i.h
+ * RHSWaitSet internal hooks for members without native queue set support
+ */
+#pragma once
+
+#include "semaphore.h"
+#include "stream_buf.h"
+#include "event_flag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Attach proxy semaphore released on every send, NULL to detach */
+void rhs_stream_buffer_set_wait_set_proxy(RHSStreamBuffer* stream_buffer, RHSSemaphore* proxy);
+
+/** Attach proxy semaphore released on every set, NULL to detach */
+void rhs_event_flag_set_wait_set_proxy(RHSEventFlag* instance, RHSSemaphore* proxy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,35 +1,213 @@
 #include "rhs_hal.h"
+#include "rhs.h"
 
-void rhs_hal_init(void)
+#define TAG "RHSHal"
+
+#define RHS_HAL_INIT_STACK_SIZE 1024
+
+#ifndef RHS_HAL_SPEAKER_INIT_MODE
+#    define RHS_HAL_SPEAKER_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_FLASH_EX_INIT_MODE
+#    define RHS_HAL_FLASH_EX_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_RTC_INIT_MODE
+#    define RHS_HAL_RTC_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_I2C_INIT_MODE
+#    define RHS_HAL_I2C_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_RANDOM_INIT_MODE
+#    define RHS_HAL_RANDOM_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_USB_INIT_MODE
+#    define RHS_HAL_USB_INIT_MODE RHSHalInitModeEarly
+#endif
+#ifndef RHS_HAL_ETH_INIT_MODE
+#    define RHS_HAL_ETH_INIT_MODE RHSHalInitModeEarly
+#endif
+
+#if RHS_HAL_FLASH_EX
+static void rhs_hal_flash_ex_init_entry(void)
 {
-    rhs_hal_cortex_init_early();
-    rhs_hal_interrupt_init();
+    rhs_hal_flash_ex_init();
+}
+#endif
+
+#if RHS_HAL_I2C
+static void rhs_hal_i2c_init_entry(void)
+{
+    rhs_hal_i2c_init(&rhs_hal_i2c1_handle);
+}
+#endif
+
+// clang-format off
+static RHSHalInitInfo rhs_hal_init_table[RHSHalPeripheralCount] = {
 #if RHS_HAL_SPEAKER
-    rhs_hal_speaker_init();
+    [RHSHalPeripheralSpeaker] = {"speaker", rhs_hal_speaker_init, RHS_HAL_SPEAKER_INIT_MODE},
 #endif
 #if RHS_HAL_FLASH_EX
-    rhs_hal_flash_ex_init();
+    [RHSHalPeripheralFlashEx] = {"flash_ex", rhs_hal_flash_ex_init_entry, RHS_HAL_FLASH_EX_INIT_MODE},
 #endif
 #if RHS_HAL_RTC
-    rhs_hal_rtc_init();
+    [RHSHalPeripheralRtc] = {"rtc", rhs_hal_rtc_init, RHS_HAL_RTC_INIT_MODE},
 #endif
 #if RHS_HAL_IO
-    rhs_hal_io_init();
+    [RHSHalPeripheralIo] = {"io", rhs_hal_io_init, RHSHalInitModeEarly},
 #endif
 #if RHS_HAL_I2C
-    rhs_hal_i2c_init(&rhs_hal_i2c1_handle);
-#endif
-#if RHS_HAL_SERIAL
-#endif
-#if RHS_HAL_CAN
+    [RHSHalPeripheralI2c] = {"i2c", rhs_hal_i2c_init_entry, RHS_HAL_I2C_INIT_MODE},
 #endif
 #if RHS_HAL_RANDOM
-    rhs_hal_random_init();
+    [RHSHalPeripheralRandom] = {"random", rhs_hal_random_init, RHS_HAL_RANDOM_INIT_MODE},
 #endif
 #if RHS_HAL_USB
-    rhs_hal_usb_init();
+    [RHSHalPeripheralUsb] = {"usb", rhs_hal_usb_init, RHS_HAL_USB_INIT_MODE},
 #endif
 #if RHS_HAL_ETH
-    rhs_hal_eth_init();
+    [RHSHalPeripheralEth] = {"eth", rhs_hal_eth_init, RHS_HAL_ETH_INIT_MODE},
 #endif
+};
+// clang-format on
+
+// Bit per peripheral, set once it is ready
+static RHSEventFlag* rhs_hal_init_ready = NULL;
+
+static bool rhs_hal_init_claim(RHSHalInitInfo* info)
+{
+    bool claimed = false;
+
+    RHS_CRITICAL_ENTER();
+    if (info->state == RHSHalInitStateIdle)
+    {
+        info->state = RHSHalInitStateRunning;
+        claimed     = true;
+    }
+    RHS_CRITICAL_EXIT();
+
+    return claimed;
+}
+
+static void rhs_hal_init_run(RHSHalPeripheral peripheral)
+{
+    RHSHalInitInfo* info  = &rhs_hal_init_table[peripheral];
+    const uint32_t  start = rhs_boot_begin();
+
+    info->init();
+
+    info->duration = rhs_hal_cortex_get_cycles() - start;
+    info->state    = RHSHalInitStateReady;
+    rhs_event_flag_set(rhs_hal_init_ready, 1UL << peripheral);
+    rhs_boot_mark(RHSBootEventTypePeripheral, info->name, start);
+}
+
+static void rhs_hal_init_async_free(void* context, uint32_t arg)
+{
+    (void) arg;
+    rhs_thread_join(context);
+    rhs_thread_free(context);
+}
+
+static int32_t rhs_hal_init_async(void* context)
+{
+    for (size_t i = 0; i < RHSHalPeripheralCount; i++)
+    {
+        RHSHalInitInfo* info = &rhs_hal_init_table[i];
+        if (info->init && info->mode == RHSHalInitModeAsync && rhs_hal_init_claim(info))
+        {
+            rhs_hal_init_run((RHSHalPeripheral) i);
+        }
+    }
+
+    // Thread can not free itself
+    rhs_timer_pending_callback(rhs_hal_init_async_free, rhs_thread_get_current(), 0);
+    return 0;
+}
+
+void rhs_hal_init(void)
+{
+    rhs_hal_cortex_init_early();
+
+    // Cycle counter is running from here
+    const uint32_t start = rhs_boot_begin();
+
+    rhs_hal_interrupt_init();
+
+    rhs_hal_init_ready = rhs_event_flag_alloc();
+
+    bool async = false;
+    for (size_t i = 0; i < RHSHalPeripheralCount; i++)
+    {
+        RHSHalInitInfo* info = &rhs_hal_init_table[i];
+        if (info->init == NULL)
+        {
+            continue;
+        }
+        if (info->mode == RHSHalInitModeEarly && rhs_hal_init_claim(info))
+        {
+            rhs_hal_init_run((RHSHalPeripheral) i);
+        }
+        async |= (info->mode == RHSHalInitModeAsync);
+    }
+
+    // Slow peripherals come up while services run
+    if (async)
+    {
+        RHSThread* thread = rhs_thread_alloc_ex(
+            "hal_init", RHS_HAL_INIT_STACK_SIZE, RHSThreadPriorityLow, rhs_hal_init_async, NULL);
+        rhs_thread_start(thread);
+    }
+
+    rhs_boot_mark(RHSBootEventTypeHalInit, "rhs_hal_init", start);
+}
+
+bool rhs_hal_init_ensure(RHSHalPeripheral peripheral)
+{
+    rhs_assert(peripheral < RHSHalPeripheralCount);
+
+    RHSHalInitInfo* info = &rhs_hal_init_table[peripheral];
+    rhs_assert(info->init);
+
+    if (info->state == RHSHalInitStateReady)
+    {
+        return true;
+    }
+    if (rhs_kernel_is_irq_or_masked())
+    {
+        return false;
+    }
+
+    if (rhs_hal_init_claim(info))
+    {
+        RHS_LOG_D(TAG, "Lazy init of %s", info->name);
+        rhs_hal_init_run(peripheral);
+    }
+    else
+    {
+        // Async thread or another caller is initializing it
+        rhs_assert((rhs_event_flag_wait(rhs_hal_init_ready,
+                                        1UL << peripheral,
+                                        RHSFlagWaitAny | RHSFlagNoClear,
+                                        RHSWaitForever) &
+                    RHSFlagError) == 0U);
+    }
+
+    return true;
+}
+
+bool rhs_hal_init_is_ready(RHSHalPeripheral peripheral)
+{
+    // No assert, the crash handler calls it
+    if (peripheral >= RHSHalPeripheralCount)
+    {
+        return false;
+    }
+    const RHSHalInitInfo* info = &rhs_hal_init_table[peripheral];
+    return (info->init != NULL) && (info->state == RHSHalInitStateReady);
+}
+
+const RHSHalInitInfo* rhs_hal_get_init_info(RHSHalPeripheral peripheral)
+{
+    rhs_assert(peripheral < RHSHalPeripheralCount);
+    return &rhs_hal_init_table[peripheral];
 }
@@ -25,6 +25,9 @@
 #endif
 #if RHS_HAL_CAN
 #    include "rhs_hal_can.h"
+#    ifdef RHS_HAL_CAN_VIRTUAL
+#        include "rhs_hal_can_virtual.h"
+#    endif
 #endif
 #if RHS_HAL_RANDOM
 #    include "rhs_hal_random.h"
@@ -37,4 +40,91 @@
 #    include "rhs_hal_eth.h"
 #endif
 
+typedef enum
+{
+    RHSHalInitModeEarly,  // In rhs_hal_init, default
+    RHSHalInitModeAsync,  // In low priority thread started by rhs_hal_init
+    RHSHalInitModeLazy,   // On first use
+} RHSHalInitMode;
+
+typedef enum
+{
+    RHSHalInitStateIdle,
+    RHSHalInitStateRunning,
+    RHSHalInitStateReady,
+} RHSHalInitState;
+
+typedef enum
+{
+    RHSHalPeripheralSpeaker,
+    RHSHalPeripheralFlashEx,
+    RHSHalPeripheralRtc,
+    RHSHalPeripheralIo,
+    RHSHalPeripheralI2c,
+    RHSHalPeripheralRandom,
+    RHSHalPeripheralUsb,
+    RHSHalPeripheralEth,
+    RHSHalPeripheralCount,
+} RHSHalPeripheral;
+
+typedef struct
+{
+    const char*              name;
+    void                     (*init)(void);  // NULL if peripheral is not built
+    RHSHalInitMode           mode;
+    volatile RHSHalInitState state;
+    uint32_t                 duration;  // Cycles
+} RHSHalInitInfo;
+
+/** Initialize HAL
+ *
+ * Cortex, interrupts and peripherals in early mode are initialized here.
+ * Peripherals are put into async or lazy mode with the RHS_HAL_ASYNC_INIT and
+ * RHS_HAL_LAZY_INIT cmake lists, IO is always initialized early.
+ */
 void rhs_hal_init(void);
+
+/** Make sure peripheral is initialized, called by peripheral API on entry
+ *
+ * Initializes a lazy peripheral in caller context or waits for the async
+ * thread. Never blocks in ISR.
+ *
+ * @param[in]  peripheral  peripheral
+ *
+ * @return     true if peripheral is ready, false only in ISR
+ */
+bool rhs_hal_init_ensure(RHSHalPeripheral peripheral);
+
+/** rhs_hal_init_ensure for APIs without an error return
+ *
+ * Such APIs are thread-only until the peripheral is ready. An ISR call before
+ * that crashes with a message naming the peripheral. APIs that can report an
+ * error return it instead, see rhs_hal_flash_ex_read.
+ */
+#define RHS_HAL_INIT_ENSURE(peripheral)                                                \
+    do                                                                                 \
+    {                                                                                  \
+        if (!rhs_hal_init_ensure(peripheral))                                          \
+        {                                                                              \
+            rhs_crash(#peripheral " used in ISR before init, first call from thread"); \
+        }                                                                              \
+    } while (0)
+
+/** Check that peripheral is initialized, never initializes it
+ *
+ * Safe with interrupts masked, for paths that must not block or crash such
+ * as the crash handler.
+ *
+ * @param[in]  peripheral  peripheral
+ *
+ * @return     true if peripheral is built and ready
+ */
+bool rhs_hal_init_is_ready(RHSHalPeripheral peripheral);
+
+/** Get peripheral init mode, state and duration
+ *
+ * @param[in]  peripheral  peripheral
+ *
+ * @return     init info
+ */
+const RHSHalInitInfo* rhs_hal_get_init_info(RHSHalPeripheral peripheral);
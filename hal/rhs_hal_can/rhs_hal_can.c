@@ -2,32 +2,60 @@
 #include "rcan.h"
 #include "rhs.h"
 #include "rhs_hal_can.h"
+#include "rhs_hal_can_common_i.h"
 #include "rhs_hal.h"
 
 #define TAG "rhs_hal_can"
 
-#define CAN_LOG_E(...) RHS_LOG_E(TAG, __VA_ARGS__)
-#ifndef CAN_LOG_E
-#    define CAN_LOG_E(...)
+#ifdef CAN2
+#    define RHS_HAL_CAN_FILTER_BANKS 28U  // Shared by CAN1 and CAN2
+#else
+#    define RHS_HAL_CAN_FILTER_BANKS 14U
 #endif
 
+#define RHS_HAL_CAN_ERROR_RING_MASK (RHS_HAL_CAN_ERROR_RING_SIZE - 1U)
+static_assert((RHS_HAL_CAN_ERROR_RING_SIZE & RHS_HAL_CAN_ERROR_RING_MASK) == 0,
+              "Error ring size must be a power of two");
+
+#define RHS_HAL_CAN_ERROR_REPORT_MS 10    // Error report batching and state poll period
+#define RHS_HAL_CAN_INIT_MODE_US    10000  // Initialization mode request timeout
+#define RHS_HAL_CAN_INIT_MODE_MS    10     // Same timeout for the recovery, checked on report ticks
+
+typedef enum
+{
+    RHSHalCANRecoveryIdle,
+    RHSHalCANRecoveryBackoff,    // Bus-off, waiting for the back-off
+    RHSHalCANRecoveryEnter,      // INRQ set, waiting for INAK
+    RHSHalCANRecoveryLeave,      // INRQ cleared, waiting for INAK to drop
+    RHSHalCANRecoveryRequested,  // Waiting for 128 x 11 recessive bits
+} RHSHalCANRecovery;
+
 typedef struct
 {
-    bool                      enabled;
-    rcan                      rcan;
-    uint8_t                   lec;
-    uint8_t                   tec;
-    uint8_t                   rec;
-    RHSHalCANAsyncRxCallback  rx_callback;
-    void*                     rx_context;
-    RHSHalCANAsyncTxCallback  tx_callback;
-    void*                     tx_context;
-    RHSHalCANAsyncSCECallback sce_callback;
-    void*                     sce_context;
-    RHSHalCANStatistic        statistic;
+    RHSHalCANCommon*    common;  // Backend independent part, rhs_hal_can_common of the channel
+    rcan                rcan;
+    RHSHalCANTxQueue    tx_queue;
+    uint32_t            tx_busy;   // Mailboxes holding a tx_mailbox frame
+    uint32_t            tx_abort;  // Mailboxes with abort requested
+    RHSHalCANTxEntry    tx_mailbox[RHS_HAL_CAN_TX_MAILBOXES];
+    RHSHalCANErrorCode  error_code;  // Last code put into the ring since the last report
+    uint32_t            error_head;  // Written with interrupts masked
+    uint32_t            error_tail;  // Written by timer thread only
+    RHSHalCANErrorEvent error_ring[RHS_HAL_CAN_ERROR_RING_SIZE];
+    RHSTimerWheelEntry  error_entry;
+    RHSHalCANRecovery   recovery;
+    uint32_t            recovery_tick;  // Kernel tick to leave bus-off at, or to give up the INAK wait
+    uint32_t            backoff_ms;
 } RHSHalCAN;
 
-static RHSHalCAN rhs_hal_can[RHSHalCANIdMax] = {0};
+static RHSHalCAN rhs_hal_can[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = {.common = &rhs_hal_can_common[RHSHalCANId1]},
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = {.common = &rhs_hal_can_common[RHSHalCANId2]},
+#endif
+};
+
+static RHSTimerWheel* rhs_hal_can_error_wheel = NULL;  // Shared by all channels, allocated on first init
 
 static uint32_t HAL_RCC_CAN1_CLK_ENABLED = 0;
 
@@ -190,178 +218,517 @@ static uint8_t get_can_num_interface(CAN_TypeDef* can)
     }
 }
 
-static void print_ecr(CAN_TypeDef* can)
+static RHSHalCANErrorState can_error_state(uint32_t esr)
 {
-    uint32_t ecr     = can->ESR;
-    uint8_t  tec     = (ecr >> 16) & 0xFF;
-    uint8_t  rec     = (ecr >> 24) & 0xFF;
-    uint8_t  lec     = (ecr >> 4) & 0x03;
-    uint8_t  can_num = get_can_num_interface(can);
-
-    if (lec == 0b000 && rec == 0 && tec == 0)
+    if (esr & CAN_ESR_BOFF)
     {
-        return;
+        return RHSHalCANErrorStateBusOff;
     }
-
-    if (lec == 0b001)
+    if (esr & CAN_ESR_EPVF)
     {
-        CAN_LOG_E("CAN%d Stuff error", can_num);
-        /* Following the bit stuffing process, if more than five consecutive bits of
-    the same level occur on the Bus, a "Stuff Error" is signalled. */
+        return RHSHalCANErrorStatePassive;
     }
-    if (lec == 0b010)
+    if (esr & CAN_ESR_EWGF)
     {
-        CAN_LOG_E("CAN%d Form error", can_num);
-        /* Form check checks the CAN frame sent/received for a standard
-    format. Violation of fixed bit format results in a Form Error. */
+        return RHSHalCANErrorStateWarning;
     }
-    if (lec == 0b011)
+    return RHSHalCANErrorStateActive;
+}
+
+// Count state change or bus error and put it into the error ring, from SCE ISR and timer thread
+static void can_error_update(RHSHalCAN* can, uint32_t esr, RHSHalCANErrorCode code)
+{
+    const uint64_t            now   = rhs_hal_cortex_get_cycles64();
+    const RHSHalCANErrorState state = can_error_state(esr);
+
+    RHS_CRITICAL_ENTER();
+    RHSHalCANErrorStatistic* error   = &can->common->error;
+    const bool               changed = state != error->state;
+
+    error->tec = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+    error->rec = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+    if (changed)
     {
-        CAN_LOG_E("CAN%d Acknowledgment error", can_num);
-        /* An acknowledgment error happens when the transmitter
-    doesn’t receive an Acknowledgment (ACK) bit from other nodes
-    after transmitting a data frame. */
+        error->state = state;
+        error->warnings += state == RHSHalCANErrorStateWarning ? 1U : 0U;
+        error->passives += state == RHSHalCANErrorStatePassive ? 1U : 0U;
+        error->bus_offs += state == RHSHalCANErrorStateBusOff ? 1U : 0U;
     }
-    if (lec == 0b100)
+    if (code != RHSHalCANErrorCodeNone)
     {
-        RHS_LOG_E(TAG, "CAN%d Bit recessive error", can_num);
-        /* This occurs when the transmitter sends a dominant bit (logic ‘0’), but
-    sees a recessive bit (logic ‘1’) on the bus. In CAN, a dominant bit
-    “overwrites” a recessive one. So, if a transmitter trying to send ‘0’
-    sees ‘1’, either another node is transmitting ‘1’ simultaneously, or
-    there’s an issue with the transmitter itself.  */
+        error->errors[code]++;
     }
-    if (lec == 0b101)
+
+    if (changed || (code != RHSHalCANErrorCodeNone && code != can->error_code))
     {
-        CAN_LOG_E("CAN%d Bit dominant error", can_num);
-        /* This happens when the transmitter sends a recessive bit
-    (logic ‘1’), but sees a dominant bit (logic ‘0’) on the bus. This
-    means another node is simultaneously transmitting a ‘0’ (which
-    dominates on the bus), or there’s a bus driver problem. */
+        if (can->error_head - can->error_tail < RHS_HAL_CAN_ERROR_RING_SIZE)
+        {
+            can->error_ring[can->error_head & RHS_HAL_CAN_ERROR_RING_MASK] = (RHSHalCANErrorEvent){
+                .timestamp = now,
+                .state     = state,
+                .code      = changed ? RHSHalCANErrorCodeNone : code,
+                .tec       = error->tec,
+                .rec       = error->rec,
+            };
+            can->error_head++;
+        }
+        else
+        {
+            error->events_lost++;
+        }
+        can->error_code = changed ? can->error_code : code;
     }
-    if (lec == 0b110)
+    RHS_CRITICAL_EXIT();
+}
+
+// Arm the report while there is something to report. A timer command queue too full to start an idle
+// wheel from the ISR is not fatal: the ring keeps the events and the next SCE interrupt or TX submit retries.
+static void can_error_kick(RHSHalCAN* can)
+{
+    if (rhs_timer_wheel_is_running(&can->error_entry))
     {
-        CAN_LOG_E("CAN%d CRC error", can_num);
-        /*  A Cyclic Redundancy Check (CRC) error. */
+        return;
     }
-    if (lec == 0b111)
+    if (can->error_tail != rhs_atomic_load(&can->error_head) || can->common->error.state != RHSHalCANErrorStateActive)
     {
-        CAN_LOG_E("CAN%d Set by software", can_num);
-        /* This error isn’t a hardware error detected by the CAN controller
-    itself. It’s set by the software for purposes like debugging, testing,
-    or handling user-defined exception situations. For instance, it might
-    signal invalid data, a timeout, or other software problems. */
+        rhs_timer_wheel_try_start(rhs_hal_can_error_wheel, &can->error_entry, 0);
     }
-    CAN_LOG_E("CAN%d rec: %d, tec: %d", can_num, rec, tec);
 }
 
 static void can_sce_callback(void* context)
 {
     rhs_assert(context);
     RHSHalCAN*        can        = (RHSHalCAN*) context;
+    RHSHalCANCommon*  common     = can->common;
     CAN_TypeDef*      can_handle = can->rcan.handle.Instance;
     uint8_t           can_num    = get_can_num_interface(can_handle);
     RHSHalCANSCEEvent event      = 0;
+    const uint32_t    esr        = can_handle->ESR;
+    uint32_t          code       = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos;
 
     if (can_handle->MSR & CAN_MSR_ERRI)
     {
-        CAN_LOG_E("CAN%d ERRI", can_num);
         can_handle->MSR = CAN_MSR_ERRI;
         event |= RHSHalCANSCEEventError;
     }
     if (can_handle->MSR & CAN_MSR_WKUI)
     {
-        CAN_LOG_E("CAN%d WKUI", can_num);
         can_handle->MSR = CAN_MSR_WKUI;
     }
-    if (can_handle->ESR & CAN_ESR_BOFF)
+    if (esr & CAN_ESR_BOFF)
     {
-        CAN_LOG_E("CAN%d BOFF", can_num);
         event |= RHSHalCANSCEEventBusOff;
     }
-    uint32_t tsr = can_handle->TSR;
+    // Code 7 is set by software, it marks the code as read so the next error is told apart
+    if (code == RHSHalCANErrorCodeMax)
+    {
+        code = RHSHalCANErrorCodeNone;
+    }
+    else if (code != RHSHalCANErrorCodeNone)
+    {
+        can_handle->ESR = CAN_ESR_LEC;
+    }
 
+    uint32_t tsr = can_handle->TSR;
     if (tsr & (CAN_TSR_ALST0 | CAN_TSR_ALST1 | CAN_TSR_ALST2 | CAN_TSR_TERR0 | CAN_TSR_TERR1 | CAN_TSR_TERR2))
     {
-        can->statistic.tx_errs++;
+        rhs_atomic_add(&common->statistic.tx_errs, 1);
+        const uint32_t tec = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+        if ((tsr & (CAN_TSR_TERR0 | CAN_TSR_TERR1 | CAN_TSR_TERR2)) && tec >= 0x80U)
+        {
+            event |= RHSHalCANSCEEventTXPassive;
+        }
+    }
+    else
+    {
+        rhs_atomic_add(&common->statistic.rx_errs, 1);
+    }
+    if (((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos) >= 0x80U)
+    {
+        event |= RHSHalCANSCEEventRXPassive;
+    }
 
-        if (tsr & (CAN_TSR_ALST0 | CAN_TSR_ALST1 | CAN_TSR_ALST2))
+    // Logging is left to the timer thread, the ISR only records
+    can_error_update(can, esr, (RHSHalCANErrorCode) code);
+    can_error_kick(can);
+
+    if (common->sce_callback)
+    {
+        common->sce_callback(can_num, event, common->sce_context);
+    }
+}
+
+// Request or leave initialization mode, waits for the acknowledge, thread context
+static bool can_init_mode(CAN_TypeDef* can_handle, bool enter)
+{
+    RHSHalCortexTimer timer = rhs_hal_cortex_timer_get(RHS_HAL_CAN_INIT_MODE_US);
+
+    if (enter)
+    {
+        can_handle->MCR |= CAN_MCR_INRQ;
+    }
+    else
+    {
+        can_handle->MCR &= ~CAN_MCR_INRQ;
+    }
+    while (((can_handle->MSR & CAN_MSR_INAK) != 0U) != enter)
+    {
+        if (rhs_hal_cortex_timer_is_expired(timer))
         {
-            CAN_LOG_E("CAN%d Arbitration lost", can_num);
+            return false;
         }
-        if (tsr & (CAN_TSR_TERR0 | CAN_TSR_TERR1 | CAN_TSR_TERR2))
+    }
+    return true;
+}
+
+// Timer thread: log and pass on recorded events, poll the way back to error active and leave bus-off
+static void can_error_report(void* context)
+{
+    RHSHalCAN*        can = context;
+    const RHSHalCANId id  = (RHSHalCANId) (can - rhs_hal_can);
+    if (!can->common->enabled)
+    {
+        return;
+    }
+
+    CAN_TypeDef* can_handle = can->rcan.handle.Instance;
+
+    // Error counters fall without an interrupt, state changes on the way down are found here
+    can_error_update(can, can_handle->ESR, RHSHalCANErrorCodeNone);
+
+    while (can->error_tail != rhs_atomic_load(&can->error_head))
+    {
+        const RHSHalCANErrorEvent event = can->error_ring[can->error_tail & RHS_HAL_CAN_ERROR_RING_MASK];
+        can->error_tail++;
+        rhs_hal_can_common_error_report(id, &event);
+    }
+
+    RHS_CRITICAL_ENTER();
+    can->error_code                 = RHSHalCANErrorCodeNone;
+    const RHSHalCANErrorState state = can->common->error.state;
+    RHS_CRITICAL_EXIT();
+
+    uint32_t       poll = rhs_ms_to_ticks(RHS_HAL_CAN_ERROR_REPORT_MS);
+    const uint32_t tick = rhs_get_tick();
+    if (state != RHSHalCANErrorStateBusOff)
+    {
+        if (can->recovery == RHSHalCANRecoveryEnter)
+        {
+            can_handle->MCR &= ~CAN_MCR_INRQ;
+        }
+        if (can->recovery != RHSHalCANRecoveryIdle)
+        {
+            can->recovery = RHSHalCANRecoveryIdle;
+            rhs_atomic_add(&can->common->error.recoveries, 1);
+            RHS_LOG_I(TAG, "CAN%d left bus-off", id);
+        }
+        if (state == RHSHalCANErrorStateActive)
         {
-            // can_handle->TSR = CAN_TSR_ABRQ0;
-            // can_handle->TSR = CAN_TSR_ABRQ1;
-            // can_handle->TSR = CAN_TSR_ABRQ2;
-            CAN_LOG_E("CAN%d Transmission error", can_num);
-            if (((can_handle->ESR >> 16) & 0xFF) >= 0x80)
+            return;
+        }
+    }
+    else if (can->recovery == RHSHalCANRecoveryIdle)
+    {
+        can->recovery      = RHSHalCANRecoveryBackoff;
+        can->recovery_tick = tick + rhs_ms_to_ticks(can->backoff_ms);
+        poll               = can->recovery_tick - tick;
+        RHS_LOG_W(TAG, "CAN%d bus-off, recovery in %lu ms", id, (unsigned long) can->backoff_ms);
+    }
+    else if (can->recovery == RHSHalCANRecoveryBackoff)
+    {
+        if ((int32_t) (tick - can->recovery_tick) < 0)
+        {
+            poll = can->recovery_tick - tick;
+        }
+        // Automatic bus-off management is off, a pass through initialization mode starts the recovery
+        else
+        {
+            can_handle->MCR |= CAN_MCR_INRQ;
+            can->recovery      = RHSHalCANRecoveryEnter;
+            can->recovery_tick = tick + rhs_ms_to_ticks(RHS_HAL_CAN_INIT_MODE_MS);
+        }
+    }
+    else if (can->recovery == RHSHalCANRecoveryEnter || can->recovery == RHSHalCANRecoveryLeave)
+    {
+        // INAK is checked once per report tick, the timer thread never spins on it
+        const bool enter = can->recovery == RHSHalCANRecoveryEnter;
+        if (((can_handle->MSR & CAN_MSR_INAK) != 0U) == enter)
+        {
+            if (enter)
             {
-                event |= RHSHalCANSCEEventTXPassive;
+                can_handle->MCR &= ~CAN_MCR_INRQ;
+                can->recovery      = RHSHalCANRecoveryLeave;
+                can->recovery_tick = tick + rhs_ms_to_ticks(RHS_HAL_CAN_INIT_MODE_MS);
             }
+            else
+            {
+                can->recovery = RHSHalCANRecoveryRequested;
+            }
+        }
+        else if ((int32_t) (tick - can->recovery_tick) >= 0)
+        {
+            can_handle->MCR &= ~CAN_MCR_INRQ;
+            can->recovery      = RHSHalCANRecoveryBackoff;
+            can->recovery_tick = tick + rhs_ms_to_ticks(can->backoff_ms);
+            poll               = can->recovery_tick - tick;
+            RHS_LOG_E(TAG, "CAN%d recovery request timed out, retry in %lu ms", id, (unsigned long) can->backoff_ms);
         }
     }
+
+    rhs_timer_wheel_start(rhs_hal_can_error_wheel, &can->error_entry, poll);
+}
+
+// Copy frame out of FIFO mailbox, registers are cheaper than HAL_CAN_GetRxMessage in the RX ISR
+static void can_rx_read_mailbox(const CAN_FIFOMailBox_TypeDef* mailbox, RHSHalCANFrameType* frame)
+{
+    const uint32_t rir  = mailbox->RIR;
+    const uint32_t low  = mailbox->RDLR;
+    const uint32_t high = mailbox->RDHR;
+
+    if (rir & CAN_RI0R_IDE)
+    {
+        frame->type = FrameTypeExtID;
+        frame->id   = (rir >> CAN_RI0R_EXID_Pos) & 0x1FFFFFFFU;
+    }
     else
     {
-        can->statistic.rx_errs++;
+        frame->type = FrameTypeStdID;
+        frame->id   = (rir >> CAN_RI0R_STID_Pos) & 0x7FFU;
     }
+    frame->rtr = (rir & CAN_RI0R_RTR) != 0U;
+    frame->len = MIN(mailbox->RDTR & CAN_RDT0R_DLC, 8U);
+    memcpy(&frame->payload[0], &low, sizeof(low));
+    memcpy(&frame->payload[4], &high, sizeof(high));
+}
 
-    can->lec = (can_handle->ESR >> 4) & 0x03;
-    print_ecr(can_handle);
+// Move all pending frames of both hardware FIFOs into the software ring.
+// RX0 and RX1 ISRs share one priority, so they never preempt each other and the ring has one producer.
+static void can_rx_drain(RHSHalCAN* can)
+{
+    RHSHalCANCommon*   common     = can->common;
+    CAN_TypeDef*       can_handle = can->rcan.handle.Instance;
+    volatile uint32_t* rfr[2]     = {&can_handle->RF0R, &can_handle->RF1R};
+    uint32_t           head       = common->rx_head;
+    uint32_t           bits       = 0;
+    uint32_t           frames     = 0;
+    uint64_t           now;
+    bool               pending;
+
+    do
+    {
+        pending = false;
+        now     = rhs_hal_cortex_get_cycles64();
+        for (uint32_t fifo = 0; fifo < 2U; fifo++)
+        {
+            // RF0R and RF1R share the bit layout. Plain writes, read-modify-write would clear FOVR unseen.
+            const uint32_t rfr_value = *rfr[fifo];
+            if (rfr_value & CAN_RF0R_FOVR0)
+            {
+                *rfr[fifo] = CAN_RF0R_FOVR0;
+                rhs_atomic_add(&common->statistic.rx_ovfs, 1);
+            }
+            if ((rfr_value & CAN_RF0R_FMP0) == 0U)
+            {
+                continue;
+            }
+
+            pending = true;
+            if (head - common->rx_tail < RHS_HAL_CAN_RX_RING_SIZE)
+            {
+                RHSHalCANFrameType* frame = &common->rx_ring[head & RHS_HAL_CAN_RX_RING_MASK];
+                can_rx_read_mailbox(&can_handle->sFIFOMailBox[fifo], frame);
+                frame->timestamp = now;
+                rhs_hal_can_common_capture_put(common, frame, false);
+                bits += rhs_hal_can_frame_bits(frame);
+                frames++;
+                head++;
+                __DMB();
+                common->rx_head = head;
+                rhs_atomic_add(&common->statistic.rx_msgs, 1);
+            }
+            else
+            {
+                rhs_atomic_add(&common->statistic.rx_drops, 1);
+            }
+            *rfr[fifo] = CAN_RF0R_RFOM0;
+        }
+    } while (pending);
 
-    if (can->sce_callback)
+    if (frames)
     {
-        can->sce_callback(can_num, event, can->sce_context);
+        RHS_CRITICAL_ENTER();
+        rhs_hal_can_common_load_add(common, now, bits, frames);
+        RHS_CRITICAL_EXIT();
     }
 }
 
 static void can_rx_callback(void* context)
 {
     rhs_assert(context);
-    RHSHalCAN*   can        = (RHSHalCAN*) context;
-    CAN_TypeDef* can_handle = can->rcan.handle.Instance;
-    uint8_t      can_num    = get_can_num_interface(can_handle);
+    RHSHalCAN*       can        = (RHSHalCAN*) context;
+    RHSHalCANCommon* common     = can->common;
+    CAN_TypeDef*     can_handle = can->rcan.handle.Instance;
+    uint8_t          can_num    = get_can_num_interface(can_handle);
 
-    if (can_handle->RF0R & CAN_RF0R_FOVR0)
+    can_rx_drain(can);
+
+    if (common->rx_callback && (common->rx_head - common->rx_tail >= common->rx_threshold))
     {
-        can->statistic.rx_ovfs++;
+        common->rx_callback(can_num, common->rx_context);
     }
+}
+
+static void can_tx_load(RHSHalCAN* can, uint32_t mailbox, const RHSHalCANTxEntry* entry)
+{
+    CAN_TxMailBox_TypeDef*    tx    = &can->rcan.handle.Instance->sTxMailBox[mailbox];
+    const RHSHalCANFrameType* frame = &entry->frame;
+    uint32_t                  low;
+    uint32_t                  high;
+    uint32_t                  tir;
 
-    if (can->rx_callback)
+    if (frame->type == FrameTypeExtID)
     {
-        can->rx_callback(can_num, can->rx_context);
+        tir = ((frame->id & 0x1FFFFFFFU) << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE;
     }
+    else
+    {
+        tir = (frame->id & 0x7FFU) << CAN_TI0R_STID_Pos;
+    }
+    if (frame->rtr)
+    {
+        tir |= CAN_TI0R_RTR;
+    }
+    memcpy(&low, &frame->payload[0], sizeof(low));
+    memcpy(&high, &frame->payload[4], sizeof(high));
+
+    can->tx_mailbox[mailbox]        = *entry;
+    can->tx_mailbox[mailbox].loaded = rhs_hal_cortex_get_cycles();
+    can->tx_busy |= 1U << mailbox;
+    tx->TDTR = MIN(frame->len, 8U);
+    tx->TDLR = low;
+    tx->TDHR = high;
+    tx->TIR  = tir | CAN_TI0R_TXRQ;
 }
 
-static void can_tx_callback(void* context)
+// Account completed mailboxes at time now, an aborted frame goes back into the queue with its submit
+// order. Runs with interrupts masked. Returns mask of completed mailboxes.
+static uint32_t can_tx_complete(RHSHalCAN* can, uint64_t now)
 {
-    rhs_assert(context);
-    RHSHalCAN*   can        = (RHSHalCAN*) context;
-    CAN_TypeDef* can_handle = can->rcan.handle.Instance;
+    CAN_TypeDef*   can_handle = can->rcan.handle.Instance;
+    const uint32_t tsr        = can_handle->TSR;
+    uint32_t       done       = 0;
 
-    can->statistic.tx_msgs++;
-    if (can_handle->TSR & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2))
+    for (uint32_t mailbox = 0; mailbox < RHS_HAL_CAN_TX_MAILBOXES; mailbox++)
     {
-        if (can_handle->TSR & CAN_TSR_RQCP0)
+        // Mailbox status bits repeat every 8 bits in TSR
+        const uint32_t shift = mailbox * 8U;
+        const uint32_t bit   = 1U << mailbox;
+        if ((tsr & (CAN_TSR_RQCP0 << shift)) == 0U)
+        {
+            continue;
+        }
+        can_handle->TSR = CAN_TSR_RQCP0 << shift;  // Also clears TXOK, ALST and TERR
+        done |= bit;
+        if ((can->tx_busy & bit) == 0U)
         {
-            can_handle->TSR = CAN_TSR_RQCP0;
+            continue;
         }
-        if (can_handle->TSR & CAN_TSR_RQCP1)
+
+        RHSHalCANTxEntry* entry = &can->tx_mailbox[mailbox];
+        can->tx_busy &= ~bit;
+        if (tsr & (CAN_TSR_TXOK0 << shift))
         {
-            can_handle->TSR = CAN_TSR_RQCP1;
+            const uint32_t cycles_per_us = MAX(rhs_hal_cortex_get_cycles_frequency() / 1000000U, 1U);
+            rhs_hal_can_common_tx_sent(can->common, entry, now, ((uint32_t) now - entry->loaded) / cycles_per_us);
         }
-        if (can_handle->TSR & CAN_TSR_RQCP2)
+        else if (can->tx_abort & bit)
         {
-            can_handle->TSR = CAN_TSR_RQCP2;
+            rhs_hal_can_tx_queue_push(&can->tx_queue, entry);
+            rhs_atomic_add(&can->common->tx_statistic.aborts, 1);
         }
+        // Otherwise lost without automatic retransmission, the SCE ISR counts it in tx_errs
+        can->tx_abort &= ~bit;
+    }
+    return done;
+}
+
+// Move queue head into free mailboxes. When none is free and preempt is set, abort the mailbox that
+// loses arbitration to the head. A frame with the head's key in a mailbox stops the refill, so equal
+// ids keep their order. Runs with interrupts masked.
+static void can_tx_refill(RHSHalCAN* can, bool preempt)
+{
+    CAN_TypeDef* can_handle = can->rcan.handle.Instance;
+
+    while (can->tx_queue.count > 0)
+    {
+        const RHSHalCANTxEntry* head  = &can->tx_queue.heap[0];
+        const uint32_t          empty = (can_handle->TSR >> CAN_TSR_TME0_Pos) & 0x7U;
+        uint32_t                free  = RHS_HAL_CAN_TX_MAILBOXES;
+        uint32_t                worst = RHS_HAL_CAN_TX_MAILBOXES;
 
-        if (can->tx_callback)
+        for (uint32_t mailbox = 0; mailbox < RHS_HAL_CAN_TX_MAILBOXES; mailbox++)
         {
-            can->tx_callback(can->tx_context);
+            const uint32_t bit = 1U << mailbox;
+            if (can->tx_busy & bit)
+            {
+                // An empty busy mailbox waits for the TX ISR, its frame may come back from an abort
+                if (can->tx_mailbox[mailbox].key == head->key)
+                {
+                    return;
+                }
+                if ((empty & bit) == 0U &&
+                    (worst == RHS_HAL_CAN_TX_MAILBOXES || can->tx_mailbox[mailbox].key > can->tx_mailbox[worst].key))
+                {
+                    worst = mailbox;
+                }
+            }
+            else if (empty & bit)
+            {
+                free = MIN(free, mailbox);
+            }
         }
+
+        if (free < RHS_HAL_CAN_TX_MAILBOXES)
+        {
+            can_tx_load(can, free, head);
+            rhs_hal_can_tx_queue_pop(&can->tx_queue);
+            continue;
+        }
+        if (preempt && worst < RHS_HAL_CAN_TX_MAILBOXES && can->tx_mailbox[worst].key > head->key &&
+            (can->tx_abort & (1U << worst)) == 0U)
+        {
+            // Completes in the TX ISR, as sent if the frame was on the bus already
+            can->tx_abort |= 1U << worst;
+            can_handle->TSR = CAN_TSR_ABRQ0 << (worst * 8U);
+        }
+        return;
+    }
+}
+
+static void can_tx_callback(void* context)
+{
+    rhs_assert(context);
+    RHSHalCAN*     can = (RHSHalCAN*) context;
+    const uint64_t now = rhs_hal_cortex_get_cycles64();
+
+    RHS_CRITICAL_ENTER();
+    const uint32_t done = can_tx_complete(can, now);
+    can_tx_refill(can, true);
+    RHS_CRITICAL_EXIT();
+
+    if (done && can->common->tx_callback)
+    {
+        can->common->tx_callback(can->common->tx_context);
     }
 }
 
+static void can_tx_reset(RHSHalCAN* can)
+{
+    can->tx_queue.count = 0;
+    can->tx_busy        = 0;
+    can->tx_abort       = 0;
+}
+
 /*********************************** CAN INIT ************************************/
 
 void* rhs_hal_can_get_handle(RHSHalCANId id)
@@ -371,41 +738,80 @@ void* rhs_hal_can_get_handle(RHSHalCANId id)
 
 void rhs_hal_can_init(RHSHalCANId id, uint32_t baud)
 {
-    rhs_assert(rhs_hal_can[id].enabled == false);
+    rhs_assert(rhs_hal_can_common[id].enabled == false);
+
+    RHSHalCAN* can  = &rhs_hal_can[id];
+    can->error_code = RHSHalCANErrorCodeNone;
+    can->error_head = 0;
+    can->error_tail = 0;
+    can->recovery   = RHSHalCANRecoveryIdle;
+    if (can->backoff_ms == 0U)
+    {
+        can->backoff_ms = RHS_HAL_CAN_BUS_OFF_BACKOFF_MS;
+    }
+    if (rhs_hal_can_error_wheel == NULL)
+    {
+        rhs_hal_can_error_wheel = rhs_timer_wheel_alloc(rhs_ms_to_ticks(RHS_HAL_CAN_ERROR_REPORT_MS));
+    }
+    rhs_timer_wheel_entry_init(&can->error_entry, can_error_report, can);
+    rhs_hal_can_common_init(id, baud);
 
+    // TX ISR serves the TX queue, SCE ISR tracks the error state from now on
+    can_tx_reset(can);
     switch (id)
     {
     case RHSHalCANId1:
         rhs_assert(rcan_start(&rhs_hal_can[id].rcan, (uint32_t) CAN1, baud) == true);
-        rhs_hal_can[id].enabled = true;
+        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Tx, can_tx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN1SCE, RHSHalInterruptPriorityLow, can_sce_callback, &rhs_hal_can[id]);
+        rhs_hal_can_common[id].enabled = true;
         break;
 #if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
     case RHSHalCANId2:
         rhs_assert(rcan_start(&rhs_hal_can[id].rcan, (uint32_t) CAN2, baud) == true);
-        rhs_hal_can[id].enabled = true;
+        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Tx, can_tx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN2SCE, RHSHalInterruptPriorityLow, can_sce_callback, &rhs_hal_can[id]);
+        rhs_hal_can_common[id].enabled = true;
         break;
 #endif
     case RHSHalCANIdMax:
     default:
         rhs_crash("No CAN interface");
     }
+
+    // Bus-off is left by can_error_report after the back-off, not by hardware right away
+    CAN_TypeDef* can_handle = can->rcan.handle.Instance;
+    rhs_assert(can_init_mode(can_handle, true));
+    can_handle->MCR &= ~CAN_MCR_ABOM;
+    rhs_assert(can_init_mode(can_handle, false));
+
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_TX_MAILBOX_EMPTY);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_LAST_ERROR_CODE);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_BUSOFF);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR_PASSIVE);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR_WARNING);
 }
 
 void rhs_hal_can_deinit(RHSHalCANId id)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
     switch (id)
     {
     case RHSHalCANId1:
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1SCE, NULL, NULL);
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Tx, NULL, NULL);
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Rx0, NULL, NULL);
+        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Rx1, NULL, NULL);
         break;
 #if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
     case RHSHalCANId2:
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2SCE, NULL, NULL);
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Tx, NULL, NULL);
         rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Rx0, NULL, NULL);
+        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Rx1, NULL, NULL);
         break;
 #endif
     case RHSHalCANIdMax:
@@ -420,114 +826,120 @@ void rhs_hal_can_deinit(RHSHalCANId id)
     HAL_CAN_DeactivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR_WARNING);
     HAL_CAN_DeactivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_TX_MAILBOX_EMPTY);
     HAL_CAN_DeactivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_RX_FIFO0_MSG_PENDING);
-    rhs_hal_can[id].enabled = false;
+    HAL_CAN_DeactivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_RX_FIFO1_MSG_PENDING);
+    rhs_hal_can_common[id].rx_started = false;
+    rhs_hal_can_common[id].rx_head    = 0;
+    rhs_hal_can_common[id].rx_tail    = 0;
+    rhs_hal_can_common[id].enabled    = false;
+    can_tx_reset(&rhs_hal_can[id]);
+    rhs_timer_wheel_stop(rhs_hal_can_error_wheel, &rhs_hal_can[id].error_entry);
 }
 
-void rhs_hal_can_async_sce(RHSHalCANId id, RHSHalCANAsyncSCECallback callback, void* context)
+void rhs_hal_can_set_bus_off_backoff(RHSHalCANId id, uint32_t backoff_ms)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
-
-    rhs_hal_can[id].sce_callback = callback;
-    rhs_hal_can[id].sce_context  = context;
-
-    switch (id)
-    {
-    case RHSHalCANId1:
-        rhs_hal_interrupt_set_isr_ex(RHSHalInterruptIdCAN1SCE,
-                                     RHSHalInterruptPriorityLow,
-                                     can_sce_callback,
-                                     &rhs_hal_can[id]);
-        break;
-#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
-    case RHSHalCANId2:
-        rhs_hal_interrupt_set_isr_ex(RHSHalInterruptIdCAN2SCE,
-                                     RHSHalInterruptPriorityLow,
-                                     can_sce_callback,
-                                     &rhs_hal_can[id]);
-        break;
-#endif
-    case RHSHalCANIdMax:
-    default:
-        rhs_crash("No CAN interface");
-    }
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(backoff_ms > 0U);
 
-    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR);
-    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_LAST_ERROR_CODE);
-    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_BUSOFF);
-    // HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR_PASSIVE);
-    // HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_ERROR_WARNING);
+    rhs_hal_can[id].backoff_ms = backoff_ms;
 }
 
 bool rhs_hal_can_tx(RHSHalCANId id, RHSHalCANFrameType* frame)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
-    static uint8_t tec = 0;
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    RHSHalCAN*       can   = &rhs_hal_can[id];
+    RHSHalCANTxEntry entry = {
+        .frame = *frame, .key = rhs_hal_can_tx_key(frame), .cycles = rhs_hal_cortex_get_cycles()};
+    bool sent = false;
 
-    tec = (rhs_hal_can[id].rcan.handle.Instance->ESR >> 16) & 0xFF;
-    if (rhs_hal_can[id].tec != tec)
+    // Straight into a free mailbox, queued frames and equal ids in mailboxes go first
+    RHS_CRITICAL_ENTER();
+    if (can->tx_queue.count == 0)
     {
-        print_ecr(rhs_hal_can[id].rcan.handle.Instance);
-        rhs_hal_can[id].tec = tec;
+        entry.seq = can->tx_queue.seq++;
+        rhs_hal_can_tx_queue_push(&can->tx_queue, &entry);
+        can_tx_refill(can, false);
+        sent                = can->tx_queue.count == 0;
+        can->tx_queue.count = 0;
     }
-    rcan_frame rcan_frame = {0};
+    RHS_CRITICAL_EXIT();
 
-    rcan_frame.id   = frame->id;
-    rcan_frame.len  = frame->len;
-    rcan_frame.type = frame->type;
-    rcan_frame.rtr  = frame->rtr;
-    memcpy(rcan_frame.payload, frame->payload, frame->len);
-    if (rcan_send(&rhs_hal_can[id].rcan, &rcan_frame) == false)
+    if (!sent)
     {
-        rhs_hal_can[id].statistic.tx_ovfs++;
-        return false;
+        rhs_atomic_add(&can->common->statistic.tx_ovfs, 1);
     }
-    return true;
+    return sent;
 }
 
-void rhs_hal_can_tx_cmplt_cb(RHSHalCANId id, RHSHalCANAsyncTxCallback callback, void* context)
+bool rhs_hal_can_tx_submit(RHSHalCANId id, const RHSHalCANFrameType* frame)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
-    rhs_assert(callback);
-    rhs_assert(context);
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+    rhs_assert(frame);
 
-    rhs_hal_can[id].tx_callback = callback;
-    rhs_hal_can[id].tx_context  = context;
+    RHSHalCAN*       can   = &rhs_hal_can[id];
+    RHSHalCANTxEntry entry = {
+        .frame = *frame, .key = rhs_hal_can_tx_key(frame), .cycles = rhs_hal_cortex_get_cycles()};
+    bool queued = false;
 
-    switch (id)
+    RHS_CRITICAL_ENTER();
+    if (can->tx_queue.count < RHS_HAL_CAN_TX_QUEUE_SIZE)
     {
-    case RHSHalCANId1:
-        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Tx, can_tx_callback, &rhs_hal_can[id]);
-        break;
-#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
-    case RHSHalCANId2:
-        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Tx, can_tx_callback, &rhs_hal_can[id]);
-        break;
-#endif
-    case RHSHalCANIdMax:
-    default:
-        rhs_crash("No CAN interface");
+        entry.seq = can->tx_queue.seq++;
+        rhs_hal_can_tx_queue_push(&can->tx_queue, &entry);
+        can_tx_refill(can, true);
+        can->common->tx_statistic.peak = MAX(can->common->tx_statistic.peak, can->tx_queue.count);
+        queued                         = true;
     }
+    RHS_CRITICAL_EXIT();
 
-    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_TX_MAILBOX_EMPTY);
+    // Retries a report the SCE ISR could not arm
+    can_error_kick(can);
+
+    if (!queued)
+    {
+        rhs_atomic_add(&can->common->tx_statistic.drops, 1);
+        rhs_atomic_add(&can->common->statistic.tx_ovfs, 1);
+    }
+    return queued;
+}
+
+size_t rhs_hal_can_tx_pending(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    return rhs_atomic_load(&rhs_hal_can[id].tx_queue.count);
 }
 
 void rhs_hal_can_async_rx_start(RHSHalCANId id, RHSHalCANAsyncRxCallback callback, void* context)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
     rhs_assert(callback);
     rhs_assert(context);
 
-    rhs_hal_can[id].rx_callback = callback;
-    rhs_hal_can[id].rx_context  = context;
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+    common->rx_callback     = callback;
+    common->rx_context      = context;
+    if (common->rx_threshold == 0)
+    {
+        common->rx_threshold = 1;
+    }
+    common->rx_started = true;
 
+    // High priority keeps the 3 frame hardware FIFOs from overrunning at 1 Mbit/s
     switch (id)
     {
     case RHSHalCANId1:
-        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN1Rx0, can_rx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN1Rx0, RHSHalInterruptPriorityHigh, can_rx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN1Rx1, RHSHalInterruptPriorityHigh, can_rx_callback, &rhs_hal_can[id]);
         break;
 #if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
     case RHSHalCANId2:
-        rhs_hal_interrupt_set_isr(RHSHalInterruptIdCAN2Rx0, can_rx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN2Rx0, RHSHalInterruptPriorityHigh, can_rx_callback, &rhs_hal_can[id]);
+        rhs_hal_interrupt_set_isr_ex(
+            RHSHalInterruptIdCAN2Rx1, RHSHalInterruptPriorityHigh, can_rx_callback, &rhs_hal_can[id]);
         break;
 #endif
     case RHSHalCANIdMax:
@@ -536,17 +948,16 @@ void rhs_hal_can_async_rx_start(RHSHalCANId id, RHSHalCANAsyncRxCallback callbac
     }
 
     HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_RX_FIFO0_MSG_PENDING);
+    HAL_CAN_ActivateNotification(&rhs_hal_can[id].rcan.handle, CAN_IT_RX_FIFO1_MSG_PENDING);
 }
 
 bool rhs_hal_can_rx(RHSHalCANId id, RHSHalCANFrameType* frame)
 {
-    rhs_assert(rhs_hal_can[id].enabled == true);
-    static uint8_t rec = 0;
-    rec                = (rhs_hal_can[id].rcan.handle.Instance->ESR >> 24) & 0xFF;
-    if (rhs_hal_can[id].rec != rec)
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    if (rhs_hal_can_common[id].rx_started)
     {
-        print_ecr(rhs_hal_can[id].rcan.handle.Instance);
-        rhs_hal_can[id].rec = rec;
+        return rhs_hal_can_rx_batch(id, frame, 1) == 1;
     }
 
     rcan_frame rcan_frame = {0};
@@ -560,12 +971,77 @@ bool rhs_hal_can_rx(RHSHalCANId id, RHSHalCANFrameType* frame)
     frame->type = rcan_frame.type;
     frame->rtr  = rcan_frame.rtr;
     memcpy(frame->payload, rcan_frame.payload, rcan_frame.len);
-    rhs_hal_can[id].statistic.rx_msgs++;
+    frame->timestamp = rhs_hal_cortex_get_cycles64();  // Polled, time of read rather than of reception
+    rhs_atomic_add(&rhs_hal_can_common[id].statistic.rx_msgs, 1);
     return true;
 }
 
-RHSHalCANStatistic rhs_hal_can_get_statistic(RHSHalCANId id)
+// Filter banks belong to CAN1, CAN2 owns the banks from CAN2SB on
+static void rhs_hal_can_filter_range(RHSHalCANId id, uint32_t* first, uint32_t* count)
+{
+#ifdef CAN2
+    const uint32_t split = (CAN1->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    *first               = (id == RHSHalCANId1) ? 0U : split;
+    *count               = (id == RHSHalCANId1) ? split : RHS_HAL_CAN_FILTER_BANKS - split;
+#else
+    (void) id;
+    *first = 0;
+    *count = RHS_HAL_CAN_FILTER_BANKS;
+#endif
+}
+
+size_t rhs_hal_can_get_filter_banks(RHSHalCANId id)
 {
     rhs_assert(id < RHSHalCANIdMax);
-    return rhs_hal_can[id].statistic;
+
+    uint32_t first;
+    uint32_t count;
+    rhs_hal_can_filter_range(id, &first, &count);
+    return count;
+}
+
+bool rhs_hal_can_set_filters(RHSHalCANId id, const RHSHalCANFilter* filters, size_t count)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(filters || count == 0);
+
+    const RHSHalCANFilter accept_all = rhs_hal_can_filter_mask32(0, 0, RHSHalCANFilterFifo0);
+    uint32_t              first;
+    uint32_t              banks;
+
+    rhs_hal_can_filter_range(id, &first, &banks);
+    if (count > banks)
+    {
+        return false;
+    }
+    if (count == 0)
+    {
+        filters = &accept_all;
+        count   = 1;
+    }
+
+    CAN_TypeDef* master = CAN1;
+
+    // Mode, scale and FIFO registers are shared by both channels
+    RHS_CRITICAL_ENTER();
+    master->FMR |= CAN_FMR_FINIT;
+    for (uint32_t bank = first; bank < first + banks; bank++)
+    {
+        master->FA1R &= ~(1UL << bank);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t bit = 1UL << (first + i);
+
+        master->FM1R  = (filters[i].mode == RHSHalCANFilterModeList) ? (master->FM1R | bit) : (master->FM1R & ~bit);
+        master->FS1R  = (filters[i].scale == RHSHalCANFilterScale32) ? (master->FS1R | bit) : (master->FS1R & ~bit);
+        master->FFA1R = (filters[i].fifo == RHSHalCANFilterFifo1) ? (master->FFA1R | bit) : (master->FFA1R & ~bit);
+        master->sFilterRegister[first + i].FR1 = filters[i].fr1;
+        master->sFilterRegister[first + i].FR2 = filters[i].fr2;
+        master->FA1R |= bit;
+    }
+    master->FMR &= ~CAN_FMR_FINIT;
+    RHS_CRITICAL_EXIT();
+
+    return true;
 }
@@ -1,6 +1,32 @@
 #pragma once
 #include "stdint.h"
 #include "stdbool.h"
+#include "stddef.h"
+
+/** Software RX ring per channel, power of two */
+#ifndef RHS_HAL_CAN_RX_RING_SIZE
+#    define RHS_HAL_CAN_RX_RING_SIZE 32
+#endif
+
+/** Software TX queue per channel, frames */
+#ifndef RHS_HAL_CAN_TX_QUEUE_SIZE
+#    define RHS_HAL_CAN_TX_QUEUE_SIZE 32
+#endif
+
+/** Bus load metering window, ms */
+#ifndef RHS_HAL_CAN_LOAD_WINDOW_MS
+#    define RHS_HAL_CAN_LOAD_WINDOW_MS 100
+#endif
+
+/** Error event ring per channel, power of two */
+#ifndef RHS_HAL_CAN_ERROR_RING_SIZE
+#    define RHS_HAL_CAN_ERROR_RING_SIZE 16
+#endif
+
+/** Default wait before leaving bus-off, ms */
+#ifndef RHS_HAL_CAN_BUS_OFF_BACKOFF_MS
+#    define RHS_HAL_CAN_BUS_OFF_BACKOFF_MS 100
+#endif
 
 typedef enum
 {
@@ -16,6 +42,7 @@ typedef struct
     FrameType type;
     bool      rtr;
     uint8_t   payload[8];
+    uint64_t  timestamp;  // rhs_hal_cortex_get_cycles64 in the RX ISR, ignored on transmit
 } RHSHalCANFrameType;
 
 typedef struct
@@ -25,7 +52,8 @@ typedef struct
     uint32_t tx_ovfs;
     uint32_t rx_msgs;
     uint32_t rx_errs;
-    uint32_t rx_ovfs;
+    uint32_t rx_ovfs;   // Hardware FIFO overruns
+    uint32_t rx_drops;  // Frames dropped because the software RX ring was full
 } RHSHalCANStatistic;
 
 /**
@@ -66,6 +94,92 @@ typedef void (*RHSHalCANAsyncSCECallback)(RHSHalCANId id, RHSHalCANSCEEvent even
 
 void rhs_hal_can_async_sce(RHSHalCANId id, RHSHalCANAsyncSCECallback callback, void* context);
 
+/** ERROR STATE */
+
+typedef enum
+{
+    RHSHalCANErrorStateActive,   // TEC and REC below 96
+    RHSHalCANErrorStateWarning,  // TEC or REC from 96
+    RHSHalCANErrorStatePassive,  // TEC or REC above 127
+    RHSHalCANErrorStateBusOff,   // TEC above 255, not on the bus
+} RHSHalCANErrorState;
+
+/** Bus error, the bxCAN last error code */
+typedef enum
+{
+    RHSHalCANErrorCodeNone,
+    RHSHalCANErrorCodeStuff,
+    RHSHalCANErrorCodeForm,
+    RHSHalCANErrorCodeAck,
+    RHSHalCANErrorCodeBitRecessive,
+    RHSHalCANErrorCodeBitDominant,
+    RHSHalCANErrorCodeCrc,
+    RHSHalCANErrorCodeMax,
+} RHSHalCANErrorCode;
+
+typedef struct
+{
+    uint64_t            timestamp;  // rhs_hal_cortex_get_cycles64
+    RHSHalCANErrorState state;      // State after the event
+    RHSHalCANErrorCode  code;       // Bus error, None for a state change
+    uint8_t             tec;
+    uint8_t             rec;
+} RHSHalCANErrorEvent;
+
+typedef struct
+{
+    RHSHalCANErrorState state;
+    uint8_t             tec;
+    uint8_t             rec;
+    uint32_t            errors[RHSHalCANErrorCodeMax];  // By code, None is unused
+    uint32_t            warnings;                       // Entries into each state
+    uint32_t            passives;
+    uint32_t            bus_offs;
+    uint32_t            recoveries;   // Bus-off left
+    uint32_t            events_lost;  // Events dropped because the ring was full
+} RHSHalCANErrorStatistic;
+
+/** Error event callback
+ *
+ * Called in timer thread context, may log and block briefly.
+ *
+ * @param      id       CAN channel
+ * @param[in]  event    event
+ * @param      context  callback context
+ */
+typedef void (*RHSHalCANErrorCallback)(RHSHalCANId id, const RHSHalCANErrorEvent* event, void* context);
+
+/** Set error event callback
+ *
+ * The SCE ISR tracks the error state and puts state changes and bus errors
+ * into a ring of RHS_HAL_CAN_ERROR_RING_SIZE events. A bus error is put once
+ * per report unless its code changes, all of them are counted. The timer
+ * thread logs the events and passes them to callback.
+ *
+ * @param      id        CAN channel
+ * @param[in]  callback  callback, NULL to only log
+ * @param      context   callback context
+ */
+void rhs_hal_can_set_error_callback(RHSHalCANId id, RHSHalCANErrorCallback callback, void* context);
+
+/** Set wait before leaving bus-off
+ *
+ * After the wait the controller rejoins the bus once it has seen 128 times 11
+ * recessive bits, as the standard requires.
+ *
+ * @param      id          CAN channel
+ * @param[in]  backoff_ms  wait above 0, RHS_HAL_CAN_BUS_OFF_BACKOFF_MS by default
+ */
+void rhs_hal_can_set_bus_off_backoff(RHSHalCANId id, uint32_t backoff_ms);
+
+/** Get error state and counters
+ *
+ * @param      id    CAN channel
+ *
+ * @return     statistic
+ */
+RHSHalCANErrorStatistic rhs_hal_can_get_error_statistic(RHSHalCANId id);
+
 /** TRANSMISSION */
 
 bool rhs_hal_can_tx(RHSHalCANId id, RHSHalCANFrameType* frame);
@@ -82,6 +196,48 @@ typedef void (*RHSHalCANAsyncTxCallback)(void* context);
 
 void rhs_hal_can_tx_cmplt_cb(RHSHalCANId id, RHSHalCANAsyncTxCallback callback, void* context);
 
+typedef struct
+{
+    uint32_t queued;          // Frames waiting for a mailbox
+    uint32_t peak;            // Highest queued count
+    uint32_t drops;           // Submits refused because the queue was full
+    uint32_t aborts;          // Mailboxes aborted for a frame with a lower id
+    uint32_t latency_max_us;  // Longest time from submit to transmit complete
+    uint32_t latency_p99_us;  // 99th percentile, lower bound of histogram bucket
+} RHSHalCANTxQueueStatistic;
+
+/** Queue frame for transmission, never blocks, ISR safe
+ *
+ * Frames leave in bus arbitration order, the lowest id first, frames with the
+ * same id in submit order. The TX ISR moves the queue head into a free
+ * mailbox. If all three mailboxes are busy and the head wins arbitration over
+ * one of them, that mailbox is aborted and its frame queued again, so a low
+ * priority backlog in the mailboxes can't hold back a high priority frame.
+ * rhs_hal_can_tx uses a mailbox only when the queue is empty.
+ *
+ * @param      id     CAN channel
+ * @param[in]  frame  frame, copied
+ *
+ * @return     false if RHS_HAL_CAN_TX_QUEUE_SIZE frames are queued already
+ */
+bool rhs_hal_can_tx_submit(RHSHalCANId id, const RHSHalCANFrameType* frame);
+
+/** Get number of queued frames, without frames in mailboxes
+ *
+ * @param      id    CAN channel
+ *
+ * @return     frame count
+ */
+size_t rhs_hal_can_tx_pending(RHSHalCANId id);
+
+/** Get TX queue statistic, latency is also exported as canN_tx_latency_us histogram
+ *
+ * @param      id    CAN channel
+ *
+ * @return     statistic
+ */
+RHSHalCANTxQueueStatistic rhs_hal_can_get_tx_queue_statistic(RHSHalCANId id);
+
 /** RECEIVE */
 
 /** Receive callback
@@ -94,8 +250,279 @@ void rhs_hal_can_tx_cmplt_cb(RHSHalCANId id, RHSHalCANAsyncTxCallback callback,
  */
 typedef void (*RHSHalCANAsyncRxCallback)(RHSHalCANId id, void* context);
 
+/** Start interrupt driven receive
+ *
+ * RX ISRs drain both hardware FIFOs into a software ring of
+ * RHS_HAL_CAN_RX_RING_SIZE frames and call callback when the ring holds at
+ * least the wake threshold of frames. Read the ring with rhs_hal_can_rx or
+ * rhs_hal_can_rx_batch from one context only, usually the callback or one
+ * thread.
+ *
+ * @param      id        CAN channel
+ * @param      callback  called in RX ISR
+ * @param      context   callback context
+ */
 void rhs_hal_can_async_rx_start(RHSHalCANId id, RHSHalCANAsyncRxCallback callback, void* context);
 
+/** Set RX wake threshold, 1 by default
+ *
+ * With a threshold above 1 fewer frames than the threshold stay in the ring
+ * until more arrive, poll them with rhs_hal_can_rx_pending.
+ *
+ * @param      id      CAN channel
+ * @param[in]  frames  ring level that calls RX callback, 1 - RHS_HAL_CAN_RX_RING_SIZE
+ */
+void rhs_hal_can_set_rx_threshold(RHSHalCANId id, uint32_t frames);
+
+/** Read up to max frames from RX ring, ISR safe
+ *
+ * @param      id      CAN channel
+ * @param[out] frames  frames, oldest first
+ * @param[in]  max     frames capacity
+ *
+ * @return     number of frames read
+ */
+size_t rhs_hal_can_rx_batch(RHSHalCANId id, RHSHalCANFrameType* frames, size_t max);
+
+/** Get number of frames in RX ring
+ *
+ * @param      id    CAN channel
+ *
+ * @return     frame count
+ */
+size_t rhs_hal_can_rx_pending(RHSHalCANId id);
+
+/** Read one frame, from RX ring once async receive is started
+ *
+ * @param      id     CAN channel
+ * @param[out] frame  frame
+ *
+ * @return     true if frame is read
+ */
 bool rhs_hal_can_rx(RHSHalCANId id, RHSHalCANFrameType* frame);
 
 RHSHalCANStatistic rhs_hal_can_get_statistic(RHSHalCANId id);
+
+/** BUS LOAD */
+
+typedef struct
+{
+    uint32_t bits_per_s;          // Last complete window, stuff bits estimated
+    uint32_t frames_per_s;        // Last complete window
+    uint32_t load_permille;       // Last complete window, of the bitrate
+    uint32_t peak_load_permille;  // Busiest window since init or peak reset
+    uint64_t bits;                // Total
+    uint64_t frames;              // Total
+} RHSHalCANBusLoad;
+
+/** Estimate bits a frame takes on the wire
+ *
+ * Frame format bits including 3 bit intermission, plus half of the worst
+ * case stuff bits. Real stuffing depends on the data, so this is at most
+ * 10% off for a data frame.
+ *
+ * @param[in]  frame  frame
+ *
+ * @return     bit count
+ */
+inline static uint32_t rhs_hal_can_frame_bits(const RHSHalCANFrameType* frame)
+{
+    const uint32_t data      = frame->rtr ? 0U : 8U * (frame->len > 8U ? 8U : frame->len);
+    const uint32_t stuffable = (frame->type == FrameTypeExtID ? 54U : 34U) + data;
+    const uint32_t fixed     = (frame->type == FrameTypeExtID ? 67U : 47U) + data;
+    return fixed + (stuffable - 1U) / 8U;
+}
+
+/** Get bus load of channel
+ *
+ * Every received frame and every transmit completion adds its
+ * rhs_hal_can_frame_bits to a window of RHS_HAL_CAN_LOAD_WINDOW_MS, so rates
+ * lag by up to one window. Frames sent by other nodes and not received, for
+ * example because of acceptance filters, are not counted.
+ *
+ * @param      id    CAN channel
+ *
+ * @return     bus load
+ */
+RHSHalCANBusLoad rhs_hal_can_get_bus_load(RHSHalCANId id);
+
+/** Reset peak_load_permille
+ *
+ * @param      id    CAN channel
+ */
+void rhs_hal_can_reset_bus_load_peak(RHSHalCANId id);
+
+/** ACCEPTANCE FILTERS */
+
+typedef enum
+{
+    RHSHalCANFilterModeMask,  // Frame matches id where mask bits are set
+    RHSHalCANFilterModeList,  // Frame matches one of the listed ids
+} RHSHalCANFilterMode;
+
+typedef enum
+{
+    RHSHalCANFilterScale32,  // Two 32-bit values, one id and mask or two ids
+    RHSHalCANFilterScale16,  // Four 16-bit values, two ids and masks or four ids
+} RHSHalCANFilterScale;
+
+typedef enum
+{
+    RHSHalCANFilterFifo0,
+    RHSHalCANFilterFifo1,
+} RHSHalCANFilterFifo;
+
+/** bxCAN filter bank, build it with rhs_hal_can_filter_* */
+typedef struct
+{
+    RHSHalCANFilterMode  mode;
+    RHSHalCANFilterScale scale;
+    RHSHalCANFilterFifo  fifo;
+    uint32_t             fr1;
+    uint32_t             fr2;
+} RHSHalCANFilter;
+
+/** 32-bit filter image of identifier, also usable as mask
+ *
+ * @param[in]  id    frame id, or mask bits to compare
+ * @param[in]  type  FrameTypeStdID or FrameTypeExtID, for a mask set it to compare IDE
+ * @param[in]  rtr   remote frame, for a mask set it to compare RTR
+ *
+ * @return     filter register image
+ */
+inline static uint32_t rhs_hal_can_filter_id32(uint32_t id, FrameType type, bool rtr)
+{
+    uint32_t image = (rtr ? 1UL : 0UL) << 1;
+    if (type == FrameTypeExtID)
+    {
+        return image | ((id & 0x1FFFFFFFUL) << 3) | (1UL << 2);
+    }
+    return image | ((id & 0x7FFUL) << 21);
+}
+
+/** 16-bit filter image of identifier, also usable as mask
+ *
+ * Extended ids are compared by their 14 upper bits only.
+ *
+ * @param[in]  id    frame id, or mask bits to compare
+ * @param[in]  type  FrameTypeStdID or FrameTypeExtID, for a mask set it to compare IDE
+ * @param[in]  rtr   remote frame, for a mask set it to compare RTR
+ *
+ * @return     filter register image
+ */
+inline static uint16_t rhs_hal_can_filter_id16(uint32_t id, FrameType type, bool rtr)
+{
+    uint32_t image = (rtr ? 1UL : 0UL) << 4;
+    if (type == FrameTypeExtID)
+    {
+        return (uint16_t) (image | (((id >> 18) & 0x7FFUL) << 5) | (1UL << 3) | ((id >> 15) & 0x7UL));
+    }
+    return (uint16_t) (image | ((id & 0x7FFUL) << 5));
+}
+
+inline static RHSHalCANFilter rhs_hal_can_filter_mask32(uint32_t id, uint32_t mask, RHSHalCANFilterFifo fifo)
+{
+    return (RHSHalCANFilter){RHSHalCANFilterModeMask, RHSHalCANFilterScale32, fifo, id, mask};
+}
+
+inline static RHSHalCANFilter rhs_hal_can_filter_list32(uint32_t id1, uint32_t id2, RHSHalCANFilterFifo fifo)
+{
+    return (RHSHalCANFilter){RHSHalCANFilterModeList, RHSHalCANFilterScale32, fifo, id1, id2};
+}
+
+inline static RHSHalCANFilter
+rhs_hal_can_filter_mask16(uint16_t id1, uint16_t mask1, uint16_t id2, uint16_t mask2, RHSHalCANFilterFifo fifo)
+{
+    return (RHSHalCANFilter){RHSHalCANFilterModeMask,
+                             RHSHalCANFilterScale16,
+                             fifo,
+                             ((uint32_t) mask1 << 16) | id1,
+                             ((uint32_t) mask2 << 16) | id2};
+}
+
+inline static RHSHalCANFilter
+rhs_hal_can_filter_list16(uint16_t id1, uint16_t id2, uint16_t id3, uint16_t id4, RHSHalCANFilterFifo fifo)
+{
+    return (RHSHalCANFilter){RHSHalCANFilterModeList,
+                             RHSHalCANFilterScale16,
+                             fifo,
+                             ((uint32_t) id2 << 16) | id1,
+                             ((uint32_t) id4 << 16) | id3};
+}
+
+/** Get number of filter banks of channel
+ *
+ * @param      id    CAN channel
+ *
+ * @return     bank count, CAN1 and CAN2 share 28 banks split at CAN2SB
+ */
+size_t rhs_hal_can_get_filter_banks(RHSHalCANId id);
+
+/** Program acceptance filters, frames that match none are dropped by hardware
+ *
+ * @param      id       CAN channel
+ * @param[in]  filters  filter banks, NULL to accept all frames into FIFO0
+ * @param[in]  count    bank count, up to rhs_hal_can_get_filter_banks
+ *
+ * @return     false if there are not enough banks, filters are unchanged then
+ */
+bool rhs_hal_can_set_filters(RHSHalCANId id, const RHSHalCANFilter* filters, size_t count);
+
+/** CAPTURE */
+
+typedef struct
+{
+    uint32_t id;      // Frame is captured if its id equals id in the mask bits
+    uint32_t mask;    // 0 captures every frame
+    bool     tx;      // Capture own frames on transmit completion too
+    size_t   frames;  // Ring size, power of two
+} RHSHalCANCaptureConfig;
+
+typedef struct
+{
+    RHSHalCANFrameType frame;  // Timestamp of reception or of transmit completion
+    bool               tx;
+} RHSHalCANCaptureRecord;
+
+typedef struct
+{
+    uint32_t captured;
+    uint32_t drops;  // Frames dropped because the capture ring was full
+    size_t   pending;
+} RHSHalCANCaptureStatistic;
+
+/** Start capture into a RAM ring
+ *
+ * RX and TX ISRs copy matching frames into the ring next to normal receive,
+ * so capture sees received frames that pass the acceptance filters once async
+ * receive is started. Read the ring with rhs_hal_can_capture_read from one
+ * thread only.
+ *
+ * @param      id      CAN channel
+ * @param[in]  config  capture config, copied
+ */
+void rhs_hal_can_capture_start(RHSHalCANId id, const RHSHalCANCaptureConfig* config);
+
+/** Stop capture and free the ring, call from the reader thread
+ *
+ * @param      id    CAN channel
+ */
+void rhs_hal_can_capture_stop(RHSHalCANId id);
+
+/** Read up to max records from capture ring
+ *
+ * @param      id       CAN channel
+ * @param[out] records  records, oldest first
+ * @param[in]  max      records capacity
+ *
+ * @return     number of records read, 0 if capture is stopped
+ */
+size_t rhs_hal_can_capture_read(RHSHalCANId id, RHSHalCANCaptureRecord* records, size_t max);
+
+/** Get capture counters, they restart with rhs_hal_can_capture_start
+ *
+ * @param      id    CAN channel
+ *
+ * @return     statistic
+ */
+RHSHalCANCaptureStatistic rhs_hal_can_capture_get_statistic(RHSHalCANId id);
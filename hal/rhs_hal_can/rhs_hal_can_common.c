@@ -0,0 +1,522 @@
+#include <stdlib.h>
+#include "rhs.h"
+#include "rhs_hal_can.h"
+#include "rhs_hal_can_common_i.h"
+#include "rhs_hal.h"
+
+#define TAG "rhs_hal_can"
+
+RHSHalCANCommon rhs_hal_can_common[RHSHalCANIdMax] = {0};
+
+static const char* const rhs_hal_can_error_code_names[RHSHalCANErrorCodeMax] = {
+    [RHSHalCANErrorCodeNone]         = "no",
+    [RHSHalCANErrorCodeStuff]        = "stuff",
+    [RHSHalCANErrorCodeForm]         = "form",
+    [RHSHalCANErrorCodeAck]          = "acknowledgment",
+    [RHSHalCANErrorCodeBitRecessive] = "bit recessive",
+    [RHSHalCANErrorCodeBitDominant]  = "bit dominant",
+    [RHSHalCANErrorCodeCrc]          = "CRC",
+};
+
+static const char* const rhs_hal_can_error_state_names[] = {
+    [RHSHalCANErrorStateActive]  = "error active",
+    [RHSHalCANErrorStateWarning] = "error warning",
+    [RHSHalCANErrorStatePassive] = "error passive",
+    [RHSHalCANErrorStateBusOff]  = "bus-off",
+};
+
+// clang-format off
+static const char* const rhs_hal_can_metric_names[RHSHalCANIdMax][RHS_HAL_CAN_METRICS] = {
+    [RHSHalCANId1] = {"can1_tx_msgs", "can1_tx_errs", "can1_tx_ovfs", "can1_rx_msgs", "can1_rx_errs", "can1_rx_ovfs",
+                      "can1_rx_drops"},
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = {"can2_tx_msgs", "can2_tx_errs", "can2_tx_ovfs", "can2_rx_msgs", "can2_rx_errs", "can2_rx_ovfs",
+                      "can2_rx_drops"},
+#endif
+};
+
+static const char* const rhs_hal_can_tx_latency_names[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = "can1_tx_latency_us",
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = "can2_tx_latency_us",
+#endif
+};
+
+static const char* const rhs_hal_can_tx_bus_names[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = "can1_tx_bus_us",
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = "can2_tx_bus_us",
+#endif
+};
+
+static const char* const rhs_hal_can_load_names[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = "can1_bus_load_permille",
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = "can2_bus_load_permille",
+#endif
+};
+// clang-format on
+
+static uint32_t rhs_hal_can_load_read(void* context)
+{
+    const RHSHalCANCommon* common = context;
+    return rhs_hal_can_get_bus_load((RHSHalCANId) (common - rhs_hal_can_common)).load_permille;
+}
+
+// Statistic counters are exported as they are, sampled on scrape. Both backends export the same names, so
+// dashboards work against the simulation too.
+static void rhs_hal_can_register_metrics(RHSHalCANId id)
+{
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+    if (common->metrics[0].registered)
+    {
+        return;
+    }
+
+    uint32_t* counters[RHS_HAL_CAN_METRICS] = {
+        &common->statistic.tx_msgs,
+        &common->statistic.tx_errs,
+        &common->statistic.tx_ovfs,
+        &common->statistic.rx_msgs,
+        &common->statistic.rx_errs,
+        &common->statistic.rx_ovfs,
+        &common->statistic.rx_drops,
+    };
+    for (size_t i = 0; i < RHS_HAL_CAN_METRICS; i++)
+    {
+        rhs_metric_init(&common->metrics[i],
+                        rhs_hal_can_metric_names[id][i],
+                        RHSMetricTypeCounter,
+                        rhs_metric_read_word,
+                        counters[i]);
+        rhs_metric_register(&common->metrics[i]);
+    }
+
+    common->tx_latency = (RHSMetric){
+        .name      = rhs_hal_can_tx_latency_names[id],
+        .type      = RHSMetricTypeHistogram,
+        .histogram = &common->tx_latency_histogram,
+    };
+    rhs_metric_register(&common->tx_latency);
+
+    common->tx_bus = (RHSMetric){
+        .name      = rhs_hal_can_tx_bus_names[id],
+        .type      = RHSMetricTypeHistogram,
+        .histogram = &common->tx_bus_histogram,
+    };
+    rhs_metric_register(&common->tx_bus);
+
+    rhs_metric_init(
+        &common->load_metric, rhs_hal_can_load_names[id], RHSMetricTypeGauge, rhs_hal_can_load_read, common);
+    rhs_metric_register(&common->load_metric);
+}
+
+void rhs_hal_can_common_init(RHSHalCANId id, uint32_t baud)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+
+    common->baud        = baud;
+    common->load_window = (uint64_t) rhs_hal_cortex_get_cycles_frequency() * RHS_HAL_CAN_LOAD_WINDOW_MS / 1000U;
+    common->load_start  = rhs_hal_cortex_get_cycles64();
+    common->load_bits   = 0;
+    common->load_frames = 0;
+    common->load        = (RHSHalCANBusLoad){0};
+    common->error       = (RHSHalCANErrorStatistic){0};
+    common->rx_head     = 0;
+    common->rx_tail     = 0;
+
+    rhs_hal_can_register_metrics(id);
+}
+
+/********************************** BUS LOAD *************************************/
+
+static uint32_t can_load_permille(const RHSHalCANCommon* common, uint32_t bits)
+{
+    const uint64_t capacity = (uint64_t) common->baud * RHS_HAL_CAN_LOAD_WINDOW_MS;
+    return capacity ? (uint32_t) ((uint64_t) bits * 1000U * 1000U / capacity) : 0U;
+}
+
+// Close the window if now is past it. After an idle gap the last complete window is an empty one.
+// Runs with interrupts masked.
+static void can_load_roll(RHSHalCANCommon* common, uint64_t now)
+{
+    if (common->load_window == 0U || now < common->load_start + common->load_window)
+    {
+        return;
+    }
+
+    const uint64_t elapsed = now - common->load_start;
+    uint32_t       bits    = common->load_bits;
+    uint32_t       frames  = common->load_frames;
+
+    common->load.peak_load_permille = MAX(common->load.peak_load_permille, can_load_permille(common, bits));
+    if (elapsed >= 2U * common->load_window)
+    {
+        bits   = 0;
+        frames = 0;
+    }
+    common->load.bits_per_s    = (uint32_t) ((uint64_t) bits * 1000U / RHS_HAL_CAN_LOAD_WINDOW_MS);
+    common->load.frames_per_s  = (uint32_t) ((uint64_t) frames * 1000U / RHS_HAL_CAN_LOAD_WINDOW_MS);
+    common->load.load_permille = can_load_permille(common, bits);
+    common->load_start += elapsed - elapsed % common->load_window;
+    common->load_bits   = 0;
+    common->load_frames = 0;
+}
+
+void rhs_hal_can_common_load_add(RHSHalCANCommon* common, uint64_t now, uint32_t bits, uint32_t frames)
+{
+    can_load_roll(common, now);
+    common->load_bits += bits;
+    common->load_frames += frames;
+    common->load.bits += bits;
+    common->load.frames += frames;
+}
+
+/*********************************** RX PATH *************************************/
+
+void rhs_hal_can_common_capture_put(RHSHalCANCommon* common, const RHSHalCANFrameType* frame, bool tx)
+{
+    RHSHalCANCaptureRecord* ring = common->capture_ring;
+    if (ring == NULL || (tx && !common->capture.tx) || ((frame->id ^ common->capture.id) & common->capture.mask) != 0U)
+    {
+        return;
+    }
+
+    const uint32_t head = common->capture_head;
+    const uint32_t size = (uint32_t) common->capture.frames;
+    if (head - common->capture_tail >= size)
+    {
+        rhs_atomic_add(&common->capture_statistic.drops, 1);
+        return;
+    }
+    ring[head & (size - 1U)] = (RHSHalCANCaptureRecord){.frame = *frame, .tx = tx};
+    __DMB();
+    common->capture_head = head + 1U;
+    rhs_atomic_add(&common->capture_statistic.captured, 1);
+}
+
+size_t rhs_hal_can_common_rx_read(RHSHalCANCommon* common, RHSHalCANFrameType* frames, size_t max)
+{
+    const uint32_t tail  = common->rx_tail;
+    const uint32_t count = MIN(common->rx_head - tail, (uint32_t) max);
+
+    __DMB();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        frames[i] = common->rx_ring[(tail + i) & RHS_HAL_CAN_RX_RING_MASK];
+    }
+    __DMB();
+    common->rx_tail = tail + count;
+
+    return count;
+}
+
+/*********************************** TX QUEUE ************************************/
+
+void rhs_hal_can_common_tx_sent(RHSHalCANCommon* common, RHSHalCANTxEntry* entry, uint64_t now, uint32_t bus_us)
+{
+    const uint32_t cycles_per_us = MAX(rhs_hal_cortex_get_cycles_frequency() / 1000000U, 1U);
+    const uint32_t us            = ((uint32_t) now - entry->cycles) / cycles_per_us;
+
+    rhs_atomic_add(&common->statistic.tx_msgs, 1);
+    rhs_atomic_max(&common->tx_statistic.latency_max_us, us);
+    rhs_metric_record(&common->tx_latency, us);
+    rhs_metric_record(&common->tx_bus, bus_us);
+    rhs_hal_can_common_load_add(common, now, rhs_hal_can_frame_bits(&entry->frame), 1);
+    entry->frame.timestamp = now;
+    rhs_hal_can_common_capture_put(common, &entry->frame, true);
+}
+
+// Bus arbitration order: base id, RTR or SRR, IDE, extended id, RTR. A standard data frame beats a
+// standard remote frame, which beats every extended frame with the same base id.
+uint32_t rhs_hal_can_tx_key(const RHSHalCANFrameType* frame)
+{
+    const uint32_t rtr = frame->rtr ? 1U : 0U;
+    if (frame->type == FrameTypeExtID)
+    {
+        const uint32_t id = frame->id & 0x1FFFFFFFU;
+        return ((id >> 18) << 21) | (3U << 19) | ((id & 0x3FFFFU) << 1) | rtr;
+    }
+    return ((frame->id & 0x7FFU) << 21) | (rtr << 20);
+}
+
+static bool can_tx_before(const RHSHalCANTxEntry* a, const RHSHalCANTxEntry* b)
+{
+    return a->key < b->key || (a->key == b->key && (int32_t) (a->seq - b->seq) < 0);
+}
+
+void rhs_hal_can_tx_queue_push(RHSHalCANTxQueue* queue, const RHSHalCANTxEntry* entry)
+{
+    rhs_assert(queue->count < RHS_HAL_CAN_TX_HEAP_SIZE);
+
+    uint32_t index = queue->count++;
+    while (index > 0)
+    {
+        const uint32_t parent = (index - 1U) / 2U;
+        if (!can_tx_before(entry, &queue->heap[parent]))
+        {
+            break;
+        }
+        queue->heap[index] = queue->heap[parent];
+        index              = parent;
+    }
+    queue->heap[index] = *entry;
+}
+
+void rhs_hal_can_tx_queue_pop(RHSHalCANTxQueue* queue)
+{
+    const RHSHalCANTxEntry* last  = &queue->heap[--queue->count];
+    uint32_t                index = 0;
+    while (true)
+    {
+        uint32_t child = index * 2U + 1U;
+        if (child >= queue->count)
+        {
+            break;
+        }
+        if (child + 1U < queue->count && can_tx_before(&queue->heap[child + 1U], &queue->heap[child]))
+        {
+            child++;
+        }
+        if (!can_tx_before(&queue->heap[child], last))
+        {
+            break;
+        }
+        queue->heap[index] = queue->heap[child];
+        index              = child;
+    }
+    queue->heap[index] = *last;
+}
+
+/*********************************** ERRORS **************************************/
+
+void rhs_hal_can_common_error_report(RHSHalCANId id, const RHSHalCANErrorEvent* event)
+{
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+
+    if (event->code != RHSHalCANErrorCodeNone)
+    {
+        RHS_LOG_W(TAG,
+                  "CAN%d %s error, tec %u rec %u",
+                  id,
+                  rhs_hal_can_error_code_names[event->code],
+                  (unsigned) event->tec,
+                  (unsigned) event->rec);
+    }
+    else
+    {
+        RHS_LOG_W(TAG,
+                  "CAN%d %s, tec %u rec %u",
+                  id,
+                  rhs_hal_can_error_state_names[event->state],
+                  (unsigned) event->tec,
+                  (unsigned) event->rec);
+    }
+    if (common->error_callback)
+    {
+        common->error_callback(id, event, common->error_context);
+    }
+}
+
+/********************************** PUBLIC API ***********************************/
+
+void rhs_hal_can_async_sce(RHSHalCANId id, RHSHalCANAsyncSCECallback callback, void* context)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    // SCE events are reported since rhs_hal_can_init
+    RHS_CRITICAL_ENTER();
+    rhs_hal_can_common[id].sce_callback = callback;
+    rhs_hal_can_common[id].sce_context  = context;
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_hal_can_set_error_callback(RHSHalCANId id, RHSHalCANErrorCallback callback, void* context)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHS_CRITICAL_ENTER();
+    rhs_hal_can_common[id].error_callback = callback;
+    rhs_hal_can_common[id].error_context  = context;
+    RHS_CRITICAL_EXIT();
+}
+
+RHSHalCANErrorStatistic rhs_hal_can_get_error_statistic(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHS_CRITICAL_ENTER();
+    const RHSHalCANErrorStatistic error = rhs_hal_can_common[id].error;
+    RHS_CRITICAL_EXIT();
+
+    return error;
+}
+
+void rhs_hal_can_tx_cmplt_cb(RHSHalCANId id, RHSHalCANAsyncTxCallback callback, void* context)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+    rhs_assert(callback);
+    rhs_assert(context);
+
+    // Completions are reported since rhs_hal_can_init, the callback is picked up on the next one
+    RHS_CRITICAL_ENTER();
+    rhs_hal_can_common[id].tx_callback = callback;
+    rhs_hal_can_common[id].tx_context  = context;
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_hal_can_set_rx_threshold(RHSHalCANId id, uint32_t frames)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(frames > 0 && frames <= RHS_HAL_CAN_RX_RING_SIZE);
+
+    rhs_hal_can_common[id].rx_threshold = frames;
+}
+
+size_t rhs_hal_can_rx_batch(RHSHalCANId id, RHSHalCANFrameType* frames, size_t max)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+    rhs_assert(rhs_hal_can_common[id].rx_started);
+    rhs_assert(frames || max == 0);
+
+    return rhs_hal_can_common_rx_read(&rhs_hal_can_common[id], frames, max);
+}
+
+size_t rhs_hal_can_rx_pending(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    return rhs_hal_can_common[id].rx_head - rhs_hal_can_common[id].rx_tail;
+}
+
+RHSHalCANStatistic rhs_hal_can_get_statistic(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    // Counters are updated from ISRs and threads, each one is atomic
+    RHSHalCANStatistic* statistic = &rhs_hal_can_common[id].statistic;
+    return (RHSHalCANStatistic){
+        .tx_msgs  = rhs_atomic_load(&statistic->tx_msgs),
+        .tx_errs  = rhs_atomic_load(&statistic->tx_errs),
+        .tx_ovfs  = rhs_atomic_load(&statistic->tx_ovfs),
+        .rx_msgs  = rhs_atomic_load(&statistic->rx_msgs),
+        .rx_errs  = rhs_atomic_load(&statistic->rx_errs),
+        .rx_ovfs  = rhs_atomic_load(&statistic->rx_ovfs),
+        .rx_drops = rhs_atomic_load(&statistic->rx_drops),
+    };
+}
+
+RHSHalCANBusLoad rhs_hal_can_get_bus_load(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+    const uint64_t   now    = rhs_hal_cortex_get_cycles64();
+
+    // Roll here too, so an idle bus reads as idle
+    RHS_CRITICAL_ENTER();
+    can_load_roll(common, now);
+    const RHSHalCANBusLoad load = common->load;
+    RHS_CRITICAL_EXIT();
+
+    return load;
+}
+
+void rhs_hal_can_reset_bus_load_peak(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHS_CRITICAL_ENTER();
+    rhs_hal_can_common[id].load.peak_load_permille = 0;
+    RHS_CRITICAL_EXIT();
+}
+
+RHSHalCANTxQueueStatistic rhs_hal_can_get_tx_queue_statistic(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+    return (RHSHalCANTxQueueStatistic){
+        .queued         = (uint32_t) rhs_hal_can_tx_pending(id),
+        .peak           = rhs_atomic_load(&common->tx_statistic.peak),
+        .drops          = rhs_atomic_load(&common->tx_statistic.drops),
+        .aborts         = rhs_atomic_load(&common->tx_statistic.aborts),
+        .latency_max_us = rhs_atomic_load(&common->tx_statistic.latency_max_us),
+        .latency_p99_us = rhs_metric_get_percentile(&common->tx_latency, 99),
+    };
+}
+
+void rhs_hal_can_capture_start(RHSHalCANId id, const RHSHalCANCaptureConfig* config)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(config);
+    rhs_assert(config->frames > 0 && (config->frames & (config->frames - 1U)) == 0);
+    rhs_assert(rhs_hal_can_common[id].capture_ring == NULL);
+
+    RHSHalCANCommon*        common = &rhs_hal_can_common[id];
+    RHSHalCANCaptureRecord* ring   = malloc(config->frames * sizeof(RHSHalCANCaptureRecord));
+
+    RHS_CRITICAL_ENTER();
+    common->capture           = *config;
+    common->capture_head      = 0;
+    common->capture_tail      = 0;
+    common->capture_statistic = (RHSHalCANCaptureStatistic){0};
+    common->capture_ring      = ring;
+    RHS_CRITICAL_EXIT();
+}
+
+void rhs_hal_can_capture_stop(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+
+    // Writers load the ring pointer per frame, none holds it once interrupts are unmasked again
+    RHS_CRITICAL_ENTER();
+    RHSHalCANCaptureRecord* ring = common->capture_ring;
+    common->capture_ring         = NULL;
+    RHS_CRITICAL_EXIT();
+
+    free(ring);
+}
+
+size_t rhs_hal_can_capture_read(RHSHalCANId id, RHSHalCANCaptureRecord* records, size_t max)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(records || max == 0);
+
+    RHSHalCANCommon*              common = &rhs_hal_can_common[id];
+    const RHSHalCANCaptureRecord* ring   = common->capture_ring;
+    if (ring == NULL)
+    {
+        return 0;
+    }
+
+    const uint32_t mask  = (uint32_t) common->capture.frames - 1U;
+    const uint32_t tail  = common->capture_tail;
+    const uint32_t count = MIN(common->capture_head - tail, (uint32_t) max);
+
+    __DMB();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        records[i] = ring[(tail + i) & mask];
+    }
+    __DMB();
+    common->capture_tail = tail + count;
+
+    return count;
+}
+
+RHSHalCANCaptureStatistic rhs_hal_can_capture_get_statistic(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+    return (RHSHalCANCaptureStatistic){
+        .captured = rhs_atomic_load(&common->capture_statistic.captured),
+        .drops    = rhs_atomic_load(&common->capture_statistic.drops),
+        .pending  = common->capture_head - common->capture_tail,
+    };
+}
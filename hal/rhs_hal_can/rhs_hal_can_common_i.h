@@ -0,0 +1,160 @@
+/**
+ * @file rhs_hal_can_common_i.h
+ * RHS HAL CAN backend independent part, shared by the bxCAN and the virtual backend
+ *
+ * Holds the channel state that does not depend on where frames come from:
+ * callbacks, counters and metrics, the software RX ring, the capture ring,
+ * bus load accounting and the arbitration ordered TX queue. A backend moves
+ * frames between its bus and this state and implements the rest of
+ * rhs_hal_can.h.
+ */
+#pragma once
+
+#include "rhs.h"
+#include "rhs_hal_can.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RHS_HAL_CAN_METRICS 7  // One per RHSHalCANStatistic counter
+
+#define RHS_HAL_CAN_RX_RING_MASK (RHS_HAL_CAN_RX_RING_SIZE - 1U)
+static_assert((RHS_HAL_CAN_RX_RING_SIZE & RHS_HAL_CAN_RX_RING_MASK) == 0, "RX ring size must be a power of two");
+
+#define RHS_HAL_CAN_TX_MAILBOXES 3U
+#define RHS_HAL_CAN_TX_HEAP_SIZE (RHS_HAL_CAN_TX_QUEUE_SIZE + RHS_HAL_CAN_TX_MAILBOXES)  // Room for aborted frames
+
+typedef struct
+{
+    RHSHalCANFrameType frame;
+    uint32_t           key;     // Bus arbitration order, lower wins
+    uint32_t           seq;     // Submit order among equal keys
+    uint32_t           cycles;  // Submit time
+    uint32_t           loaded;  // Mailbox load time
+} RHSHalCANTxEntry;
+
+typedef struct
+{
+    uint32_t         seq;
+    uint32_t         count;                           // Frames in heap
+    RHSHalCANTxEntry heap[RHS_HAL_CAN_TX_HEAP_SIZE];  // Binary min-heap in arbitration order
+} RHSHalCANTxQueue;
+
+typedef struct
+{
+    bool                      enabled;
+    RHSHalCANAsyncRxCallback  rx_callback;
+    void*                     rx_context;
+    RHSHalCANAsyncTxCallback  tx_callback;
+    void*                     tx_context;
+    RHSHalCANAsyncSCECallback sce_callback;
+    void*                     sce_context;
+    RHSHalCANStatistic        statistic;
+    RHSMetric                 metrics[RHS_HAL_CAN_METRICS];
+    bool                      rx_started;
+    uint32_t                  rx_threshold;  // Ring level that calls rx_callback
+    volatile uint32_t         rx_head;       // Written by the backend RX path only
+    volatile uint32_t         rx_tail;       // Written by reader only
+    RHSHalCANFrameType        rx_ring[RHS_HAL_CAN_RX_RING_SIZE];
+    RHSHalCANCaptureRecord*   capture_ring;  // NULL while capture is stopped
+    RHSHalCANCaptureConfig    capture;
+    volatile uint32_t         capture_head;  // Written by the backend RX path or with interrupts masked
+    volatile uint32_t         capture_tail;  // Written by reader only
+    RHSHalCANCaptureStatistic capture_statistic;
+    RHSHalCANTxQueueStatistic tx_statistic;
+    RHSMetric                 tx_latency;
+    RHSMetricHistogram        tx_latency_histogram;
+    RHSMetric                 tx_bus;  // Time the frame spent on the bus or in a mailbox
+    RHSMetricHistogram        tx_bus_histogram;
+    uint32_t                  baud;
+    uint64_t                  load_window;  // Cycles
+    uint64_t                  load_start;   // Current window start, cycles
+    uint32_t                  load_bits;    // Current window
+    uint32_t                  load_frames;  // Current window
+    RHSHalCANBusLoad          load;
+    RHSMetric                 load_metric;
+    RHSHalCANErrorStatistic   error;
+    RHSHalCANErrorCallback    error_callback;
+    void*                     error_context;
+} RHSHalCANCommon;
+
+extern RHSHalCANCommon rhs_hal_can_common[RHSHalCANIdMax];
+
+/** Reset load, error and RX state of a channel and register its metrics once
+ *
+ * @param[in]  id    channel
+ * @param[in]  baud  bit rate the bus load is measured against
+ */
+void rhs_hal_can_common_init(RHSHalCANId id, uint32_t baud);
+
+/** Account frames on the bus, runs with interrupts masked
+ *
+ * @param      common  channel
+ * @param[in]  now     rhs_hal_cortex_get_cycles64
+ * @param[in]  bits    rhs_hal_can_frame_bits of the frames
+ * @param[in]  frames  frames
+ */
+void rhs_hal_can_common_load_add(RHSHalCANCommon* common, uint64_t now, uint32_t bits, uint32_t frames);
+
+/** Copy frame into the capture ring if it matches the capture config
+ *
+ * Runs in the RX path or with interrupts masked, nothing that writes the ring
+ * preempts the RX path.
+ *
+ * @param      common  channel
+ * @param[in]  frame   frame
+ * @param[in]  tx      true for a transmitted frame
+ */
+void rhs_hal_can_common_capture_put(RHSHalCANCommon* common, const RHSHalCANFrameType* frame, bool tx);
+
+/** Take frames out of the RX ring, single reader
+ *
+ * @param      common  channel
+ * @param[out] frames  frames
+ * @param[in]  max     room in frames
+ *
+ * @return     frames taken
+ */
+size_t rhs_hal_can_common_rx_read(RHSHalCANCommon* common, RHSHalCANFrameType* frames, size_t max);
+
+/** Account a transmitted frame and capture it, runs with interrupts masked
+ *
+ * @param      common  channel
+ * @param      entry   frame sent, timestamp set to now
+ * @param[in]  now     rhs_hal_cortex_get_cycles64 at transmit complete
+ * @param[in]  bus_us  time on the bus or in a mailbox
+ */
+void rhs_hal_can_common_tx_sent(RHSHalCANCommon* common, RHSHalCANTxEntry* entry, uint64_t now, uint32_t bus_us);
+
+/** Log an error event and pass it on to the error callback, thread context
+ *
+ * @param[in]  id     channel
+ * @param[in]  event  event
+ */
+void rhs_hal_can_common_error_report(RHSHalCANId id, const RHSHalCANErrorEvent* event);
+
+/** Arbitration key of a frame
+ *
+ * @param[in]  frame  frame
+ *
+ * @return     key, a lower key wins arbitration
+ */
+uint32_t rhs_hal_can_tx_key(const RHSHalCANFrameType* frame);
+
+/** Insert entry in arbitration order, runs with interrupts masked
+ *
+ * @param      queue  queue with room for the entry
+ * @param[in]  entry  entry, key and seq set
+ */
+void rhs_hal_can_tx_queue_push(RHSHalCANTxQueue* queue, const RHSHalCANTxEntry* entry);
+
+/** Remove the head, runs with interrupts masked
+ *
+ * @param      queue  queue holding a frame at least
+ */
+void rhs_hal_can_tx_queue_pop(RHSHalCANTxQueue* queue);
+
+#ifdef __cplusplus
+}
+#endif
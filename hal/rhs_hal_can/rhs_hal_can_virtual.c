@@ -0,0 +1,989 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rhs.h"
+#include "rhs_hal_can.h"
+#include "rhs_hal_can_common_i.h"
+#include "rhs_hal_can_virtual.h"
+#include "rhs_hal.h"
+
+#define TAG "rhs_hal_can"
+
+#define RHS_HAL_CAN_FILTER_BANKS 14U  // Per channel, as CAN1 and CAN2 split them after reset
+
+#define RHS_HAL_CAN_VIRTUAL_STACK_SIZE    1024
+#define RHS_HAL_CAN_VIRTUAL_FLAG_WAKE     (1U << 0)
+#define RHS_HAL_CAN_VIRTUAL_ERROR_BITS    17U            // Error flag, delimiter and intermission
+#define RHS_HAL_CAN_VIRTUAL_RECOVERY_BITS (128U * 11U)  // Recessive bits seen before leaving bus-off
+#define RHS_HAL_CAN_VIRTUAL_NS_PER_S      1000000000ULL
+
+typedef struct RHSHalCAN           RHSHalCAN;
+typedef struct RHSHalCANVirtualBus RHSHalCANVirtualBus;
+
+struct RHSHalCANVirtualNode
+{
+    RHSHalCANVirtualBus*               bus;
+    RHSHalCANVirtualNode*              next;
+    RHSHalCAN*                         can;     // Channel of the node, NULL for a simulated node
+    bool                               active;  // On the bus, bus-off included
+    RHSHalCANVirtualRxCallback         rx_callback;
+    void*                              rx_context;
+    RHSHalCANTxQueue                   tx_queue;  // Frames waiting for arbitration
+    uint32_t                           tec;
+    uint32_t                           rec;
+    bool                               bus_off;
+    uint64_t                           recover_ns;  // Bus time to leave bus-off at
+    uint32_t                           backoff_ms;
+    const RHSHalCANVirtualTraceRecord* trace;  // NULL if not replaying, set under the bus mutex
+    size_t                             trace_count;
+    size_t                             trace_index;
+    uint32_t                           trace_period_us;
+    uint32_t                           trace_loops;     // Left, 0 until stopped
+    uint64_t                           trace_start_ns;  // Bus time of the loop start
+    RHSHalCANVirtualNodeStatistic      statistic;
+};
+
+struct RHSHalCANVirtualBus
+{
+    RHSThread*            thread;
+    RHSMutex*             mutex;  // Held by the bus thread from arbitration to delivery
+    RHSHalCANVirtualNode* nodes;
+    uint32_t              baud;
+    uint64_t              now_ns;  // Bus time, bus thread only
+    uint64_t              ticks;   // Kernel tick extended to 64 bits, bus thread only
+    uint32_t              last_tick;
+    RHSHalCANErrorCode    inject_code;
+    uint32_t              inject_frames;
+};
+
+struct RHSHalCAN
+{
+    RHSHalCANCommon*     common;  // Backend independent part, rhs_hal_can_common of the channel
+    RHSHalCANVirtualNode node;
+    RHSHalCANErrorCode   error_code;  // Last code reported since the last good frame
+    RHSHalCANFilter      filters[RHS_HAL_CAN_FILTER_BANKS];
+    size_t               filter_count;  // 0 accepts all frames
+};
+
+static RHSHalCAN rhs_hal_can[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = {.common = &rhs_hal_can_common[RHSHalCANId1]},
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = {.common = &rhs_hal_can_common[RHSHalCANId2]},
+#endif
+};
+
+static RHSHalCANVirtualBus rhs_hal_can_virtual_bus[RHSHalCANIdMax] = {0};
+
+// clang-format off
+static const char* const rhs_hal_can_virtual_thread_names[RHSHalCANIdMax] = {
+    [RHSHalCANId1] = "can1_bus",
+#if !defined(BMPLC_XL) && !defined(BMPLC_L) && !defined(BMPLC_M)
+    [RHSHalCANId2] = "can2_bus",
+#endif
+};
+// clang-format on
+
+/*********************************** TX QUEUE ************************************/
+
+// Queue frame if fewer than limit frames wait, the bus thread is woken by the caller
+static bool can_virtual_push(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame, uint32_t limit)
+{
+    RHSHalCANTxEntry entry = {
+        .frame = *frame, .key = rhs_hal_can_tx_key(frame), .cycles = rhs_hal_cortex_get_cycles()};
+    bool queued = false;
+
+    RHS_CRITICAL_ENTER();
+    if (node->tx_queue.count < limit)
+    {
+        entry.seq = node->tx_queue.seq++;
+        rhs_hal_can_tx_queue_push(&node->tx_queue, &entry);
+        queued = true;
+    }
+    RHS_CRITICAL_EXIT();
+
+    if (!queued)
+    {
+        rhs_atomic_add(&node->statistic.tx_drops, 1);
+    }
+    return queued;
+}
+
+static void can_virtual_wake(RHSHalCANVirtualBus* bus)
+{
+    rhs_thread_flags_set(rhs_thread_get_id(bus->thread), RHS_HAL_CAN_VIRTUAL_FLAG_WAKE);
+}
+
+/********************************** BUS THREAD ***********************************/
+
+static RHSHalCANErrorState can_virtual_state(const RHSHalCANVirtualNode* node)
+{
+    if (node->bus_off)
+    {
+        return RHSHalCANErrorStateBusOff;
+    }
+    if (node->tec > 127U || node->rec > 127U)
+    {
+        return RHSHalCANErrorStatePassive;
+    }
+    if (node->tec >= 96U || node->rec >= 96U)
+    {
+        return RHSHalCANErrorStateWarning;
+    }
+    return RHSHalCANErrorStateActive;
+}
+
+// Bus thread only
+static uint64_t can_virtual_kernel_ns(RHSHalCANVirtualBus* bus)
+{
+    const uint32_t tick = rhs_get_tick();
+    bus->ticks += tick - bus->last_tick;
+    bus->last_tick = tick;
+    return bus->ticks * RHS_HAL_CAN_VIRTUAL_NS_PER_S / rhs_kernel_get_tick_frequency();
+}
+
+// Let the kernel catch up with the bus, which runs at most one tick ahead
+static void can_virtual_pace(RHSHalCANVirtualBus* bus)
+{
+    const uint64_t tick_ns = RHS_HAL_CAN_VIRTUAL_NS_PER_S / rhs_kernel_get_tick_frequency();
+    const uint64_t kernel  = can_virtual_kernel_ns(bus);
+    if (bus->now_ns > kernel + tick_ns)
+    {
+        rhs_delay_tick((uint32_t) ((bus->now_ns - kernel) / tick_ns));
+    }
+}
+
+// Track the error state of a channel, count bus errors and report state changes and new codes
+static void can_virtual_error_update(RHSHalCAN* can, RHSHalCANErrorCode code, bool sender)
+{
+    const RHSHalCANId           id     = (RHSHalCANId) (can - rhs_hal_can);
+    RHSHalCANCommon*            common = can->common;
+    const RHSHalCANVirtualNode* node   = &can->node;
+    const RHSHalCANErrorState   state  = can_virtual_state(node);
+
+    RHS_CRITICAL_ENTER();
+    RHSHalCANErrorStatistic*  error = &common->error;
+    const RHSHalCANErrorState old   = error->state;
+
+    error->tec = (uint8_t) MIN(node->tec, 255U);
+    error->rec = (uint8_t) node->rec;
+    if (state != old)
+    {
+        error->state = state;
+        error->warnings += state == RHSHalCANErrorStateWarning ? 1U : 0U;
+        error->passives += state == RHSHalCANErrorStatePassive ? 1U : 0U;
+        error->bus_offs += state == RHSHalCANErrorStateBusOff ? 1U : 0U;
+        error->recoveries += old == RHSHalCANErrorStateBusOff ? 1U : 0U;
+    }
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        error->errors[code]++;
+    }
+    RHS_CRITICAL_EXIT();
+
+    if (code == RHSHalCANErrorCodeNone && state == old)
+    {
+        return;
+    }
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        rhs_atomic_add(sender ? &common->statistic.tx_errs : &common->statistic.rx_errs, 1);
+    }
+
+    RHSHalCANSCEEvent sce = 0;
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        sce |= RHSHalCANSCEEventError;
+        sce |= (sender && node->tec >= 0x80U) ? RHSHalCANSCEEventTXPassive : 0;
+    }
+    sce |= node->rec >= 0x80U ? RHSHalCANSCEEventRXPassive : 0;
+    sce |= state == RHSHalCANErrorStateBusOff ? RHSHalCANSCEEventBusOff : 0;
+    if (common->sce_callback)
+    {
+        common->sce_callback(id, sce, common->sce_context);
+    }
+
+    // A repeating code is reported once until a frame goes through
+    if (state == old && code == can->error_code)
+    {
+        return;
+    }
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        can->error_code = code;
+    }
+    const RHSHalCANErrorEvent event = {
+        .timestamp = rhs_hal_cortex_get_cycles64(),
+        .state     = state,
+        .code      = state != old ? RHSHalCANErrorCodeNone : code,
+        .tec       = common->error.tec,
+        .rec       = common->error.rec,
+    };
+
+    if (state == RHSHalCANErrorStateBusOff && state != old)
+    {
+        RHS_LOG_W(TAG, "CAN%d bus-off, recovery in %lu ms", id, (unsigned long) node->backoff_ms);
+    }
+    else if (old == RHSHalCANErrorStateBusOff && state != old)
+    {
+        RHS_LOG_I(TAG, "CAN%d left bus-off", id);
+    }
+    rhs_hal_can_common_error_report(id, &event);
+}
+
+// A destroyed frame costs the sender 8, unless it is passive and only missed the acknowledgment, and
+// every receiver 1. Above 255 the sender goes bus-off.
+static void can_virtual_node_error(RHSHalCANVirtualNode* node, RHSHalCANErrorCode code, bool sender)
+{
+    if (sender)
+    {
+        if (code != RHSHalCANErrorCodeAck || node->tec < 0x80U)
+        {
+            node->tec += 8U;
+        }
+        if (node->tec > 255U)
+        {
+            const RHSHalCANVirtualBus* bus = node->bus;
+            node->bus_off                  = true;
+            node->recover_ns = bus->now_ns + (uint64_t) node->backoff_ms * 1000000U +
+                               (uint64_t) RHS_HAL_CAN_VIRTUAL_RECOVERY_BITS * RHS_HAL_CAN_VIRTUAL_NS_PER_S / bus->baud;
+        }
+    }
+    else
+    {
+        node->rec = MIN(node->rec + 1U, 255U);
+    }
+
+    if (node->can)
+    {
+        can_virtual_error_update(node->can, code, sender);
+    }
+}
+
+static void can_virtual_node_ok(RHSHalCANVirtualNode* node, bool sender)
+{
+    const RHSHalCANErrorState state = can_virtual_state(node);
+
+    if (sender)
+    {
+        node->tec -= node->tec ? 1U : 0U;
+    }
+    else
+    {
+        node->rec = node->rec > 127U ? 119U : node->rec - (node->rec ? 1U : 0U);
+    }
+
+    if (node->can)
+    {
+        node->can->error_code = RHSHalCANErrorCodeNone;
+        if (state != can_virtual_state(node))
+        {
+            can_virtual_error_update(node->can, RHSHalCANErrorCodeNone, sender);
+        }
+    }
+}
+
+static bool can_virtual_filter_match(const RHSHalCANFilter* filter, const RHSHalCANFrameType* frame)
+{
+    if (filter->scale == RHSHalCANFilterScale32)
+    {
+        const uint32_t image = rhs_hal_can_filter_id32(frame->id, frame->type, frame->rtr);
+        if (filter->mode == RHSHalCANFilterModeMask)
+        {
+            return ((image ^ filter->fr1) & filter->fr2) == 0U;
+        }
+        return image == filter->fr1 || image == filter->fr2;
+    }
+
+    // Two id and mask pairs or four ids, low half first
+    const uint32_t image     = rhs_hal_can_filter_id16(frame->id, frame->type, frame->rtr);
+    const uint32_t values[4] = {filter->fr1 & 0xFFFFU, filter->fr1 >> 16, filter->fr2 & 0xFFFFU, filter->fr2 >> 16};
+    if (filter->mode == RHSHalCANFilterModeMask)
+    {
+        return ((image ^ values[0]) & values[1]) == 0U || ((image ^ values[2]) & values[3]) == 0U;
+    }
+    return image == values[0] || image == values[1] || image == values[2] || image == values[3];
+}
+
+// Runs with interrupts masked
+static bool can_virtual_filter_accepts(const RHSHalCAN* can, const RHSHalCANFrameType* frame)
+{
+    for (size_t i = 0; i < can->filter_count; i++)
+    {
+        if (can_virtual_filter_match(&can->filters[i], frame))
+        {
+            return true;
+        }
+    }
+    return can->filter_count == 0;
+}
+
+static void can_virtual_deliver(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame, uint32_t bits)
+{
+    RHSHalCAN* can = node->can;
+    if (can == NULL)
+    {
+        rhs_atomic_add(&node->statistic.rx_msgs, 1);
+        if (node->rx_callback)
+        {
+            node->rx_callback(node, frame, node->rx_context);
+        }
+        return;
+    }
+
+    RHSHalCANCommon* common = can->common;
+    bool             accepted;
+    bool             stored = false;
+
+    RHS_CRITICAL_ENTER();
+    accepted = can_virtual_filter_accepts(can, frame);
+    if (accepted)
+    {
+        const uint32_t head = common->rx_head;
+        if (head - common->rx_tail < RHS_HAL_CAN_RX_RING_SIZE)
+        {
+            common->rx_ring[head & RHS_HAL_CAN_RX_RING_MASK] = *frame;
+            __DMB();
+            common->rx_head = head + 1U;
+            stored          = true;
+        }
+        if (common->rx_started)
+        {
+            rhs_hal_can_common_capture_put(common, frame, false);
+        }
+        rhs_hal_can_common_load_add(common, frame->timestamp, bits, 1);
+    }
+    RHS_CRITICAL_EXIT();
+
+    if (!accepted)
+    {
+        return;
+    }
+    rhs_atomic_add(&node->statistic.rx_msgs, 1);
+    rhs_atomic_add(stored ? &common->statistic.rx_msgs : &common->statistic.rx_drops, 1);
+    if (common->rx_started && common->rx_callback && (common->rx_head - common->rx_tail >= common->rx_threshold))
+    {
+        common->rx_callback((RHSHalCANId) (can - rhs_hal_can), common->rx_context);
+    }
+}
+
+static void can_virtual_sent(RHSHalCANVirtualNode* node, RHSHalCANTxEntry* entry, uint64_t ns)
+{
+    rhs_atomic_add(&node->statistic.tx_msgs, 1);
+
+    RHSHalCAN* can = node->can;
+    if (can == NULL)
+    {
+        return;
+    }
+
+    RHS_CRITICAL_ENTER();
+    rhs_hal_can_common_tx_sent(can->common, entry, entry->frame.timestamp, (uint32_t) (ns / 1000U));
+    RHS_CRITICAL_EXIT();
+
+    if (can->common->tx_callback)
+    {
+        can->common->tx_callback(can->common->tx_context);
+    }
+}
+
+static bool can_virtual_receives(const RHSHalCANVirtualNode* node, const RHSHalCANVirtualNode* sender)
+{
+    return node != sender && node->active && !node->bus_off;
+}
+
+// Put the winner on the bus for its frame time, then deliver the frame or destroy it with an error
+// frame and queue it again
+static void can_virtual_transmit(RHSHalCANVirtualBus* bus, RHSHalCANVirtualNode* sender, RHSHalCANTxEntry* entry)
+{
+    RHSHalCANErrorCode code      = RHSHalCANErrorCodeNone;
+    uint32_t           receivers = 0;
+
+    for (const RHSHalCANVirtualNode* node = bus->nodes; node != NULL; node = node->next)
+    {
+        receivers += can_virtual_receives(node, sender) ? 1U : 0U;
+    }
+
+    RHS_CRITICAL_ENTER();
+    if (bus->inject_frames > 0U)
+    {
+        code = bus->inject_code;
+        bus->inject_frames--;
+    }
+    RHS_CRITICAL_EXIT();
+    if (code == RHSHalCANErrorCodeNone && receivers == 0U)
+    {
+        code = RHSHalCANErrorCodeAck;
+    }
+
+    // A destroyed frame is cut off half way on average
+    const uint32_t frame_bits = rhs_hal_can_frame_bits(&entry->frame);
+    uint32_t       bits       = frame_bits;
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        bits = frame_bits / 2U + RHS_HAL_CAN_VIRTUAL_ERROR_BITS;
+    }
+    const uint64_t ns = (uint64_t) bits * RHS_HAL_CAN_VIRTUAL_NS_PER_S / bus->baud;
+    bus->now_ns += ns;
+    can_virtual_pace(bus);
+
+    if (code != RHSHalCANErrorCodeNone)
+    {
+        RHS_CRITICAL_ENTER();
+        rhs_hal_can_tx_queue_push(&sender->tx_queue, entry);
+        RHS_CRITICAL_EXIT();
+
+        can_virtual_node_error(sender, code, true);
+        for (RHSHalCANVirtualNode* node = bus->nodes; node != NULL; node = node->next)
+        {
+            if (can_virtual_receives(node, sender))
+            {
+                can_virtual_node_error(node, code, false);
+            }
+        }
+        return;
+    }
+
+    entry->frame.timestamp = rhs_hal_cortex_get_cycles64();
+    for (RHSHalCANVirtualNode* node = bus->nodes; node != NULL; node = node->next)
+    {
+        if (can_virtual_receives(node, sender))
+        {
+            can_virtual_node_ok(node, false);
+            can_virtual_deliver(node, &entry->frame, frame_bits);
+        }
+    }
+    can_virtual_node_ok(sender, true);
+    can_virtual_sent(sender, entry, ns);
+}
+
+// Queue due trace records, returns bus time of the next record
+static uint64_t can_virtual_replay(RHSHalCANVirtualNode* node, uint64_t now)
+{
+    if (node->trace && node->trace_start_ns == UINT64_MAX)
+    {
+        node->trace_start_ns = now;
+    }
+    while (node->trace)
+    {
+        const RHSHalCANVirtualTraceRecord* record = &node->trace[node->trace_index];
+        const uint64_t                     at     = node->trace_start_ns + (uint64_t) record->time_us * 1000U;
+        if (at > now)
+        {
+            return at;
+        }
+
+        can_virtual_push(node, &record->frame, RHS_HAL_CAN_TX_QUEUE_SIZE);
+        rhs_atomic_add(&node->statistic.replayed, 1);
+        if (++node->trace_index < node->trace_count)
+        {
+            continue;
+        }
+        node->trace_index = 0;
+        node->trace_start_ns += (uint64_t) node->trace_period_us * 1000U;
+        if (node->trace_loops != 0U && --node->trace_loops == 0U)
+        {
+            node->trace               = NULL;
+            node->statistic.replaying = false;
+        }
+    }
+    return UINT64_MAX;
+}
+
+// Run due replays and bus-off recoveries, returns bus time of the next one
+static uint64_t can_virtual_events(RHSHalCANVirtualBus* bus)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (RHSHalCANVirtualNode* node = bus->nodes; node != NULL; node = node->next)
+    {
+        if (!node->active)
+        {
+            continue;
+        }
+        if (node->bus_off && node->recover_ns <= bus->now_ns)
+        {
+            node->bus_off = false;
+            node->tec     = 0;
+            node->rec     = 0;
+            if (node->can)
+            {
+                can_virtual_error_update(node->can, RHSHalCANErrorCodeNone, true);
+            }
+        }
+        else if (node->bus_off)
+        {
+            next = MIN(next, node->recover_ns);
+        }
+        next = MIN(next, can_virtual_replay(node, bus->now_ns));
+    }
+    return next;
+}
+
+// Node whose queue head wins arbitration, its head is taken off the queue. NULL if no frame waits.
+static RHSHalCANVirtualNode* can_virtual_arbitrate(RHSHalCANVirtualBus* bus, RHSHalCANTxEntry* entry)
+{
+    RHSHalCANVirtualNode* winner = NULL;
+
+    RHS_CRITICAL_ENTER();
+    for (RHSHalCANVirtualNode* node = bus->nodes; node != NULL; node = node->next)
+    {
+        if (node->active && !node->bus_off && node->tx_queue.count > 0U &&
+            (winner == NULL || node->tx_queue.heap[0].key < winner->tx_queue.heap[0].key))
+        {
+            winner = node;
+        }
+    }
+    if (winner)
+    {
+        *entry = winner->tx_queue.heap[0];
+        rhs_hal_can_tx_queue_pop(&winner->tx_queue);
+    }
+    RHS_CRITICAL_EXIT();
+
+    return winner;
+}
+
+static int32_t can_virtual_bus_thread(void* context)
+{
+    RHSHalCANVirtualBus* bus     = context;
+    const uint64_t       tick_ns = RHS_HAL_CAN_VIRTUAL_NS_PER_S / rhs_kernel_get_tick_frequency();
+
+    for (;;)
+    {
+        RHSHalCANTxEntry entry;
+
+        rhs_assert(rhs_mutex_acquire(bus->mutex, RHSWaitForever) == RHSStatusOk);
+        const uint64_t kernel = can_virtual_kernel_ns(bus);
+        bus->now_ns           = MAX(bus->now_ns, kernel);
+
+        const uint64_t        next   = can_virtual_events(bus);
+        RHSHalCANVirtualNode* sender = can_virtual_arbitrate(bus, &entry);
+        if (sender)
+        {
+            can_virtual_transmit(bus, sender, &entry);
+        }
+        rhs_mutex_release(bus->mutex);
+
+        if (sender)
+        {
+            continue;
+        }
+
+        // Idle, sleep until the next replayed frame or recovery unless a frame is queued meanwhile
+        uint32_t timeout = RHSWaitForever;
+        if (next != UINT64_MAX)
+        {
+            timeout = (uint32_t) MIN((next - kernel + tick_ns - 1U) / tick_ns, (uint64_t) RHSWaitForever - 1U);
+        }
+        rhs_thread_flags_wait(RHS_HAL_CAN_VIRTUAL_FLAG_WAKE, RHSFlagWaitAny, timeout);
+    }
+
+    return 0;
+}
+
+/*********************************** CAN INIT ************************************/
+
+void* rhs_hal_can_get_handle(RHSHalCANId id)
+{
+    return &rhs_hal_can[id].node;
+}
+
+void rhs_hal_can_init(RHSHalCANId id, uint32_t baud)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(rhs_hal_can_common[id].enabled == false);
+    rhs_assert(baud > 0U);
+
+    RHSHalCAN*           can = &rhs_hal_can[id];
+    RHSHalCANVirtualBus* bus = &rhs_hal_can_virtual_bus[id];
+
+    can->error_code   = RHSHalCANErrorCodeNone;
+    can->filter_count = 0;
+    if (can->node.backoff_ms == 0U)
+    {
+        can->node.backoff_ms = RHS_HAL_CAN_BUS_OFF_BACKOFF_MS;
+    }
+    rhs_hal_can_common_init(id, baud);
+
+    if (bus->thread == NULL)
+    {
+        bus->mutex     = rhs_mutex_alloc(RHSMutexTypeNormal);
+        bus->last_tick = rhs_get_tick();
+        bus->thread    = rhs_thread_alloc_ex(rhs_hal_can_virtual_thread_names[id],
+                                          RHS_HAL_CAN_VIRTUAL_STACK_SIZE,
+                                          RHSThreadPriorityIsr,
+                                          can_virtual_bus_thread,
+                                          bus);
+        rhs_thread_start(bus->thread);
+    }
+
+    // The channel is a node of its bus like the simulated ones, the bus runs at the last baud set
+    rhs_assert(rhs_mutex_acquire(bus->mutex, RHSWaitForever) == RHSStatusOk);
+    bus->baud = baud;
+    if (can->node.bus == NULL)
+    {
+        can->node.bus  = bus;
+        can->node.can  = can;
+        can->node.next = bus->nodes;
+        bus->nodes     = &can->node;
+    }
+    can->node.tx_queue.count = 0;
+    can->node.tec            = 0;
+    can->node.rec            = 0;
+    can->node.bus_off        = false;
+    can->node.active         = true;
+    can->common->enabled     = true;
+    rhs_mutex_release(bus->mutex);
+}
+
+void rhs_hal_can_deinit(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    RHSHalCAN* can = &rhs_hal_can[id];
+
+    // Simulated nodes keep the bus running
+    rhs_assert(rhs_mutex_acquire(can->node.bus->mutex, RHSWaitForever) == RHSStatusOk);
+    RHS_CRITICAL_ENTER();
+    can->node.active         = false;
+    can->node.tx_queue.count = 0;
+    can->common->rx_started  = false;
+    can->common->rx_head     = 0;
+    can->common->rx_tail     = 0;
+    can->common->enabled     = false;
+    RHS_CRITICAL_EXIT();
+    rhs_mutex_release(can->node.bus->mutex);
+}
+
+void rhs_hal_can_set_bus_off_backoff(RHSHalCANId id, uint32_t backoff_ms)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(backoff_ms > 0U);
+
+    rhs_hal_can[id].node.backoff_ms = backoff_ms;
+}
+
+bool rhs_hal_can_tx(RHSHalCANId id, RHSHalCANFrameType* frame)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    RHSHalCAN* can = &rhs_hal_can[id];
+
+    // The queue stands in for the mailboxes
+    if (!can_virtual_push(&can->node, frame, RHS_HAL_CAN_TX_MAILBOXES))
+    {
+        rhs_atomic_add(&can->common->statistic.tx_ovfs, 1);
+        return false;
+    }
+    can_virtual_wake(can->node.bus);
+    return true;
+}
+
+bool rhs_hal_can_tx_submit(RHSHalCANId id, const RHSHalCANFrameType* frame)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+    rhs_assert(frame);
+
+    RHSHalCAN* can = &rhs_hal_can[id];
+
+    if (!can_virtual_push(&can->node, frame, RHS_HAL_CAN_TX_QUEUE_SIZE))
+    {
+        rhs_atomic_add(&can->common->tx_statistic.drops, 1);
+        rhs_atomic_add(&can->common->statistic.tx_ovfs, 1);
+        return false;
+    }
+    rhs_atomic_max(&can->common->tx_statistic.peak, rhs_atomic_load(&can->node.tx_queue.count));
+    can_virtual_wake(can->node.bus);
+    return true;
+}
+
+size_t rhs_hal_can_tx_pending(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    return rhs_atomic_load(&rhs_hal_can[id].node.tx_queue.count);
+}
+
+void rhs_hal_can_async_rx_start(RHSHalCANId id, RHSHalCANAsyncRxCallback callback, void* context)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+    rhs_assert(callback);
+    rhs_assert(context);
+
+    RHSHalCANCommon* common = &rhs_hal_can_common[id];
+
+    RHS_CRITICAL_ENTER();
+    common->rx_callback = callback;
+    common->rx_context  = context;
+    if (common->rx_threshold == 0)
+    {
+        common->rx_threshold = 1;
+    }
+    common->rx_started = true;
+    RHS_CRITICAL_EXIT();
+}
+
+bool rhs_hal_can_rx(RHSHalCANId id, RHSHalCANFrameType* frame)
+{
+    rhs_assert(rhs_hal_can_common[id].enabled == true);
+
+    // The ring is filled from rhs_hal_can_init on, it is read before async receive too
+    return rhs_hal_can_common_rx_read(&rhs_hal_can_common[id], frame, 1) == 1;
+}
+
+size_t rhs_hal_can_get_filter_banks(RHSHalCANId id)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+
+    return RHS_HAL_CAN_FILTER_BANKS;
+}
+
+bool rhs_hal_can_set_filters(RHSHalCANId id, const RHSHalCANFilter* filters, size_t count)
+{
+    rhs_assert(id < RHSHalCANIdMax);
+    rhs_assert(filters || count == 0);
+
+    if (count > RHS_HAL_CAN_FILTER_BANKS)
+    {
+        return false;
+    }
+
+    RHS_CRITICAL_ENTER();
+    memcpy(rhs_hal_can[id].filters, filters, count * sizeof(RHSHalCANFilter));
+    rhs_hal_can[id].filter_count = count;
+    RHS_CRITICAL_EXIT();
+
+    return true;
+}
+
+/******************************** SIMULATED NODES ********************************/
+
+RHSHalCANVirtualNode* rhs_hal_can_virtual_node_alloc(RHSHalCANId bus_id)
+{
+    rhs_assert(bus_id < RHSHalCANIdMax);
+
+    RHSHalCANVirtualBus* bus = &rhs_hal_can_virtual_bus[bus_id];
+    rhs_assert(bus->thread);
+
+    RHSHalCANVirtualNode* node = malloc(sizeof(RHSHalCANVirtualNode));
+    *node = (RHSHalCANVirtualNode){.bus = bus, .active = true, .backoff_ms = RHS_HAL_CAN_BUS_OFF_BACKOFF_MS};
+
+    rhs_assert(rhs_mutex_acquire(bus->mutex, RHSWaitForever) == RHSStatusOk);
+    node->next = bus->nodes;
+    bus->nodes = node;
+    rhs_mutex_release(bus->mutex);
+
+    return node;
+}
+
+void rhs_hal_can_virtual_node_free(RHSHalCANVirtualNode* node)
+{
+    rhs_assert(node);
+    rhs_assert(node->can == NULL);
+
+    RHSHalCANVirtualBus* bus = node->bus;
+
+    rhs_assert(rhs_mutex_acquire(bus->mutex, RHSWaitForever) == RHSStatusOk);
+    RHSHalCANVirtualNode** link = &bus->nodes;
+    while (*link != node)
+    {
+        rhs_assert(*link);
+        link = &(*link)->next;
+    }
+    *link = node->next;
+    rhs_mutex_release(bus->mutex);
+
+    free(node);
+}
+
+void rhs_hal_can_virtual_node_set_rx_callback(RHSHalCANVirtualNode*      node,
+                                              RHSHalCANVirtualRxCallback callback,
+                                              void*                      context)
+{
+    rhs_assert(node);
+
+    RHS_CRITICAL_ENTER();
+    node->rx_callback = callback;
+    node->rx_context  = context;
+    RHS_CRITICAL_EXIT();
+}
+
+bool rhs_hal_can_virtual_node_tx(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame)
+{
+    rhs_assert(node);
+    rhs_assert(frame);
+
+    if (!can_virtual_push(node, frame, RHS_HAL_CAN_TX_QUEUE_SIZE))
+    {
+        return false;
+    }
+    can_virtual_wake(node->bus);
+    return true;
+}
+
+void rhs_hal_can_virtual_node_replay(RHSHalCANVirtualNode*              node,
+                                     const RHSHalCANVirtualTraceRecord* trace,
+                                     size_t                             count,
+                                     uint32_t                           period_us,
+                                     uint32_t                           loops)
+{
+    rhs_assert(node);
+    rhs_assert(trace && count > 0);
+    rhs_assert(period_us >= trace[count - 1U].time_us);
+    rhs_assert(period_us > 0U || loops > 0U);
+    for (size_t i = 1; i < count; i++)
+    {
+        rhs_assert(trace[i].time_us >= trace[i - 1U].time_us);
+    }
+
+    // The first loop starts at the next bus thread pass
+    rhs_assert(rhs_mutex_acquire(node->bus->mutex, RHSWaitForever) == RHSStatusOk);
+    node->trace               = trace;
+    node->trace_count         = count;
+    node->trace_index         = 0;
+    node->trace_period_us     = period_us;
+    node->trace_loops         = loops;
+    node->trace_start_ns      = UINT64_MAX;
+    node->statistic.replaying = true;
+    rhs_mutex_release(node->bus->mutex);
+
+    can_virtual_wake(node->bus);
+}
+
+void rhs_hal_can_virtual_node_replay_stop(RHSHalCANVirtualNode* node)
+{
+    rhs_assert(node);
+
+    rhs_assert(rhs_mutex_acquire(node->bus->mutex, RHSWaitForever) == RHSStatusOk);
+    node->trace               = NULL;
+    node->statistic.replaying = false;
+    rhs_mutex_release(node->bus->mutex);
+}
+
+RHSHalCANVirtualNodeStatistic rhs_hal_can_virtual_node_get_statistic(RHSHalCANVirtualNode* node)
+{
+    rhs_assert(node);
+
+    RHS_CRITICAL_ENTER();
+    RHSHalCANVirtualNodeStatistic statistic = node->statistic;
+    statistic.state                         = can_virtual_state(node);
+    statistic.tec                           = (uint16_t) node->tec;
+    statistic.rec                           = (uint8_t) node->rec;
+    RHS_CRITICAL_EXIT();
+
+    return statistic;
+}
+
+void rhs_hal_can_virtual_inject_errors(RHSHalCANId bus_id, RHSHalCANErrorCode code, uint32_t frames)
+{
+    rhs_assert(bus_id < RHSHalCANIdMax);
+    rhs_assert(code > RHSHalCANErrorCodeNone && code < RHSHalCANErrorCodeMax);
+
+    RHSHalCANVirtualBus* bus = &rhs_hal_can_virtual_bus[bus_id];
+
+    RHS_CRITICAL_ENTER();
+    bus->inject_code   = code;
+    bus->inject_frames = frames;
+    RHS_CRITICAL_EXIT();
+}
+
+static int can_virtual_hex(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool rhs_hal_can_virtual_trace_parse(const char* line, uint64_t* time_us, RHSHalCANFrameType* frame)
+{
+    rhs_assert(line);
+    rhs_assert(time_us);
+    rhs_assert(frame);
+
+    char* end;
+
+    // (seconds.microseconds)
+    if (*line != '(' || line[1] < '0' || line[1] > '9')
+    {
+        return false;
+    }
+    const uint64_t seconds = strtoull(line + 1, &end, 10);
+    if (*end != '.')
+    {
+        return false;
+    }
+    const char*    fraction = end + 1;
+    const uint64_t micros   = strtoull(fraction, &end, 10);
+    if (end - fraction != 6 || *end != ')')
+    {
+        return false;
+    }
+
+    // Interface name
+    line = end + 1;
+    while (*line == ' ')
+    {
+        line++;
+    }
+    while (*line != ' ' && *line != '\0')
+    {
+        line++;
+    }
+    while (*line == ' ')
+    {
+        line++;
+    }
+
+    // id#data or id#R with an optional length
+    uint32_t id     = 0;
+    size_t   digits = 0;
+    for (; can_virtual_hex(line[digits]) >= 0; digits++)
+    {
+        id = (id << 4) | (uint32_t) can_virtual_hex(line[digits]);
+    }
+    if (line[digits] != '#' || (digits != 3 && digits != 8) || id > (digits == 3 ? 0x7FFU : 0x1FFFFFFFU))
+    {
+        return false;
+    }
+    *frame = (RHSHalCANFrameType){.id = id, .type = digits == 3 ? FrameTypeStdID : FrameTypeExtID};
+
+    line += digits + 1U;
+    if (*line == 'R')
+    {
+        frame->rtr = true;
+        line++;
+        if (*line >= '0' && *line <= '8')
+        {
+            frame->len = (uint8_t) (*line++ - '0');
+        }
+    }
+    else
+    {
+        while (frame->len < 8U && can_virtual_hex(line[0]) >= 0 && can_virtual_hex(line[1]) >= 0)
+        {
+            frame->payload[frame->len++] = (uint8_t) ((can_virtual_hex(line[0]) << 4) | can_virtual_hex(line[1]));
+            line += 2;
+            if (*line == '.')
+            {
+                line++;
+            }
+        }
+    }
+    if (*line != '\0' && *line != '\r' && *line != '\n')
+    {
+        return false;
+    }
+
+    *time_us = seconds * 1000000U + micros;
+    return true;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file rhs_hal_can_virtual.h
+ * Virtual CAN bus, rhs_hal_can backend for host builds
+ *
+ * With the cmake option RHS_HAL_CAN_VIRTUAL the rhs_hal_can API is served by
+ * an in-process bus per channel instead of bxCAN. Any number of simulated
+ * nodes join the bus of a channel next to the channel itself. A bus thread
+ * picks the queued frame that wins arbitration, holds the bus for
+ * rhs_hal_can_frame_bits at the baud of rhs_hal_can_init and then delivers the
+ * frame to every other node. Bus time follows the kernel tick and may run one
+ * tick ahead of it, so with RHS_VIRTUAL_TIME hours of traffic run in seconds.
+ *
+ * Error counters follow the standard: a destroyed frame costs the sender 8
+ * and every receiver 1, and the sender retransmits it. A sender alone on the
+ * bus gets acknowledgment errors until it is error passive. Acceptance
+ * filters are matched in software, 14 banks per channel.
+ *
+ * Callbacks that run in ISR context on hardware, and the error callback,
+ * run in the bus thread. They must not allocate or free nodes.
+ */
+#pragma once
+
+#include "rhs_hal_can.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RHSHalCANVirtualNode RHSHalCANVirtualNode;
+
+/** Recorded frame */
+typedef struct
+{
+    uint32_t           time_us;  // Since trace start, not decreasing
+    RHSHalCANFrameType frame;
+} RHSHalCANVirtualTraceRecord;
+
+typedef struct
+{
+    RHSHalCANErrorState state;
+    uint16_t            tec;       // Above 255 in bus-off
+    uint8_t             rec;
+    uint32_t            tx_msgs;
+    uint32_t            tx_drops;  // Frames refused because the queue was full, replayed ones included
+    uint32_t            rx_msgs;
+    uint32_t            replayed;  // Trace records queued
+    bool                replaying;
+} RHSHalCANVirtualNodeStatistic;
+
+/** Frame callback of simulated node
+ *
+ * Called in the bus thread for every frame sent by another node.
+ *
+ * @param      node     node
+ * @param[in]  frame    frame, timestamp is set
+ * @param      context  callback context
+ */
+typedef void (*RHSHalCANVirtualRxCallback)(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame, void* context);
+
+/** Allocate simulated node on the bus of a channel
+ *
+ * @param      bus   channel, initialized once at least
+ *
+ * @return     node, it has a TX queue of RHS_HAL_CAN_TX_QUEUE_SIZE frames
+ */
+RHSHalCANVirtualNode* rhs_hal_can_virtual_node_alloc(RHSHalCANId bus);
+
+/** Leave the bus and free node, waits for a frame on the bus
+ *
+ * @param      node  node
+ */
+void rhs_hal_can_virtual_node_free(RHSHalCANVirtualNode* node);
+
+/** Set frame callback
+ *
+ * @param      node      node
+ * @param[in]  callback  callback, NULL to only count frames
+ * @param      context   callback context
+ */
+void rhs_hal_can_virtual_node_set_rx_callback(RHSHalCANVirtualNode*      node,
+                                              RHSHalCANVirtualRxCallback callback,
+                                              void*                      context);
+
+/** Queue frame, never blocks
+ *
+ * Frames leave in arbitration order like with rhs_hal_can_tx_submit.
+ *
+ * @param      node   node
+ * @param[in]  frame  frame, copied
+ *
+ * @return     false if the queue is full
+ */
+bool rhs_hal_can_virtual_node_tx(RHSHalCANVirtualNode* node, const RHSHalCANFrameType* frame);
+
+/** Replay recorded frames as load, replaces a running replay
+ *
+ * The bus thread queues every record at its time. A record that finds the
+ * queue full is dropped, so a trace faster than the bus shows as tx_drops.
+ *
+ * @param      node       node
+ * @param[in]  trace      records, must stay valid until the replay ends
+ * @param[in]  count      record count above 0
+ * @param[in]  period_us  time from loop start to the next loop start, at least the last record time
+ * @param[in]  loops      loop count, 0 to loop until stopped
+ */
+void rhs_hal_can_virtual_node_replay(RHSHalCANVirtualNode*              node,
+                                     const RHSHalCANVirtualTraceRecord* trace,
+                                     size_t                             count,
+                                     uint32_t                           period_us,
+                                     uint32_t                           loops);
+
+/** Stop replay, queued records are still sent
+ *
+ * @param      node  node
+ */
+void rhs_hal_can_virtual_node_replay_stop(RHSHalCANVirtualNode* node);
+
+/** Get node counters
+ *
+ * @param      node  node
+ *
+ * @return     statistic
+ */
+RHSHalCANVirtualNodeStatistic rhs_hal_can_virtual_node_get_statistic(RHSHalCANVirtualNode* node);
+
+/** Destroy the next frames on the bus with error frames
+ *
+ * Each destroyed frame takes half of its bits and an error frame of 17 bits
+ * on the bus, then it is retransmitted.
+ *
+ * @param      bus     channel
+ * @param[in]  code    error seen by the nodes, not RHSHalCANErrorCodeNone
+ * @param[in]  frames  frame count, replaces injections not done yet, 0 cancels
+ */
+void rhs_hal_can_virtual_inject_errors(RHSHalCANId bus, RHSHalCANErrorCode code, uint32_t frames);
+
+/** Parse line of a candump log, `(1436509052.249713) can0 123#DEADBEEF`
+ *
+ * Ids of 3 hex digits are standard, of 8 extended. `123#R` and `123#R4` are
+ * remote frames.
+ *
+ * @param[in]  line     log line, may end with a line break
+ * @param[out] time_us  absolute time of the frame
+ * @param[out] frame    frame
+ *
+ * @return     false if the line is not a frame
+ */
+bool rhs_hal_can_virtual_trace_parse(const char* line, uint64_t* time_us, RHSHalCANFrameType* frame);
+
+#ifdef __cplusplus
+}
+#endif
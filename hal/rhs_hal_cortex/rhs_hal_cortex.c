@@ -118,3 +118,43 @@ void rhs_hal_cortex_timer_wait(RHSHalCortexTimer cortex_timer)
     while (!rhs_hal_cortex_timer_is_expired(cortex_timer))
         ;
 }
+
+uint32_t rhs_hal_cortex_get_cycles(void)
+{
+#if !defined(STM32G0B1xx)
+    return DWT->CYCCNT;
+#else
+    return TIM2->CNT;
+#endif
+}
+
+uint32_t rhs_hal_cortex_get_cycles_frequency(void)
+{
+#if !defined(STM32G0B1xx)
+    return SystemCoreClock;
+#else
+    return 1000000U;
+#endif
+}
+
+uint64_t rhs_hal_cortex_get_cycles64(void)
+{
+    static uint64_t last_cycles = 0;
+    static uint32_t last_tick   = 0;
+
+    RHS_CRITICAL_ENTER();
+    const uint32_t now   = rhs_hal_cortex_get_cycles();
+    const uint32_t tick  = rhs_get_tick();
+    const uint32_t delta = now - (uint32_t) last_cycles;
+    // Ticks since last call tell how often the counter wrapped, the tick error is far below one wrap
+    const uint64_t expected = (uint64_t) (tick - last_tick) * rhs_hal_cortex_get_cycles_frequency() /
+                              rhs_kernel_get_tick_frequency();
+    const uint64_t wraps    = expected > delta ? (expected - delta + (1ULL << 31)) >> 32 : 0U;
+
+    last_cycles += (wraps << 32) + delta;
+    last_tick    = tick;
+    const uint64_t value = last_cycles;
+    RHS_CRITICAL_EXIT();
+
+    return value;
+}
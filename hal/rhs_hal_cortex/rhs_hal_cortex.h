@@ -18,3 +18,27 @@ RHSHalCortexTimer rhs_hal_cortex_timer_get(uint32_t timeout_us);
 bool rhs_hal_cortex_timer_is_expired(RHSHalCortexTimer cortex_timer);
 
 void rhs_hal_cortex_timer_wait(RHSHalCortexTimer cortex_timer);
+
+/** Get free-running cycle counter
+ *
+ * DWT->CYCCNT on Cortex-M3/M4/M7, TIM2 (1 MHz) on Cortex-M0+. Wraps around.
+ *
+ * @return     current counter value
+ */
+uint32_t rhs_hal_cortex_get_cycles(void);
+
+/** Get cycle counter frequency
+ *
+ * @return     counts per second of rhs_hal_cortex_get_cycles
+ */
+uint32_t rhs_hal_cortex_get_cycles_frequency(void);
+
+/** Get cycle counter extended to 64 bits, ISR safe
+ *
+ * Wraps of rhs_hal_cortex_get_cycles are counted against the kernel tick, so
+ * calls may be any time apart as long as the tick runs. Before the scheduler
+ * starts, call it at least once per counter wrap.
+ *
+ * @return     monotonic counter value, counts of rhs_hal_cortex_get_cycles_frequency
+ */
+uint64_t rhs_hal_cortex_get_cycles64(void);
@@ -8,6 +8,7 @@
 
 #include "rhs_hal_flash_ex.h"
 #include "rhs.h"
+#include "rhs_hal.h"
 #include "mt25ql128aba.h"
 
 #if defined(BMPLC_XL) || defined(BMPLC_L)
@@ -226,6 +227,11 @@ int rhs_hal_flash_ex_init(void)
 
 int rhs_hal_flash_ex_read(uint32_t addr, uint8_t* p_data, uint32_t size)
 {
+    if (!rhs_hal_init_ensure(RHSHalPeripheralFlashEx))
+    {
+        return RHS_FLASH_EX_BUSY;
+    }
+
     int error = RHS_FLASH_EX_OK;
     rhs_assert(addr + size <= MT25QL128ABA_FLASH_SIZE);
 
@@ -253,6 +259,11 @@ int rhs_hal_flash_ex_read(uint32_t addr, uint8_t* p_data, uint32_t size)
 
 int rhs_hal_flash_ex_erase_chip(void)
 {
+    if (!rhs_hal_init_ensure(RHSHalPeripheralFlashEx))
+    {
+        return RHS_FLASH_EX_BUSY;
+    }
+
     int error = RHS_FLASH_EX_OK;
 
     rhs_mutex_acquire(flash_mutex, RHSWaitForever);
@@ -289,10 +300,16 @@ int rhs_hal_flash_ex_erase_chip(void)
 
 int rhs_hal_flash_ex_write(uint32_t addr, const uint8_t* p_data, uint32_t size)
 {
+    if (!rhs_hal_init_ensure(RHSHalPeripheralFlashEx))
+    {
+        return RHS_FLASH_EX_BUSY;
+    }
+
     uint32_t       end_addr, current_size, current_addr;
     const uint8_t* write_data;
     int            error = RHS_FLASH_EX_OK;
     rhs_assert(addr + size <= MT25QL128ABA_FLASH_SIZE);
+    RHS_PROFILE_SCOPE(rhs_hal_flash_ex_write);
 
     rhs_mutex_acquire(flash_mutex, RHSWaitForever);
 
@@ -348,6 +365,11 @@ int rhs_hal_flash_ex_write(uint32_t addr, const uint8_t* p_data, uint32_t size)
 
 int rhs_hal_flash_ex_block_erase(uint32_t addr, uint32_t size)
 {
+    if (!rhs_hal_init_ensure(RHSHalPeripheralFlashEx))
+    {
+        return RHS_FLASH_EX_BUSY;
+    }
+
     int      error = RHS_FLASH_EX_OK;
     uint32_t current_size, current_addr;
     rhs_assert(addr + size <= MT25QL128ABA_FLASH_SIZE);
@@ -1,6 +1,7 @@
 #include "rhs_hal_i2c.h"
 #include "rhs.h"
 #include "rhs_hal_cortex.h"
+#include "rhs_hal.h"
 
 #define TAG "rhs_hal_i2c"
 
@@ -16,6 +17,7 @@ void rhs_hal_i2c_deinit(const RHSHalI2cBusHandle* handle)
 
 void rhs_hal_i2c_acquire(const RHSHalI2cBusHandle* handle)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralI2c);
     // Lock bus access
     handle->bus->callback(handle->bus, RHSHalI2cBusEventLock);
     // Ensure that no active handle set
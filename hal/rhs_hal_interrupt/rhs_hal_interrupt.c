@@ -1,4 +1,5 @@
 #include <rhs_hal_interrupt.h>
+#include "rhs.h"
 
 #if defined(STM32F765xx)
 #    include "stm32f765xx.h"
@@ -26,12 +27,12 @@
 #    define RHS_HAL_INTERRUPT_ACCOUNT_START() const uint32_t _isr_start = TIM2->CNT;
 #    define RHS_HAL_INTERRUPT_ACCOUNT_END()                   \
         const uint32_t _time_in_isr = TIM2->CNT - _isr_start; \
-        rhs_hal_interrupt.counter_time_in_isr_total += _time_in_isr;
+        rhs_atomic_add(&rhs_hal_interrupt.counter_time_in_isr_total, _time_in_isr);
 #else
 #    define RHS_HAL_INTERRUPT_ACCOUNT_START() const uint32_t _isr_start = DWT->CYCCNT;
 #    define RHS_HAL_INTERRUPT_ACCOUNT_END()                     \
         const uint32_t _time_in_isr = DWT->CYCCNT - _isr_start; \
-        rhs_hal_interrupt.counter_time_in_isr_total += _time_in_isr;
+        rhs_atomic_add(&rhs_hal_interrupt.counter_time_in_isr_total, _time_in_isr);
 #endif
 
 typedef struct
@@ -43,7 +44,7 @@ typedef struct
 typedef struct
 {
     RHSHalInterruptISRPair isr[RHSHalInterruptIdMax];
-    uint32_t               counter_time_in_isr_total;
+    volatile uint32_t      counter_time_in_isr_total;  // Nested ISRs add to it
 } RHSHalIterrupt;
 
 static RHSHalIterrupt rhs_hal_interrupt = {};
@@ -53,6 +54,7 @@ const IRQn_Type rhs_hal_interrupt_irqn[RHSHalInterruptIdMax] = {
 #if defined(BMPLC_XL) || defined(BMPLC_L)
     /* CAN */
     [RHSHalInterruptIdCAN1Rx0] = CAN1_RX0_IRQn,
+    [RHSHalInterruptIdCAN1Rx1] = CAN1_RX1_IRQn,
     [RHSHalInterruptIdCAN1SCE] = CAN1_SCE_IRQn,
     [RHSHalInterruptIdCAN1Tx]  = CAN1_TX_IRQn,
     /* UART */
@@ -67,6 +69,7 @@ const IRQn_Type rhs_hal_interrupt_irqn[RHSHalInterruptIdMax] = {
 #elif defined(BMPLC_M)
     /* CAN */
     [RHSHalInterruptIdCAN1Rx0] = CAN1_RX0_IRQn,
+    [RHSHalInterruptIdCAN1Rx1] = CAN1_RX1_IRQn,
     [RHSHalInterruptIdCAN1SCE] = CAN1_SCE_IRQn,
     [RHSHalInterruptIdCAN1Tx]  = CAN1_TX_IRQn,
     /* UART */
@@ -78,9 +81,11 @@ const IRQn_Type rhs_hal_interrupt_irqn[RHSHalInterruptIdMax] = {
 #    if defined(STM32F765xx)
     /* CAN */
     [RHSHalInterruptIdCAN1Rx0] = CAN1_RX0_IRQn,
+    [RHSHalInterruptIdCAN1Rx1] = CAN1_RX1_IRQn,
     [RHSHalInterruptIdCAN1SCE] = CAN1_SCE_IRQn,
     [RHSHalInterruptIdCAN1Tx]  = CAN1_TX_IRQn,
     [RHSHalInterruptIdCAN2Rx0] = CAN2_RX0_IRQn,
+    [RHSHalInterruptIdCAN2Rx1] = CAN2_RX1_IRQn,
     [RHSHalInterruptIdCAN2SCE] = CAN2_SCE_IRQn,
     [RHSHalInterruptIdCAN2Tx]  = CAN2_TX_IRQn,
     /* UART */
@@ -95,14 +100,17 @@ const IRQn_Type rhs_hal_interrupt_irqn[RHSHalInterruptIdMax] = {
 #    elif defined(STM32F407xx) || defined(STM32F405xx)
     /* CAN */
     [RHSHalInterruptIdCAN1Rx0] = CAN1_RX0_IRQn,
+    [RHSHalInterruptIdCAN1Rx1] = CAN1_RX1_IRQn,
     [RHSHalInterruptIdCAN1SCE] = CAN1_SCE_IRQn,
     [RHSHalInterruptIdCAN1Tx]  = CAN1_TX_IRQn,
     [RHSHalInterruptIdCAN2Rx0] = CAN2_RX0_IRQn,
+    [RHSHalInterruptIdCAN2Rx1] = CAN2_RX1_IRQn,
     [RHSHalInterruptIdCAN2SCE] = CAN2_SCE_IRQn,
     [RHSHalInterruptIdCAN2Tx]  = CAN2_TX_IRQn,
 #    elif defined(STM32F103xE)
     /* CAN */
     [RHSHalInterruptIdCAN1Rx0] = CAN1_RX0_IRQn,
+    [RHSHalInterruptIdCAN1Rx1] = CAN1_RX1_IRQn,
     [RHSHalInterruptIdCAN1SCE] = CAN1_SCE_IRQn,
     [RHSHalInterruptIdCAN1Tx]  = CAN1_TX_IRQn,
     /* UART */
@@ -120,8 +128,10 @@ __attribute__((always_inline)) inline static void rhs_hal_interrupt_call(RHSHalI
     const RHSHalInterruptISRPair* isr_descr = &rhs_hal_interrupt.isr[index];
 
     RHS_HAL_INTERRUPT_ACCOUNT_START();
+    RHS_TRACE_EVENT(RHSTraceEventIsrEnter, index, 0);
     if (isr_descr->isr != NULL)
         isr_descr->isr(isr_descr->context);
+    RHS_TRACE_EVENT(RHSTraceEventIsrExit, index, 0);
     RHS_HAL_INTERRUPT_ACCOUNT_END();
 }
 
@@ -151,10 +161,19 @@ __attribute__((always_inline)) inline static void rhs_hal_interrupt_disable(RHSH
     NVIC_DisableIRQ(rhs_hal_interrupt_irqn[index]);
 }
 
+static RHSMetric rhs_hal_interrupt_metric;
+
 void rhs_hal_interrupt_init(void)
 {
     NVIC_SetPriority(SVCall_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
     NVIC_SetPriority(PendSV_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 15, 0));
+
+    rhs_metric_init(&rhs_hal_interrupt_metric,
+                    "rhs_isr_cycles",
+                    RHSMetricTypeCounter,
+                    rhs_metric_read_word,
+                    (void*) &rhs_hal_interrupt.counter_time_in_isr_total);
+    rhs_metric_register(&rhs_hal_interrupt_metric);
 }
 
 void rhs_hal_interrupt_set_isr(RHSHalInterruptId index, RHSHalInterruptISR isr, void* context)
@@ -209,6 +228,12 @@ void CAN1_RX0_IRQHandler(void)
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Rx0);
 }
 
+/* CAN 1 RX1 */
+void CAN1_RX1_IRQHandler(void)
+{
+    rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Rx1);
+}
+
 void CAN1_SCE_IRQHandler(void)
 {
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN1SCE);
@@ -227,6 +252,12 @@ void CAN2_RX0_IRQHandler(void)
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN2Rx0);
 }
 
+/* CAN 2 RX1 */
+void CAN2_RX1_IRQHandler(void)
+{
+    rhs_hal_interrupt_call(RHSHalInterruptIdCAN2Rx1);
+}
+
 void CAN2_SCE_IRQHandler(void)
 {
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN2SCE);
@@ -277,6 +308,12 @@ void CAN1_RX0_IRQHandler(void)
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Rx0);
 }
 
+/* CAN 1 RX1 */
+void CAN1_RX1_IRQHandler(void)
+{
+    rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Rx1);
+}
+
 void CAN1_SCE_IRQHandler(void)
 {
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN1SCE);
@@ -293,6 +330,12 @@ void CAN2_RX0_IRQHandler(void)
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN2Rx0);
 }
 
+/* CAN 2 RX1 */
+void CAN2_RX1_IRQHandler(void)
+{
+    rhs_hal_interrupt_call(RHSHalInterruptIdCAN2Rx1);
+}
+
 void CAN2_SCE_IRQHandler(void)
 {
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN2SCE);
@@ -316,6 +359,11 @@ void USB_LP_CAN1_RX0_IRQHandler(void)
 #    endif
 }
 
+void CAN1_RX1_IRQHandler(void)
+{
+    rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Rx1);
+}
+
 void USB_HP_CAN1_TX_IRQHandler(void)
 {
     rhs_hal_interrupt_call(RHSHalInterruptIdCAN1Tx);
@@ -514,5 +562,5 @@ const char* rhs_hal_interrupt_get_name(uint8_t exception_number)
 
 uint32_t rhs_hal_interrupt_get_time_in_isr_total(void)
 {
-    return rhs_hal_interrupt.counter_time_in_isr_total;
+    return rhs_atomic_load(&rhs_hal_interrupt.counter_time_in_isr_total);
 }
@@ -14,6 +14,7 @@ typedef enum
 #if defined(BMPLC_XL) || defined(BMPLC_L)
     /* CAN */
     RHSHalInterruptIdCAN1Rx0,
+    RHSHalInterruptIdCAN1Rx1,
     RHSHalInterruptIdCAN1SCE,
     RHSHalInterruptIdCAN1Tx,
 
@@ -31,6 +32,7 @@ typedef enum
 #elif defined(BMPLC_M)
     /* CAN */
     RHSHalInterruptIdCAN1Rx0,
+    RHSHalInterruptIdCAN1Rx1,
     RHSHalInterruptIdCAN1SCE,
     RHSHalInterruptIdCAN1Tx,
 
@@ -47,9 +49,11 @@ typedef enum
 #    if defined(STM32F765xx)
     /* CAN */
     RHSHalInterruptIdCAN1Rx0,
+    RHSHalInterruptIdCAN1Rx1,
     RHSHalInterruptIdCAN1SCE,
     RHSHalInterruptIdCAN1Tx,
     RHSHalInterruptIdCAN2Rx0,
+    RHSHalInterruptIdCAN2Rx1,
     RHSHalInterruptIdCAN2SCE,
     RHSHalInterruptIdCAN2Tx,
 
@@ -66,9 +70,11 @@ typedef enum
 #    elif defined(STM32F407xx) || defined(STM32F405xx)
     /* CAN */
     RHSHalInterruptIdCAN1Rx0,
+    RHSHalInterruptIdCAN1Rx1,
     RHSHalInterruptIdCAN1SCE,
     RHSHalInterruptIdCAN1Tx,
     RHSHalInterruptIdCAN2Rx0,
+    RHSHalInterruptIdCAN2Rx1,
     RHSHalInterruptIdCAN2SCE,
     RHSHalInterruptIdCAN2Tx,
 #    elif defined(STM32F103xE)
@@ -1,5 +1,6 @@
 #include <rhs.h>
 #include <rhs_hal_random.h>
+#include <rhs_hal.h>
 
 #if defined(STM32F765xx)
 #    include "stm32f7xx_ll_bus.h"
@@ -62,6 +63,7 @@ void rhs_hal_random_init(void)
 
 uint32_t rhs_hal_random_get(void)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRandom);
     // while (LL_HSEM_1StepLock(HSEM, CFG_HW_RNG_SEMID))
     // ;
     LL_RNG_Enable(RNG);
@@ -77,6 +79,7 @@ uint32_t rhs_hal_random_get(void)
 
 void rhs_hal_random_fill_buf(uint8_t* buf, uint32_t len)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRandom);
     rhs_assert(buf);
     rhs_assert(len);
 
@@ -112,11 +115,13 @@ void rhs_hal_random_init(void)
 
 uint32_t rhs_hal_random_get(void)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRandom);
     return rhs_hal_random_read_rng();
 }
 
 void rhs_hal_random_fill_buf(uint8_t* buf, uint32_t len)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRandom);
     rhs_assert(buf);
     rhs_assert(len);
 
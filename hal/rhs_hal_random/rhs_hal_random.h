@@ -3,6 +3,8 @@
 
 void rhs_hal_random_init(void);
 
+// Calls below are thread-only until the RNG is initialized, see RHS_HAL_INIT_ENSURE
+
 uint32_t rhs_hal_random_get(void);
 
 void rhs_hal_random_fill_buf(uint8_t* buf, uint32_t len);
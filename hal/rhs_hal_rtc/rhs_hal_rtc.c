@@ -1,4 +1,5 @@
 #include "rhs_hal_rtc.h"
+#include "rhs_hal.h"
 
 #if defined(BMPLC_XL) || defined(BMPLC_L)
 #    include "stm32f7xx_ll_rtc.h"
@@ -86,6 +87,7 @@ void rhs_hal_rtc_init(void)
 
 void rhs_hal_rtc_set_datetime(datetime_t* datetime)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRtc);
     RTC_TimeTypeDef sTime;
     RTC_DateTypeDef sDate;
 
@@ -121,6 +123,7 @@ void rhs_hal_rtc_set_datetime(datetime_t* datetime)
 
 void rhs_hal_rtc_get_datetime(datetime_t* out_datetime)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRtc);
     RTC_TimeTypeDef sTime;
     RTC_DateTypeDef sDate;
 
@@ -168,10 +171,12 @@ void rhs_hal_rtc_get_timestamp(uint64_t* out_seconds, uint32_t* out_mseconds)
 
 uint32_t rhs_hal_rtc_get_register(RHSHalRtcRegister reg)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRtc);
     return LL_RTC_BAK_GetRegister(RTC, reg);
 }
 
 void rhs_hal_rtc_set_register(RHSHalRtcRegister reg, uint32_t value)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralRtc);
     LL_RTC_BAK_SetRegister(RTC, reg, value);
 }
@@ -11,6 +11,8 @@ typedef enum
 
 void rhs_hal_rtc_init(void);
 
+// Calls below are thread-only until the RTC is initialized, see RHS_HAL_INIT_ENSURE
+
 void rhs_hal_rtc_set_datetime(datetime_t* datetime);
 
 void rhs_hal_rtc_get_datetime(datetime_t* out_datetime);
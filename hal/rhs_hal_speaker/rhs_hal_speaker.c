@@ -1,5 +1,6 @@
 #include "rhs_hal_speaker.h"
 #include "rhs.h"
+#include "rhs_hal.h"
 #include "stdbool.h"
 #include "FreeRTOS.h"
 #include "semphr.h"
@@ -269,6 +270,7 @@ static inline uint32_t rhs_hal_speaker_calculate_compare(float volume)
 bool rhs_hal_speaker_acquire(uint32_t timeout)
 {
     rhs_assert(!RHS_IS_IRQ_MODE());
+    rhs_assert(rhs_hal_init_ensure(RHSHalPeripheralSpeaker));
 
     if (rhs_mutex_acquire(rhs_hal_speaker_mutex, timeout) == RHSStatusOk)
     {
@@ -82,6 +82,7 @@ void rhs_hal_usb_init(void)
 
 void rhs_hal_usb_reinit(void)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralUsb);
 #if defined(STM32F1)
     RCC->APB1RSTR |= RCC_APB1RSTR_USBRST;
     RCC->APB1ENR &= ~RCC_APB1ENR_USBEN;
@@ -133,6 +134,7 @@ void rhs_hal_usb_reinit(void)
 
 void rhs_hal_usb_disable(void)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralUsb);
 #if defined(STM32F1)
     RCC->APB1RSTR |= RCC_APB1RSTR_USBRST;
     RCC->APB1ENR &= ~RCC_APB1ENR_USBEN;
@@ -175,6 +177,7 @@ static RHSHalUsbInterface* s_usb_desc = NULL;
 
 void rhs_hal_usb_set_interface(RHSHalUsbInterface* iface)
 {
+    RHS_HAL_INIT_ENSURE(RHSHalPeripheralUsb);
     if (iface == s_usb_desc)
         return;
     if (s_usb_desc != NULL)
@@ -1,8 +1,173 @@
 #include "rhs.h"
+#include <string.h>
+
+#define TAG "rhs"
+
+#define RHS_SERVICES_START_STACK 1024
+#define RHS_SERVICES_READY_MS    1000  // Longest wait for a wave to create its records
+
+static RHSThread* rhs_services_thread = NULL;
 
 void rhs_init(void)
 {
+    const uint32_t start = rhs_boot_begin();
+
     rhs_record_init();
+    rhs_metrics_init();
+    rhs_queue_stats_init();
     rhs_thread_init();
     rhs_log_init();
+    rhs_retained_init();
+
+    rhs_boot_mark(RHSBootEventTypeInit, "rhs_init", start);
+}
+
+static int32_t rhs_service_body(void* context)
+{
+    const RHSInternalApplication* service = context;
+    rhs_boot_mark(RHSBootEventTypeService, service->name, rhs_boot_begin());
+    return service->app(NULL);
+}
+
+static bool rhs_service_has_record(const char* const* records, const char* record)
+{
+    for (; records && *records; records++)
+    {
+        if (strcmp(*records, record) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t rhs_service_find_provider(const char* record)
+{
+    rhs_assert(record);
+
+    for (int32_t i = 0; i < RHS_SERVICES_COUNT; i++)
+    {
+        if (rhs_service_has_record(RHS_SERVICES[i].provides, record))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Records without a provider service come from co services or start up hooks
+static bool rhs_service_is_startable(size_t index, const bool* started)
+{
+    for (const char* const* record = RHS_SERVICES[index].consumes; record && *record; record++)
+    {
+        int32_t provider = rhs_service_find_provider(*record);
+        if (provider >= 0 && (size_t) provider != index && !started[provider])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void rhs_service_start(size_t index, bool* started, bool* wave)
+{
+    const RHSInternalApplication* service = &RHS_SERVICES[index];
+
+    RHSThread* thread =
+        rhs_thread_alloc_service(service->name, service->stack_size, rhs_service_body, (void*) service);
+    rhs_thread_start(thread);
+    started[index] = true;
+    wave[index]    = true;
+}
+
+static bool rhs_service_is_ready(size_t index)
+{
+    for (const char* const* record = RHS_SERVICES[index].provides; record && *record; record++)
+    {
+        if (!rhs_record_exists(*record))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Start thread outranks the services, a wave runs only while it waits here
+static void rhs_services_wait_ready(bool* wave)
+{
+    const uint32_t start = rhs_get_tick();
+
+    for (size_t i = 0; i < (size_t) RHS_SERVICES_COUNT; i++)
+    {
+        while (wave[i] && !rhs_service_is_ready(i))
+        {
+            if (rhs_get_tick() - start >= rhs_ms_to_ticks(RHS_SERVICES_READY_MS))
+            {
+                RHS_LOG_W(TAG, "%s did not create its records, starting its consumers", RHS_SERVICES[i].name);
+                break;
+            }
+            rhs_delay_tick(1);
+        }
+        wave[i] = false;
+    }
+}
+
+static int32_t rhs_services_start(void* context)
+{
+    (void) context;
+
+    bool*  started = calloc(RHS_SERVICES_COUNT ? RHS_SERVICES_COUNT : 1, sizeof(bool));
+    bool*  wave    = calloc(RHS_SERVICES_COUNT ? RHS_SERVICES_COUNT : 1, sizeof(bool));
+    size_t count   = 0;
+
+    while (count < (size_t) RHS_SERVICES_COUNT)
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < (size_t) RHS_SERVICES_COUNT; i++)
+        {
+            if (!started[i] && rhs_service_is_startable(i, started))
+            {
+                rhs_service_start(i, started, wave);
+                size++;
+            }
+        }
+
+        if (size == 0)
+        {
+            RHS_LOG_E(TAG, "Service dependency cycle, starting the rest in registration order");
+            for (size_t i = 0; i < (size_t) RHS_SERVICES_COUNT; i++)
+            {
+                if (!started[i])
+                {
+                    rhs_service_start(i, started, wave);
+                    size++;
+                }
+            }
+        }
+        count += size;
+        rhs_services_wait_ready(wave);
+    }
+
+    free(wave);
+    free(started);
+    return 0;
+}
+
+void rhs_start_services(void)
+{
+    rhs_assert(rhs_services_thread == NULL);
+
+    rhs_services_thread = rhs_thread_alloc_ex(
+        "services_start", RHS_SERVICES_START_STACK, RHSThreadPriorityHighest, rhs_services_start, NULL);
+    rhs_thread_start(rhs_services_thread);
+}
+
+void rhs_wait_services(void)
+{
+    if (rhs_services_thread)
+    {
+        rhs_thread_join(rhs_services_thread);
+        rhs_thread_free(rhs_services_thread);
+        rhs_services_thread = NULL;
+    }
 }
@@ -3,6 +3,8 @@
 #include "core/base.h"
 #include "core/check.h"
 #include "core/common.h"
+#include "core/atomic.h"
+#include "core/seqlock.h"
 #include "core/defines.h"
 #include "core/event_flag.h"
 #include "core/kernel.h"
@@ -13,9 +15,44 @@
 #include "core/thread.h"
 #include "core/thread_list.h"
 #include "core/timer.h"
+#include "core/timer_wheel.h"
 #include "core/stream_buf.h"
 #include "core/semaphore.h"
+#include "core/wait_set.h"
+#include "core/coroutine.h"
 #include "core/api_lock.h"
+#include "core/rpc.h"
 #include "core/record.h"
+#include "core/trace.h"
+#include "core/profile.h"
+#include "core/boot.h"
+#include "core/retained.h"
+#include "core/metrics.h"
+#include "core/queue_stats.h"
+#include "core/virtual_time.h"
 
 void rhs_init(void);
+
+/** Start RHS_SERVICES threads
+ *
+ * Creates a highest priority start thread that runs once the kernel is
+ * started. It starts the services in waves: a service starts when the
+ * providers of the records it consumes have created them, or after
+ * RHS_SERVICES_READY_MS. Call after rhs_init and before kernel start.
+ */
+void rhs_start_services(void);
+
+/** Wait for the start thread of rhs_start_services and free it
+ *
+ * The loader calls it before the start up hooks. Returns at once if
+ * rhs_start_services was not called.
+ */
+void rhs_wait_services(void);
+
+/** Find service that provides record
+ *
+ * @param[in]  record  record name
+ *
+ * @return     index in RHS_SERVICES or -1
+ */
+int32_t rhs_service_find_provider(const char* record);
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Compare two `bench` CLI JSON reports and flag regressions.
+
+    python3 tools/bench_compare.py base.json new.json --threshold 5
+
+Input may contain surrounding CLI/log output, the first JSON object found in
+each file is used. Exit status is 1 when any benchmark got slower than the
+threshold (percent of cycles per operation).
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, errors="replace") as f:
+        text = f.read()
+    start = text.find("{")
+    end = text.rfind("}")
+    if start < 0 or end < 0:
+        raise SystemExit("%s: no JSON report found" % path)
+    report = json.loads(text[start : end + 1])
+    return report, {b["name"]: b for b in report["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=5.0, help="allowed slowdown, percent")
+    args = parser.parse_args()
+
+    base_report, base = load(args.base)
+    new_report, new = load(args.new)
+
+    if base_report.get("frequency") != new_report.get("frequency"):
+        print("warning: cycle counter frequency differs, results are not comparable", file=sys.stderr)
+
+    print("%-24s %12s %12s %8s" % ("benchmark", base_report.get("git_sha", "base"), new_report.get("git_sha", "new"), "diff"))
+    regressed = False
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-24s %12s %12s" % (name, base.get(name, {}).get("cycles_per_op", "-"), new.get(name, {}).get("cycles_per_op", "-")))
+            continue
+        old_value = base[name]["cycles_per_op"]
+        new_value = new[name]["cycles_per_op"]
+        diff = (new_value - old_value) * 100.0 / old_value if old_value else 0.0
+        mark = ""
+        if diff > args.threshold:
+            mark = " <-- regression"
+            regressed = True
+        print("%-24s %12d %12d %+7.1f%%%s" % (name, old_value, new_value, diff, mark))
+
+    sys.exit(1 if regressed else 0)
+
+
+if __name__ == "__main__":
+    main()
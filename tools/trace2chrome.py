@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Convert RHS tracer dump (see core/trace.h) to Chrome trace JSON.
+
+Input is the text produced by `trace dump` CLI command or rhs_trace_dump():
+
+    F <cycles per second>
+    N <events> <lost>
+    T <thread id> <thread name>
+    E <timestamp hex> <type> <id> <arg>
+
+Unknown lines (CLI echo, log output) are ignored, so a raw RTT/UART/TCP
+capture can be fed directly. Open the result in chrome://tracing or
+https://ui.perfetto.dev.
+"""
+
+import argparse
+import json
+import socket
+import sys
+
+ISR_TID_BASE = 0x10000
+
+SPAN_EVENTS = {"SB": "B", "SE": "E"}
+OBJECT_EVENTS = {
+    "QP": "queue_put",
+    "QG": "queue_get",
+    "MA": "mutex_acquire",
+    "MR": "mutex_release",
+}
+
+
+def read_tcp(address):
+    host, port = address.rsplit(":", 1)
+    data = b""
+    with socket.create_connection((host, int(port)), timeout=10) as sock:
+        while b"# end" not in data:
+            chunk = sock.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+    return data.decode(errors="replace").splitlines()
+
+
+def convert(lines):
+    frequency = 1000000
+    lost = 0
+    threads = {}
+    events = []
+
+    last_raw = None
+    base = 0
+    high = 0
+    current_tid = 0
+    isr_stack = []
+
+    for line in lines:
+        fields = line.strip().split()
+        if not fields:
+            continue
+        tag = fields[0]
+        if tag == "F" and len(fields) == 2:
+            frequency = int(fields[1])
+        elif tag == "N" and len(fields) == 3:
+            lost = int(fields[2])
+        elif tag == "T" and len(fields) >= 3:
+            threads[int(fields[1], 16)] = " ".join(fields[2:])
+        elif tag == "E" and len(fields) == 5:
+            raw = int(fields[1], 16)
+            if last_raw is None:
+                base = raw
+            elif raw < last_raw:
+                high += 1 << 32
+            last_raw = raw
+            ts = (high + raw - base) * 1e6 / frequency
+
+            kind, ident, arg = fields[2], fields[3], int(fields[4])
+            tid = isr_stack[-1] if isr_stack else current_tid
+
+            if kind == "SI":
+                current_tid = int(ident, 16)
+                events.append({"ph": "B", "name": "run", "pid": 0, "tid": current_tid, "ts": ts})
+            elif kind == "SO":
+                events.append({"ph": "E", "name": "run", "pid": 0, "tid": int(ident, 16), "ts": ts})
+            elif kind == "IE":
+                isr_tid = ISR_TID_BASE + int(ident, 16)
+                threads.setdefault(isr_tid, "ISR %d" % int(ident, 16))
+                isr_stack.append(isr_tid)
+                events.append({"ph": "B", "name": "isr", "pid": 0, "tid": isr_tid, "ts": ts})
+            elif kind == "IX":
+                isr_tid = ISR_TID_BASE + int(ident, 16)
+                if isr_stack and isr_stack[-1] == isr_tid:
+                    isr_stack.pop()
+                events.append({"ph": "E", "name": "isr", "pid": 0, "tid": isr_tid, "ts": ts})
+            elif kind in SPAN_EVENTS:
+                events.append({"ph": SPAN_EVENTS[kind], "name": ident, "pid": 0, "tid": tid, "ts": ts})
+            elif kind == "MK":
+                events.append(
+                    {"ph": "i", "s": "t", "name": ident, "pid": 0, "tid": tid, "ts": ts, "args": {"arg": arg}}
+                )
+            elif kind in OBJECT_EVENTS:
+                events.append(
+                    {
+                        "ph": "i",
+                        "s": "t",
+                        "name": OBJECT_EVENTS[kind],
+                        "pid": 0,
+                        "tid": tid,
+                        "ts": ts,
+                        "args": {"object": "0x" + ident, "status": arg},
+                    }
+                )
+
+    for tid, name in threads.items():
+        events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": tid, "args": {"name": name}})
+
+    return {"traceEvents": events, "otherData": {"lost_events": lost, "frequency": frequency}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", help="dump file, stdin if omitted")
+    parser.add_argument("--tcp", metavar="HOST:PORT", help="read dump from TCP socket")
+    parser.add_argument("-o", "--output", help="output JSON file, stdout if omitted")
+    args = parser.parse_args()
+
+    if args.tcp:
+        lines = read_tcp(args.tcp)
+    elif args.input:
+        with open(args.input, errors="replace") as f:
+            lines = f.read().splitlines()
+    else:
+        lines = sys.stdin.read().splitlines()
+
+    trace = convert(lines)
+    if trace["otherData"]["lost_events"]:
+        print("warning: %d events were overwritten" % trace["otherData"]["lost_events"], file=sys.stderr)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()